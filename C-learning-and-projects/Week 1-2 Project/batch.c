@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "batch.h"
+#include "metrics.h"
+
+static char *nextToken(char **cursor) { // Splits off the next blank-separated word
+    char *p = *cursor;
+    while (*p == ' ' || *p == '\t') ++p;
+    if (!*p) return NULL;
+    char *start = p;
+    while (*p && *p != ' ' && *p != '\t') ++p;
+    if (*p) *p++ = '\0';
+    *cursor = p;
+    return start;
+}
+
+static int toInt(const char *s, int *out) { // Whole token must be an integer
+    if (!s) return -1;
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end || v < -2147483647L - 1 || v > 2147483647L) return -1;
+    *out = (int)v;
+    return 0;
+}
+
+static int toFloat(const char *s, float *out) {
+    if (!s) return -1;
+    char *end;
+    *out = strtof(s, &end);
+    return (end == s || *end) ? -1 : 0;
+}
+
+typedef struct { // Where QUERY rows go
+    const Query *q;
+    FILE *out;
+} QueryOut;
+
+static void printQueryRow(const Item *item, void *ctx) {
+    const QueryOut *qo = ctx;
+    queryPrintRow(qo->q, item, qo->out);
+}
+
+static const char *runCommand(Inventory *inv, char *line, FILE *out, int *printed) { // Executes one line, returns an error reason or NULL
+    char *cursor = line;
+    char *cmd = nextToken(&cursor);
+    for (char *c = cmd; *c; ++c) *c = (char)toupper((unsigned char)*c); // Commands are case-insensitive
+    int id;
+    if (strcmp(cmd, "GET") == 0) {
+        if (toInt(nextToken(&cursor), &id) != 0) return "bad id";
+        const Item *it = inventoryGet(inv, id);
+        if (!it) return "not found";
+        fprintf(out, "%d,%s,%d,%.2f,%s\n", it->id, it->name, it->quantity, it->price, categorytostring(it->category));
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "QTY") == 0) {
+        int qty;
+        if (toInt(nextToken(&cursor), &id) != 0 || toInt(nextToken(&cursor), &qty) != 0) return "usage: QTY <id> <quantity>";
+        int rc = inventorySetQuantity(inv, id, qty);
+        return rc == 0 ? NULL : rc == 1 ? "not found" : "save failed";
+    }
+    if (strcmp(cmd, "DEL") == 0) {
+        if (toInt(nextToken(&cursor), &id) != 0) return "bad id";
+        int rc = inventoryDelete(inv, id);
+        return rc == 0 ? NULL : rc == 1 ? "not found" : "save failed";
+    }
+    if (strcmp(cmd, "ADD") == 0) {
+        Item it;
+        int cat;
+        memset(&it, 0, sizeof it);
+        if (toInt(nextToken(&cursor), &it.id) != 0 || toInt(nextToken(&cursor), &it.quantity) != 0 ||
+            toFloat(nextToken(&cursor), &it.price) != 0 || toInt(nextToken(&cursor), &cat) != 0) {
+            return "usage: ADD <id> <quantity> <price> <category> <name>";
+        }
+        while (*cursor == ' ' || *cursor == '\t') ++cursor; // The rest of the line is the name
+        strncpy(it.name, cursor, sizeof it.name - 1);
+        const char *invalid = itemInvalid(&it); // Same rules as the menu and the server
+        if (invalid) return invalid;
+        it.category = (cat >= 0 && cat <= 3) ? (Category)cat : OTHER; // Same rule as the menu
+        int rc = inventoryAdd(inv, &it);
+        return rc == 0 ? NULL : rc == 1 ? "duplicate id" : "save failed";
+    }
+    if (strcmp(cmd, "STATS") == 0) { // STATS [category]: count,quantity,value,min price,max price
+        int cat = -1;
+        char *arg = nextToken(&cursor);
+        if (arg && toInt(arg, &cat) != 0) return "usage: STATS [category]";
+        ColumnSummary sum;
+        inventorySummarize(inv, cat, &sum);
+        fprintf(out, "%ld,%lld,%.2f,%.2f,%.2f\n", sum.count, sum.quantity, sum.value, sum.minPrice, sum.maxPrice);
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "VALUE") == 0) { // Stock value per category, one line each
+        double value[COL_CATEGORIES];
+        inventoryValueByCategory(inv, value);
+        for (int k = 0; k < COL_CATEGORIES; ++k) fprintf(out, "%s,%.2f\n", categorytostring((Category)k), value[k]);
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "SNAPSHOT") == 0) { // Background snapshot, see snapshot.h
+        return inventorySnapshotNow(inv) < 0 ? "snapshot failed" : NULL;
+    }
+    if (strcmp(cmd, "SNAPSTATS") == 0) { // completed,failed,running,items,duration ms,fork ms,trim ms,cow faults
+        inventoryPollSnapshot(inv);
+        const SnapshotMetrics *m = &inv->snap.metrics;
+        fprintf(out, "%ld,%ld,%d,%ld,%.3f,%.3f,%.3f,%ld\n", m->completed, m->failed, snapshotRunning(&inv->snap),
+                m->items, m->durationMs, m->forkMs, m->trimMs, m->cowFaults);
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "SYNC") == 0) { // Everything so far on stable storage
+        return inventoryWaitDurable(inv) == 0 ? NULL : "save failed";
+    }
+    if (strcmp(cmd, "BEGIN") == 0) {
+        int rc = inventoryBegin(inv);
+        return rc == 0 ? NULL : rc == 1 ? "transaction already open" : "save failed";
+    }
+    if (strcmp(cmd, "COMMIT") == 0) {
+        int rc = inventoryCommit(inv);
+        return rc == 0 ? NULL : rc == 1 ? "no transaction" : "save failed";
+    }
+    if (strcmp(cmd, "ROLLBACK") == 0) {
+        int rc = inventoryRollback(inv);
+        return rc == 0 ? NULL : rc == 1 ? "no transaction" : "rollback failed";
+    }
+    if (strcmp(cmd, "COMMITSTATS") == 0) { // commits,syncs,failed,mean batch,p50 us,p99 us,p99.9 us,max us
+        if (!inv->group) return "group commit is off";
+        GroupCommitStats *st = malloc(sizeof *st); // The histograms are large
+        if (!st) return "out of memory";
+        groupCommitStats(inv->group, st);
+        fprintf(out, "%ld,%ld,%ld,%.2f,%.1f,%.1f,%.1f,%.1f\n", st->commits, st->syncs, st->failures, histMean(&st->batch),
+                histPercentile(&st->latency, 50.0) / 1e3, histPercentile(&st->latency, 99.0) / 1e3,
+                histPercentile(&st->latency, 99.9) / 1e3, st->latency.max / 1e3);
+        free(st);
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "QUERY") == 0) { // QUERY <query>: aggregates as one line, or rows then "ROWS <n>"
+        static char err[QUERY_ERROR_MAX]; // Returned as the reason
+        Query q;
+        if (queryParse(cursor, &q, err) != 0) return err;
+        QueryOut qo = { &q, out };
+        QueryResult res;
+        if (inventoryQuery(inv, &q, q.aggregate ? NULL : printQueryRow, &qo, &res) != 0) return "out of memory";
+        if (q.aggregate) queryPrintAggregates(&q, &res, out, 0);
+        else fprintf(out, "ROWS %ld\n", res.matched);
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "TOP") == 0 || strcmp(cmd, "BOTTOM") == 0) { // TOP|BOTTOM <quantity|price|value> <k> [category]
+        static const char usage[] = "usage: TOP|BOTTOM <quantity|price|value> <k> [category]";
+        char *fieldArg = nextToken(&cursor);
+        int k, cat = -1, field = -1;
+        for (char *c = fieldArg; c && *c; ++c) *c = (char)tolower((unsigned char)*c);
+        for (int f = TOPK_QUANTITY; fieldArg && f <= TOPK_VALUE; ++f) {
+            if (strcmp(fieldArg, topKFieldName((TopKField)f)) == 0) field = f;
+        }
+        if (field < 0 || toInt(nextToken(&cursor), &k) != 0 || k < 0) return usage;
+        char *arg = nextToken(&cursor);
+        if (arg && toInt(arg, &cat) != 0) return usage;
+        if (k > inv->live) k = inv->live; // No more than there are, as in the menu
+        TopKEntry *best = malloc((k ? (size_t)k : 1) * sizeof *best);
+        if (!best) return "out of memory";
+        int n = inventoryTopK(inv, (TopKField)field, cat, cmd[0] == 'T', k, 0, best);
+        for (int i = 0; i < n; ++i) {
+            const Item *it = &inv->items[best[i].slot];
+            fprintf(out, "%d,%s,%d,%.2f,%s\n", it->id, it->name, it->quantity, it->price, categorytostring(it->category));
+        }
+        free(best);
+        if (n < 0) return "out of memory";
+        fprintf(out, "ROWS %d\n", n);
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "NAME") == 0 || strcmp(cmd, "PREFIX") == 0) { // NAME|PREFIX <k> <text>: best k as GET lines, then "ROWS <matches>"
+        int k;
+        if (toInt(nextToken(&cursor), &k) != 0 || k < 0) return "usage: NAME|PREFIX <k> <text>";
+        if (k > inv->live) k = inv->live; // No more than there are
+        while (*cursor == ' ' || *cursor == '\t') ++cursor; // The text is the rest of the line, blanks inside included
+        if (!inv->names && inventoryEnableNameIndex(inv, 0) != 0) return "out of memory"; // Built on first use
+        int *slots = malloc((k ? (size_t)k : 1) * sizeof *slots);
+        if (!slots) return "out of memory";
+        long matches = cmd[0] == 'P' ? inventoryFindByNamePrefix(inv, cursor, slots, k) : inventoryFindByNameText(inv, cursor, slots, k);
+        if (matches < 0) { free(slots); return "out of memory"; }
+        long shown = matches < k ? matches : k;
+        for (long i = 0; i < shown; ++i) {
+            const Item *it = &inv->items[slots[i]];
+            fprintf(out, "%d,%s,%d,%.2f,%s\n", it->id, it->name, it->quantity, it->price, categorytostring(it->category));
+        }
+        free(slots);
+        fprintf(out, "ROWS %ld\n", matches);
+        *printed = 1;
+        return NULL;
+    }
+    if (strcmp(cmd, "METRICS") == 0) { // METRICS [json]: the process-wide operation metrics, see metrics.h
+        char *arg = nextToken(&cursor);
+        for (char *c = arg; c && *c; ++c) *c = (char)tolower((unsigned char)*c);
+        if (arg && strcmp(arg, "json") != 0) return "usage: METRICS [json]";
+        if (metricsDump(out, arg != NULL) != 0) return "out of memory";
+        *printed = 1;
+        return NULL;
+    }
+    return "unknown command";
+}
+
+int runBatch(Inventory *inv, FILE *in, FILE *out, long syncEvery, BatchStats *stats) {
+    memset(stats, 0, sizeof *stats);
+    setvbuf(in, NULL, _IOFBF, BATCH_IO_BUFFER); // Read commands in large chunks
+    setvbuf(out, NULL, _IOFBF, BATCH_IO_BUFFER); // Results are written in large chunks too
+    inventoryDeferLog(inv, 1); // Log records wait in the stdio buffer
+    char line[BATCH_LINE_MAX];
+    int rc = 0;
+    long sinceSync = 0;
+    while (fgets(line, sizeof line, in)) {
+        size_t len = strcspn(line, "\r\n");
+        if (line[len] == '\0' && !feof(in)) { // Line longer than the buffer: skip the rest of it
+            int c; while ((c = fgetc(in)) != '\n' && c != EOF);
+            fputs("ERR line too long\n", out);
+            stats->ops++;
+            stats->failed++;
+            continue;
+        }
+        line[len] = '\0'; // Remove trailing newline character
+        char *p = line;
+        while (*p == ' ' || *p == '\t') ++p;
+        if (*p == '\0' || *p == '#') continue; // Blank line or comment
+        int printed = 0;
+        const char *err = runCommand(inv, p, out, &printed);
+        stats->ops++;
+        if (err) { fprintf(out, "ERR %s\n", err); stats->failed++; }
+        else if (!printed) fputs("OK\n", out); // Queries already printed their result
+        if (syncEvery > 0 && ++sinceSync >= syncEvery) { // Periodic persistence step
+            if (inventoryFlushLog(inv) != 0) rc = -2;
+            inventoryPollSnapshot(inv); // Reap a finished background snapshot
+            stats->syncs++;
+            sinceSync = 0;
+        }
+    }
+    if (inv->txn.active) { fputs("ERR transaction not committed, rolled back\n", out); inventoryRollback(inv); }
+    inventoryDeferLog(inv, 0);
+    if (inventoryWaitDurable(inv) != 0) rc = -2; // Final persistence step: on stable storage before we report success
+    stats->syncs++;
+    fflush(out);
+    return rc;
+}
@@ -0,0 +1,43 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <stdio.h>
+#include "inventory.h"
+
+#define BATCH_IO_BUFFER (1 << 20) // stdio buffer for the command stream and the results
+#define BATCH_LINE_MAX 256 // Longest command line accepted
+
+typedef struct { // Counters filled in by runBatch
+    long ops; // Commands executed
+    long failed; // Commands answered with ERR
+    long syncs; // Times the log was flushed
+} BatchStats;
+
+/*
+Executes a command stream, one command per line:
+  ADD <id> <quantity> <price> <category> <name...>
+  QTY <id> <quantity>
+  DEL <id>
+  GET <id>
+  STATS [category]  (count,quantity,value,min price,max price; all items without a category)
+  VALUE           (category,value per category, four lines)
+  SNAPSHOT        (start a background snapshot)
+  SNAPSTATS       (completed,failed,running,items,duration ms,fork ms,trim ms,cow faults)
+  SYNC            (make everything so far durable and wait for it)
+  BEGIN / COMMIT / ROLLBACK  (transaction: the commands in between apply together or not at all)
+  COMMITSTATS     (commits,syncs,failed,mean batch,p50 us,p99 us,p99.9 us,max us of group commit)
+  QUERY <query>   (see query.h: aggregates as one CSV line, or matching rows then "ROWS <n>")
+  TOP|BOTTOM <quantity|price|value> <k> [category]  (the k highest/lowest items as GET lines, then "ROWS <n>")
+  PREFIX <k> <text>  (items whose name starts with text, in name order: the first k as GET lines, then "ROWS <matches>")
+  NAME <k> <text>    (items whose name contains text, best first, as PREFIX; both ignore case)
+  METRICS [json]  (operation counts, latencies, bytes and probes per lookup as a table or one JSON line)
+Blank lines and lines starting with '#' are ignored. Each command answers
+"OK", "ERR <reason>", or its result on 'out': for GET the item as
+id,name,quantity,price,category. Log records are buffered and flushed every
+'syncEvery' commands (0: only at the end); with group commit each flush is
+also queued for a sync. Everything is durable when it returns. A transaction
+still open at the end is rolled back. Returns 0 on success, negative
+if persisting failed
+*/
+int runBatch(Inventory *inv, FILE *in, FILE *out, long syncEvery, BatchStats *stats);
+
+#endif // BATCH_H
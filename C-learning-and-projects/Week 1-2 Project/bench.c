@@ -0,0 +1,945 @@
+// Benchmark harness for the inventory code.
+// Usage: bench [--items N[,N...]] [--ops M] [--runs R] [--format json|csv] [--out file]
+//              [--dir path] [--seed S] [--keep]
+// For every dataset size it generates a reproducible synthetic inventory
+// (see synth.h) and times loading, saving, opening, lookups, quantity
+// updates, deletes, full listing, reports, queries, top-K, the paged store and sharded
+// opens over 1-16 shards and threads, on the original code path and
+// on the faster modes added since. Results are one row per (op, mode) with
+// ops/sec and latency percentiles in nanoseconds. For bulk operations
+// (save, load, list, ...) 'ops' counts items and the latency is per run.
+// File reads hit the page cache: the file was just written. The *_cold
+// load rows drop the file's cached pages first, so they read the disk.
+// Saves and loads run once on stdio and once on io_uring (when available).
+// The metrics_off/metrics_on rows repeat lookups and in-memory updates with
+// the operation metrics (metrics.h) switched off and on, to show their cost.
+// The name rows build the name index (nameindex.h) on one thread and on all,
+// then run type-ahead prefix and substring queries (best 10) through it and
+// through a scan of every name. The shm rows publish the items in shared
+// memory (shmstore.h) and time random gets from 1, 2 and 4 reader processes
+// (shmreader.h), with the writer idle and with it updating quantities the
+// whole time, plus the writer's update cost with the mirror kept in step.
+// The striped rows run a 90% get / 10% update mix on the thread-safe
+// inventory (striped.h) from 1 to 64 threads: with its lock stripes, with
+// one lock for everything, and with another thread scanning snapshots the
+// whole time (their duration is the striped_scan row).
+#define _GNU_SOURCE // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include "item.h"
+#include "fileio.h"
+#include "inventory.h"
+#include "compact.h"
+#include "columns.h"
+#include "query.h"
+#include "topk.h"
+#include "pagedstore.h"
+#include "sharded.h"
+#include "histogram.h"
+#include "synth.h"
+#include "uring.h"
+#include "metrics.h"
+#include "shmreader.h"
+#include "striped.h"
+
+#define BENCH_MAX_SIZES 16
+#define BENCH_LINEAR_BUDGET 2000000000LL // Item comparisons allowed for the linear-scan lookups
+#define BENCH_SYNC_OPS 20000 // Cap on updates that each wait for fdatasync
+#define BENCH_TOPK 100 // K of the top-K rows (lowest stock, as the restock report asks)
+#define BENCH_SHARDS 4 // Shard counts tried: 1, 4, 16, 64
+#define BENCH_SHARD_THREADS 5 // Thread counts tried: 1, 2, 4, 8, 16 (up to the shard count)
+#define BENCH_PAGED_POOL 256 // Pool pages (1 MB) for the paged store rows: most of the tree stays on disk
+#define BENCH_METRICS_CHUNK 1024 // Metrics cost rows: operations per clock read (one read per op would drown the difference)
+#define BENCH_METRICS_ROUNDS 7 // Off/on alternate this often, the best round of each counts
+#define BENCH_NAME_QUERIES 20000 // Cap on name queries per mode
+#define BENCH_NAME_RESULTS 10 // Matches a type-ahead box shows
+#define BENCH_SHM_READERS 3 // Reader process counts tried: 1, 2, 4
+#define BENCH_STRIPED_THREADS 7 // Thread counts tried: 1, 2, 4, 8, 16, 32, 64
+#define BENCH_STRIPED_MAX_THREADS 64
+#define BENCH_STRIPED_WRITES 10 // Percent of the mixed operations that update a quantity
+#define BENCH_QUERY "select count, sum(value) where category=food and quantity<10 and price>2.5" // Filter + aggregate timed per mode
+
+typedef struct { // Where and how results are written
+    FILE *out;
+    int json;
+    int rows; // Rows written so far (JSON needs commas between them)
+} Report;
+
+static Histogram lat; // Latencies of the measurement in progress (too big for the stack)
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void emit(Report *rep, long items, const char *op, const char *mode, long long ops, uint64_t ns) { // One result row from 'lat'
+    double secs = ns / 1e9;
+    double rate = secs > 0 ? ops / secs : 0.0;
+    if (rep->json) {
+        fprintf(rep->out, "%s\n    {\"items\":%ld,\"op\":\"%s\",\"mode\":\"%s\",\"ops\":%lld,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"latency_ns\":",
+                rep->rows ? "," : "", items, op, mode, ops, secs, rate);
+        histWriteJson(&lat, rep->out);
+        fputc('}', rep->out);
+    } else {
+        fprintf(rep->out, "%ld,%s,%s,%lld,%.6f,%.1f,%.1f,%llu,%llu,%llu,%llu,%llu\n", items, op, mode, ops, secs, rate, histMean(&lat),
+                (unsigned long long)histPercentile(&lat, 50.0), (unsigned long long)histPercentile(&lat, 90.0),
+                (unsigned long long)histPercentile(&lat, 99.0), (unsigned long long)histPercentile(&lat, 99.9),
+                (unsigned long long)lat.max);
+    }
+    fflush(rep->out);
+    rep->rows++;
+    fprintf(stderr, "  %-8s %-13s %14.0f ops/s  p50 %8llu ns  p99 %10llu ns\n", op, mode, rate,
+            (unsigned long long)histPercentile(&lat, 50.0), (unsigned long long)histPercentile(&lat, 99.0));
+}
+
+static void benchQuery(Report *rep, long n, const Inventory *inv, int useColumns, int kernels, int runs) { // One query mode: rows or columns, kernel set
+    Query q;
+    QueryResult res;
+    char err[QUERY_ERROR_MAX];
+    if (queryParse(BENCH_QUERY, &q, err) != 0) { fprintf(stderr, "bench query: %s\n", err); return; }
+    int used = queryUseKernels(kernels);
+    histInit(&lat);
+    uint64_t total = 0;
+    for (int r = 0; r < runs; ++r) {
+        uint64_t t0 = nowNs();
+        queryRun(&q, inv->items, inv->count, useColumns ? inv->cols : NULL, NULL, NULL, &res);
+        uint64_t took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    char mode[32];
+    snprintf(mode, sizeof mode, "%s/%s", useColumns ? "cols" : "rows", columnsKernelName(used));
+    emit(rep, n, "query", mode, (long long)inv->count * runs, total);
+}
+
+static const Item *sortItems; // Items the baseline sort compares
+
+static int byQuantity(const void *a, const void *b) { // Baseline: sort every live slot by quantity, then slot
+    int x = *(const int *)a, y = *(const int *)b;
+    int qx = sortItems[x].quantity, qy = sortItems[y].quantity;
+    return qx != qy ? (qx < qy ? -1 : 1) : x - y;
+}
+
+static void benchTopK(Report *rep, long n, const Inventory *inv, int runs) { // Lowest-stock K: full sort against bounded heaps
+    TopKEntry best[BENCH_TOPK];
+    int *slots = malloc((size_t)(inv->count ? inv->count : 1) * sizeof *slots);
+    if (!slots) return;
+    histInit(&lat);
+    uint64_t total = 0;
+    sortItems = inv->items;
+    for (int r = 0; r < (runs < 2 ? runs : 2); ++r) { // The sort is slow; two runs show it well enough
+        uint64_t t0 = nowNs();
+        int m = 0;
+        for (int i = 0; i < inv->count; ++i) if (inventorySlotLive(inv, i)) slots[m++] = i;
+        qsort(slots, (size_t)m, sizeof *slots, byQuantity);
+        uint64_t took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    emit(rep, n, "topk", "sort", (long long)inv->count * (runs < 2 ? runs : 2), total);
+    free(slots);
+    static const struct { int threads; int cols; const char *mode; } modes[] = {
+        { 1, 0, "heap/rows" }, { 1, 1, "heap/cols" }, { 0, 1, "heap/cols/mt" }
+    };
+    for (size_t m = 0; m < sizeof modes / sizeof modes[0]; ++m) {
+        if (modes[m].cols && !inv->cols) continue;
+        histInit(&lat);
+        total = 0;
+        for (int r = 0; r < runs; ++r) {
+            uint64_t t0 = nowNs();
+            topK(inv->items, inv->count, modes[m].cols ? inv->cols : NULL, TOPK_QUANTITY, -1, 0, BENCH_TOPK, modes[m].threads, best);
+            uint64_t took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, "topk", modes[m].mode, (long long)inv->count * runs, total);
+    }
+}
+
+typedef char NameQuery[8]; // Up to 6 characters of a real name
+
+static long nameQueries(const Inventory *inv, NameQuery *qs, long count, int substring, uint64_t *rng) { // Prefixes (1-6) or inner pieces (3-6) of live names
+    long made = 0;
+    for (long tries = 0; made < count && tries < count * 8; ++tries) {
+        int slot = (int)(synthNext(rng) % (uint64_t)inv->count);
+        if (!inventorySlotLive(inv, slot)) continue;
+        const char *name = inv->items[slot].name;
+        int len = (int)strlen(name);
+        int want = substring ? 3 + (int)(synthNext(rng) % 4) : 1 + (int)(synthNext(rng) % 6);
+        if (want > len) want = len;
+        if (want == 0 || (substring && want < 3)) continue;
+        int at = substring ? (int)(synthNext(rng) % (uint64_t)(len - want + 1)) : 0;
+        memcpy(qs[made], name + at, (size_t)want);
+        qs[made++][want] = '\0';
+    }
+    return made;
+}
+
+static int scanNames(const Inventory *inv, const char *text, int substring) { // Baseline: every live name, case-insensitive
+    int matches = 0;
+    size_t len = strlen(text);
+    for (int i = 0; i < inv->count; ++i) {
+        if (!inventorySlotLive(inv, i)) continue;
+        const char *name = inv->items[i].name;
+        if (!substring) { matches += strncasecmp(name, text, len) == 0; continue; }
+        for (const char *p = name; *p; ++p) {
+            if (strncasecmp(p, text, len) == 0) { matches++; break; }
+        }
+    }
+    return matches;
+}
+
+static void benchNames(Report *rep, long n, Inventory *inv, long ops, int runs, uint64_t seed) { // Name index build, then prefix and substring queries
+    static const struct { int threads; const char *mode; } builds[] = { { 1, "1_thread" }, { 0, "all_threads" } };
+    uint64_t total, t0, took;
+    for (size_t b = 0; b < sizeof builds / sizeof builds[0]; ++b) {
+        histInit(&lat);
+        total = 0;
+        for (int r = 0; r < runs; ++r) {
+            t0 = nowNs();
+            if (inventoryEnableNameIndex(inv, builds[b].threads) != 0) return;
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, "name_build", builds[b].mode, (long long)inv->count * runs, total);
+    }
+    long count = ops < BENCH_NAME_QUERIES ? ops : BENCH_NAME_QUERIES;
+    NameQuery *qs = malloc((size_t)(count ? count : 1) * sizeof *qs);
+    if (!qs) return;
+    uint64_t rng = seed ^ 0x9A3Eu;
+    int slots[BENCH_NAME_RESULTS];
+    volatile long sink = 0;
+    for (int substring = 0; substring < 2; ++substring) {
+        const char *op = substring ? "name_substr" : "name_prefix";
+        long made = nameQueries(inv, qs, count, substring, &rng);
+        histInit(&lat);
+        total = 0;
+        for (long i = 0; i < made; ++i) {
+            t0 = nowNs();
+            sink += substring ? inventoryFindByNameText(inv, qs[i], slots, BENCH_NAME_RESULTS)
+                              : inventoryFindByNamePrefix(inv, qs[i], slots, BENCH_NAME_RESULTS);
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, op, substring ? "trigram" : "trie", made, total);
+        long scans = (long)(BENCH_LINEAR_BUDGET / 20 / (n ? n : 1)); // A name scan costs far more than an id compare
+        if (scans > made) scans = made;
+        if (scans < 1) scans = made < 1 ? 0 : 1;
+        histInit(&lat);
+        total = 0;
+        for (long i = 0; i < scans; ++i) {
+            t0 = nowNs();
+            sink += scanNames(inv, qs[i], substring);
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, op, "scan", scans, total);
+    }
+    (void)sink;
+    free(qs);
+}
+
+static void dropCachedPages(const char *path) { // Evicts the (clean, synced) file from the page cache so the next read goes to disk
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static int *shuffledIds(int n, int count, uint64_t *rng) { // 'count' distinct ids from 1..n in random order
+    int *ids = malloc((size_t)n * sizeof *ids);
+    if (!ids) return NULL;
+    for (int i = 0; i < n; ++i) ids[i] = i + 1;
+    for (int i = 0; i < count && i < n - 1; ++i) { // Partial Fisher-Yates
+        int j = i + (int)(synthNext(rng) % (uint64_t)(n - i));
+        int t = ids[i]; ids[i] = ids[j]; ids[j] = t;
+    }
+    return ids;
+}
+
+static int benchFiles(Report *rep, const char *path, const char *compactPath, int n, int runs, uint64_t seed) { // generate, save, load
+    Item *items = malloc((size_t)n * sizeof *items);
+    if (!items) return -1;
+    histInit(&lat);
+    uint64_t t0 = nowNs();
+    synthItems(items, n, 1, seed);
+    uint64_t took = nowNs() - t0;
+    histRecord(&lat, took);
+    emit(rep, n, "generate", "synth", n, took);
+
+    int ring = ioRingAvailable(); // Without it the uring rows would only time stdio again
+    uint64_t total = 0;
+    for (int b = 0; b < (ring ? 2 : 1); ++b) { // Same file through each backend
+        itemsSetIoBackend(b ? ITEMS_IO_URING : ITEMS_IO_STDIO);
+        histInit(&lat);
+        total = 0;
+        for (int r = 0; r < runs; ++r) {
+            remove(path);
+            t0 = nowNs();
+            if (saveItems(path, items, n) != 0) { itemsSetIoBackend(ITEMS_IO_AUTO); free(items); return -2; }
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, "save", b ? "uring" : "stdio", (long long)n * runs, total);
+    }
+    itemsSetIoBackend(ITEMS_IO_AUTO);
+    if (!ring) fprintf(stderr, "  (io_uring is not available here, no uring rows)\n");
+
+    CompactStore cs; // Compact layout: interned names
+    if (compactFromItems(&cs, items, n) != 0) { free(items); return -1; }
+    histInit(&lat);
+    total = 0;
+    for (int r = 0; r < runs; ++r) {
+        t0 = nowNs();
+        if (compactSave(&cs, compactPath) != 0) { compactFree(&cs); free(items); return -2; }
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    compactFree(&cs);
+    emit(rep, n, "save", "compact", (long long)n * runs, total);
+    free(items);
+
+    static const char *const modes[] = {"stdio", "uring", "stdio_cold", "uring_cold", "mmap", "mmap_verify", "compact"};
+    for (int m = 0; m < 7; ++m) { // Each load path over the same data
+        if (!ring && (m == 1 || m == 3)) continue;
+        itemsSetIoBackend(m == 1 || m == 3 ? ITEMS_IO_URING : ITEMS_IO_STDIO);
+        histInit(&lat);
+        total = 0;
+        for (int r = 0; r < runs; ++r) {
+            Item *arr = NULL;
+            int count = 0, rc;
+            ItemMapping map = {0};
+            if (m == 2 || m == 3) dropCachedPages(path);
+            t0 = nowNs();
+            if (m < 4) rc = loadItems(path, &arr, &count);
+            else if (m == 6) rc = compactLoad(&cs, compactPath);
+            else {
+                rc = loadItemsMapped(path, &arr, &count, &map);
+                if (rc == 0 && m == 5) rc = verifyMappedItems(&map);
+                if (rc == 0 && count > 0) { // Touch every record so lazy page faults are paid here
+                    volatile long sum = 0;
+                    for (int i = 0; i < count; i += 60) sum += arr[i].id; // About one touch per 4 KB page
+                }
+            }
+            took = nowNs() - t0;
+            if (rc != 0) { itemsSetIoBackend(ITEMS_IO_AUTO); return -3; }
+            if (m == 6) compactFree(&cs);
+            else releaseItems(arr, &map);
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, "load", modes[m], (long long)n * runs, total);
+    }
+    itemsSetIoBackend(ITEMS_IO_AUTO);
+    return 0;
+}
+
+static uint64_t metricsRound(Inventory *inv, int n, long ops, uint64_t seed, int update) { // One timed pass of lookups or updates
+    uint64_t rng = seed, total = 0;
+    volatile int sink = 0;
+    for (long i = 0; i < ops; i += BENCH_METRICS_CHUNK) {
+        long m = ops - i < BENCH_METRICS_CHUNK ? ops - i : BENCH_METRICS_CHUNK;
+        uint64_t t0 = nowNs();
+        for (long k = 0; k < m; ++k) {
+            int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+            if (update) inventorySetQuantity(inv, id, (int)(k & 1023));
+            else sink += inventoryFind(inv, id);
+        }
+        uint64_t took = nowNs() - t0;
+        histRecordN(&lat, took / (uint64_t)m, (uint64_t)m); // Chunk average per operation
+        total += took;
+    }
+    return total;
+}
+
+static void benchMetricsCost(Report *rep, Inventory *inv, int n, long ops, uint64_t seed) { // Same ids with the metrics off and on
+    static const char *const modes[] = {"metrics_off", "metrics_on"};
+    for (int update = 0; update < 2; ++update) {
+        if (update) inventoryBeginBulk(inv); // Memory only, so the log does not hide the difference
+        uint64_t best[2] = {UINT64_MAX, UINT64_MAX};
+        static Histogram bestLat[2];
+        for (int r = 0; r < BENCH_METRICS_ROUNDS * 2; ++r) {
+            int on = r & 1;
+            metricsEnable(on);
+            histInit(&lat);
+            uint64_t total = metricsRound(inv, n, ops, seed, update);
+            if (total < best[on]) { best[on] = total; bestLat[on] = lat; }
+        }
+        metricsEnable(1);
+        if (update) inventoryEndBulk(inv);
+        for (int on = 0; on < 2; ++on) {
+            lat = bestLat[on];
+            emit(rep, n, update ? "update" : "lookup", modes[on], ops, best[on]);
+        }
+        fprintf(stderr, "  metrics cost on %s: %+.1f%%\n", update ? "updates" : "lookups", 100.0 * ((double)best[1] / (double)best[0] - 1.0));
+    }
+}
+
+typedef struct { // One reader process's results, in memory shared with the parent
+    long long ops;
+    uint64_t ns; // Its wall time
+    uint64_t retries; // Reads repeated because the writer was in the middle of the record
+    Histogram lat;
+} SharedResult;
+
+static void sharedReader(SharedResult *res, const char *name, int n, long ops, uint64_t rng) { // Child process: random gets, never returns
+    ShmReader r;
+    if (shmReaderOpen(&r, name) != 0) _exit(1);
+    histInit(&res->lat);
+    Item item;
+    uint64_t start = nowNs();
+    for (long i = 0; i < ops; ++i) {
+        int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+        uint64_t t0 = nowNs();
+        if (shmReaderGet(&r, id, &item) < 0) _exit(1);
+        histRecord(&res->lat, nowNs() - t0);
+    }
+    res->ns = nowNs() - start;
+    res->ops = ops;
+    res->retries = r.retries;
+    shmReaderClose(&r);
+    _exit(0);
+}
+
+static int benchShared(Report *rep, Inventory *inv, int n, long ops, uint64_t seed) { // Readers in other processes, with and without a writer
+    static const int readerCounts[BENCH_SHM_READERS] = {1, 2, 4};
+    static Histogram writes; // The writer's updates while the readers run
+    char name[SHM_NAME_MAX], mode[32];
+    snprintf(name, sizeof name, "/inventory-bench-%d", (int)getpid());
+    if (inventoryEnableShared(inv, name) != 0) { perror("shm rows skipped"); return 0; } // No /dev/shm here
+    size_t resBytes = (size_t)readerCounts[BENCH_SHM_READERS - 1] * sizeof(SharedResult); // One per reader of the largest round
+    SharedResult *res = mmap(NULL, resBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (res == MAP_FAILED) return -1;
+    uint64_t rng = seed ^ 0x5A4Eu, total = 0, t0, took;
+    inventoryBeginBulk(inv); // Memory only: the log would hide what the mirror costs
+    histInit(&lat);
+    for (long i = 0; i < ops; ++i) { // Compare with the "update memory" row
+        int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+        t0 = nowNs();
+        if (inventorySetQuantity(inv, id, (int)(i & 1023)) < 0) { munmap(res, resBytes); inventoryEndBulk(inv); return -4; }
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    emit(rep, n, "shm_write", "no_readers", ops, total);
+    int rc = 0;
+    for (int c = 0; c < BENCH_SHM_READERS && rc == 0; ++c) {
+        for (int writing = 0; writing < 2 && rc == 0; ++writing) {
+            int readers = readerCounts[c], running = 0;
+            for (int k = 0; k < readers; ++k) {
+                pid_t pid = fork();
+                if (pid == 0) sharedReader(&res[k], name, n, ops, seed ^ (uint64_t)(c * 16 + k + 1));
+                if (pid > 0) running++;
+            }
+            long long written = 0;
+            uint64_t writeNs = 0;
+            histInit(&writes);
+            while (writing && running > 0) { // Update until the last reader is done
+                for (int b = 0; b < 1024; ++b, ++written) {
+                    int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+                    t0 = nowNs();
+                    if (inventorySetQuantity(inv, id, (int)(written & 1023)) < 0) rc = -4;
+                    took = nowNs() - t0;
+                    histRecord(&writes, took);
+                    writeNs += took;
+                }
+                int status;
+                while (running > 0 && waitpid(-1, &status, WNOHANG) > 0) running--;
+            }
+            int failed = 0, status;
+            while (running > 0 && wait(&status) > 0) {
+                running--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = 1;
+            }
+            if (failed) { rc = -4; break; }
+            histInit(&lat);
+            long long got = 0;
+            uint64_t wall = 0, retries = 0;
+            for (int k = 0; k < readers; ++k) { // All readers together: their ops over the slowest one's time
+                histMerge(&lat, &res[k].lat);
+                got += res[k].ops;
+                if (res[k].ns > wall) wall = res[k].ns;
+                retries += res[k].retries;
+            }
+            snprintf(mode, sizeof mode, "%s_r%d", writing ? "writing" : "idle", readers);
+            emit(rep, n, "shm_get", mode, got, wall);
+            fprintf(stderr, "  shm readers retried %llu of %lld gets\n", (unsigned long long)retries, got);
+            if (writing) {
+                lat = writes;
+                snprintf(mode, sizeof mode, "r%d", readers);
+                emit(rep, n, "shm_write", mode, written, writeNs);
+            }
+        }
+    }
+    munmap(res, resBytes);
+    if (inventoryEndBulk(inv) != 0 && rc == 0) rc = -4;
+    return rc;
+}
+
+static int benchOps(Report *rep, const char *path, int n, long ops, int runs, uint64_t seed) { // open, lookups, updates, deletes, listing
+    Inventory inv;
+    uint64_t total = 0, t0, took;
+    static const char *const openModes[] = {"heap", "mmap"};
+    for (int m = 0; m < 2; ++m) { // Load plus id index
+        histInit(&lat);
+        total = 0;
+        for (int r = 0; r < runs; ++r) {
+            t0 = nowNs();
+            if (inventoryOpen(&inv, path, m ? INV_OPEN_MMAP : 0) != 0) return -3;
+            took = nowNs() - t0;
+            inventoryClose(&inv);
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, "open", openModes[m], (long long)n * runs, total);
+    }
+
+    if (inventoryOpen(&inv, path, 0) != 0) return -3;
+    int rc = 0;
+    uint64_t rng = seed ^ 0x5EEDu;
+    uint64_t timerStart = nowNs(); // Cost of the timing itself, to read the small latencies against
+    histInit(&lat);
+    for (long i = 0; i < ops; ++i) {
+        uint64_t a = nowNs();
+        histRecord(&lat, nowNs() - a);
+    }
+    emit(rep, n, "timer", "clock_gettime", ops, nowNs() - timerStart);
+
+    volatile int sink = 0;
+    histInit(&lat);
+    total = 0;
+    for (long i = 0; i < ops; ++i) { // Hash index
+        int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+        t0 = nowNs();
+        sink += inventoryFind(&inv, id);
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    emit(rep, n, "lookup", "hash", ops, total);
+    benchMetricsCost(rep, &inv, n, ops, seed ^ 0xC057u);
+
+    long linearOps = (long)(BENCH_LINEAR_BUDGET / n); // The original menu's linear search, kept affordable
+    if (linearOps > ops) linearOps = ops;
+    if (linearOps < 1) linearOps = 1;
+    histInit(&lat);
+    total = 0;
+    for (long i = 0; i < linearOps; ++i) {
+        int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+        t0 = nowNs();
+        for (int k = 0; k < inv.count; ++k) if (inv.items[k].id == id) { sink += k; break; }
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    emit(rep, n, "lookup", "linear", linearOps, total);
+
+    static const char *const updateModes[] = {"wal", "wal_deferred", "memory"};
+    for (int m = 0; m < 3; ++m) { // Durable per op, batched, and no log at all
+        if (m == 2) inventoryBeginBulk(&inv); // Logging off
+        inventoryDeferLog(&inv, m == 1);
+        histInit(&lat);
+        total = 0;
+        for (long i = 0; i < ops; ++i) {
+            int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+            t0 = nowNs();
+            if (inventorySetQuantity(&inv, id, (int)(i & 1023)) < 0) { rc = -4; goto done; }
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        t0 = nowNs();
+        if (inventoryFlushLog(&inv) != 0) { rc = -4; goto done; } // Deferred records count too
+        total += nowNs() - t0;
+        if (m == 2) inventoryEndBulk(&inv);
+        inventoryDeferLog(&inv, 0);
+        emit(rep, n, "update", updateModes[m], ops, total);
+    }
+
+    long deletes = ops < n / 2 ? ops : n / 2; // Leave half the items for the listing
+    int *ids = shuffledIds(n, (int)deletes, &rng);
+    if (!ids) { rc = -1; goto done; }
+    histInit(&lat);
+    total = 0;
+    for (long i = 0; i < deletes; ++i) { // Tombstones plus the occasional compaction
+        t0 = nowNs();
+        if (inventoryDelete(&inv, ids[i]) != 0) { free(ids); rc = -4; goto done; }
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    free(ids);
+    emit(rep, n, "delete", "wal", deletes, total);
+
+    fflush(stdout); // Listing prints through printItem, so stdout goes to /dev/null meanwhile
+    int saved = dup(1), devnull = open("/dev/null", O_WRONLY);
+    if (saved >= 0 && devnull >= 0) {
+        dup2(devnull, 1);
+        histInit(&lat);
+        total = 0;
+        for (int r = 0; r < runs; ++r) {
+            t0 = nowNs();
+            for (int i = 0; i < inv.count; ++i) if (inventorySlotLive(&inv, i)) printItem(&inv.items[i]);
+            fflush(stdout);
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        dup2(saved, 1);
+        emit(rep, n, "list", "printItem", (long long)inv.live * runs, total);
+    }
+    if (saved >= 0) close(saved);
+    if (devnull >= 0) close(devnull);
+
+    ColumnSummary sum;
+    histInit(&lat);
+    total = 0;
+    for (int r = 0; r < runs; ++r) { // Reports: row scan against the columnar copy
+        t0 = nowNs();
+        rowsSummarize(inv.items, inv.count, -1, &sum);
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    emit(rep, n, "summary", "rows", (long long)inv.count * runs, total);
+    if (inventoryEnableColumns(&inv) == 0) {
+        histInit(&lat);
+        total = 0;
+        for (int r = 0; r < runs; ++r) {
+            t0 = nowNs();
+            columnsSummarize(inv.cols, -1, &sum);
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, "summary", columnsKernelName(columnsUseKernels(COL_KERNEL_AVX2)), (long long)inv.count * runs, total);
+    }
+    benchQuery(rep, n, &inv, 0, COL_KERNEL_SCALAR, runs); // Filter language: branch-free masks, then AVX2, rows then columns
+    benchQuery(rep, n, &inv, 0, COL_KERNEL_AVX2, runs);
+    if (inv.cols) {
+        benchQuery(rep, n, &inv, 1, COL_KERNEL_SCALAR, runs);
+        benchQuery(rep, n, &inv, 1, COL_KERNEL_AVX2, runs);
+    }
+    benchTopK(rep, n, &inv, runs);
+    benchNames(rep, n, &inv, ops, runs, seed);
+
+    long syncOps = ops < BENCH_SYNC_OPS ? ops : BENCH_SYNC_OPS; // Durable updates: one fdatasync each
+    histInit(&lat);
+    total = 0;
+    for (long i = 0; i < syncOps; ++i) {
+        int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+        t0 = nowNs();
+        if (inventorySetQuantity(&inv, id, (int)(i & 1023)) < 0 || inventoryWaitDurable(&inv) != 0) { rc = -4; goto done; }
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    emit(rep, n, "update", "fsync", syncOps, total);
+
+    if (inventoryEnableGroupCommit(&inv, GC_DEFAULT_DELAY_US, GC_DEFAULT_BATCH) == 0) { // Durable too, syncs shared
+        histInit(&lat);
+        total = 0;
+        for (long i = 0; i < ops; ++i) {
+            int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+            t0 = nowNs();
+            if (inventorySetQuantity(&inv, id, (int)(i & 1023)) < 0) { rc = -4; goto done; }
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        t0 = nowNs();
+        if (inventoryWaitDurable(&inv) != 0) { rc = -4; goto done; } // Until the last one is on disk
+        total += nowNs() - t0;
+        emit(rep, n, "update", "group", ops, total);
+        GroupCommitStats *st = malloc(sizeof *st);
+        if (st) { // Queued -> durable per commit
+            groupCommitStats(inv.group, st);
+            lat = st->latency;
+            emit(rep, n, "commit", "group", st->commits, total);
+            lat = st->batch;
+            emit(rep, n, "sync_batch", "group", st->syncs, total); // Latency columns hold commits per sync here
+            free(st);
+        }
+    }
+    rc = benchShared(rep, &inv, n, ops, seed); // Last: from here on every change also goes to the segment
+    (void)sink;
+done:
+    inventoryClose(&inv); // Also stops the group-commit thread and closes the log
+    return rc;
+}
+
+static int benchShards(Report *rep, const char *path, const char *manifest, int n, int runs) { // Startup: shard count against threads
+    static const int shardCounts[BENCH_SHARDS] = {1, 4, 16, 64};
+    static const int threadCounts[BENCH_SHARD_THREADS] = {1, 2, 4, 8, 16};
+    for (int c = 0; c < BENCH_SHARDS; ++c) {
+        histInit(&lat);
+        uint64_t t0 = nowNs();
+        if (shardSplit(path, manifest, shardCounts[c], SHARD_BY_HASH, 0) != 0) return -2;
+        uint64_t took = nowNs() - t0;
+        histRecord(&lat, took);
+        char mode[32];
+        snprintf(mode, sizeof mode, "shards%d", shardCounts[c]);
+        emit(rep, n, "split", mode, n, took);
+        for (int t = 0; t < BENCH_SHARD_THREADS && threadCounts[t] <= shardCounts[c]; ++t) { // Load, verify and index every shard
+            ShardedInventory si;
+            uint64_t total = 0;
+            histInit(&lat);
+            for (int r = 0; r < runs; ++r) {
+                t0 = nowNs();
+                if (shardedOpen(&si, manifest, 0, threadCounts[t]) != 0) return -3;
+                took = nowNs() - t0;
+                shardedClose(&si);
+                histRecord(&lat, took);
+                total += took;
+            }
+            snprintf(mode, sizeof mode, "shards%d_t%d", shardCounts[c], threadCounts[t]);
+            emit(rep, n, "open", mode, (long long)n * runs, total);
+        }
+    }
+    shardRemoveAll(manifest);
+    return 0;
+}
+
+static int countItem(const Item *item, void *ctx) { (void)item; ++*(long *)ctx; return 0; }
+
+static int benchPaged(Report *rep, const char *path, const char *pagedPath, int n, long ops, uint64_t seed) { // Same items behind a 1 MB pool
+    PagedStore ps;
+    if (pagedOpen(&ps, pagedPath, BENCH_PAGED_POOL) < 0) return -3;
+    histInit(&lat);
+    long added;
+    uint64_t t0 = nowNs();
+    if (pagedImportItems(&ps, path, &added) != 0) { pagedClose(&ps); return -3; }
+    uint64_t took = nowNs() - t0, total;
+    histRecord(&lat, took);
+    emit(rep, n, "import", "paged", added, took);
+
+    uint64_t rng = seed ^ 0xBA6Eu;
+    static const char *const lookupModes[] = {"paged", "paged_absent"};
+    for (int m = 0; m < 2; ++m) { // Present ids walk the tree, absent ones mostly stop at the Bloom filter
+        Item item;
+        histInit(&lat);
+        total = 0;
+        for (long i = 0; i < ops; ++i) {
+            int id = 1 + (int)(synthNext(&rng) % (uint64_t)n) + (m ? n : 0);
+            t0 = nowNs();
+            if (pagedGet(&ps, id, &item) < 0) { pagedClose(&ps); return -4; }
+            took = nowNs() - t0;
+            histRecord(&lat, took);
+            total += took;
+        }
+        emit(rep, n, "lookup", lookupModes[m], ops, total);
+    }
+
+    histInit(&lat);
+    total = 0;
+    for (long i = 0; i < ops; ++i) { // Logged, not synced: the "wal" update row of the array
+        int id = 1 + (int)(synthNext(&rng) % (uint64_t)n);
+        t0 = nowNs();
+        if (pagedSetQuantity(&ps, id, (int)(i & 1023)) < 0) { pagedClose(&ps); return -4; }
+        took = nowNs() - t0;
+        histRecord(&lat, took);
+        total += took;
+    }
+    emit(rep, n, "update", "paged", ops, total);
+
+    long seen = 0;
+    histInit(&lat);
+    t0 = nowNs();
+    if (pagedScan(&ps, 1, n, countItem, &seen) != 0) { pagedClose(&ps); return -4; }
+    took = nowNs() - t0;
+    histRecord(&lat, took);
+    emit(rep, n, "scan", "paged", seen, took);
+    return pagedClose(&ps) == 0 ? 0 : -4;
+}
+
+typedef struct { // One thread of the striped rows
+    StripedInventory *si;
+    int n;
+    long ops;
+    uint64_t seed;
+    Histogram *lat;
+    int failed;
+} StripedWorker;
+
+static void *stripedWorker(void *arg) { // Random gets and updates
+    StripedWorker *w = arg;
+    uint64_t rng = w->seed;
+    Item item;
+    histInit(w->lat);
+    for (long i = 0; i < w->ops; ++i) {
+        uint64_t r = synthNext(&rng);
+        int id = 1 + (int)(r % (uint64_t)w->n);
+        uint64_t t0 = nowNs();
+        int rc = (r >> 40) % 100 < BENCH_STRIPED_WRITES ? stripedSetQuantity(w->si, id, (int)(i & 1023)) : stripedGet(w->si, id, &item);
+        histRecord(w->lat, nowNs() - t0);
+        if (rc != 0) w->failed = 1;
+    }
+    return NULL;
+}
+
+typedef struct { // The thread taking snapshots during the *_scanning rows
+    StripedInventory *si;
+    int stop;
+    long scans, items;
+    Histogram lat;
+} StripedScanner;
+
+static void *stripedScanner(void *arg) { // Consistent listings, back to back, until told to stop
+    StripedScanner *sc = arg;
+    while (!__atomic_load_n(&sc->stop, __ATOMIC_ACQUIRE)) {
+        uint64_t t0 = nowNs();
+        if (stripedScan(sc->si, countItem, &sc->items) != 0) break;
+        histRecord(&sc->lat, nowNs() - t0);
+        sc->scans++;
+    }
+    return NULL;
+}
+
+static int benchStriped(Report *rep, int n, long ops, uint64_t seed) { // Mixed throughput from 1 to 64 threads
+    static const int threadCounts[BENCH_STRIPED_THREADS] = {1, 2, 4, 8, 16, 32, BENCH_STRIPED_MAX_THREADS};
+    static const struct { int stripes; const char *suffix; } layouts[] = { { STRIPED_DEFAULT_STRIPES, "" }, { 1, "_1lock" } };
+    Item *items = malloc((size_t)n * sizeof *items);
+    Histogram *lats = malloc(BENCH_STRIPED_MAX_THREADS * sizeof *lats); // One per thread, merged afterwards
+    StripedScanner *sc = malloc(sizeof *sc);
+    if (!items || !lats || !sc) { free(items); free(lats); free(sc); return -1; }
+    synthItems(items, n, 1, seed);
+    int rc = 0;
+    char mode[32];
+    for (size_t l = 0; l < sizeof layouts / sizeof layouts[0] && rc == 0; ++l) {
+        StripedInventory si;
+        if (stripedInit(&si, layouts[l].stripes) != 0) { rc = -1; break; }
+        histInit(&lat);
+        uint64_t t0 = nowNs();
+        for (int i = 0; i < n && rc == 0; ++i) if (stripedAdd(&si, &items[i]) < 0) rc = -1;
+        uint64_t took = nowNs() - t0;
+        histRecord(&lat, took);
+        snprintf(mode, sizeof mode, "load%s", layouts[l].suffix);
+        if (rc == 0) emit(rep, n, "striped", mode, n, took);
+        for (int scanning = 0; scanning < (l == 0 ? 2 : 1) && rc == 0; ++scanning) { // Snapshots only against the stripes
+            for (int c = 0; c < BENCH_STRIPED_THREADS && rc == 0; ++c) {
+                int threads = threadCounts[c];
+                StripedWorker workers[BENCH_STRIPED_MAX_THREADS];
+                pthread_t tids[BENCH_STRIPED_MAX_THREADS];
+                memset(sc, 0, sizeof *sc);
+                sc->si = &si;
+                histInit(&sc->lat);
+                pthread_t scanTid;
+                int scannerUp = scanning && pthread_create(&scanTid, NULL, stripedScanner, sc) == 0;
+                int started = 0;
+                t0 = nowNs();
+                for (int t = 0; t < threads; ++t) {
+                    workers[t] = (StripedWorker){ &si, n, ops / threads > 0 ? ops / threads : 1, seed ^ (uint64_t)(t + 1) * 0x9E3779B97F4A7C15u, &lats[t], 0 };
+                    if (pthread_create(&tids[t], NULL, stripedWorker, &workers[t]) != 0) break;
+                    started++;
+                }
+                long long done = 0;
+                histInit(&lat);
+                for (int t = 0; t < started; ++t) {
+                    pthread_join(tids[t], NULL);
+                    histMerge(&lat, &lats[t]);
+                    done += workers[t].ops;
+                    if (workers[t].failed) rc = -4;
+                }
+                took = nowNs() - t0;
+                if (scannerUp) {
+                    __atomic_store_n(&sc->stop, 1, __ATOMIC_RELEASE);
+                    pthread_join(scanTid, NULL);
+                }
+                if (started < threads) rc = -1;
+                if (rc != 0) break;
+                snprintf(mode, sizeof mode, "t%d%s", threads, scanning ? "_scanning" : layouts[l].suffix);
+                emit(rep, n, "striped_mix", mode, done, took);
+                if (scanning && sc->scans > 0) {
+                    lat = sc->lat;
+                    snprintf(mode, sizeof mode, "t%d", threads);
+                    emit(rep, n, "striped_scan", mode, sc->items, took); // ops: items listed, latency: one whole scan
+                }
+            }
+        }
+        stripedFree(&si);
+    }
+    free(items);
+    free(lats);
+    free(sc);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    long sizes[BENCH_MAX_SIZES] = {1000, 100000, 1000000};
+    int nSizes = 3, runs = 3, keep = 0;
+    long ops = 1000000;
+    uint64_t seed = SYNTH_DEFAULT_SEED;
+    const char *dir = ".", *outPath = NULL;
+    Report rep = {stdout, 1, 0};
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--keep") == 0) keep = 1;
+        else if (i + 1 >= argc) { fprintf(stderr, "Missing value for %s\n", argv[i]); return 1; }
+        else if (strcmp(argv[i], "--items") == 0) { // Comma-separated sizes
+            nSizes = 0;
+            for (char *p = argv[++i]; *p && nSizes < BENCH_MAX_SIZES; ) {
+                char *end;
+                sizes[nSizes] = strtol(p, &end, 10);
+                if (end == p || sizes[nSizes] < 1 || sizes[nSizes] > 0x7FFFFFFFL) { fprintf(stderr, "Bad size list.\n"); return 1; }
+                nSizes++;
+                p = *end == ',' ? end + 1 : end;
+            }
+        }
+        else if (strcmp(argv[i], "--ops") == 0) ops = strtol(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--runs") == 0) runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--format") == 0) rep.json = strcmp(argv[++i], "csv") != 0;
+        else if (strcmp(argv[i], "--out") == 0) outPath = argv[++i];
+        else if (strcmp(argv[i], "--dir") == 0) dir = argv[++i];
+        else if (strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[++i], NULL, 10);
+        else { fprintf(stderr, "Unknown option %s\n", argv[i]); return 1; }
+    }
+    if (ops < 1 || runs < 1) { fprintf(stderr, "--ops and --runs must be positive.\n"); return 1; }
+    if (outPath && !(rep.out = fopen(outPath, "w"))) { perror(outPath); return 1; }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN); // The sharded open rows only scale up to this
+    fprintf(stderr, "%ld CPUs online\n", cores);
+    if (rep.json) fprintf(rep.out, "{\"benchmark\":\"inventory\",\"seed\":%llu,\"ops\":%ld,\"runs\":%d,\"cores\":%ld,\"results\":[",
+                          (unsigned long long)seed, ops, runs, cores);
+    else fprintf(rep.out, "items,op,mode,ops,seconds,ops_per_sec,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    int rc = 0;
+    for (int s = 0; s < nSizes && rc == 0; ++s) {
+        int n = (int)sizes[s];
+        char path[WAL_PATH_MAX], compactPath[WAL_PATH_MAX], logPath[WAL_PATH_MAX + 8], pagedPath[WAL_PATH_MAX], pagedAux[WAL_PATH_MAX + 8], manifest[WAL_PATH_MAX];
+        static const char *const pagedSuffixes[] = {"", WAL_SUFFIX, BP_JOURNAL_SUFFIX, PAGED_BLOOM_SUFFIX};
+        snprintf(path, sizeof path, "%s/bench_%d.dat", dir, n);
+        snprintf(compactPath, sizeof compactPath, "%s/bench_%d.cmp", dir, n);
+        snprintf(pagedPath, sizeof pagedPath, "%s/bench_%d.pages", dir, n);
+        snprintf(manifest, sizeof manifest, "%s/bench_%d.shards", dir, n);
+        snprintf(logPath, sizeof logPath, "%s%s", path, WAL_SUFFIX);
+        remove(logPath); // Start from the snapshot alone
+        for (int k = 0; k < 4; ++k) { snprintf(pagedAux, sizeof pagedAux, "%s%s", pagedPath, pagedSuffixes[k]); remove(pagedAux); }
+        fprintf(stderr, "%d items:\n", n);
+        rc = benchFiles(&rep, path, compactPath, n, runs, seed);
+        if (rc == 0) rc = benchShards(&rep, path, manifest, n, runs);
+        if (rc == 0) rc = benchOps(&rep, path, n, ops, runs, seed);
+        if (rc == 0) rc = benchPaged(&rep, path, pagedPath, n, ops, seed);
+        if (rc == 0) rc = benchStriped(&rep, n, ops, seed);
+        if (rc != 0) fprintf(stderr, "Benchmark failed at %d items (%d).\n", n, rc);
+        if (!keep) {
+            remove(path); remove(compactPath); remove(logPath);
+            for (int k = 0; k < 4; ++k) { snprintf(pagedAux, sizeof pagedAux, "%s%s", pagedPath, pagedSuffixes[k]); remove(pagedAux); }
+        }
+    }
+    if (rep.json) fprintf(rep.out, "\n]}\n");
+    if (rep.out != stdout) fclose(rep.out);
+    return rc == 0 ? 0 : 1;
+}
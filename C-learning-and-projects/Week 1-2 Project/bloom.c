@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bloom.h"
+#include "crc32c.h"
+#include "fileio.h"
+
+static const char BLOOM_MAGIC[8] = {'I', 'N', 'V', 'B', 'L', 'O', 'O', 'M'};
+#define BLOOM_HEADER 40 // magic, tag, mask, hashes, expected, CRC32C of the bits
+
+static uint64_t mix(int32_t id) { // splitmix64 finalizer: every id bit moves every output bit
+    uint64_t z = (uint64_t)(uint32_t)id + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+int bloomInit(BloomFilter *b, long expected, int bitsPerId) {
+    memset(b, 0, sizeof *b);
+    if (expected < 1024) expected = 1024;
+    if (bitsPerId < 1) bitsPerId = BLOOM_BITS_PER_ID;
+    uint64_t m = 64;
+    while (m < (uint64_t)expected * (uint64_t)bitsPerId) m <<= 1; // Power of two: probes are masked, not divided
+    int k = (int)((double)m / (double)expected * 0.6931 + 0.5); // k = m/n ln 2 for the rounded-up m
+    b->hashes = k < 1 ? 1 : k > BLOOM_MAX_HASHES ? BLOOM_MAX_HASHES : k;
+    b->mask = m - 1;
+    b->expected = expected;
+    b->bits = calloc(m / 64, sizeof *b->bits);
+    return b->bits ? 0 : -1;
+}
+
+void bloomFree(BloomFilter *b) {
+    free(b->bits);
+    memset(b, 0, sizeof *b);
+}
+
+void bloomAdd(BloomFilter *b, int32_t id) {
+    uint64_t h = mix(id);
+    uint64_t h1 = h, h2 = (h >> 32) | 1; // Odd step: the probes never cycle early
+    for (int i = 0; i < b->hashes; ++i) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) & b->mask;
+        b->bits[bit >> 6] |= 1ull << (bit & 63);
+    }
+    b->added++;
+}
+
+int bloomMayContain(const BloomFilter *b, int32_t id) {
+    uint64_t h = mix(id);
+    uint64_t h1 = h, h2 = (h >> 32) | 1;
+    for (int i = 0; i < b->hashes; ++i) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) & b->mask;
+        if (!(b->bits[bit >> 6] & (1ull << (bit & 63)))) return 0;
+    }
+    return 1;
+}
+
+int bloomSave(const BloomFilter *b, const char *path, uint64_t tag) {
+    char tmp[WAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return -1;
+    uint64_t hdr[5] = { tag, b->mask, (uint64_t)b->hashes, (uint64_t)b->expected, crc32c(0, b->bits, bloomBytes(b)) };
+    int rc = fwrite(BLOOM_MAGIC, 1, 8, fp) == 8 && fwrite(hdr, sizeof hdr[0], 4, fp) == 4 && fwrite(&hdr[4], 4, 1, fp) == 1 &&
+             fwrite(b->bits, 1, bloomBytes(b), fp) == bloomBytes(b) ? 0 : -1; // Host byte order: the file is a cache, rebuilt when it does not fit
+    if (rc == 0 && syncFile(fp) != 0) rc = -1;
+    if (fclose(fp) != 0) rc = -1;
+#ifdef _WIN32
+    if (rc == 0) remove(path);
+#endif
+    if (rc == 0 && rename(tmp, path) != 0) rc = -1;
+    if (rc != 0) remove(tmp);
+    return rc;
+}
+
+int bloomLoad(BloomFilter *b, const char *path, uint64_t tag) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    char magic[8];
+    uint64_t hdr[4];
+    uint32_t crc;
+    int rc = fread(magic, 1, 8, fp) == 8 && memcmp(magic, BLOOM_MAGIC, 8) == 0 && fread(hdr, sizeof hdr[0], 4, fp) == 4 &&
+             fread(&crc, 4, 1, fp) == 1 && hdr[0] == tag && hdr[1] >= 63 && ((hdr[1] + 1) & hdr[1]) == 0 &&
+             hdr[2] >= 1 && hdr[2] <= BLOOM_MAX_HASHES ? 0 : -1;
+    if (rc == 0) {
+        memset(b, 0, sizeof *b);
+        b->mask = hdr[1];
+        b->hashes = (int)hdr[2];
+        b->expected = (long)hdr[3];
+        b->bits = malloc(bloomBytes(b));
+        if (!b->bits || fread(b->bits, 1, bloomBytes(b), fp) != bloomBytes(b) || crc32c(0, b->bits, bloomBytes(b)) != crc) {
+            bloomFree(b);
+            rc = -1;
+        }
+    }
+    fclose(fp);
+    return rc;
+}
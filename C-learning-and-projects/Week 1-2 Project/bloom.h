@@ -0,0 +1,44 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+#include <stdint.h>
+
+/*
+Bloom filter over item ids: answers "certainly absent" or "maybe present".
+Sized at a number of bits per expected id (10 bits give about 1% false
+positives, each 5 more divide that by ten); the bit count is rounded up to a power of two and the k probes come from double hashing of
+one 64-bit mix of the id. Deleting is not possible: a deleted id keeps
+answering "maybe" until the filter is rebuilt
+*/
+#define BLOOM_BITS_PER_ID 10 // About 1% false positives
+#define BLOOM_MAX_HASHES 16
+
+typedef struct {
+    uint64_t *bits;
+    uint64_t mask; // Bit count - 1
+    int hashes; // Probes per id
+    long expected; // Ids it was sized for
+    long added; // Ids added since it was built
+} BloomFilter;
+
+/* Sizes an empty filter for 'expected' ids at 'bitsPerId' bits each. Returns 0 on success, -1 on failure */
+int bloomInit(BloomFilter *b, long expected, int bitsPerId);
+
+/* Releases the bits */
+void bloomFree(BloomFilter *b);
+
+void bloomAdd(BloomFilter *b, int32_t id);
+
+/* Returns 0 if 'id' was never added, 1 if it may have been */
+int bloomMayContain(const BloomFilter *b, int32_t id);
+
+/* Bytes of the bit array */
+static inline uint64_t bloomBytes(const BloomFilter *b) { return (b->mask + 1) / 8; }
+
+/*
+Writes the filter to 'path' (via a temp file and rename) tagged with
+'tag', and reads it back only if the tag matches. Return 0 on success
+*/
+int bloomSave(const BloomFilter *b, const char *path, uint64_t tag);
+int bloomLoad(BloomFilter *b, const char *path, uint64_t tag);
+
+#endif // BLOOM_H
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bufpool.h"
+#include "crc32c.h"
+#include "fileio.h"
+#include "byteorder.h"
+
+#define BP_ENTRY (PAGE_SIZE + 16) // Journal entry: header, then the page
+#define BP_TAG_PAGE 0x47504a50u // "PJPG": header of a journaled page
+#define BP_TAG_COMMIT 0x4d434a50u // "PJCM": commit record, its page field holds the entry count
+
+static uint32_t pageCrc(const unsigned char *p) { // CRC32C of the page without its own checksum field
+    return crc32c(crc32c(0, p, PAGE_CRC_OFFSET), p + PAGE_CRC_OFFSET + 4, PAGE_SIZE - PAGE_CRC_OFFSET - 4);
+}
+
+static int fullRead(int fd, void *buf, size_t len, off_t at) { // pread until done. Returns 0, or -2 (short or failed)
+    unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, at);
+        if (n <= 0) return -2;
+        p += n; len -= (size_t)n; at += n;
+    }
+    return 0;
+}
+
+static int fullWrite(int fd, const void *buf, size_t len, off_t at) {
+    const unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, at);
+        if (n <= 0) return -2;
+        p += n; len -= (size_t)n; at += n;
+    }
+    return 0;
+}
+
+static void entryHeader(unsigned char *h, uint32_t tag, uint32_t page) { // Tag, page, reserved, CRC32C of the first 12 bytes
+    putU32(h, tag);
+    putU32(h + 4, page);
+    putU32(h + 8, 0);
+    putU32(h + 12, crc32c(0, h, 12));
+}
+
+static int journalAppend(BufferPool *bp, uint32_t page, unsigned char *data) { // Appends the latest copy of 'page'
+    if (bp->stuck) return -2; // Would overwrite the commit record the next open needs
+    unsigned char h[16];
+    putU32(data + PAGE_CRC_OFFSET, pageCrc(data));
+    entryHeader(h, BP_TAG_PAGE, page);
+    off_t at = (off_t)bp->journalEntries * BP_ENTRY;
+    if (fullWrite(bp->jfd, h, sizeof h, at) != 0 || fullWrite(bp->jfd, data, PAGE_SIZE, at + 16) != 0) return -2;
+    int rc = hashIndexSetSlot(&bp->journaled, (int)page + 1, (int)bp->journalEntries);
+    if (rc == 1 && hashIndexInsert(&bp->journaled, (int)page + 1, (int)bp->journalEntries) != 0) return -1;
+    bp->journalEntries++;
+    return 0;
+}
+
+static int recoverJournal(BufferPool *bp) { // Finishes a committed checkpoint, drops an uncommitted journal
+    unsigned char h[16];
+    unsigned char *page = malloc(PAGE_SIZE);
+    if (!page) return -1;
+    long entries = 0;
+    int committed = 0;
+    while (fullRead(bp->jfd, h, sizeof h, (off_t)entries * BP_ENTRY) == 0 && getU32(h + 12) == crc32c(0, h, 12)) {
+        if (getU32(h) == BP_TAG_COMMIT) { committed = getU32(h + 4) == (uint32_t)entries; break; }
+        if (getU32(h) != BP_TAG_PAGE || fullRead(bp->jfd, page, PAGE_SIZE, (off_t)entries * BP_ENTRY + 16) != 0 ||
+            getU32(page + PAGE_CRC_OFFSET) != pageCrc(page)) break; // Torn entry: the checkpoint never committed
+        entries++;
+    }
+    int rc = 0;
+    for (long i = 0; committed && i < entries && rc == 0; ++i) { // Replay in order, later copies win
+        rc = fullRead(bp->jfd, h, sizeof h, (off_t)i * BP_ENTRY);
+        if (rc == 0) rc = fullRead(bp->jfd, page, PAGE_SIZE, (off_t)i * BP_ENTRY + 16);
+        if (rc == 0) rc = fullWrite(bp->fd, page, PAGE_SIZE, (off_t)getU32(h + 4) * PAGE_SIZE);
+    }
+    free(page);
+    if (rc == 0 && committed && syncFileData(bp->fd) != 0) rc = -2;
+    if (rc == 0 && ftruncate(bp->jfd, 0) != 0) rc = -2; // Applied, or never committed: either way it is spent
+    if (rc == 0) syncFileData(bp->jfd);
+    return rc;
+}
+
+int bpOpen(BufferPool *bp, const char *path, int frames) {
+    memset(bp, 0, sizeof *bp);
+    bp->fd = bp->jfd = -1;
+    if (frames < BP_MIN_FRAMES) frames = BP_MIN_FRAMES;
+    bp->nFrames = frames;
+    bp->mem = malloc((size_t)frames * PAGE_SIZE);
+    bp->frames = calloc((size_t)frames, sizeof *bp->frames);
+    if (!bp->mem || !bp->frames || hashIndexInit(&bp->table, (size_t)frames) != 0 || hashIndexInit(&bp->journaled, 64) != 0) {
+        bpClose(bp);
+        return -1;
+    }
+    bp->fd = open(path, O_RDWR | O_CREAT, 0644);
+    snprintf(bp->journalPath, sizeof bp->journalPath, "%s%s", path, BP_JOURNAL_SUFFIX);
+    bp->jfd = bp->fd >= 0 ? open(bp->journalPath, O_RDWR | O_CREAT, 0644) : -1;
+    if (bp->jfd < 0) { bpClose(bp); return -2; }
+    int rc = recoverJournal(bp);
+    if (rc != 0) { bpClose(bp); return rc; }
+    struct stat st;
+    if (fstat(bp->fd, &st) != 0) { bpClose(bp); return -2; }
+    if (st.st_size % PAGE_SIZE != 0) { bpClose(bp); return -4; }
+    bp->filePages = bp->pageCount = (uint32_t)(st.st_size / PAGE_SIZE);
+    return st.st_size == 0 ? 1 : 0;
+}
+
+void bpClose(BufferPool *bp) {
+    if (bp->fd >= 0) close(bp->fd);
+    if (bp->jfd >= 0) close(bp->jfd);
+    free(bp->mem);
+    free(bp->frames);
+    hashIndexFree(&bp->table);
+    hashIndexFree(&bp->journaled);
+    memset(bp, 0, sizeof *bp);
+    bp->fd = bp->jfd = -1;
+}
+
+static int victim(BufferPool *bp) { // Clock sweep: free frame, or unpinned frame not referenced since the last pass
+    for (int sweep = 0; sweep < 2 * bp->nFrames; ++sweep) {
+        int f = bp->hand;
+        bp->hand = (bp->hand + 1) % bp->nFrames;
+        BpFrame *fr = &bp->frames[f];
+        if (!fr->used) return f;
+        if (fr->pins) continue;
+        if (fr->ref) { fr->ref = 0; continue; } // Second chance
+        return f;
+    }
+    return -1; // Everything pinned
+}
+
+static int claim(BufferPool *bp, int *errPtr) { // A frame ready for a new page (dirty contents written back), or -1
+    int f = victim(bp);
+    if (f < 0) { *errPtr = -1; return -1; }
+    BpFrame *fr = &bp->frames[f];
+    if (fr->used) {
+        if (fr->dirty) {
+            int rc = journalAppend(bp, fr->page, bp->mem + (size_t)f * PAGE_SIZE);
+            if (rc != 0) { *errPtr = rc; return -1; }
+            bp->stats.writeBacks++;
+        }
+        hashIndexRemove(&bp->table, (int)fr->page + 1);
+        bp->stats.evictions++;
+    }
+    memset(fr, 0, sizeof *fr);
+    return f;
+}
+
+unsigned char *bpFetch(BufferPool *bp, uint32_t page, int *errPtr) {
+    int dummy;
+    if (!errPtr) errPtr = &dummy;
+    int f = hashIndexFind(&bp->table, (int)page + 1);
+    if (f >= 0) {
+        bp->frames[f].pins++;
+        bp->frames[f].ref = 1;
+        bp->stats.hits++;
+        return bp->mem + (size_t)f * PAGE_SIZE;
+    }
+    if (page >= bp->pageCount) { *errPtr = -7; return NULL; } // A link to a page that does not exist
+    f = claim(bp, errPtr);
+    if (f < 0) return NULL;
+    unsigned char *data = bp->mem + (size_t)f * PAGE_SIZE;
+    int slot = hashIndexFind(&bp->journaled, (int)page + 1);
+    int rc = slot >= 0 ? fullRead(bp->jfd, data, PAGE_SIZE, (off_t)slot * BP_ENTRY + 16) : fullRead(bp->fd, data, PAGE_SIZE, (off_t)page * PAGE_SIZE);
+    if (rc == 0 && getU32(data + PAGE_CRC_OFFSET) != pageCrc(data)) rc = -7;
+    if (rc == 0 && hashIndexInsert(&bp->table, (int)page + 1, f) != 0) rc = -1;
+    if (rc != 0) { *errPtr = rc; return NULL; } // Frame stays free
+    bp->frames[f] = (BpFrame){ page, 1, 1, 1, 0 };
+    bp->stats.misses++;
+    if (slot >= 0) bp->stats.journalReads++;
+    return data;
+}
+
+unsigned char *bpNew(BufferPool *bp, uint32_t *pagePtr) {
+    int err;
+    int f = claim(bp, &err);
+    if (f < 0 || hashIndexInsert(&bp->table, (int)bp->pageCount + 1, f) != 0) return NULL;
+    unsigned char *data = bp->mem + (size_t)f * PAGE_SIZE;
+    memset(data, 0, PAGE_SIZE);
+    bp->frames[f] = (BpFrame){ bp->pageCount, 1, 1, 1, 1 };
+    *pagePtr = bp->pageCount++;
+    return data;
+}
+
+void bpUnpin(BufferPool *bp, uint32_t page, int dirty) {
+    int f = hashIndexFind(&bp->table, (int)page + 1);
+    if (f < 0) return;
+    if (bp->frames[f].pins > 0) bp->frames[f].pins--;
+    if (dirty) bp->frames[f].dirty = 1;
+}
+
+int bpCheckpoint(BufferPool *bp) {
+    for (int f = 0; f < bp->nFrames; ++f) { // 1. Every dirty page into the journal
+        BpFrame *fr = &bp->frames[f];
+        if (!fr->used || !fr->dirty) continue;
+        if (journalAppend(bp, fr->page, bp->mem + (size_t)f * PAGE_SIZE) != 0) return -2;
+        fr->dirty = 0;
+    }
+    if (bp->journalEntries == 0) return 0; // Nothing changed since the last checkpoint
+    unsigned char h[16]; // 2. Commit it: from here on a crash finishes the checkpoint in bpOpen
+    entryHeader(h, BP_TAG_COMMIT, (uint32_t)bp->journalEntries);
+    if (fullWrite(bp->jfd, h, sizeof h, (off_t)bp->journalEntries * BP_ENTRY) != 0 || syncFileData(bp->jfd) != 0) return -2;
+    unsigned char *page = malloc(PAGE_SIZE);
+    if (!page) return -1;
+    int rc = 0;
+    for (size_t i = 0; i < bp->journaled.capacity && rc == 0; ++i) { // 3. Latest copy of each page into the main file
+        const HashEntry *e = &bp->journaled.entries[i];
+        if (e->id <= 0) continue;
+        uint32_t p = (uint32_t)(e->id - 1);
+        rc = fullRead(bp->jfd, page, PAGE_SIZE, (off_t)e->slot * BP_ENTRY + 16);
+        if (rc == 0) rc = fullWrite(bp->fd, page, PAGE_SIZE, (off_t)p * PAGE_SIZE);
+        if (p >= bp->filePages) bp->filePages = p + 1;
+        bp->stats.checkpointPages++;
+    }
+    free(page);
+    if (rc == 0 && syncFileData(bp->fd) != 0) rc = -2;
+    if (rc == 0 && ftruncate(bp->jfd, 0) != 0) rc = -2; // 4. Spent
+    if (rc != 0) { bp->stuck = 1; return rc; } // The committed journal is still there; the next open applies it
+    hashIndexFree(&bp->journaled);
+    if (hashIndexInit(&bp->journaled, 64) != 0) return -1;
+    bp->journalEntries = 0;
+    return 0;
+}
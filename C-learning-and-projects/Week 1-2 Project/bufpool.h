@@ -0,0 +1,91 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+#include <stdint.h>
+#include "hashindex.h"
+
+/*
+Bounded buffer pool over a file of fixed-size pages. At most 'frames'
+pages are in memory; a clock sweep evicts the first unpinned frame whose
+reference bit is clear. Every page carries a CRC32C in bytes 12..15,
+filled in when the page is written and checked when it is read.
+
+The main file only changes at checkpoints. Dirty pages evicted in between
+go to a page journal (<file>.pj) and are read back from there, so a crash
+leaves the main file exactly as of the last checkpoint. A checkpoint
+appends the remaining dirty pages and a commit record to the journal,
+syncs it, copies the journaled pages into the main file, syncs that and
+empties the journal; bpOpen finishes a checkpoint that committed but was
+cut short, and drops a journal that never committed
+*/
+#define PAGE_SIZE 4096
+#define PAGE_CRC_OFFSET 12 // Bytes 12..15 of every page hold its checksum
+#define BP_MIN_FRAMES 16 // Enough for the deepest B+tree path plus slack
+#define BP_DEFAULT_FRAMES 2048 // 8 MB of pages
+#define BP_JOURNAL_SUFFIX ".pj"
+#define BP_PATH_MAX 520
+
+typedef struct { // One frame of the pool
+    uint32_t page; // Page held (valid when 'used')
+    int pins; // Users holding the page; pinned frames are never evicted
+    unsigned char used, ref, dirty;
+} BpFrame;
+
+typedef struct { // Cache behaviour, for the statistics screen and the benchmark
+    long hits, misses; // Fetches served from a frame / read from disk
+    long evictions; // Frames reused for another page
+    long writeBacks; // Dirty pages written to the journal on eviction
+    long journalReads; // Misses served from the journal
+    long checkpointPages; // Pages copied into the main file by checkpoints
+} BpStats;
+
+typedef struct {
+    int fd; // Main file
+    int jfd; // Page journal
+    char journalPath[BP_PATH_MAX];
+    unsigned char *mem; // frames * PAGE_SIZE bytes
+    BpFrame *frames;
+    int nFrames;
+    int hand; // Clock position
+    HashIndex table; // page + 1 -> frame
+    HashIndex journaled; // page + 1 -> entry of its latest copy in the journal
+    long journalEntries; // Entries appended since the last checkpoint
+    int stuck; // A committed checkpoint could not be copied: no more writes until it is reopened
+    uint32_t filePages; // Pages in the main file
+    uint32_t pageCount; // Pages in use, including ones not written yet
+    BpStats stats;
+} BufferPool;
+
+/*
+Opens (creating if needed) 'path' with 'frames' frames and recovers its
+journal. Returns 0 on success, 1 if the file is new, -1 out of memory,
+-2 I/O error, -4 not a page file (size not a multiple of PAGE_SIZE)
+*/
+int bpOpen(BufferPool *bp, const char *path, int frames);
+
+/* Closes the files and frees the frames without writing anything (call bpCheckpoint first) */
+void bpClose(BufferPool *bp);
+
+/*
+Pins page 'page' and returns its bytes, or NULL on an I/O error, a
+checksum mismatch or when every frame is pinned. *errPtr (may be NULL)
+receives -2, -7 or -1 respectively
+*/
+unsigned char *bpFetch(BufferPool *bp, uint32_t page, int *errPtr);
+
+/* Appends a zeroed page, pinned and dirty. *pagePtr receives its number. NULL if no frame is free */
+unsigned char *bpNew(BufferPool *bp, uint32_t *pagePtr);
+
+/* Releases a pin taken by bpFetch/bpNew; 'dirty' marks the page changed */
+void bpUnpin(BufferPool *bp, uint32_t page, int dirty);
+
+/*
+Writes every dirty page into the main file atomically, as described above.
+Returns 0 on success, -2 on I/O error. Once a checkpoint has committed,
+a failure leaves the pool read-only; reopening finishes the copy
+*/
+int bpCheckpoint(BufferPool *bp);
+
+/* Pages written to the journal since the last checkpoint (a checkpoint copies them all again) */
+static inline long bpJournalPages(const BufferPool *bp) { return bp->journalEntries; }
+
+#endif // BUFPOOL_H
@@ -0,0 +1,41 @@
+#ifndef BYTEORDER_H
+#define BYTEORDER_H
+#include <stdint.h>
+
+/*
+Little-endian loads and stores for the on-disk formats (snapshots, logs,
+pages, shard manifests, change feeds). Byte by byte, so they work at any
+alignment and on any host; compilers turn them into single moves where
+the host allows it.
+*/
+
+static inline void putU16(unsigned char *p, uint16_t v) { // Store 'v' little-endian
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static inline uint16_t getU16(const unsigned char *p) { // Load a little-endian u16
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline void putU32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static inline uint32_t getU32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void putU64(unsigned char *p, uint64_t v) {
+    putU32(p, (uint32_t)v);
+    putU32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint64_t getU64(const unsigned char *p) {
+    return (uint64_t)getU32(p) | ((uint64_t)getU32(p + 4) << 32);
+}
+
+#endif // BYTEORDER_H
@@ -0,0 +1,769 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+#include "changefeed.h"
+#include "crc32c.h"
+#include "byteorder.h"
+
+#define CDC_IO_BUFFER (1 << 16) // stdio buffer of the feed writer
+#define CDC_BATCH 512 // Frames read and sent per write (48 KB)
+#define CDC_TORN_RETRIES 50 // Polls a record with a bad checksum may take to finish arriving
+
+uint64_t cdcClock(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void feedPath(char *out, size_t size, const char *itemsFile) { // "<items>.cdc"
+    snprintf(out, size, "%s%s", itemsFile, CDC_SUFFIX);
+}
+
+static void imagePath(char *out, size_t size, const char *itemsFile, uint64_t stream, uint64_t base) { // "<items>.cdc.<stream>.<base>"
+    snprintf(out, size, "%s%s.%016llx.%llu", itemsFile, CDC_SUFFIX, (unsigned long long)stream, (unsigned long long)base);
+}
+
+void cdcEncode(unsigned char out[CDC_RECORD_SIZE], const CdcRecord *r) {
+    memset(out, 0, CDC_RECORD_SIZE);
+    putU64(out, r->seq);
+    putU64(out + 8, r->timeNs);
+    putU32(out + 16, (uint32_t)r->op);
+    unsigned char *p = out + CDC_PAYLOAD;
+    switch (r->op) {
+        case WAL_OP_ADD: case CDC_MSG_ITEM: encodeItemRecord(p, &r->item); break;
+        case WAL_OP_QTY: putU32(p, (uint32_t)r->item.id); putU32(p + 4, (uint32_t)r->item.quantity); break;
+        case WAL_OP_DEL: putU32(p, (uint32_t)r->item.id); break;
+        case CDC_MSG_HELLO: case CDC_MSG_SNAPSHOT: case CDC_MSG_SNAPSHOT_END: putU64(p, r->stream); putU64(p + 8, r->count); break;
+        default: break; // Markers and heartbeats carry no payload
+    }
+    putU32(out + 92, crc32c(0, out, 92));
+}
+
+int cdcDecode(CdcRecord *r, const unsigned char in[CDC_RECORD_SIZE]) {
+    if (getU32(in + 92) != crc32c(0, in, 92)) return -7;
+    memset(r, 0, sizeof *r);
+    r->seq = getU64(in);
+    r->timeNs = getU64(in + 8);
+    r->op = (int)getU32(in + 16);
+    const unsigned char *p = in + CDC_PAYLOAD;
+    switch (r->op) {
+        case WAL_OP_ADD: case CDC_MSG_ITEM: decodeItemRecord(&r->item, p); break;
+        case WAL_OP_QTY: r->item.id = (int)getU32(p); r->item.quantity = (int)getU32(p + 4); break;
+        case WAL_OP_DEL: r->item.id = (int)getU32(p); break;
+        case CDC_MSG_HELLO: case CDC_MSG_SNAPSHOT: case CDC_MSG_SNAPSHOT_END: r->stream = getU64(p); r->count = getU64(p + 8); break;
+        default: break;
+    }
+    return 0;
+}
+
+/* Feed file header */
+
+typedef struct { // What tells a feed's items file apart from one changed behind its back
+    uint64_t itemsSize;
+    uint64_t itemsMtime; // Nanoseconds where the platform keeps them
+    uint64_t logSize;
+} FileStamp;
+
+typedef struct {
+    uint64_t stream;
+    uint64_t base;
+    int clean;
+    FileStamp stamp;
+} FeedHeader;
+
+static void stampFiles(const char *itemsFile, FileStamp *out) { // Size and mtime of the items file, size of its log
+    struct stat st;
+    char logPath[WAL_PATH_MAX + 8];
+    memset(out, 0, sizeof *out);
+    if (stat(itemsFile, &st) == 0) {
+        out->itemsSize = (uint64_t)st.st_size;
+#ifdef __linux__
+        out->itemsMtime = (uint64_t)st.st_mtim.tv_sec * 1000000000u + (uint64_t)st.st_mtim.tv_nsec;
+#else
+        out->itemsMtime = (uint64_t)st.st_mtime * 1000000000u;
+#endif
+    }
+    snprintf(logPath, sizeof logPath, "%s%s", itemsFile, WAL_SUFFIX);
+    if (stat(logPath, &st) == 0) out->logSize = (uint64_t)st.st_size;
+}
+
+static void encodeFeedHeader(unsigned char *h, const FeedHeader *fh) {
+    memset(h, 0, CDC_RECORD_SIZE);
+    memcpy(h, CDC_MAGIC, 8);
+    putU32(h + 8, CDC_FORMAT_VERSION);
+    putU32(h + 12, CDC_RECORD_SIZE);
+    putU64(h + 16, fh->stream);
+    putU64(h + 24, fh->base);
+    putU32(h + 32, (uint32_t)fh->clean);
+    putU64(h + 40, fh->stamp.itemsSize);
+    putU64(h + 48, fh->stamp.itemsMtime);
+    putU64(h + 56, fh->stamp.logSize);
+    putU32(h + 92, crc32c(0, h, 92));
+}
+
+static int decodeFeedHeader(const unsigned char *h, FeedHeader *fh) { // 0, -4 not a feed, -5 other layout, -7 checksum mismatch
+    if (memcmp(h, CDC_MAGIC, 8) != 0) return -4;
+    if (getU32(h + 92) != crc32c(0, h, 92)) return -7;
+    if (getU32(h + 8) != CDC_FORMAT_VERSION || getU32(h + 12) != CDC_RECORD_SIZE) return -5;
+    fh->stream = getU64(h + 16);
+    fh->base = getU64(h + 24);
+    fh->clean = (int)getU32(h + 32);
+    fh->stamp.itemsSize = getU64(h + 40);
+    fh->stamp.itemsMtime = getU64(h + 48);
+    fh->stamp.logSize = getU64(h + 56);
+    return fh->base >= 1 ? 0 : -5;
+}
+
+static int writeFeedHeader(const char *path, const FeedHeader *fh) { // In place, synced
+    unsigned char h[CDC_RECORD_SIZE];
+    encodeFeedHeader(h, fh);
+    FILE *fp = fopen(path, "r+b");
+    if (!fp) return -2;
+    int ok = fwrite(h, 1, sizeof h, fp) == sizeof h && syncFile(fp) == 0;
+    if (fclose(fp) != 0) ok = 0;
+    return ok ? 0 : -2;
+}
+
+/* Writer */
+
+static uint64_t newStreamId(uint64_t old) { // Any value that differs from the previous stream, never 0
+    static uint64_t salt;
+    uint64_t id = (cdcClock() ^ (old * 0x9E3779B97F4A7C15u) ^ ++salt) * 0xBF58476D1CE4E5B9u;
+    id ^= id >> 31;
+    return id && id != old ? id : old + 1;
+}
+
+static int openAppend(ChangeFeed *cf) { // Appends after the last record
+    cf->fp = fopen(cf->path, "ab");
+    if (!cf->fp) return -2;
+    setvbuf(cf->fp, NULL, _IOFBF, CDC_IO_BUFFER);
+    return 0;
+}
+
+static int copyRecords(FILE *out, FILE *in, uint64_t records) { // The next 'records' records of 'in' to 'out'
+    unsigned char buf[CDC_BATCH * CDC_RECORD_SIZE];
+    while (records > 0) {
+        size_t n = records < CDC_BATCH ? (size_t)records : CDC_BATCH;
+        if (fread(buf, CDC_RECORD_SIZE, n, in) != n || fwrite(buf, CDC_RECORD_SIZE, n, out) != n) return -2;
+        records -= n;
+    }
+    return 0;
+}
+
+static int installFeed(ChangeFeed *cf, const char *tmp) { // Renames the finished, synced 'tmp' over the feed
+    if (cf->fp) { fclose(cf->fp); cf->fp = NULL; } // Everything it held was flushed before
+#ifdef _WIN32
+    remove(cf->path); // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tmp, cf->path) != 0) { remove(tmp); return -2; }
+    syncParentDir(cf->path);
+    return openAppend(cf);
+}
+
+static int replaceFeed(ChangeFeed *cf, const FeedHeader *fh, FILE *copyFrom, uint64_t records) { // Header plus 'records' records of 'copyFrom', renamed over the feed
+    char tmp[WAL_PATH_MAX + 16];
+    snprintf(tmp, sizeof tmp, "%s.tmp", cf->path);
+    FILE *out = fopen(tmp, "wb");
+    if (!out) return -2;
+    unsigned char h[CDC_RECORD_SIZE];
+    encodeFeedHeader(h, fh);
+    int rc = fwrite(h, 1, sizeof h, out) == sizeof h ? 0 : -2;
+    if (rc == 0) rc = copyRecords(out, copyFrom, records);
+    if (rc == 0 && syncFile(out) != 0) rc = -2;
+    if (fclose(out) != 0 && rc == 0) rc = -2;
+    if (rc != 0) { remove(tmp); return rc; }
+    return installFeed(cf, tmp);
+}
+
+static void itemsOf(const ChangeFeed *cf, char *out, size_t size) { // The items file, from "<items>.cdc"
+    snprintf(out, size, "%.*s", (int)(strlen(cf->path) - strlen(CDC_SUFFIX)), cf->path);
+}
+
+static void foldPaths(const ChangeFeed *cf, char *feedTmp, char *imageTmp, size_t size) { // What a fold writes before it is installed
+    snprintf(feedTmp, size, "%s.fold", cf->path);
+    snprintf(imageTmp, size, "%s.fold.image", cf->path);
+}
+
+static int buildFold(const ChangeFeed *cf, uint64_t end, uint64_t *cutPtr) { // Next base image and a feed starting at it, under the fold names
+    char items[WAL_PATH_MAX], oldImage[WAL_PATH_MAX + 48], feedTmp[WAL_PATH_MAX + 32], imageTmp[WAL_PATH_MAX + 32];
+    itemsOf(cf, items, sizeof items);
+    imagePath(oldImage, sizeof oldImage, items, cf->stream, cf->base);
+    foldPaths(cf, feedTmp, imageTmp, sizeof feedTmp);
+    Item *arr = NULL;
+    int count = 0;
+    if (loadItems(oldImage, &arr, &count) != 0) return -2;
+    Inventory state; // In memory only, nothing logged
+    int rc = inventoryInit(&state) == 0 && inventoryAddBatch(&state, arr, count, NULL) == 0 ? 0 : -1;
+    free(arr);
+    FILE *in = rc == 0 ? fopen(cf->path, "rb") : NULL;
+    if (rc == 0 && (!in || fseek(in, CDC_RECORD_SIZE, SEEK_SET) != 0)) rc = -2;
+    CdcApplier a;
+    cdcApplierInit(&a, &state);
+    uint64_t target = end - CDC_FEED_KEEP_RECORDS, cut = cf->base;
+    for (uint64_t s = cf->base; rc == 0 && s < end && cut < target; ++s) { // Stop at the first transaction boundary past the target
+        unsigned char buf[CDC_RECORD_SIZE];
+        CdcRecord r;
+        if (fread(buf, 1, sizeof buf, in) != sizeof buf || cdcDecode(&r, buf) != 0 || r.seq != s) { rc = -7; break; }
+        int applied = cdcApply(&a, &r);
+        if (applied < 0) rc = -1;
+        else if (applied == 1) cut = s + 1;
+    }
+    cdcApplierFree(&a);
+    if (rc == 0 && cut == cf->base) rc = 1; // One transaction spans everything: nothing to fold yet
+    if (rc == 0 && saveLiveItems(imageTmp, state.items, state.count) != 0) rc = -2;
+    FILE *out = NULL;
+    if (rc == 0) {
+        FeedHeader fh = { cf->stream, cut, 0, {0, 0, 0} };
+        unsigned char h[CDC_RECORD_SIZE];
+        encodeFeedHeader(h, &fh);
+        out = fopen(feedTmp, "wb");
+        if (!out || fwrite(h, 1, sizeof h, out) != sizeof h || fseek(in, (long)((cut - cf->base + 1) * CDC_RECORD_SIZE), SEEK_SET) != 0 ||
+            copyRecords(out, in, end - cut) != 0 || syncFile(out) != 0) rc = -2;
+        if (out && fclose(out) != 0 && rc == 0) rc = -2;
+    }
+    if (rc < 0) { remove(feedTmp); remove(imageTmp); }
+    if (in) fclose(in);
+    inventoryClose(&state);
+    *cutPtr = cut;
+    return rc;
+}
+
+static int installFold(ChangeFeed *cf, uint64_t cut) { // Adds what was appended since the fold began, then swaps its files in
+    char items[WAL_PATH_MAX], oldImage[WAL_PATH_MAX + 48], image[WAL_PATH_MAX + 48], feedTmp[WAL_PATH_MAX + 32], imageTmp[WAL_PATH_MAX + 32];
+    itemsOf(cf, items, sizeof items);
+    imagePath(oldImage, sizeof oldImage, items, cf->stream, cf->base);
+    imagePath(image, sizeof image, items, cf->stream, cut);
+    foldPaths(cf, feedTmp, imageTmp, sizeof feedTmp);
+    FILE *in = fopen(cf->path, "rb"), *out = fopen(feedTmp, "ab");
+    int rc = in && out ? 0 : -2;
+    if (rc == 0 && (fseek(in, (long)((cf->foldEnd - cf->base + 1) * CDC_RECORD_SIZE), SEEK_SET) != 0 ||
+                    copyRecords(out, in, cf->next - cf->foldEnd) != 0 || syncFile(out) != 0)) rc = -2;
+    if (out && fclose(out) != 0) rc = -2;
+    if (in) fclose(in);
+    if (rc == 0 && rename(imageTmp, image) != 0) rc = -2; // The image first: the new feed's header names it
+    if (rc != 0) { remove(feedTmp); remove(imageTmp); return rc; }
+    rc = installFeed(cf, feedTmp); // Publishers see the new file and carry on from their position
+    if (rc != 0) { remove(image); return rc; }
+    remove(oldImage);
+    cf->base = cut;
+    cf->stats.folds++;
+    return 0;
+}
+
+#ifndef _WIN32
+
+typedef struct { // What the fold child sends back through the pipe
+    int rc; // 0 if its files are ready, 1 if there was nothing to fold
+    int pad;
+    uint64_t cut; // Base of the new image
+} FoldReport;
+
+static int startFold(ChangeFeed *cf) { // Forks a child that builds the next base image while the writer carries on
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    cf->foldEnd = cf->next; // Everything before it was flushed just now, the child reads it from the file
+    pid_t pid = fork();
+    if (pid < 0) { close(fds[0]); close(fds[1]); return -1; }
+    if (pid == 0) { // Child: build, report, leave without the parent's atexit or stdio flushes
+        close(fds[0]);
+        FoldReport rep;
+        memset(&rep, 0, sizeof rep);
+        rep.rc = buildFold(cf, cf->foldEnd, &rep.cut);
+        ssize_t ignored = write(fds[1], &rep, sizeof rep); // Smaller than PIPE_BUF, so it arrives whole
+        (void)ignored;
+        _exit(rep.rc < 0 ? 1 : 0);
+    }
+    close(fds[1]);
+    cf->foldPipe = fds[0];
+    cf->foldPid = (int)pid;
+    return 0;
+}
+
+static int pollFold(ChangeFeed *cf, int wait) { // 0 still running (or none), 1 installed or nothing to fold, negative on failure
+    if (!cf->foldPid) return 0;
+    int status;
+    pid_t r;
+    do {
+        r = waitpid((pid_t)cf->foldPid, &status, wait ? 0 : WNOHANG);
+    } while (r < 0 && errno == EINTR);
+    if (r == 0) return 0;
+    FoldReport rep;
+    memset(&rep, 0, sizeof rep);
+    if (read(cf->foldPipe, &rep, sizeof rep) != (ssize_t)sizeof rep) rep.rc = -1; // Died before reporting
+    close(cf->foldPipe);
+    cf->foldPid = 0;
+    if (r < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || rep.rc < 0) return -1;
+    return rep.rc == 1 ? 1 : installFold(cf, rep.cut) == 0 ? 1 : -2;
+}
+
+static void abandonFold(ChangeFeed *cf) { // The feed is about to be replaced: what the child builds no longer fits it
+    if (!cf->foldPid) return;
+    kill((pid_t)cf->foldPid, SIGKILL);
+    while (waitpid((pid_t)cf->foldPid, NULL, 0) < 0 && errno == EINTR) {}
+    close(cf->foldPipe);
+    cf->foldPid = 0;
+    char feedTmp[WAL_PATH_MAX + 32], imageTmp[WAL_PATH_MAX + 32];
+    foldPaths(cf, feedTmp, imageTmp, sizeof feedTmp);
+    remove(feedTmp);
+    remove(imageTmp);
+}
+
+#else
+
+static int startFold(ChangeFeed *cf) { // No fork(): fold here and now
+    uint64_t cut;
+    cf->foldEnd = cf->next;
+    int rc = buildFold(cf, cf->foldEnd, &cut);
+    return rc != 0 ? (rc < 0 ? rc : 0) : installFold(cf, cut);
+}
+
+static int pollFold(ChangeFeed *cf, int wait) {
+    (void)cf;
+    (void)wait;
+    return 0;
+}
+
+static void abandonFold(ChangeFeed *cf) {
+    (void)cf;
+}
+
+#endif
+
+static int rebase(ChangeFeed *cf, uint64_t base) { // New stream whose base image is the inventory as it is now
+    abandonFold(cf);
+    if (cf->fp && fflush(cf->fp) != 0) return -2;
+    char oldImage[WAL_PATH_MAX + 48], image[WAL_PATH_MAX + 48];
+    imagePath(oldImage, sizeof oldImage, cf->inv->wal.snapshot, cf->stream, cf->base);
+    uint64_t stream = newStreamId(cf->stream);
+    imagePath(image, sizeof image, cf->inv->wal.snapshot, stream, base);
+    if (saveLiveItems(image, cf->inv->items, cf->inv->count) != 0) { remove(image); return -2; } // Synced; named by the header below
+    FeedHeader fh = { stream, base, 0, {0, 0, 0} };
+    int rc = replaceFeed(cf, &fh, NULL, 0);
+    if (rc != 0) { remove(image); return rc; }
+    if (cf->stream) remove(oldImage); // Publishers still sending it have it open
+    cf->stream = stream;
+    cf->base = cf->next = base;
+    cf->txnDepth = 0;
+    cf->stats.rebases++;
+    return 0;
+}
+
+static int feedTap(void *ctx, int op, const unsigned char *payload, uint32_t len) { // Attached to the inventory's log
+    ChangeFeed *cf = ctx;
+    if (cf->broken) return 0; // The log goes on; the unclean close starts a new stream next time
+    if (op == WAL_TAP_UNLOGGED) {
+        if (rebase(cf, cf->next) != 0) cf->broken = 1;
+        return 0;
+    }
+    if (op == WAL_TAP_FLUSH) {
+        cf->pending = 0;
+        if (fflush(cf->fp) != 0) cf->broken = 1;
+        else if (cf->foldPid) { if (pollFold(cf, 0) < 0) cf->broken = 1; } // Only a quick check: the child does the work
+        else if (cf->txnDepth == 0 && cf->next - cf->base >= (uint64_t)CDC_FEED_MAX_RECORDS && startFold(cf) < 0) cf->broken = 1;
+        if (cf->broken) fprintf(stderr, "Warning: writing the change feed failed, followers will need a fresh snapshot.\n");
+        return 0;
+    }
+    unsigned char rec[CDC_RECORD_SIZE] = {0};
+    putU64(rec, cf->next);
+    putU64(rec + 8, cdcClock());
+    putU32(rec + 16, (uint32_t)op);
+    memcpy(rec + CDC_PAYLOAD, payload, len < ITEMS_RECORD_SIZE ? len : ITEMS_RECORD_SIZE); // Log payloads are already in the feed layout
+    putU32(rec + 92, crc32c(0, rec, 92));
+    if (cf->pending + sizeof rec > CDC_IO_BUFFER) { // Our buffer is full: the log's goes out first, so the feed never runs ahead of it
+        if (fflush(cf->inv->wal.fp) != 0 || fflush(cf->fp) != 0) { cf->broken = 1; return 0; }
+        cf->pending = 0;
+    }
+    if (fwrite(rec, 1, sizeof rec, cf->fp) != sizeof rec) { cf->broken = 1; return 0; }
+    cf->pending += sizeof rec;
+    cf->next++;
+    cf->stats.appended++;
+    if (op == WAL_OP_BEGIN) cf->txnDepth = 1;
+    else if (op == WAL_OP_COMMIT || op == WAL_OP_ABORT) cf->txnDepth = 0;
+    return 0;
+}
+
+int changeFeedOpen(ChangeFeed *cf, Inventory *inv) {
+    memset(cf, 0, sizeof *cf);
+    if (!inv->logging || !inv->wal.fp) return -3;
+    cf->inv = inv;
+    feedPath(cf->path, sizeof cf->path, inv->wal.snapshot);
+    uint64_t next = 1; // Sequences keep counting across streams
+    int reuse = 0;
+    FILE *fp = fopen(cf->path, "rb");
+    if (fp) {
+        unsigned char h[CDC_RECORD_SIZE];
+        FeedHeader fh;
+        if (fread(h, 1, sizeof h, fp) == sizeof h && decodeFeedHeader(h, &fh) == 0) {
+            fseek(fp, 0, SEEK_END);
+            long size = ftell(fp);
+            uint64_t records = size > CDC_RECORD_SIZE ? (uint64_t)(size - CDC_RECORD_SIZE) / CDC_RECORD_SIZE : 0;
+            FileStamp now;
+            stampFiles(inv->wal.snapshot, &now);
+            char image[WAL_PATH_MAX + 48];
+            imagePath(image, sizeof image, inv->wal.snapshot, fh.stream, fh.base);
+            struct stat st;
+            reuse = fh.clean && memcmp(&now, &fh.stamp, sizeof now) == 0 && stat(image, &st) == 0 && size % CDC_RECORD_SIZE == 0;
+            cf->stream = fh.stream; // So a new stream differs from it and drops its image
+            cf->base = fh.base;
+            next = fh.base + records;
+        }
+        fclose(fp);
+    }
+    int rc;
+    if (reuse) {
+        FeedHeader fh = { cf->stream, cf->base, 0, {0, 0, 0} }; // Unclean until changeFeedClose
+        cf->next = next;
+        rc = writeFeedHeader(cf->path, &fh);
+        if (rc == 0) rc = openAppend(cf);
+    } else {
+        rc = rebase(cf, next);
+        if (rc == 0) rc = 1;
+        cf->stats.rebases = 0; // Only the ones while running are news
+    }
+    if (rc < 0) {
+        if (cf->fp) fclose(cf->fp);
+        cf->fp = NULL;
+        return rc;
+    }
+    inv->wal.tap = feedTap;
+    inv->wal.tapCtx = cf;
+    return rc;
+}
+
+int changeFeedClose(ChangeFeed *cf) {
+    if (!cf->fp) return 0;
+    if (cf->foldPid && pollFold(cf, 1) < 0) cf->broken = 1; // Let a running fold finish, its work is done by now or soon
+    if (!cf->fp) return -2; // Installing the fold lost the feed
+    int rc = syncFile(cf->fp) == 0 ? 0 : -2;
+    if (fclose(cf->fp) != 0) rc = -2;
+    cf->fp = NULL;
+    if (rc == 0 && !cf->broken) { // Matching stamps on the next open prove nothing changed in between
+        char items[WAL_PATH_MAX];
+        itemsOf(cf, items, sizeof items);
+        FeedHeader fh = { cf->stream, cf->base, 1, {0, 0, 0} };
+        stampFiles(items, &fh.stamp);
+        rc = writeFeedHeader(cf->path, &fh);
+    }
+    return rc;
+}
+
+void changeFeedReport(const ChangeFeed *cf, FILE *out) {
+    fprintf(out, "Change feed: stream %016llx, records %llu..%llu, %ld appended, %ld folds, %ld new streams%s\n",
+            (unsigned long long)cf->stream, (unsigned long long)cf->base, (unsigned long long)cf->next - 1,
+            cf->stats.appended, cf->stats.folds, cf->stats.rebases, cf->broken ? " (BROKEN: stopped after a write error)" : "");
+}
+
+/* Applier */
+
+void cdcApplierInit(CdcApplier *a, Inventory *inv) {
+    memset(a, 0, sizeof *a);
+    a->inv = inv;
+}
+
+void cdcApplierReset(CdcApplier *a) {
+    a->inTxn = 0;
+    a->heldCount = 0;
+}
+
+void cdcApplierFree(CdcApplier *a) {
+    free(a->held);
+    memset(a, 0, sizeof *a);
+}
+
+static int sameItem(const Item *a, const Item *b) { // Field by field: the padding is not part of the item
+    return a->id == b->id && a->quantity == b->quantity && a->price == b->price && a->category == b->category && strcmp(a->name, b->name) == 0;
+}
+
+static int applyChange(Inventory *inv, const CdcRecord *r) { // Idempotent form of one data record
+    int rc = 0;
+    if (r->op == WAL_OP_ADD) { // Upsert: the target may have it already (a replayed record)
+        const Item *cur = inventoryGet(inv, r->item.id);
+        if (cur && sameItem(cur, &r->item)) return 0;
+        if (cur) rc = inventoryDelete(inv, r->item.id);
+        if (rc >= 0) rc = inventoryAdd(inv, &r->item);
+    } else if (r->op == WAL_OP_QTY) {
+        rc = inventorySetQuantity(inv, r->item.id, r->item.quantity);
+    } else if (r->op == WAL_OP_DEL) {
+        rc = inventoryDelete(inv, r->item.id);
+    }
+    return rc < 0 ? rc : 0; // 1 (missing or invalid id) is fine here
+}
+
+int cdcApply(CdcApplier *a, const CdcRecord *r) {
+    switch (r->op) {
+        case WAL_OP_BEGIN:
+            a->inTxn = 1;
+            a->heldCount = 0;
+            return 0;
+        case WAL_OP_ABORT:
+            cdcApplierReset(a);
+            return 1;
+        case WAL_OP_COMMIT: {
+            if (!a->inTxn) return 1;
+            int rc = inventoryBegin(a->inv) < 0 ? -2 : 0;
+            for (int i = 0; rc == 0 && i < a->heldCount; ++i) rc = applyChange(a->inv, &a->held[i]);
+            if (rc == 0) rc = inventoryCommit(a->inv) < 0 ? -2 : 0;
+            else inventoryRollback(a->inv);
+            cdcApplierReset(a);
+            return rc < 0 ? rc : 1;
+        }
+        case WAL_OP_ADD: case WAL_OP_QTY: case WAL_OP_DEL:
+            if (!a->inTxn) {
+                int rc = applyChange(a->inv, r);
+                return rc < 0 ? rc : 1;
+            }
+            if (a->heldCount == a->heldCap) {
+                int cap = a->heldCap ? a->heldCap * 2 : 64;
+                CdcRecord *tmp = realloc(a->held, (size_t)cap * sizeof *tmp);
+                if (!tmp) return -1;
+                a->held = tmp;
+                a->heldCap = cap;
+            }
+            a->held[a->heldCount++] = *r;
+            return 0;
+        default:
+            return a->inTxn ? 0 : 1; // Not a change
+    }
+}
+
+/* Publisher */
+
+#ifndef _WIN32
+static volatile sig_atomic_t stopping = 0; // Set by SIGINT/SIGTERM while serving
+
+static void onStopSignal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static int writeAll(int fd, const unsigned char *p, size_t n) { // -1 once the follower is gone
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static int sendFrame(int fd, const CdcRecord *r) {
+    unsigned char buf[CDC_RECORD_SIZE];
+    cdcEncode(buf, r);
+    return writeAll(fd, buf, sizeof buf);
+}
+
+typedef struct { // The feed file as a publisher reads it
+    int fd;
+    ino_t ino; // To notice a fold or new stream renaming another file into place
+    FeedHeader h;
+} FeedReader;
+
+static int openReader(FeedReader *rd, const char *path) {
+    rd->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (rd->fd < 0) return 1;
+    unsigned char h[CDC_RECORD_SIZE];
+    struct stat st;
+    if (pread(rd->fd, h, sizeof h, 0) != (ssize_t)sizeof h || decodeFeedHeader(h, &rd->h) != 0 || fstat(rd->fd, &st) != 0) {
+        close(rd->fd);
+        return -5;
+    }
+    rd->ino = st.st_ino;
+    return 0;
+}
+
+static uint64_t readerEnd(const FeedReader *rd) { // Sequence after the last whole record
+    struct stat st;
+    if (fstat(rd->fd, &st) != 0 || st.st_size < CDC_RECORD_SIZE) return rd->h.base;
+    return rd->h.base + (uint64_t)(st.st_size / CDC_RECORD_SIZE - 1);
+}
+
+static int readerReplaced(const FeedReader *rd, const char *path) {
+    struct stat st;
+    return stat(path, &st) != 0 || st.st_ino != rd->ino;
+}
+
+static int sendSnapshot(int fd, const char *itemsFile, const FeedHeader *h) { // 0 sent, 1 image gone (a fold won the race), -1 follower gone
+    char image[WAL_PATH_MAX + 48];
+    imagePath(image, sizeof image, itemsFile, h->stream, h->base);
+    Item *items = NULL;
+    int count = 0;
+    if (loadItems(image, &items, &count) != 0) return 1;
+    CdcRecord r = { .seq = h->base - 1, .timeNs = cdcClock(), .op = CDC_MSG_SNAPSHOT, .stream = h->stream, .count = (uint64_t)count };
+    int rc = sendFrame(fd, &r);
+    unsigned char *buf = malloc(CDC_BATCH * CDC_RECORD_SIZE);
+    if (!buf) rc = -1;
+    CdcRecord it = { .op = CDC_MSG_ITEM };
+    for (int i = 0; rc == 0 && i < count; i += CDC_BATCH) {
+        int n = count - i < CDC_BATCH ? count - i : CDC_BATCH;
+        for (int k = 0; k < n; ++k) {
+            it.item = items[i + k];
+            cdcEncode(buf + (size_t)k * CDC_RECORD_SIZE, &it);
+        }
+        rc = writeAll(fd, buf, (size_t)n * CDC_RECORD_SIZE);
+    }
+    free(buf);
+    free(items);
+    r.op = CDC_MSG_SNAPSHOT_END;
+    if (rc == 0) rc = sendFrame(fd, &r);
+    return rc;
+}
+
+static int waitIdle(int fd, int isSocket) { // Sleeps one poll interval; -1 if the follower hung up or we are stopping
+    if (stopping) return -1;
+    if (!isSocket) {
+        struct timespec ts = { 0, CDC_POLL_MS * 1000000L };
+        nanosleep(&ts, NULL);
+        return stopping ? -1 : 0;
+    }
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, CDC_POLL_MS) > 0) { // Followers send nothing after the hello: this is the hangup
+        unsigned char drop[64];
+        ssize_t got = read(fd, drop, sizeof drop);
+        if (got <= 0 && !(got < 0 && errno == EINTR)) return -1;
+    }
+    return stopping ? -1 : 0;
+}
+
+int changeFeedPublish(const char *itemsFile, int fd, uint64_t stream, uint64_t fromSeq) {
+    char path[WAL_PATH_MAX + 8];
+    feedPath(path, sizeof path, itemsFile);
+    struct stat st;
+    int isSocket = fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode);
+    signal(SIGPIPE, SIG_IGN); // A follower going away is a write error, not a signal
+    unsigned char *buf = malloc(CDC_BATCH * CDC_RECORD_SIZE);
+    if (!buf) return -1;
+    int announced = 0, rc = 0;
+    uint64_t lastSent = cdcClock();
+    for (;;) { // Once per feed file: the first, then after each fold or new stream
+        FeedReader rd;
+        int orc = openReader(&rd, path);
+        if (orc != 0) { rc = announced ? -2 : orc; break; }
+        uint64_t end = readerEnd(&rd);
+        if (stream != rd.h.stream || fromSeq < rd.h.base || fromSeq > end) { // Snapshot plus the records after it
+            int s = sendSnapshot(fd, itemsFile, &rd.h);
+            if (s > 0) { close(rd.fd); if (waitIdle(fd, isSocket) != 0) break; continue; }
+            if (s < 0) { close(rd.fd); break; }
+            stream = rd.h.stream;
+            fromSeq = rd.h.base;
+            announced = 1;
+        } else if (!announced) {
+            CdcRecord hello = { .seq = fromSeq - 1, .timeNs = cdcClock(), .op = CDC_MSG_HELLO, .stream = stream };
+            if (sendFrame(fd, &hello) != 0) { close(rd.fd); break; }
+            announced = 1;
+        }
+        int torn = 0, gone = 0;
+        while (!gone) { // Tail the file
+            end = readerEnd(&rd);
+            if (fromSeq < end) {
+                size_t n = end - fromSeq < CDC_BATCH ? (size_t)(end - fromSeq) : CDC_BATCH;
+                ssize_t got = pread(rd.fd, buf, n * CDC_RECORD_SIZE, (off_t)((fromSeq - rd.h.base + 1) * CDC_RECORD_SIZE));
+                size_t k = got > 0 ? (size_t)got / CDC_RECORD_SIZE : 0, ok = 0;
+                for (; ok < k; ++ok) { // Send only whole, checked records in sequence
+                    const unsigned char *p = buf + ok * CDC_RECORD_SIZE;
+                    if (getU32(p + 92) != crc32c(0, p, 92) || getU64(p) != fromSeq + ok) break;
+                }
+                if (ok > 0) {
+                    if (writeAll(fd, buf, ok * CDC_RECORD_SIZE) != 0) { gone = 1; break; }
+                    fromSeq += ok;
+                    lastSent = cdcClock();
+                    torn = 0;
+                    continue;
+                }
+                if (++torn > CDC_TORN_RETRIES) { rc = -7; gone = 1; break; } // Not a write in progress: the feed is damaged
+            } else if (readerReplaced(&rd, path)) {
+                break; // Reopen: same stream carries on, a new one starts with a snapshot
+            } else if (cdcClock() - lastSent >= (uint64_t)CDC_HEARTBEAT_MS * 1000000u) {
+                CdcRecord hb = { .seq = end - 1, .timeNs = cdcClock(), .op = CDC_MSG_HEARTBEAT };
+                if (sendFrame(fd, &hb) != 0) { gone = 1; break; }
+                lastSent = hb.timeNs;
+            }
+            if (waitIdle(fd, isSocket) != 0) gone = 1;
+        }
+        close(rd.fd);
+        if (gone) break;
+    }
+    free(buf);
+    return rc;
+}
+
+static int readHello(int fd, uint64_t *stream, uint64_t *fromSeq) { // Waits a few seconds for the follower's hello
+    unsigned char h[CDC_HELLO_SIZE];
+    size_t got = 0;
+    while (got < sizeof h) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 5000) <= 0) return -1;
+        ssize_t n = read(fd, h + got, sizeof h - got);
+        if (n <= 0) return -1;
+        got += (size_t)n;
+    }
+    if (memcmp(h, CDC_HELLO_MAGIC, 8) != 0) return -1;
+    *stream = getU64(h + 8);
+    *fromSeq = getU64(h + 16);
+    return 0;
+}
+
+int changeFeedServe(const char *itemsFile, const char *socketPath) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof addr.sun_path) return -1; // Path too long for a Unix socket
+    strcpy(addr.sun_path, socketPath);
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0) return -2;
+    unlink(socketPath); // Remove a stale socket from an earlier run
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(lfd, SOMAXCONN) != 0) { close(lfd); return -3; }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = onStopSignal; // No SA_RESTART: accept returns EINTR and the loop sees 'stopping'
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGCHLD, SIG_IGN); // Publishers are reaped automatically
+    long followers = 0;
+    while (!stopping) {
+        int cfd = accept(lfd, NULL, NULL);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        pid_t pid = fork(); // One publisher per follower: each tails the feed at its own pace
+        if (pid == 0) {
+            close(lfd);
+            uint64_t stream, fromSeq;
+            int rc = readHello(cfd, &stream, &fromSeq) == 0 ? changeFeedPublish(itemsFile, cfd, stream, fromSeq) : -1;
+            close(cfd);
+            _exit(rc < 0 ? 1 : 0);
+        }
+        if (pid > 0) followers++;
+        close(cfd);
+    }
+    close(lfd);
+    unlink(socketPath);
+    fprintf(stderr, "Change feed served to %ld followers.\n", followers);
+    return 0;
+}
+#else
+int changeFeedPublish(const char *itemsFile, int fd, uint64_t stream, uint64_t fromSeq) {
+    (void)itemsFile; (void)fd; (void)stream; (void)fromSeq;
+    return -1; // Needs POSIX file descriptors
+}
+
+int changeFeedServe(const char *itemsFile, const char *socketPath) {
+    (void)itemsFile; (void)socketPath;
+    return -1; // No fork() or Unix sockets here
+}
+#endif
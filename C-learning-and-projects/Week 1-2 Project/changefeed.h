@@ -0,0 +1,169 @@
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+#include <stdio.h>
+#include <stdint.h>
+#include "inventory.h"
+
+/*
+Change data capture. With a change feed attached, every record the
+inventory logs (add, quantity update, delete, transaction markers) is also
+appended to <items>.cdc with a sequence number, so followers can apply the
+same changes in the same order instead of re-reading the whole file.
+
+Feed file: a CDC_RECORD_SIZE header, then records, all little-endian:
+  header:  0 magic "INVFEED1"  8 version (u32)  12 record size (u32)
+          16 stream id (u64)  24 base: sequence of the first record (u64)
+          32 closed cleanly (u32)   40 items file size (u64)
+          48 items file mtime (ns, u64)   56 log size (u64)   92 CRC32C of 0..91
+  record:  0 sequence (u64)  8 primary wall clock (ns, u64)  16 op (u32)
+          20 payload, 68 bytes: ADD the item record (see fileio.h), QTY id
+             and quantity (i32 each), DEL the id, zero for markers
+          88 reserved   92 CRC32C of bytes 0..91
+Records are numbered from 1 and fixed size, so sequence s sits at byte
+(s - base + 1) * CDC_RECORD_SIZE. The base image <items>.cdc.<stream>.<base>
+is an items file holding the state before record 'base': a follower that
+is new, or further behind than the feed reaches, starts from it (snapshot
+plus log offset). Once the feed holds CDC_FEED_MAX_RECORDS the older
+records are folded into a new base image, keeping CDC_FEED_KEEP_RECORDS.
+A forked child does the folding (like a background snapshot) while the
+writer carries on; the writer only swaps its files in, after adding the
+records appended meanwhile (without fork(), the fold runs in place).
+
+The stream id names one unbroken history. Opening a feed that was not
+closed cleanly, or whose items file was changed without it (another
+program, a bulk load), starts a new stream from the current items, so
+followers of the old stream take a fresh snapshot instead of diverging.
+Feed records reach the OS after the log records they copy (never ahead of
+them: whenever the feed's buffer would spill, the log's is flushed first);
+a feed is only synced when it is closed.
+*/
+#define CDC_MAGIC "INVFEED1" // 8 bytes, no terminator stored
+#define CDC_FORMAT_VERSION 1
+#define CDC_SUFFIX ".cdc"
+#define CDC_RECORD_SIZE 96
+#define CDC_PAYLOAD 20 // Payload offset within a record
+#define CDC_FEED_MAX_RECORDS (1L << 20) // About 96 MB of feed before it is folded
+#define CDC_FEED_KEEP_RECORDS (1L << 18) // Records kept by a fold, so followers a little behind need no snapshot
+#define CDC_POLL_MS 20 // Publisher: how often an idle feed is checked for new records
+#define CDC_HEARTBEAT_MS 500 // Publisher: idle stream keep-alive carrying the newest sequence
+
+/*
+Stream messages. After the follower's hello, the publisher sends 96-byte
+frames in the record layout: either HELLO (continuing from the follower's
+position) or a snapshot (SNAPSHOT, one ITEM per item, SNAPSHOT_END), then
+the records in sequence order, with HEARTBEATs while the feed is idle.
+  HELLO, SNAPSHOT, SNAPSHOT_END: sequence = last one covered, payload = stream id (u64), item count (u64)
+  ITEM: payload = item record          HEARTBEAT: sequence = newest record in the feed
+The follower's hello: magic "INVFOLLW", stream id (u64, 0 if none), first wanted sequence (u64)
+*/
+#define CDC_HELLO_MAGIC "INVFOLLW"
+#define CDC_HELLO_SIZE 24
+
+enum { // Frame ops beyond the WalOp values (1..6)
+    CDC_MSG_HELLO = 16,
+    CDC_MSG_SNAPSHOT = 17,
+    CDC_MSG_ITEM = 18,
+    CDC_MSG_SNAPSHOT_END = 19,
+    CDC_MSG_HEARTBEAT = 20
+};
+
+typedef struct { // One decoded record or frame
+    uint64_t seq;
+    uint64_t timeNs; // Primary's wall clock when it was logged (or sent)
+    int op; // WalOp or CDC_MSG_*
+    Item item; // ADD and ITEM: the item; QTY: id and quantity; DEL: id
+    uint64_t stream; // HELLO and snapshot frames
+    uint64_t count; // Snapshot frames: items in the snapshot
+} CdcRecord;
+
+typedef struct { // Writer figures, for the statistics screen
+    long appended; // Records written by this process
+    long folds; // Times old records were folded into a new base image
+    long rebases; // New streams started (unclean close, outside changes, bulk loads)
+} ChangeFeedStats;
+
+typedef struct {
+    FILE *fp; // Feed open for appending
+    Inventory *inv; // Source of the items for a new stream
+    char path[WAL_PATH_MAX + 8]; // <items>.cdc
+    uint64_t stream;
+    uint64_t base; // Sequence of the first record in the file
+    uint64_t next; // Sequence the next record gets
+    int txnDepth; // Inside BEGIN..COMMIT: no fold may cut there
+    size_t pending; // Bytes written to 'fp' since it was last flushed
+    int broken; // A write failed: the inventory's log still has everything, followers will resync
+    int foldPid; // Child building the next base image, 0 when none runs
+    int foldPipe; // Read end of the pipe it reports on
+    uint64_t foldEnd; // Records before this sequence are what the child folds; later ones are copied when it is installed
+    ChangeFeedStats stats;
+} ChangeFeed;
+
+/* Wall clock in nanoseconds: record times and replication lag compare clocks of different processes */
+uint64_t cdcClock(void);
+
+/* Encodes 'r' into a frame (CRC included) / decodes one. Decode returns 0, -7 on a checksum mismatch */
+void cdcEncode(unsigned char out[CDC_RECORD_SIZE], const CdcRecord *r);
+int cdcDecode(CdcRecord *r, const unsigned char in[CDC_RECORD_SIZE]);
+
+/*
+Opens (or starts) the feed of the open, logged inventory 'inv' and attaches
+it to the inventory's log. Call it right after inventoryOpen, and
+changeFeedClose after inventoryClose. Returns 0 continuing the previous
+stream, 1 if a new stream was started, negative on failure (-1 out of
+memory, -2 I/O error, -3 the inventory is not logged)
+*/
+int changeFeedOpen(ChangeFeed *cf, Inventory *inv);
+
+/* Syncs the feed and marks it closed cleanly (the inventory must be closed already). Returns 0 on success */
+int changeFeedClose(ChangeFeed *cf);
+
+/* Prints a one-line summary: stream, sequence range and what this process wrote */
+void changeFeedReport(const ChangeFeed *cf, FILE *out);
+
+/*
+Applies change records to an inventory: adds are upserts and updates or
+deletes of missing ids are ignored, so replaying records the target
+already has is harmless. Transactions are held back until their COMMIT
+and applied as one (dropped on ABORT)
+*/
+typedef struct {
+    Inventory *inv;
+    CdcRecord *held; // Records of the open transaction
+    int heldCount, heldCap;
+    int inTxn;
+} CdcApplier;
+
+/* Prepares an applier writing to 'inv' */
+void cdcApplierInit(CdcApplier *a, Inventory *inv);
+
+/* Forgets a transaction that has not committed (e.g. the stream broke) */
+void cdcApplierReset(CdcApplier *a);
+
+/* Releases the held records */
+void cdcApplierFree(CdcApplier *a);
+
+/*
+Applies (or holds) one data or marker record. Returns 1 if the target is
+now at a transaction boundary (the record stood alone, committed or
+aborted), 0 if it is held, negative if the inventory failed
+*/
+int cdcApply(CdcApplier *a, const CdcRecord *r);
+
+/*
+Streams the feed of 'itemsFile' to 'fd': a snapshot first unless the
+follower is on 'stream' and 'fromSeq' is still in the feed, then every
+record from there on as it is written, until the other side goes away
+(or SIGINT/SIGTERM when serving). Returns 0 when the follower left,
+1 if the inventory has no feed, negative on failure
+*/
+int changeFeedPublish(const char *itemsFile, int fd, uint64_t stream, uint64_t fromSeq);
+
+/*
+Serves the feed on the Unix socket 'socketPath': each follower that
+connects gets its own forked publisher, which starts where its hello asks.
+Runs until SIGINT or SIGTERM. Returns 0 after a clean shutdown, negative if
+the socket could not be set up (or the platform has no fork and Unix sockets)
+*/
+int changeFeedServe(const char *itemsFile, const char *socketPath);
+
+#endif // CHANGEFEED_H
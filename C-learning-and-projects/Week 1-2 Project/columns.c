@@ -0,0 +1,454 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "columns.h"
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define COLUMNS_X86 1 // SSE2 is always there on x86-64, AVX2 is checked at runtime
+#endif
+
+static uint8_t categoryByte(const Item *item) { // What the category column stores for a live item
+    return (unsigned)item->category < COL_CATEGORIES ? (uint8_t)item->category : COL_NO_CATEGORY;
+}
+
+int columnsReserve(ItemColumns *cols, int n) {
+    if (n <= cols->capacity) return 0;
+    int newCap = cols->capacity ? cols->capacity : 16;
+    while (newCap < n) newCap = newCap > 0x3FFFFFFF ? n : newCap * 2; // Same geometric growth as the items array
+    int32_t *id = realloc(cols->id, (size_t)newCap * sizeof *id);
+    if (id) cols->id = id; // Each array is kept as soon as it has grown, so a later failure leaks nothing
+    int32_t *quantity = id ? realloc(cols->quantity, (size_t)newCap * sizeof *quantity) : NULL;
+    if (quantity) cols->quantity = quantity;
+    float *price = quantity ? realloc(cols->price, (size_t)newCap * sizeof *price) : NULL;
+    if (price) cols->price = price;
+    uint8_t *category = price ? realloc(cols->category, (size_t)newCap) : NULL;
+    if (!category) return -1;
+    cols->category = category;
+    cols->capacity = newCap;
+    return 0;
+}
+
+void columnsSet(ItemColumns *cols, int slot, const Item *item) {
+    if (item->id == 0) { // Deleted slot
+        cols->id[slot] = 0;
+        columnsKill(cols, slot);
+    } else {
+        cols->id[slot] = item->id;
+        cols->quantity[slot] = item->quantity;
+        cols->price[slot] = item->price;
+        cols->category[slot] = categoryByte(item);
+    }
+    if (slot == cols->count) cols->count++;
+}
+
+void columnsKill(ItemColumns *cols, int slot) {
+    cols->quantity[slot] = 0; // Zeros keep the sums right even where a kernel does not mask
+    cols->price[slot] = 0.0f;
+    cols->category[slot] = COL_DEAD;
+}
+
+void columnsMove(ItemColumns *cols, int to, int from) {
+    cols->id[to] = cols->id[from];
+    cols->quantity[to] = cols->quantity[from];
+    cols->price[to] = cols->price[from];
+    cols->category[to] = cols->category[from];
+}
+
+int columnsBuild(ItemColumns *cols, const Item *items, int count) {
+    cols->count = 0;
+    if (columnsReserve(cols, count > 0 ? count : 1) != 0) return -1;
+    for (int i = 0; i < count; ++i) columnsSet(cols, i, &items[i]); // One pass turning rows into columns
+    return 0;
+}
+
+void columnsFree(ItemColumns *cols) {
+    free(cols->id);
+    free(cols->quantity);
+    free(cols->price);
+    free(cols->category);
+    memset(cols, 0, sizeof *cols);
+}
+
+static inline int matches(uint8_t c, int category) { // Scalar form of the kernels' lane mask
+    return category < 0 ? c != COL_DEAD : c == category;
+}
+
+/* Scalar kernels over slots [from, to); the SIMD versions use them for the tail */
+
+static long scalarCount(const ItemColumns *cols, int category, int from, int to) {
+    long n = 0;
+    for (int i = from; i < to; ++i) n += matches(cols->category[i], category);
+    return n;
+}
+
+static long long scalarSumQuantity(const ItemColumns *cols, int category, int from, int to) {
+    long long sum = 0;
+    for (int i = from; i < to; ++i) {
+        if (matches(cols->category[i], category)) sum += cols->quantity[i];
+    }
+    return sum;
+}
+
+static double scalarSumValue(const ItemColumns *cols, int category, int from, int to) {
+    double sum = 0.0;
+    for (int i = from; i < to; ++i) {
+        if (matches(cols->category[i], category)) sum += (double)cols->quantity[i] * cols->price[i];
+    }
+    return sum;
+}
+
+static long scalarMinMax(const ItemColumns *cols, int category, int from, int to, float *lo, float *hi) { // Widens *lo/*hi
+    long n = 0;
+    for (int i = from; i < to; ++i) {
+        if (!matches(cols->category[i], category)) continue;
+        float p = cols->price[i];
+        if (p < *lo) *lo = p;
+        if (p > *hi) *hi = p;
+        n++;
+    }
+    return n;
+}
+
+static void scalarValueByCategory(const ItemColumns *cols, int from, int to, double out[COL_CATEGORIES]) { // Adds to out
+    for (int i = from; i < to; ++i) {
+        uint8_t c = cols->category[i];
+        if (c < COL_CATEGORIES) out[c] += (double)cols->quantity[i] * cols->price[i];
+    }
+}
+
+typedef struct { // One kernel set, all over the whole column range
+    long (*count)(const ItemColumns *cols, int category);
+    long long (*sumQuantity)(const ItemColumns *cols, int category);
+    double (*sumValue)(const ItemColumns *cols, int category);
+    long (*minMax)(const ItemColumns *cols, int category, float *lo, float *hi);
+    void (*valueByCategory)(const ItemColumns *cols, double out[COL_CATEGORIES]);
+} Kernels;
+
+static long countScalar(const ItemColumns *c, int cat) { return scalarCount(c, cat, 0, c->count); }
+static long long sumQuantityScalar(const ItemColumns *c, int cat) { return scalarSumQuantity(c, cat, 0, c->count); }
+static double sumValueScalar(const ItemColumns *c, int cat) { return scalarSumValue(c, cat, 0, c->count); }
+static long minMaxScalar(const ItemColumns *c, int cat, float *lo, float *hi) { return scalarMinMax(c, cat, 0, c->count, lo, hi); }
+static void valueByCategoryScalar(const ItemColumns *c, double out[COL_CATEGORIES]) { scalarValueByCategory(c, 0, c->count, out); }
+
+static const Kernels scalarKernels = { countScalar, sumQuantityScalar, sumValueScalar, minMaxScalar, valueByCategoryScalar };
+
+#ifdef COLUMNS_X86
+
+/* SSE2: 4 slots per step. Category bytes are widened to 32-bit lanes and compared into a lane mask */
+
+static inline __m128i sseCategories(const uint8_t *p) { // 4 category bytes -> 4 x i32
+    int32_t raw;
+    memcpy(&raw, p, sizeof raw);
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(raw), zero), zero);
+}
+
+static inline __m128i sseMask(const uint8_t *p, int category) { // All ones in lanes that take part
+    __m128i c = sseCategories(p);
+    if (category < 0) return _mm_xor_si128(_mm_cmpeq_epi32(c, _mm_set1_epi32(COL_DEAD)), _mm_set1_epi32(-1));
+    return _mm_cmpeq_epi32(c, _mm_set1_epi32(category));
+}
+
+static inline __m128d sseLowValues(__m128i q, __m128 p) { // quantity * price of lanes 0-1 as doubles
+    return _mm_mul_pd(_mm_cvtepi32_pd(q), _mm_cvtps_pd(p));
+}
+
+static inline __m128d sseHighValues(__m128i q, __m128 p) { // Lanes 2-3
+    return _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(q, 0x0E)), _mm_cvtps_pd(_mm_movehl_ps(p, p)));
+}
+
+static long countSse2(const ItemColumns *c, int cat) {
+    int n = c->count & ~3;
+    __m128i acc = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 4) acc = _mm_sub_epi32(acc, sseMask(c->category + i, cat)); // Mask lanes are -1
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return (long)lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalarCount(c, cat, n, c->count);
+}
+
+static long long sumQuantitySse2(const ItemColumns *c, int cat) {
+    int n = c->count & ~3;
+    __m128i acc = _mm_setzero_si128(); // 2 x i64
+    for (int i = 0; i < n; i += 4) {
+        __m128i q = _mm_and_si128(_mm_loadu_si128((const __m128i *)(c->quantity + i)), sseMask(c->category + i, cat));
+        __m128i sign = _mm_cmpgt_epi32(_mm_setzero_si128(), q); // Sign-extend to 64 bits (no pmovsx before SSE4.1)
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(q, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(q, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + scalarSumQuantity(c, cat, n, c->count);
+}
+
+static double sumValueSse2(const ItemColumns *c, int cat) {
+    int n = c->count & ~3;
+    __m128d acc = _mm_setzero_pd();
+    for (int i = 0; i < n; i += 4) {
+        __m128i m = sseMask(c->category + i, cat);
+        __m128i q = _mm_and_si128(_mm_loadu_si128((const __m128i *)(c->quantity + i)), m);
+        __m128 p = _mm_and_ps(_mm_loadu_ps(c->price + i), _mm_castsi128_ps(m));
+        acc = _mm_add_pd(acc, _mm_add_pd(sseLowValues(q, p), sseHighValues(q, p)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1] + scalarSumValue(c, cat, n, c->count);
+}
+
+static long minMaxSse2(const ItemColumns *c, int cat, float *lo, float *hi) {
+    int n = c->count & ~3;
+    __m128 vlo = _mm_set1_ps(INFINITY), vhi = _mm_set1_ps(-INFINITY);
+    __m128i cnt = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 4) {
+        __m128i m = sseMask(c->category + i, cat);
+        __m128 mf = _mm_castsi128_ps(m);
+        __m128 p = _mm_loadu_ps(c->price + i);
+        vlo = _mm_min_ps(vlo, _mm_or_ps(_mm_and_ps(mf, p), _mm_andnot_ps(mf, _mm_set1_ps(INFINITY)))); // Masked-off lanes cannot win
+        vhi = _mm_max_ps(vhi, _mm_or_ps(_mm_and_ps(mf, p), _mm_andnot_ps(mf, _mm_set1_ps(-INFINITY))));
+        cnt = _mm_sub_epi32(cnt, m);
+    }
+    float l[4], h[4];
+    int32_t k[4];
+    _mm_storeu_ps(l, vlo);
+    _mm_storeu_ps(h, vhi);
+    _mm_storeu_si128((__m128i *)k, cnt);
+    for (int j = 0; j < 4; ++j) {
+        if (l[j] < *lo) *lo = l[j];
+        if (h[j] > *hi) *hi = h[j];
+    }
+    return (long)k[0] + k[1] + k[2] + k[3] + scalarMinMax(c, cat, n, c->count, lo, hi);
+}
+
+static void valueByCategorySse2(const ItemColumns *c, double out[COL_CATEGORIES]) {
+    int n = c->count & ~3;
+    __m128d acc[COL_CATEGORIES][2];
+    for (int k = 0; k < COL_CATEGORIES; ++k) acc[k][0] = acc[k][1] = _mm_setzero_pd();
+    for (int i = 0; i < n; i += 4) {
+        __m128i cats = sseCategories(c->category + i);
+        __m128i q = _mm_loadu_si128((const __m128i *)(c->quantity + i));
+        __m128 p = _mm_loadu_ps(c->price + i);
+        __m128d v0 = sseLowValues(q, p), v1 = sseHighValues(q, p); // Products once, then masked per category
+        for (int k = 0; k < COL_CATEGORIES; ++k) {
+            __m128i m = _mm_cmpeq_epi32(cats, _mm_set1_epi32(k));
+            acc[k][0] = _mm_add_pd(acc[k][0], _mm_and_pd(v0, _mm_castsi128_pd(_mm_unpacklo_epi32(m, m)))); // i32 mask -> i64 mask
+            acc[k][1] = _mm_add_pd(acc[k][1], _mm_and_pd(v1, _mm_castsi128_pd(_mm_unpackhi_epi32(m, m))));
+        }
+    }
+    for (int k = 0; k < COL_CATEGORIES; ++k) {
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(acc[k][0], acc[k][1]));
+        out[k] += lanes[0] + lanes[1];
+    }
+    scalarValueByCategory(c, n, c->count, out);
+}
+
+static const Kernels sse2Kernels = { countSse2, sumQuantitySse2, sumValueSse2, minMaxSse2, valueByCategorySse2 };
+
+/* AVX2: 8 slots per step, same structure with 256-bit registers */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i avxCategories(const uint8_t *p) { // 8 category bytes -> 8 x i32
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+
+AVX2 static inline __m256i avxMask(const uint8_t *p, int category) {
+    __m256i c = avxCategories(p);
+    if (category < 0) return _mm256_xor_si256(_mm256_cmpeq_epi32(c, _mm256_set1_epi32(COL_DEAD)), _mm256_set1_epi32(-1));
+    return _mm256_cmpeq_epi32(c, _mm256_set1_epi32(category));
+}
+
+AVX2 static inline __m256d avxLowValues(__m256i q, __m256 p) { // Lanes 0-3 as doubles
+    return _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(q)), _mm256_cvtps_pd(_mm256_castps256_ps128(p)));
+}
+
+AVX2 static inline __m256d avxHighValues(__m256i q, __m256 p) { // Lanes 4-7
+    return _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(q, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(p, 1)));
+}
+
+AVX2 static double avxSumPd(__m256d v) {
+    double lanes[4];
+    _mm256_storeu_pd(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+AVX2 static long countAvx2(const ItemColumns *c, int cat) {
+    int n = c->count & ~7;
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 8) acc = _mm256_sub_epi32(acc, avxMask(c->category + i, cat));
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    long total = 0;
+    for (int j = 0; j < 8; ++j) total += lanes[j];
+    return total + scalarCount(c, cat, n, c->count);
+}
+
+AVX2 static long long sumQuantityAvx2(const ItemColumns *c, int cat) {
+    int n = c->count & ~7;
+    __m256i acc = _mm256_setzero_si256(); // 4 x i64
+    for (int i = 0; i < n; i += 8) {
+        __m256i q = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(c->quantity + i)), avxMask(c->category + i, cat));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(q)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(q, 1)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalarSumQuantity(c, cat, n, c->count);
+}
+
+AVX2 static double sumValueAvx2(const ItemColumns *c, int cat) {
+    int n = c->count & ~7;
+    __m256d acc = _mm256_setzero_pd();
+    for (int i = 0; i < n; i += 8) {
+        __m256i m = avxMask(c->category + i, cat);
+        __m256i q = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(c->quantity + i)), m);
+        __m256 p = _mm256_and_ps(_mm256_loadu_ps(c->price + i), _mm256_castsi256_ps(m));
+        acc = _mm256_add_pd(acc, _mm256_add_pd(avxLowValues(q, p), avxHighValues(q, p)));
+    }
+    return avxSumPd(acc) + scalarSumValue(c, cat, n, c->count);
+}
+
+AVX2 static long minMaxAvx2(const ItemColumns *c, int cat, float *lo, float *hi) {
+    int n = c->count & ~7;
+    __m256 vlo = _mm256_set1_ps(INFINITY), vhi = _mm256_set1_ps(-INFINITY);
+    __m256i cnt = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 8) {
+        __m256i m = avxMask(c->category + i, cat);
+        __m256 p = _mm256_loadu_ps(c->price + i);
+        vlo = _mm256_min_ps(vlo, _mm256_blendv_ps(_mm256_set1_ps(INFINITY), p, _mm256_castsi256_ps(m)));
+        vhi = _mm256_max_ps(vhi, _mm256_blendv_ps(_mm256_set1_ps(-INFINITY), p, _mm256_castsi256_ps(m)));
+        cnt = _mm256_sub_epi32(cnt, m);
+    }
+    float l[8], h[8];
+    int32_t k[8];
+    _mm256_storeu_ps(l, vlo);
+    _mm256_storeu_ps(h, vhi);
+    _mm256_storeu_si256((__m256i *)k, cnt);
+    long total = 0;
+    for (int j = 0; j < 8; ++j) {
+        if (l[j] < *lo) *lo = l[j];
+        if (h[j] > *hi) *hi = h[j];
+        total += k[j];
+    }
+    return total + scalarMinMax(c, cat, n, c->count, lo, hi);
+}
+
+AVX2 static void valueByCategoryAvx2(const ItemColumns *c, double out[COL_CATEGORIES]) {
+    int n = c->count & ~7;
+    __m256d acc[COL_CATEGORIES][2];
+    for (int k = 0; k < COL_CATEGORIES; ++k) acc[k][0] = acc[k][1] = _mm256_setzero_pd();
+    for (int i = 0; i < n; i += 8) {
+        __m256i cats = avxCategories(c->category + i);
+        __m256i q = _mm256_loadu_si256((const __m256i *)(c->quantity + i));
+        __m256 p = _mm256_loadu_ps(c->price + i);
+        __m256d v0 = avxLowValues(q, p), v1 = avxHighValues(q, p);
+        for (int k = 0; k < COL_CATEGORIES; ++k) {
+            __m256i m = _mm256_cmpeq_epi32(cats, _mm256_set1_epi32(k));
+            __m256d m0 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(m))); // i32 mask -> i64 mask
+            __m256d m1 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(m, 1)));
+            acc[k][0] = _mm256_add_pd(acc[k][0], _mm256_and_pd(v0, m0));
+            acc[k][1] = _mm256_add_pd(acc[k][1], _mm256_and_pd(v1, m1));
+        }
+    }
+    for (int k = 0; k < COL_CATEGORIES; ++k) out[k] += avxSumPd(_mm256_add_pd(acc[k][0], acc[k][1]));
+    scalarValueByCategory(c, n, c->count, out);
+}
+
+static const Kernels avx2Kernels = { countAvx2, sumQuantityAvx2, sumValueAvx2, minMaxAvx2, valueByCategoryAvx2 };
+
+#endif // COLUMNS_X86
+
+static const Kernels *active = NULL; // Picked on first use
+static int activeSet = COL_KERNEL_SCALAR;
+
+static int bestKernels(void) { // Best set this CPU runs
+#ifdef COLUMNS_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? COL_KERNEL_AVX2 : COL_KERNEL_SSE2;
+#else
+    return COL_KERNEL_SCALAR;
+#endif
+}
+
+int columnsUseKernels(int kernels) {
+    int best = bestKernels();
+    if (kernels > best) kernels = best;
+    if (kernels < COL_KERNEL_SCALAR) kernels = COL_KERNEL_SCALAR;
+    active = &scalarKernels;
+#ifdef COLUMNS_X86
+    if (kernels == COL_KERNEL_SSE2) active = &sse2Kernels;
+    if (kernels == COL_KERNEL_AVX2) active = &avx2Kernels;
+#endif
+    activeSet = kernels;
+    return activeSet;
+}
+
+const char *columnsKernelName(int kernels) {
+    switch (kernels) {
+        case COL_KERNEL_SSE2: return "sse2";
+        case COL_KERNEL_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+static const Kernels *kernels(void) {
+    if (!active) columnsUseKernels(COL_KERNEL_AVX2); // Best available
+    return active;
+}
+
+long columnsCount(const ItemColumns *cols, int category) {
+    if (category >= COL_CATEGORIES) return 0;
+    return kernels()->count(cols, category);
+}
+
+long long columnsSumQuantity(const ItemColumns *cols, int category) {
+    if (category >= COL_CATEGORIES) return 0;
+    return kernels()->sumQuantity(cols, category);
+}
+
+double columnsSumValue(const ItemColumns *cols, int category) {
+    if (category >= COL_CATEGORIES) return 0.0;
+    return kernels()->sumValue(cols, category);
+}
+
+long columnsMinMaxPrice(const ItemColumns *cols, int category, float *minPtr, float *maxPtr) {
+    float lo = INFINITY, hi = -INFINITY;
+    long n = category >= COL_CATEGORIES ? 0 : kernels()->minMax(cols, category, &lo, &hi);
+    *minPtr = n ? lo : 0.0f;
+    *maxPtr = n ? hi : 0.0f;
+    return n;
+}
+
+void columnsValueByCategory(const ItemColumns *cols, double out[COL_CATEGORIES]) {
+    for (int k = 0; k < COL_CATEGORIES; ++k) out[k] = 0.0;
+    kernels()->valueByCategory(cols, out);
+}
+
+void columnsSummarize(const ItemColumns *cols, int category, ColumnSummary *out) {
+    out->count = columnsMinMaxPrice(cols, category, &out->minPrice, &out->maxPrice);
+    out->quantity = columnsSumQuantity(cols, category);
+    out->value = columnsSumValue(cols, category);
+}
+
+void rowsSummarize(const Item *items, int count, int category, ColumnSummary *out) {
+    memset(out, 0, sizeof *out);
+    if (category >= COL_CATEGORIES) return;
+    float lo = INFINITY, hi = -INFINITY;
+    for (int i = 0; i < count; ++i) { // Every field access pulls in the whole 68-byte row
+        const Item *it = &items[i];
+        if (it->id == 0 || (category >= 0 && (int)it->category != category)) continue;
+        out->count++;
+        out->quantity += it->quantity;
+        out->value += (double)it->quantity * it->price;
+        if (it->price < lo) lo = it->price;
+        if (it->price > hi) hi = it->price;
+    }
+    out->minPrice = out->count ? lo : 0.0f;
+    out->maxPrice = out->count ? hi : 0.0f;
+}
+
+void rowsValueByCategory(const Item *items, int count, double out[COL_CATEGORIES]) {
+    for (int k = 0; k < COL_CATEGORIES; ++k) out[k] = 0.0;
+    for (int i = 0; i < count; ++i) {
+        if (items[i].id != 0 && (unsigned)items[i].category < COL_CATEGORIES) out[items[i].category] += (double)items[i].quantity * items[i].price;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+#include <stdint.h>
+#include "item.h"
+
+#define COL_CATEGORIES 4 // ELECTRONICS..OTHER, the groups of columnsValueByCategory
+#define COL_NO_CATEGORY 0xFE // Category byte of a live item whose category is out of range (counted only under "any")
+#define COL_DEAD 0xFF // Category byte of a deleted slot
+
+enum { // Kernel sets for the aggregations, best first in columnsUseKernels
+    COL_KERNEL_SCALAR = 0,
+    COL_KERNEL_SSE2 = 1,
+    COL_KERNEL_AVX2 = 2
+};
+
+typedef struct { // Columnar copy of the fields reports read, slot-aligned with the items array
+    int32_t *id;
+    int32_t *quantity; // 0 in deleted slots
+    float *price; // 0 in deleted slots
+    uint8_t *category; // Category, COL_NO_CATEGORY or COL_DEAD
+    int count; // Slots in use (same as the inventory's count)
+    int capacity;
+} ItemColumns;
+
+typedef struct { // Result of an aggregation over one category (or all items)
+    long count; // Live items
+    long long quantity; // Sum of quantities
+    double value; // Sum of quantity * price
+    float minPrice, maxPrice; // 0 when count is 0
+} ColumnSummary;
+
+/* Fills 'cols' from 'count' slots of 'items' (id 0 marks a deleted slot). Returns 0 on success, -1 on failure */
+int columnsBuild(ItemColumns *cols, const Item *items, int count);
+
+/* Releases the arrays and resets 'cols' to empty */
+void columnsFree(ItemColumns *cols);
+
+/* Makes room for at least 'n' slots. Returns 0 on success, -1 on failure */
+int columnsReserve(ItemColumns *cols, int n);
+
+/* Writes 'item' into 'slot' (slot <= count, room must be reserved); writing slot == count appends */
+void columnsSet(ItemColumns *cols, int slot, const Item *item);
+
+/* Marks 'slot' deleted */
+void columnsKill(ItemColumns *cols, int slot);
+
+/* Copies slot 'from' to slot 'to' (compaction) */
+void columnsMove(ItemColumns *cols, int to, int from);
+
+/*
+Aggregation kernels over live slots of 'category' (-1 means any category).
+They read only the columns they need and run on SSE2/AVX2 when available
+*/
+long columnsCount(const ItemColumns *cols, int category);
+long long columnsSumQuantity(const ItemColumns *cols, int category);
+double columnsSumValue(const ItemColumns *cols, int category);
+long columnsMinMaxPrice(const ItemColumns *cols, int category, float *minPtr, float *maxPtr); // Returns the count
+
+/* Sum of quantity * price per category in one pass */
+void columnsValueByCategory(const ItemColumns *cols, double out[COL_CATEGORIES]);
+
+/* Runs all four kernels for 'category' */
+void columnsSummarize(const ItemColumns *cols, int category, ColumnSummary *out);
+
+/* Same results computed straight from the row array, used when columns are off and as the benchmark baseline */
+void rowsSummarize(const Item *items, int count, int category, ColumnSummary *out);
+void rowsValueByCategory(const Item *items, int count, double out[COL_CATEGORIES]);
+
+/*
+Selects the kernel set (COL_KERNEL_*); asking for more than the CPU has
+falls back to the best it supports. Returns the set now in use.
+Until the first call the best available set is picked automatically
+*/
+int columnsUseKernels(int kernels);
+
+/* Name of a kernel set, for reports */
+const char *columnsKernelName(int kernels);
+
+#endif // COLUMNS_H
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "compact.h"
+#include "fileio.h"
+#include "crc32c.h"
+#include "byteorder.h"
+
+#define COMPACT_MIN_CAPACITY 16
+
+static int layoutIsNative(void) { // CompactItem matches the on-disk record on this host
+    const uint16_t probe = 1;
+    return sizeof(CompactItem) == COMPACT_RECORD_SIZE && offsetof(CompactItem, nameOff) == 4 &&
+           offsetof(CompactItem, quantity) == 8 && offsetof(CompactItem, price) == 12 &&
+           offsetof(CompactItem, nameLen) == 16 && offsetof(CompactItem, category) == 18 &&
+           *(const unsigned char *)&probe == 1;
+}
+
+static void encodeRecord(unsigned char *out, const CompactItem *ci) {
+    uint32_t bits;
+    memcpy(&bits, &ci->price, sizeof bits);
+    putU32(out, (uint32_t)ci->id);
+    putU32(out + 4, ci->nameOff);
+    putU32(out + 8, (uint32_t)ci->quantity);
+    putU32(out + 12, bits);
+    out[16] = (unsigned char)ci->nameLen;
+    out[17] = (unsigned char)(ci->nameLen >> 8);
+    out[18] = ci->category;
+    out[19] = 0;
+}
+
+static void decodeRecord(CompactItem *ci, const unsigned char *in) {
+    uint32_t bits = getU32(in + 12);
+    ci->id = (int32_t)getU32(in);
+    ci->nameOff = getU32(in + 4);
+    ci->quantity = (int32_t)getU32(in + 8);
+    memcpy(&ci->price, &bits, sizeof bits);
+    ci->nameLen = (uint16_t)(in[16] | (in[17] << 8));
+    ci->category = in[18];
+    ci->reserved = 0;
+}
+
+static uint32_t blockCount(uint64_t count) {
+    return (uint32_t)((count + ITEMS_BLOCK_RECORDS - 1) / ITEMS_BLOCK_RECORDS);
+}
+
+static void encodeHeader(unsigned char *out, uint64_t count, uint64_t arenaSize) {
+    memset(out, 0, ITEMS_HEADER_SIZE);
+    memcpy(out, ITEMS_MAGIC, 8);
+    putU32(out + 8, ITEMS_FORMAT_VERSION);
+    putU32(out + 12, ITEMS_HEADER_SIZE);
+    putU32(out + 16, COMPACT_RECORD_SIZE);
+    putU32(out + 20, ITEMS_BLOCK_RECORDS);
+    putU64(out + 24, count);
+    putU64(out + 32, ITEMS_HEADER_SIZE + count * COMPACT_RECORD_SIZE + arenaSize); // CRC table after records and arena
+    putU32(out + 40, ITEMS_FLAG_COMPACT);
+    putU64(out + 44, arenaSize);
+    putU32(out + 60, crc32c(0, out, 60));
+}
+
+static int parseHeader(const unsigned char *hdr, long long fileBytes, uint64_t *countPtr, uint64_t *arenaPtr) { // Same checks as fileio's
+    if (fileBytes < ITEMS_HEADER_SIZE) return -6;
+    if (memcmp(hdr, ITEMS_MAGIC, 8) != 0) return -4;
+    if (crc32c(0, hdr, 60) != getU32(hdr + 60)) return -7;
+    if (getU32(hdr + 8) != ITEMS_FORMAT_VERSION || getU32(hdr + 12) != ITEMS_HEADER_SIZE ||
+        getU32(hdr + 16) != COMPACT_RECORD_SIZE || getU32(hdr + 20) != ITEMS_BLOCK_RECORDS ||
+        !(getU32(hdr + 40) & ITEMS_FLAG_COMPACT)) return -5; // A full-record file, or another version
+    uint64_t count = getU64(hdr + 24), arena = getU64(hdr + 44);
+    if (count > (uint64_t)0x7FFFFFFF || arena > UINT32_MAX) return -5;
+    uint64_t crcOffset = getU64(hdr + 32);
+    if (crcOffset != ITEMS_HEADER_SIZE + count * COMPACT_RECORD_SIZE + arena) return -5;
+    if ((uint64_t)fileBytes != crcOffset + ((uint64_t)blockCount(count) + 1) * 4) return -6; // Torn or padded
+    *countPtr = count;
+    *arenaPtr = arena;
+    return 0;
+}
+
+int compactInit(CompactStore *cs) {
+    memset(cs, 0, sizeof *cs);
+    strArenaInit(&cs->names);
+    return hashIndexInit(&cs->index, 0);
+}
+
+void compactFree(CompactStore *cs) {
+    free(cs->items);
+    strArenaFree(&cs->names);
+    hashIndexFree(&cs->index);
+    memset(cs, 0, sizeof *cs);
+}
+
+static int reserve(CompactStore *cs, int n) {
+    if (n <= cs->capacity) return 0;
+    int newCap = cs->capacity ? cs->capacity : COMPACT_MIN_CAPACITY;
+    while (newCap < n) newCap = newCap > 0x3FFFFFFF ? n : newCap * 2;
+    CompactItem *tmp = realloc(cs->items, (size_t)newCap * sizeof *tmp);
+    if (!tmp) return -1;
+    cs->items = tmp;
+    cs->capacity = newCap;
+    return 0;
+}
+
+int compactFind(const CompactStore *cs, int id) {
+    return hashIndexFind(&cs->index, id);
+}
+
+int compactAdd(CompactStore *cs, const Item *item) {
+    if (item->id <= 0 || hashIndexFind(&cs->index, item->id) >= 0) return 1;
+    if (reserve(cs, cs->count + 1) != 0) return -1;
+    CompactItem *ci = &cs->items[cs->count];
+    uint32_t len = (uint32_t)strnlen(item->name, sizeof item->name - 1);
+    if (strArenaIntern(&cs->names, item->name, len, &ci->nameOff) != 0) return -1; // Repeated names share one copy
+    if (hashIndexInsert(&cs->index, item->id, cs->count) != 0) return -1;
+    ci->id = item->id;
+    ci->nameLen = (uint16_t)len;
+    ci->quantity = item->quantity;
+    ci->price = item->price;
+    ci->category = (uint8_t)item->category;
+    ci->reserved = 0;
+    cs->count++;
+    cs->live++;
+    return 0;
+}
+
+int compactDelete(CompactStore *cs, int id) {
+    int slot = hashIndexFind(&cs->index, id);
+    if (slot < 0) return 1;
+    hashIndexRemove(&cs->index, id);
+    cs->items[slot].id = 0; // The name stays in the arena, other items may share it
+    cs->live--;
+    return 0;
+}
+
+int compactFromItems(CompactStore *cs, const Item *items, int count) {
+    if (compactInit(cs) != 0) return -1;
+    if (reserve(cs, count) != 0) { compactFree(cs); return -1; }
+    for (int i = 0; i < count; ++i) {
+        if (items[i].id == 0) continue;
+        if (compactAdd(cs, &items[i]) < 0) { compactFree(cs); return -1; } // Duplicate ids keep the first, as in hashIndexBuild
+    }
+    return 0;
+}
+
+void compactExpand(const CompactStore *cs, const CompactItem *ci, Item *out) {
+    memset(out, 0, sizeof *out);
+    out->id = ci->id;
+    memcpy(out->name, compactName(cs, ci), ci->nameLen < sizeof out->name ? ci->nameLen : sizeof out->name - 1);
+    out->quantity = ci->quantity;
+    out->price = ci->price;
+    out->category = (Category)ci->category;
+}
+
+int compactToItems(const CompactStore *cs, Item **arrayPtr, int *countPtr) {
+    Item *arr = malloc(cs->live > 0 ? (size_t)cs->live * sizeof *arr : 1);
+    if (!arr) return -1;
+    int n = 0;
+    for (int i = 0; i < cs->count; ++i) {
+        const CompactItem *ci = &cs->items[i];
+        if (ci->id == 0) continue;
+        compactExpand(cs, ci, &arr[n++]);
+    }
+    *arrayPtr = arr;
+    *countPtr = n;
+    return 0;
+}
+
+int compactFileDetect(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 0;
+    unsigned char hdr[ITEMS_HEADER_SIZE];
+    int is = fread(hdr, 1, sizeof hdr, fp) == sizeof hdr && memcmp(hdr, ITEMS_MAGIC, 8) == 0 &&
+             getU32(hdr + 16) == COMPACT_RECORD_SIZE && (getU32(hdr + 40) & ITEMS_FLAG_COMPACT);
+    fclose(fp);
+    return is;
+}
+
+int compactLoad(CompactStore *cs, const char *filename) {
+    if (compactInit(cs) != 0) return -1;
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 1; // No file yet, empty store
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    unsigned char hdr[ITEMS_HEADER_SIZE];
+    uint64_t total = 0, arenaSize = 0;
+    int rc = fread(hdr, 1, sizeof hdr, fp) == sizeof hdr ? parseHeader(hdr, size, &total, &arenaSize) : -6;
+    if (rc != 0) { fclose(fp); compactFree(cs); return rc; }
+    int count = (int)total;
+    uint32_t blocks = blockCount(total);
+    CompactItem *items = malloc(count ? (size_t)count * sizeof *items : 1); // All records in one block
+    char *arena = malloc(arenaSize ? (size_t)arenaSize : 1); // All names in one block
+    unsigned char *raw = malloc((size_t)ITEMS_BLOCK_RECORDS * COMPACT_RECORD_SIZE);
+    unsigned char *crcs = malloc(((size_t)blocks + 1) * 4);
+    if (!items || !arena || !raw || !crcs) { rc = -1; goto done; }
+    int native = layoutIsNative();
+    for (uint32_t b = 0; rc == 0 && b < blocks; ++b) { // Read, check and (if needed) decode one block at a time
+        int first = (int)(b * ITEMS_BLOCK_RECORDS);
+        int n = count - first < ITEMS_BLOCK_RECORDS ? count - first : ITEMS_BLOCK_RECORDS;
+        size_t bytes = (size_t)n * COMPACT_RECORD_SIZE;
+        unsigned char *dst = native ? (unsigned char *)&items[first] : raw;
+        if (fread(dst, 1, bytes, fp) != bytes) { rc = -2; break; }
+        if (!native) for (int i = 0; i < n; ++i) decodeRecord(&items[first + i], raw + (size_t)i * COMPACT_RECORD_SIZE);
+        putU32(crcs + 4 * b, crc32c(0, dst, bytes)); // Computed now, compared once the table is read
+    }
+    if (rc == 0 && arenaSize && fread(arena, 1, (size_t)arenaSize, fp) != arenaSize) rc = -2;
+    if (rc == 0) putU32(crcs + 4 * blocks, crc32c(0, arena, (size_t)arenaSize));
+    for (uint32_t b = 0; rc == 0 && b <= blocks; ++b) { // Stored table follows the arena
+        unsigned char want[4];
+        if (fread(want, 1, 4, fp) != 4) rc = -2;
+        else if (memcmp(want, crcs + 4 * b, 4) != 0) rc = -7;
+    }
+    if (rc == 0 && arenaSize && arena[arenaSize - 1] != '\0') rc = -7;
+    for (int i = 0; rc == 0 && i < count; ++i) { // Every name must lie inside the arena, terminated where the length says
+        const CompactItem *ci = &items[i];
+        if ((uint64_t)ci->nameOff + ci->nameLen >= arenaSize || arena[ci->nameOff + ci->nameLen] != '\0') rc = -7;
+    }
+    if (rc == 0) { // Size the id index for every record up front
+        hashIndexFree(&cs->index);
+        if (hashIndexInit(&cs->index, (size_t)count) != 0) rc = -1;
+    }
+    for (int i = 0; rc == 0 && i < count; ++i) {
+        if (items[i].id > 0 && hashIndexInsert(&cs->index, items[i].id, i) == 0) cs->live++;
+        else items[i].id = 0; // Invalid or repeated id: keep the slot out of the way
+    }
+done:
+    fclose(fp);
+    free(raw);
+    free(crcs);
+    if (rc != 0) { free(items); free(arena); compactFree(cs); return rc; }
+    cs->items = items;
+    cs->count = cs->capacity = count;
+    strArenaAdopt(&cs->names, arena, (uint32_t)arenaSize); // The arena keeps the block as loaded
+    return 0;
+}
+
+int compactSave(const CompactStore *cs, const char *filename) {
+    char tmp[WAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof tmp, "%s.tmp", filename);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return -1;
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+    uint32_t blocks = blockCount((uint64_t)cs->live);
+    unsigned char *buf = malloc((size_t)ITEMS_BLOCK_RECORDS * COMPACT_RECORD_SIZE);
+    unsigned char *crcs = malloc(((size_t)blocks + 1) * 4);
+    if (!buf || !crcs) { free(buf); free(crcs); fclose(fp); remove(tmp); return -3; }
+    unsigned char hdr[ITEMS_HEADER_SIZE];
+    encodeHeader(hdr, (uint64_t)cs->live, cs->names.size);
+    int rc = fwrite(hdr, 1, sizeof hdr, fp) == sizeof hdr ? 0 : -2;
+    int src = 0;
+    for (uint32_t b = 0; rc == 0 && b < blocks; ++b) {
+        int n = cs->live - (int)(b * ITEMS_BLOCK_RECORDS);
+        if (n > ITEMS_BLOCK_RECORDS) n = ITEMS_BLOCK_RECORDS;
+        for (int i = 0; i < n; ++i) {
+            while (cs->items[src].id == 0) src++; // Deleted slots are left out
+            encodeRecord(buf + (size_t)i * COMPACT_RECORD_SIZE, &cs->items[src++]);
+        }
+        size_t bytes = (size_t)n * COMPACT_RECORD_SIZE;
+        putU32(crcs + 4 * b, crc32c(0, buf, bytes));
+        if (fwrite(buf, 1, bytes, fp) != bytes) rc = -2;
+    }
+    putU32(crcs + 4 * blocks, crc32c(0, cs->names.data, cs->names.size));
+    if (rc == 0 && cs->names.size && fwrite(cs->names.data, 1, cs->names.size, fp) != cs->names.size) rc = -2;
+    if (rc == 0 && fwrite(crcs, 1, ((size_t)blocks + 1) * 4, fp) != ((size_t)blocks + 1) * 4) rc = -2;
+    free(buf);
+    free(crcs);
+    if (rc == 0 && syncFile(fp) != 0) rc = -2; // Durable before it replaces the old file
+    if (fclose(fp) != 0 && rc == 0) rc = -2;
+    if (rc != 0) { remove(tmp); return rc; }
+#ifdef _WIN32
+    remove(filename); // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tmp, filename) != 0) { remove(tmp); return -2; }
+    syncParentDir(filename);
+    return 0;
+}
+
+void printCompactItem(const CompactStore *cs, const CompactItem *ci) {
+    printItemFields(ci->id, compactName(cs, ci), ci->quantity, ci->price, (Category)ci->category); // Name printed straight from the arena
+}
+
+void compactMemory(const CompactStore *cs, size_t *compactBytes, size_t *itemBytes) {
+    *compactBytes = (size_t)cs->capacity * sizeof(CompactItem) + cs->names.cap + cs->index.capacity * sizeof(HashEntry) +
+                    cs->names.tableCap * sizeof(uint32_t);
+    *itemBytes = (size_t)cs->live * sizeof(Item) + cs->index.capacity * sizeof(HashEntry); // Same items and index as full records
+}
@@ -0,0 +1,87 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+#include <stdint.h>
+#include "item.h"
+#include "hashindex.h"
+#include "strarena.h"
+
+/*
+Compact items file (little-endian), sharing the 64-byte header of fileio.h:
+record size is COMPACT_RECORD_SIZE, flags (offset 40) has ITEMS_FLAG_COMPACT
+and offset 44 holds the name arena size (u64). After the header:
+  records, 20 bytes each:
+     0 id (i32)   4 name offset (u32)   8 quantity (i32)   12 price (f32)
+    16 name length (u16)   18 category (u8)   19 reserved
+  name arena: every distinct name once, NUL-terminated
+  CRC table: one CRC32C per block of ITEMS_BLOCK_RECORDS records, then one for the arena
+*/
+#define COMPACT_RECORD_SIZE 20
+#define ITEMS_FLAG_COMPACT 1u
+
+typedef struct { // Item with its name moved out into a shared arena
+    int32_t id; // 0 marks a deleted slot
+    uint32_t nameOff; // Offset of the name in the store's arena
+    int32_t quantity;
+    float price;
+    uint16_t nameLen;
+    uint8_t category;
+    uint8_t reserved;
+} CompactItem;
+
+typedef struct { // Compact items plus their arena and id index
+    CompactItem *items; // Slot array, one allocation
+    int count; // Slots in use, live items plus deleted ones
+    int capacity;
+    int live;
+    StrArena names; // Interned names, one allocation when loaded from a file
+    HashIndex index; // id -> slot
+} CompactStore;
+
+/* Prepares an empty store. Returns 0 on success, -1 on failure */
+int compactInit(CompactStore *cs);
+
+/* Releases everything */
+void compactFree(CompactStore *cs);
+
+/* Builds a store from 'count' slots of 'items' (id 0 skipped), interning the names. Returns 0 on success, -1 on failure */
+int compactFromItems(CompactStore *cs, const Item *items, int count);
+
+/* Copies the live items out as full Items into a malloc'd array. Returns 0 on success, -1 on failure */
+int compactToItems(const CompactStore *cs, Item **arrayPtr, int *countPtr);
+
+/*
+Loads a compact file: the records and the arena are read in one allocation
+each, with no per-name work. Returns loadItems-style codes: 0 loaded, 1 no
+file, -1 out of memory, -2 read error, -4/-5 not a compact items file,
+-6 torn, -7 checksum mismatch or a name outside the arena
+*/
+int compactLoad(CompactStore *cs, const char *filename);
+
+/* Writes the live items to 'filename' via a temp file and a rename. Returns 0 on success, non-zero on failure */
+int compactSave(const CompactStore *cs, const char *filename);
+
+/* Returns 1 if 'filename' starts with a compact items header, 0 otherwise */
+int compactFileDetect(const char *filename);
+
+/* Returns the slot of 'id', or -1 */
+int compactFind(const CompactStore *cs, int id);
+
+/* Adds 'item' (interning its name). Returns 0 on success, 1 if the id is invalid or taken, -1 on failure */
+int compactAdd(CompactStore *cs, const Item *item);
+
+/* Deletes 'id'. Returns 0 on success, 1 if it does not exist */
+int compactDelete(CompactStore *cs, int id);
+
+/* Name of a record, NUL-terminated inside the arena */
+static inline const char *compactName(const CompactStore *cs, const CompactItem *ci) { return strArenaGet(&cs->names, ci->nameOff); }
+
+/* Copies one record out as a full Item (name included) */
+void compactExpand(const CompactStore *cs, const CompactItem *ci, Item *out);
+
+/* Prints one record the way printItem prints an Item */
+void printCompactItem(const CompactStore *cs, const CompactItem *ci);
+
+/* Bytes the store uses for records, names and index, and what the same live items take as Items */
+void compactMemory(const CompactStore *cs, size_t *compactBytes, size_t *itemBytes);
+
+#endif // COMPACT_H
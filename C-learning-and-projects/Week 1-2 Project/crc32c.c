@@ -0,0 +1,99 @@
+#include <string.h>
+#include "crc32c.h"
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_X86 1 // SSE4.2 path, chosen at runtime
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM 1 // ARMv8 CRC extension, known at compile time
+#endif
+
+#define CRC32C_POLY 0x82F63B78u // Reflected Castagnoli polynomial
+
+static uint32_t crcTable[8][256]; // Slicing-by-8 lookup tables
+static int tableReady = 0;
+
+static void buildTable(void) { // Fills crcTable once
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c >> 1) ^ ((c & 1) ? CRC32C_POLY : 0); // Bitwise CRC of one byte
+        crcTable[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i) { // Each further table advances one more byte
+        for (int t = 1; t < 8; ++t) crcTable[t][i] = (crcTable[t - 1][i] >> 8) ^ crcTable[0][crcTable[t - 1][i] & 0xFF];
+    }
+    tableReady = 1;
+}
+
+static uint32_t crcSoftware(uint32_t crc, const unsigned char *p, size_t len) { // Portable slicing-by-8
+    if (!tableReady) buildTable();
+    while (len >= 8) { // Eight bytes per step
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo); // Tables assume little-endian words
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = crcTable[7][lo & 0xFF] ^ crcTable[6][(lo >> 8) & 0xFF] ^ crcTable[5][(lo >> 16) & 0xFF] ^ crcTable[4][lo >> 24] ^
+              crcTable[3][hi & 0xFF] ^ crcTable[2][(hi >> 8) & 0xFF] ^ crcTable[1][(hi >> 16) & 0xFF] ^ crcTable[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = (crc >> 8) ^ crcTable[0][(crc ^ *p++) & 0xFF]; // Leftover bytes
+    return crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crcHardware(uint32_t crc, const unsigned char *p, size_t len) { // crc32 instruction, 8 bytes at a time
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8); // Unaligned-safe load
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (len--) c32 = _mm_crc32_u8(c32, *p++); // Leftover bytes
+    return c32;
+}
+#elif defined(CRC32C_ARM)
+static uint32_t crcHardware(uint32_t crc, const unsigned char *p, size_t len) { // crc32c instructions, 8 bytes at a time
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+#endif
+
+static int useHardware = -1; // -1 until the CPU has been checked
+
+int crc32cHardware(void) {
+    if (useHardware < 0) {
+#if defined(CRC32C_X86)
+        __builtin_cpu_init();
+        useHardware = __builtin_cpu_supports("sse4.2") ? 1 : 0; // Runtime check, the binary still runs on older CPUs
+#elif defined(CRC32C_ARM)
+        useHardware = 1;
+#else
+        useHardware = 0;
+#endif
+    }
+    return useHardware;
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    crc = ~crc; // CRC-32C uses an inverted register on the way in and out
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+    if (crc32cHardware()) return ~crcHardware(crc, data, len);
+#endif
+    return ~crcSoftware(crc, data, len);
+}
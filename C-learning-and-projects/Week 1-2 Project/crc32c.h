@@ -0,0 +1,16 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Extends 'crc' (start with 0) by 'len' bytes of 'data' using CRC-32C (Castagnoli).
+Uses the SSE4.2 / ARMv8 CRC instructions when the CPU has them and a
+slicing-by-8 table otherwise; all paths produce the same value
+*/
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+/* Returns 1 if crc32c() is running on the hardware instruction, 0 for the table fallback */
+int crc32cHardware(void);
+
+#endif // CRC32C_H
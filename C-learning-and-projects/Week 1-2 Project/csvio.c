@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "csvio.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const char CSV_HEADER[] = "id,name,quantity,price,category\n";
+
+/*
+Returns the first ',', '"', '\n' at or after 'p', or 'end' if there is none.
+SSE2 compares 16 bytes against all three at once; other targets scan bytewise.
+*/
+static const char *scanSpecial(const char *p, const char *end) {
+#if defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(','), quote = _mm_set1_epi8('"'), newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p); // Unaligned 16-byte load
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, quote)),
+                                    _mm_cmpeq_epi8(chunk, newline));
+        int mask = _mm_movemask_epi8(hits); // One bit per matching byte
+        if (mask) return p + __builtin_ctz((unsigned)mask); // Lowest set bit is the first match
+        p += 16;
+    }
+#endif
+    while (p < end && *p != ',' && *p != '"' && *p != '\n') ++p; // Tail (or the whole scan without SSE2)
+    return p;
+}
+
+static const char *scanNewline(const char *p, const char *end) { // First '\n' at or after 'p', or 'end'
+    const char *nl = memchr(p, '\n', (size_t)(end - p)); // libc memchr is vectorised already
+    return nl ? nl : end;
+}
+
+static int parseInt(const char *p, const char *end, int *out) { // Whole field must be an integer
+    while (p < end && (*p == ' ' || *p == '\t')) ++p; // Allow surrounding blanks
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) --end;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    if (p == end) return -1; // No digits
+    long long v = 0;
+    for (; p < end; ++p) {
+        unsigned d = (unsigned)(*p - '0');
+        if (d > 9) return -1; // Not a digit
+        v = v * 10 + d;
+        if (v > 2147483648LL) return -1; // Out of int range
+    }
+    if (neg) v = -v;
+    if (v > 2147483647LL) return -1;
+    *out = (int)v;
+    return 0;
+}
+
+static int parseFloat(const char *p, const char *end, float *out) { // [sign] digits [. digits] [e [sign] digits]
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) --end;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    uint64_t mant = 0; // Significant digits as an integer
+    int digits = 0, scale = 0; // Digits consumed and decimal places
+    for (; p < end && (unsigned)(*p - '0') <= 9; ++p, ++digits) {
+        if (mant < 100000000000000000ULL) mant = mant * 10 + (uint64_t)(*p - '0'); else scale--; // Drop digits past 18
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && (unsigned)(*p - '0') <= 9; ++p, ++digits) {
+            if (mant < 100000000000000000ULL) { mant = mant * 10 + (uint64_t)(*p - '0'); scale++; }
+        }
+    }
+    if (digits == 0) return -1; // No number at all
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int eneg = 0, e = 0;
+        ++p;
+        if (p < end && (*p == '-' || *p == '+')) eneg = *p++ == '-';
+        if (p == end) return -1;
+        for (; p < end && (unsigned)(*p - '0') <= 9; ++p) if (e < 1000) e = e * 10 + (*p - '0');
+        scale += eneg ? e : -e;
+    }
+    if (p != end) return -1; // Trailing junk
+    double v = (double)mant;
+    while (scale > 18) { v /= 1e18; scale -= 18; }
+    while (scale < -18) { v *= 1e18; scale += 18; }
+    v = scale >= 0 ? v / pow10[scale] : v * pow10[-scale];
+    *out = (float)(neg ? -v : v);
+    return 0;
+}
+
+static int parseCategory(const char *p, const char *end, Category *out) { // Number 0-3 or a category name
+    int n;
+    if (parseInt(p, end, &n) == 0) {
+        *out = (n >= 0 && n <= 3) ? (Category)n : OTHER; // Same rule as the menu
+        return 0;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) --end;
+    for (int c = ELECTRONICS; c <= OTHER; ++c) {
+        const char *name = categorytostring((Category)c);
+        size_t len = strlen(name);
+        if ((size_t)(end - p) != len) continue;
+        size_t i = 0;
+        while (i < len && (p[i] | 0x20) == (name[i] | 0x20)) ++i; // ASCII case-insensitive compare
+        if (i == len) { *out = (Category)c; return 0; }
+    }
+    return -1;
+}
+
+/*
+Parses one row starting at 'p'. Returns 1 and sets *nextPtr past the row on
+success, 0 if the row runs past 'end' and more input is needed (only when
+!eof), -1 if the row is malformed (*nextPtr is then past its newline).
+*/
+static int parseRow(const char *p, const char *end, int eof, Item *item, const char **nextPtr) {
+    const char *fieldStart[5], *fieldEnd[5];
+    char name[sizeof item->name]; // Unquoted copy of the name field
+    size_t nameLen = 0;
+    int field = 0;
+    const char *q = p;
+    for (;;) {
+        if (field == 1 && q < end && *q == '"') { // Quoted name: copy it, undoubling quotes
+            ++q;
+            for (;;) {
+                const char *hit = scanSpecial(q, end);
+                while (hit < end && *hit != '"') hit = scanSpecial(hit + 1, end); // Commas and newlines are data here
+                if (hit == end && !eof) return 0; // Closing quote not in the buffer yet
+                if (hit == end) { *nextPtr = end; return -1; } // Never closed: the rest of the file was the name
+                for (const char *c = q; c < hit; ++c) if (nameLen < sizeof name - 1) name[nameLen++] = *c;
+                if (hit + 1 < end && hit[1] == '"') { // "" is a literal quote
+                    if (nameLen < sizeof name - 1) name[nameLen++] = '"';
+                    q = hit + 2;
+                    continue;
+                }
+                if (hit + 1 == end && !eof) return 0; // Cannot tell yet whether this quote is doubled
+                q = hit + 1; // Past the closing quote
+                break;
+            }
+            fieldStart[field] = fieldEnd[field] = q; // Name already captured
+            const char *stop = scanSpecial(q, end);
+            if (stop == end && !eof) return 0;
+            q = stop;
+        } else {
+            const char *stop = scanSpecial(q, end);
+            if (stop < end && *stop == '"') { // Stray quote in an unquoted field
+                *nextPtr = scanNewline(stop, end);
+                if (*nextPtr < end) ++*nextPtr;
+                return (*nextPtr == end && !eof) ? 0 : -1;
+            }
+            if (stop == end && !eof) return 0; // Row continues in the next chunk
+            fieldStart[field] = q;
+            fieldEnd[field] = stop;
+            if (field == 1) { // Plain name: copy up to the buffer size
+                for (const char *c = q; c < stop && *c != '\r'; ++c) if (nameLen < sizeof name - 1) name[nameLen++] = *c;
+            }
+            q = stop;
+        }
+        field++;
+        if (q == end || *q == '\n') break; // End of row
+        if (field == 5) { // Too many columns
+            q = scanNewline(q, end);
+            *nextPtr = q < end ? q + 1 : q;
+            return -1;
+        }
+        ++q; // Skip the comma
+    }
+    *nextPtr = q < end ? q + 1 : q; // Past the newline
+    if (field != 5) return -1; // Too few columns
+    if (parseInt(fieldStart[0], fieldEnd[0], &item->id) != 0) return -1;
+    if (parseInt(fieldStart[2], fieldEnd[2], &item->quantity) != 0) return -1;
+    if (parseFloat(fieldStart[3], fieldEnd[3], &item->price) != 0) return -1;
+    if (parseCategory(fieldStart[4], fieldEnd[4], &item->category) != 0) return -1;
+    memset(item->name, 0, sizeof item->name);
+    memcpy(item->name, name, nameLen);
+    return 1;
+}
+
+static int isHeaderLine(const char *p, const char *end) { // First line is a header if its first field is not a number
+    const char *stop = scanSpecial(p, end);
+    int id;
+    return parseInt(p, stop, &id) != 0;
+}
+
+static int flushBatch(Inventory *inv, Item *batch, int *n, CsvImportStats *stats) { // Hands parsed rows to the inventory
+    int added = 0;
+    int rc = inventoryAddBatch(inv, batch, *n, &added);
+    stats->added += added;
+    stats->skipped += *n - added;
+    *n = 0;
+    return rc;
+}
+
+int importCsv(Inventory *inv, const char *csvFile, CsvImportStats *stats) {
+    memset(stats, 0, sizeof *stats);
+    FILE *fp = fopen(csvFile, "rb"); // Open the CSV in binary mode, we handle \r\n ourselves
+    if (!fp) return 1;
+    char *buf = malloc(CSV_READ_BUFFER); // Read buffer
+    Item *batch = malloc(CSV_BATCH_ROWS * sizeof *batch); // Rows waiting for inventoryAddBatch
+    if (!buf || !batch) { free(buf); free(batch); fclose(fp); return -1; }
+
+    inventoryBeginBulk(inv); // No per-row logging, one snapshot at the end
+    int rc = 0, n = 0, first = 1, eof = 0;
+    size_t have = 0; // Bytes in buf not yet parsed
+    while (rc == 0) {
+        if (!eof) {
+            size_t got = fread(buf + have, 1, CSV_READ_BUFFER - have, fp); // Top the buffer up
+            have += got;
+            if (got == 0) eof = 1;
+        }
+        const char *p = buf, *end = buf + have;
+        if (first && have > 0) { // Skip a UTF-8 BOM and a header line
+            if (have >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;
+            const char *nl = scanNewline(p, end);
+            if (nl == end && !eof) continue; // Need the whole first line
+            if (isHeaderLine(p, nl)) p = nl < end ? nl + 1 : nl;
+            first = 0;
+        }
+        while (p < end) {
+            const char *next = p;
+            int r = parseRow(p, end, eof, &batch[n], &next);
+            if (r == 0) break; // Partial row, read more
+            if (next == p + 1 && *p == '\n') { p = next; continue; } // Blank line
+            if (r == 1 && itemInvalid(&batch[n])) { // Same rules as the menu, batch ADD and the server
+                stats->rows++;
+                stats->skipped++;
+            } else if (r == 1) {
+                stats->rows++;
+                if (++n == CSV_BATCH_ROWS && (rc = flushBatch(inv, batch, &n, stats)) != 0) break;
+            } else if (!(next - p == 2 && *p == '\r')) { // Ignore a lone \r\n line
+                stats->rows++;
+                stats->malformed++;
+            }
+            p = next;
+        }
+        have = (size_t)(end - p);
+        if (eof && (have == 0 || rc != 0)) break; // Everything parsed
+        if (have == CSV_READ_BUFFER) { rc = -2; break; } // A single row larger than the buffer
+        memmove(buf, p, have); // Keep the partial row for the next chunk
+    }
+    if (rc == 0 && n > 0) rc = flushBatch(inv, batch, &n, stats);
+    if (rc == 0 && inventoryEndBulk(inv) != 0) { // Persist everything with one checkpoint
+        rc = -3;
+        inventoryBeginBulk(inv); // The snapshot on disk is still the old one: back into bulk mode to drop the rows below
+    }
+    if (rc != 0) {
+        inventoryAbortBulk(inv, (int)stats->added); // All or nothing: the rows already added go again
+        stats->added = 0;
+    }
+    free(buf);
+    free(batch);
+    fclose(fp);
+    return rc;
+}
+
+typedef struct { // Output buffer for exportCsv
+    FILE *fp;
+    char *buf;
+    size_t used;
+    int failed;
+} CsvWriter;
+
+static void writerFlush(CsvWriter *w) {
+    if (w->used && fwrite(w->buf, 1, w->used, w->fp) != w->used) w->failed = 1;
+    w->used = 0;
+}
+
+static char *formatInt(char *out, long long v) { // Writes v in decimal, returns the end
+    char tmp[24];
+    int n = 0;
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    if (v < 0) *out++ = '-';
+    do { tmp[n++] = (char)('0' + u % 10); u /= 10; } while (u);
+    while (n) *out++ = tmp[--n]; // Digits were produced backwards
+    return out;
+}
+
+static char *formatPrice(char *out, float price) { // Same text as printf("%.2f") for normal prices
+    double v = price;
+    if (v != v) { memcpy(out, "nan", 3); return out + 3; } // Not a number
+    if (v < 0) { *out++ = '-'; v = -v; }
+    if (v >= 9e15) { return out + sprintf(out, "%.2f", v); } // Too large for the integer path
+    long long cents = (long long)(v * 100.0 + 0.5); // Round half up to two places
+    out = formatInt(out, cents / 100);
+    *out++ = '.';
+    *out++ = (char)('0' + (cents / 10) % 10);
+    *out++ = (char)('0' + cents % 10);
+    return out;
+}
+
+int exportCsv(const Inventory *inv, const char *csvFile, long *rowsPtr) {
+    FILE *fp = fopen(csvFile, "wb");
+    if (!fp) return 1;
+    CsvWriter w = { fp, malloc(CSV_WRITE_BUFFER), 0, 0 };
+    if (!w.buf) { fclose(fp); return -1; }
+    memcpy(w.buf, CSV_HEADER, sizeof CSV_HEADER - 1);
+    w.used = sizeof CSV_HEADER - 1;
+    long rows = 0;
+    for (int i = 0; i < inv->count; ++i) {
+        if (!inventorySlotLive(inv, i)) continue; // Skip deleted slots
+        const Item *it = &inv->items[i];
+        if (CSV_WRITE_BUFFER - w.used < 256) writerFlush(&w); // Worst-case row fits in 256 bytes
+        char *o = w.buf + w.used;
+        o = formatInt(o, it->id);
+        *o++ = ',';
+        size_t len = strnlen(it->name, sizeof it->name - 1);
+        if (memchr(it->name, ',', len) || memchr(it->name, '"', len) || memchr(it->name, '\n', len)) { // Needs quoting
+            *o++ = '"';
+            for (size_t k = 0; k < len; ++k) {
+                if (it->name[k] == '"') *o++ = '"'; // Double embedded quotes
+                *o++ = it->name[k];
+            }
+            *o++ = '"';
+        } else {
+            memcpy(o, it->name, len);
+            o += len;
+        }
+        *o++ = ',';
+        o = formatInt(o, it->quantity);
+        *o++ = ',';
+        o = formatPrice(o, it->price);
+        *o++ = ',';
+        const char *cat = categorytostring(it->category);
+        size_t catLen = strlen(cat);
+        memcpy(o, cat, catLen);
+        o += catLen;
+        *o++ = '\n';
+        w.used = (size_t)(o - w.buf);
+        rows++;
+    }
+    writerFlush(&w);
+    free(w.buf);
+    if (fclose(fp) != 0) w.failed = 1;
+    if (rowsPtr) *rowsPtr = rows;
+    return w.failed ? -2 : 0;
+}
@@ -0,0 +1,36 @@
+#ifndef CSVIO_H
+#define CSVIO_H
+#include "inventory.h"
+
+#define CSV_READ_BUFFER (4 << 20) // Bytes of CSV read per chunk
+#define CSV_WRITE_BUFFER (1 << 20) // Bytes of CSV formatted before each fwrite
+#define CSV_BATCH_ROWS 65536 // Parsed rows handed to inventoryAddBatch at once
+
+typedef struct { // Counters filled in by importCsv
+    long rows; // Data rows seen (header excluded)
+    long added; // Rows that became items
+    long skipped; // Well-formed rows rejected: invalid item (see itemInvalid) or duplicate id
+    long malformed; // Rows that could not be parsed
+} CsvImportStats;
+
+/*
+Streams 'csvFile' into 'inv'. Columns: id,name,quantity,price,category where
+category is 0-3 or a name such as "Food". A header line is detected and
+skipped; names may be quoted ("a, b" with "" for a quote). Rows go in as
+batches of CSV_BATCH_ROWS, so only one read buffer and one batch are held
+besides the inventory itself. The import is not logged row by row: it ends
+with a single checkpoint, so a crash part-way leaves the old inventory;
+on failure the rows already added are taken out again and nothing is
+written.
+Returns 0 on success, 1 if the file cannot be opened, negative on failure
+*/
+int importCsv(Inventory *inv, const char *csvFile, CsvImportStats *stats);
+
+/*
+Writes every live item of 'inv' to 'csvFile' (with a header line), formatted
+into a large buffer without printf. *rowsPtr (may be NULL) gets the row count.
+Returns 0 on success, 1 if the file cannot be created, negative on failure
+*/
+int exportCsv(const Inventory *inv, const char *csvFile, long *rowsPtr);
+
+#endif // CSVIO_H
@@ -1,41 +1,1063 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "fileio.h"
+#include "hashindex.h"
+#include "crc32c.h"
+#include "shardio.h"
+#include "uring.h"
+#include "metrics.h"
+#include "byteorder.h"
 
+static const char WAL_MAGIC[4] = {'I', 'W', 'A', 'L'}; // First bytes of every log file
+#define WAL_VERSION 3u // Bumped whenever the record layout changes (2: little-endian fields, CRC32C; 3: transaction records)
+#define WAL_OLDEST_VERSION 2u // Oldest layout we still replay (3 only added record types)
+#define WAL_HEADER_SIZE 8 // Magic plus version
+#define WAL_IO_BUFFER (1 << 20) // 1 MB stdio buffer so replay reads the log in large chunks
 
-int loadItems(const char *filename, Item **arrayPtr, int *countptr){ // Loads items from a file into a dynamically allocated array
+#define WAL_RECORD_HEADER 12 // op, payload length, CRC32C over both plus the payload (all little-endian u32)
+#define WAL_MAX_PAYLOAD ITEMS_RECORD_SIZE // Largest payload we ever write (an encoded item)
+#define ITEMS_IO_BUFFER (1 << 20) // 1 MB stdio buffer for snapshot reads and writes
+#define ITEMS_RING_CHUNK (1 << 20) // io_uring saves: bytes per write, at 1 MB-aligned file offsets
+#define ITEMS_RING_BLOCKS 16 // io_uring loads: CRC blocks per read (about 1.1 MB)
+#define ITEMS_RING_SKIPPED 2 // Internal: the io_uring path declined, use stdio
+
+static ItemsIoBackend ioBackend = ITEMS_IO_AUTO;
+
+void encodeItemRecord(unsigned char *out, const Item *item) {
+    memset(out, 0, ITEMS_RECORD_SIZE); // Unused name bytes and the pad byte are always zero
+    putU32(out + ITEMS_REC_ID, (uint32_t)item->id);
+    for (size_t i = 0; i < sizeof item->name - 1 && item->name[i]; ++i) out[ITEMS_REC_NAME + i] = (unsigned char)item->name[i]; // Name up to its NUL
+    putU32(out + ITEMS_REC_QUANTITY, (uint32_t)item->quantity);
+    uint32_t bits;
+    memcpy(&bits, &item->price, sizeof bits); // IEEE-754 single precision bits
+    putU32(out + ITEMS_REC_PRICE, bits);
+    putU32(out + ITEMS_REC_CATEGORY, (uint32_t)item->category);
+}
+
+void decodeItemRecord(Item *item, const unsigned char *in) {
+    item->id = (int32_t)getU32(in + ITEMS_REC_ID);
+    memcpy(item->name, in + ITEMS_REC_NAME, sizeof item->name);
+    item->name[sizeof item->name - 1] = '\0'; // Never trust the file to terminate the name
+    item->quantity = (int32_t)getU32(in + ITEMS_REC_QUANTITY);
+    uint32_t bits = getU32(in + ITEMS_REC_PRICE);
+    memcpy(&item->price, &bits, sizeof bits);
+    item->category = (Category)getU32(in + ITEMS_REC_CATEGORY);
+}
+
+int itemsLayoutIsNative(void) {
+    const uint16_t probe = 1; // First byte is 1 on little-endian hosts
+    return sizeof(Item) == ITEMS_RECORD_SIZE && offsetof(Item, id) == ITEMS_REC_ID &&
+           offsetof(Item, name) == ITEMS_REC_NAME && offsetof(Item, quantity) == ITEMS_REC_QUANTITY &&
+           offsetof(Item, price) == ITEMS_REC_PRICE && offsetof(Item, category) == ITEMS_REC_CATEGORY &&
+           sizeof(Category) == 4 && sizeof(float) == 4 && *(const unsigned char *)&probe == 1;
+}
+
+static uint32_t blockCount(uint64_t count) { // Number of CRC blocks covering 'count' records
+    return (uint32_t)((count + ITEMS_BLOCK_RECORDS - 1) / ITEMS_BLOCK_RECORDS);
+}
+
+static long long itemsFileBytes(uint64_t count) { // Size of an items file holding 'count' records
+    return ITEMS_HEADER_SIZE + (long long)count * ITEMS_RECORD_SIZE + (long long)blockCount(count) * 4;
+}
+
+static void encodeHeader(unsigned char *out, uint64_t count) { // Builds the 64-byte file header
+    memset(out, 0, ITEMS_HEADER_SIZE);
+    memcpy(out, ITEMS_MAGIC, 8);
+    putU32(out + 8, ITEMS_FORMAT_VERSION);
+    putU32(out + 12, ITEMS_HEADER_SIZE);
+    putU32(out + 16, ITEMS_RECORD_SIZE);
+    putU32(out + 20, ITEMS_BLOCK_RECORDS);
+    putU64(out + 24, count);
+    putU64(out + 32, ITEMS_HEADER_SIZE + count * ITEMS_RECORD_SIZE); // Where the CRC table starts
+    putU32(out + 60, crc32c(0, out, 60)); // Header checksum covers everything before it
+}
+
+/*
+Checks a header against the size of the file it came from. This is all the
+work needed to reject a torn or truncated file: the record count fixes the
+exact file length, so nothing past the header has to be read.
+*/
+static int parseHeader(const unsigned char *hdr, long long fileBytes, uint64_t *countPtr) {
+    if (fileBytes < ITEMS_HEADER_SIZE) return -6; // Too short to even hold a header
+    if (memcmp(hdr, ITEMS_MAGIC, 8) != 0) return -4; // Not our format (legacy raw dump?)
+    if (crc32c(0, hdr, 60) != getU32(hdr + 60)) return -7; // Header itself is damaged
+    if (getU32(hdr + 8) != ITEMS_FORMAT_VERSION || getU32(hdr + 12) != ITEMS_HEADER_SIZE ||
+        getU32(hdr + 16) != ITEMS_RECORD_SIZE || getU32(hdr + 20) != ITEMS_BLOCK_RECORDS) return -5; // Written by a different version
+    uint64_t count = getU64(hdr + 24);
+    if (count > (uint64_t)0x7FFFFFFF) return -5; // More items than an int can count
+    uint64_t crcOffset = getU64(hdr + 32);
+    if (crcOffset != ITEMS_HEADER_SIZE + count * ITEMS_RECORD_SIZE) return -5;
+    if ((uint64_t)fileBytes != crcOffset + (uint64_t)blockCount(count) * 4) return -6; // Torn or padded file
+    *countPtr = count;
+    return 0;
+}
+
+const char *itemsErrorString(int code) {
+    switch (code) {
+        case 0: return "ok";
+        case 1: return "no file";
+        case -1: return "out of memory";
+        case -2: return "read error";
+        case -3: return "out of memory while replaying the log";
+        case -4: return "not an items file (legacy raw format? convert it with --convert)";
+        case -5: return "unsupported file version or layout";
+        case -6: return "file is truncated or torn";
+        case -7: return "checksum mismatch, file is corrupt";
+        case -8: return "file is a shard manifest, open it as a sharded inventory";
+        default: return "unknown error";
+    }
+}
+
+void itemsSetIoBackend(ItemsIoBackend backend) {
+    ioBackend = backend;
+}
+
+ItemsIoBackend itemsIoBackend(void) {
+    return ioBackend;
+}
+
+static int ringWanted(long long bytes) { // Should a snapshot of this size go through io_uring?
+    if (ioBackend == ITEMS_IO_STDIO) return 0;
+    if (ioBackend == ITEMS_IO_AUTO && bytes < ITEMS_URING_MIN_BYTES) return 0; // Ring setup costs more than it saves
+    return ioRingAvailable();
+}
+
+static int checkBlocks(Item *arr, int count, uint32_t first, uint32_t n, const unsigned char *src, const uint32_t *crcs, int native) {
+    for (uint32_t b = first; b < first + n; ++b) { // Checks (and decodes) blocks first..first+n-1 of a snapshot
+        int r0 = (int)(b * ITEMS_BLOCK_RECORDS);
+        int k = count - r0 < ITEMS_BLOCK_RECORDS ? count - r0 : ITEMS_BLOCK_RECORDS;
+        const unsigned char *p = src + (size_t)(b - first) * ITEMS_BLOCK_RECORDS * ITEMS_RECORD_SIZE;
+        if (crc32c(0, p, (size_t)k * ITEMS_RECORD_SIZE) != crcs[b]) return -7; // Damaged block
+        if (!native) {
+            for (int i = 0; i < k; ++i) decodeItemRecord(&arr[r0 + i], p + (size_t)i * ITEMS_RECORD_SIZE);
+        }
+    }
+    return 0;
+}
+
+#ifdef __linux__
+typedef struct RingLoad RingLoad;
+
+typedef struct { // One read of a ring load
+    IoRequest req; // First, so the completion leads back here
+    RingLoad *load;
+    unsigned char *dst; // Straight into the array (native layout) or a staging buffer
+    uint32_t len, done; // Bytes wanted, bytes read so far
+    uint64_t offset; // File offset of dst[0]
+    uint32_t firstBlock, blocks;
+    int busy;
+} LoadChunk;
+
+struct RingLoad {
+    IoRing ring;
+    int fd;
+    Item *arr;
+    int count;
+    const uint32_t *crcs;
+    int native;
+    int rc;
+    LoadChunk chunks[IO_RING_DEPTH / 2]; // Half the ring: room to requeue short reads
+};
+
+static void loadChunkDone(IoRequest *req, int res) { // A read finished: check its blocks while the others are still reading
+    LoadChunk *c = (LoadChunk *)req;
+    RingLoad *l = c->load;
+    if (res <= 0) { // Error, or the file shrank under us
+        if (l->rc == 0) l->rc = res < 0 ? -2 : -6;
+        c->busy = 0;
+        return;
+    }
+    c->done += (uint32_t)res;
+    if (c->done < c->len) { // Short read: ask for the rest
+        if (ioRingRead(&l->ring, &c->req, l->fd, c->dst + c->done, c->len - c->done, c->offset + c->done, 0) != 0 && l->rc == 0) l->rc = -2;
+        return;
+    }
+    int rc = checkBlocks(l->arr, l->count, c->firstBlock, c->blocks, c->dst, l->crcs, l->native);
+    if (rc != 0 && l->rc == 0) l->rc = rc;
+    c->busy = 0;
+}
+
+/*
+Snapshot load on io_uring: up to half a ring of large reads in flight, each
+block's CRC checked (and decoded) in the completion callback, so checking
+overlaps with the reads still outstanding. Native-layout records are read
+straight into the items array
+*/
+static int loadSnapshotRing(const char *filename, Item **arrayPtr, int *countptr) {
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return ITEMS_RING_SKIPPED; // Missing file: the stdio path says so
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || !ringWanted((long long)st.st_size)) { // Empty file: the stdio path loads it as no items
+        close(fd);
+        return ITEMS_RING_SKIPPED;
+    }
+    RingLoad *l = calloc(1, sizeof *l);
+    if (!l) { close(fd); return -1; }
+    if (ioRingInit(&l->ring, IO_RING_DEPTH) != 0) { free(l); close(fd); return ITEMS_RING_SKIPPED; }
+    unsigned char hdr[ITEMS_HEADER_SIZE];
+    uint64_t total = 0;
+    int rc = pread(fd, hdr, sizeof hdr, 0) == (ssize_t)sizeof hdr ? parseHeader(hdr, (long long)st.st_size, &total) : -6;
+    int count = (int)total;
+    uint32_t blocks = blockCount(total);
+    uint32_t *crcs = NULL;
+    unsigned char *raw = NULL, *staging = NULL;
+    int native = itemsLayoutIsNative();
+    size_t chunkBytes = (size_t)ITEMS_RING_BLOCKS * ITEMS_BLOCK_RECORDS * ITEMS_RECORD_SIZE;
+    if (rc == 0) {
+        crcs = malloc(blocks ? blocks * sizeof *crcs : 1);
+        raw = malloc(blocks ? (size_t)blocks * 4 : 1);
+        l->arr = malloc(count ? (size_t)count * sizeof(Item) : 1);
+        if (!native) staging = malloc(chunkBytes * (IO_RING_DEPTH / 2));
+        if (!crcs || !raw || !l->arr || (!native && !staging)) rc = -1;
+    }
+    if (rc == 0 && blocks && pread(fd, raw, (size_t)blocks * 4, (off_t)(ITEMS_HEADER_SIZE + total * ITEMS_RECORD_SIZE)) != (ssize_t)blocks * 4) rc = -2;
+    for (uint32_t b = 0; rc == 0 && b < blocks; ++b) crcs[b] = getU32(raw + 4 * b); // CRC table sits after the records
+    l->fd = fd;
+    l->count = count;
+    l->crcs = crcs;
+    l->native = native;
+    uint32_t nextBlock = 0;
+    int busy = 0;
+    while (rc == 0 && l->rc == 0 && (nextBlock < blocks || busy)) {
+        busy = 0;
+        for (int k = 0; k < IO_RING_DEPTH / 2; ++k) {
+            LoadChunk *c = &l->chunks[k];
+            if (!c->busy && nextBlock < blocks) { // Start the next read in this slot
+                uint32_t n = blocks - nextBlock < ITEMS_RING_BLOCKS ? blocks - nextBlock : ITEMS_RING_BLOCKS;
+                uint64_t firstRecord = (uint64_t)nextBlock * ITEMS_BLOCK_RECORDS;
+                uint64_t records = (uint64_t)n * ITEMS_BLOCK_RECORDS;
+                if (firstRecord + records > total) records = total - firstRecord;
+                c->req.done = loadChunkDone;
+                c->load = l;
+                c->dst = native ? (unsigned char *)&l->arr[firstRecord] : staging + (size_t)k * chunkBytes;
+                c->len = (uint32_t)(records * ITEMS_RECORD_SIZE);
+                c->done = 0;
+                c->offset = ITEMS_HEADER_SIZE + firstRecord * ITEMS_RECORD_SIZE;
+                c->firstBlock = nextBlock;
+                c->blocks = n;
+                if (ioRingRead(&l->ring, &c->req, fd, c->dst, c->len, c->offset, 0) != 0) { rc = -2; break; }
+                c->busy = 1;
+                nextBlock += n;
+            }
+            busy |= c->busy;
+        }
+        if (rc == 0 && busy && ioRingSubmit(&l->ring, 1) < 0) rc = -2; // Wait for at least one, run every callback due
+    }
+    ioRingFree(&l->ring); // Waits out reads still in flight after a failure
+    if (rc == 0) rc = l->rc;
+    close(fd);
+    free(raw);
+    free(crcs);
+    free(staging);
+    if (rc != 0) {
+        free(l->arr);
+        free(l);
+        *arrayPtr = NULL;
+        return rc;
+    }
+    *arrayPtr = l->arr;
+    *countptr = count;
+    free(l);
+    metricsAddRead((uint64_t)st.st_size);
+    return 0;
+}
+#endif
+
+static int loadSnapshot(const char *filename, Item **arrayPtr, int *countptr){ // Loads items from a file into a dynamically allocated array
+#ifdef __linux__
+    int ringRc = loadSnapshotRing(filename, arrayPtr, countptr); // Large files go through io_uring when it is there
+    if (ringRc != ITEMS_RING_SKIPPED) return ringRc;
+#endif
     FILE *fp = fopen(filename, "rb"); // Open the file in binary read mode
     if (!fp) {
         *arrayPtr = NULL;
         return 1; // no file yet is ok
     }
+    setvbuf(fp, NULL, _IOFBF, ITEMS_IO_BUFFER); // Read in large chunks
     fseek(fp, 0, SEEK_END); // Move the file pointer to the end of the file
     long size = ftell(fp); // Get the size of the file
     rewind(fp); // Move the file pointer back to the beginning of the file
-    int count = size / sizeof(Item); // Calculate the number of items in the file
-    Item *arr = malloc(count * sizeof(Item)); // Allocate memory for the items
-    if (!arr) { fclose(fp); return -1;}// Check if memory allocation was successful
-    if (fread(arr, sizeof(Item), count, fp) != (size_t)count) { // Read the items from the file
-        free(arr); // Free the allocated memory if reading failed
-        fclose(fp); // Close the file
-        return -2; // Return an error code
+    if (size == 0) { fclose(fp); *arrayPtr = NULL; *countptr = 0; return 0; } // Empty file, empty inventory
+
+    unsigned char hdr[ITEMS_HEADER_SIZE];
+    uint64_t total = 0;
+    if (fread(hdr, 1, sizeof hdr, fp) != sizeof hdr) { fclose(fp); return -6; } // Read the header
+    int rc = parseHeader(hdr, size, &total); // Rejects torn files before reading any records
+    if (rc != 0) { fclose(fp); return rc; }
+    int count = (int)total;
+    uint32_t blocks = blockCount(total);
+
+    uint32_t *crcs = malloc(blocks ? blocks * sizeof *crcs : 1); // Expected CRC per block
+    Item *arr = malloc(count ? (size_t)count * sizeof(Item) : 1); // Allocate memory for the items
+    unsigned char *buf = malloc((size_t)ITEMS_BLOCK_RECORDS * ITEMS_RECORD_SIZE); // One block of raw records
+    if (!crcs || !arr || !buf) { free(crcs); free(arr); free(buf); fclose(fp); return -1;}// Check if memory allocation was successful
+
+    unsigned char raw[4];
+    fseek(fp, (long)(ITEMS_HEADER_SIZE + total * ITEMS_RECORD_SIZE), SEEK_SET); // CRC table sits after the records
+    for (uint32_t b = 0; b < blocks; ++b) {
+        if (fread(raw, 1, 4, fp) != 4) { rc = -2; break; }
+        crcs[b] = getU32(raw);
     }
+    fseek(fp, ITEMS_HEADER_SIZE, SEEK_SET); // Back to the first record
+
+    int native = itemsLayoutIsNative(); // Can records be read straight into the array?
+    for (uint32_t b = 0; rc == 0 && b < blocks; ++b) { // Read, check and decode one block at a time
+        int first = (int)(b * ITEMS_BLOCK_RECORDS);
+        int n = count - first < ITEMS_BLOCK_RECORDS ? count - first : ITEMS_BLOCK_RECORDS;
+        size_t bytes = (size_t)n * ITEMS_RECORD_SIZE;
+        unsigned char *dst = native ? (unsigned char *)&arr[first] : buf; // Native layout: no decode step
+        if (fread(dst, 1, bytes, fp) != bytes) { rc = -2; break; } // Read the items from the file
+        rc = checkBlocks(arr, count, b, 1, dst, crcs, native);
+    }
+    free(buf);
+    free(crcs);
     fclose(fp); // Close the file
+    if (rc != 0) { free(arr); *arrayPtr = NULL; return rc; } // Free the allocated memory if reading failed
     *arrayPtr = arr; // Set the output pointer to the allocated array
     *countptr = count; // Set the output count to the number of items read
+    metricsAddRead((uint64_t)size);
     return 0; // Return success
 }
 
-int saveItems(const char *filename, const Item *array, int count) { // Saves items to a file from a dynamically allocated array
+static uint32_t walChecksum(const unsigned char *hdr, const unsigned char *payload, uint32_t len) { // CRC32C over op, len and payload
+    return crc32c(crc32c(0, hdr, 8), payload, len);
+}
+
+int syncFileData(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0 ? 0 : -1;
+#elif defined(__APPLE__)
+    return fsync(fd) == 0 ? 0 : -1; // No fdatasync
+#else
+    return fdatasync(fd) == 0 ? 0 : -1; // Data plus the size, not timestamps
+#endif
+}
+
+int syncFile(FILE *fp) {
+    if (fflush(fp) != 0) return -1;
+    return syncFileData(fileno(fp));
+}
+
+int syncParentDir(const char *path) {
+#ifdef _WIN32
+    (void)path; // NTFS makes the rename itself durable
+    return 0;
+#else
+    char dir[WAL_PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    if (!slash) snprintf(dir, sizeof dir, ".");
+    else snprintf(dir, sizeof dir, "%.*s", slash == path ? 1 : (int)(slash - path), path);
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return -1;
+    int rc = fsync(fd); // Persists the directory entry a rename or create changed
+    close(fd);
+    return rc == 0 ? 0 : -1;
+#endif
+}
+
+static void walLogPath(char *out, const char *filename) { // Builds "<filename>.wal"
+    snprintf(out, WAL_PATH_MAX, "%s%s", filename, WAL_SUFFIX);
+}
+
+static int truncateFile(const char *path, long length) { // Cuts a file down to 'length' bytes
+    FILE *fp = fopen(path, "r+b");
+    if (!fp) return -1;
+#ifdef _WIN32
+    int rc = _chsize(_fileno(fp), length);
+#else
+    int rc = ftruncate(fileno(fp), (off_t)length);
+#endif
+    fclose(fp);
+    return rc;
+}
+
+static int growArray(Item **arr, int *cap, int needed) { // Doubles the replay array until 'needed' items fit
+    if (needed <= *cap) return 0;
+    int newCap = *cap ? *cap : 16;
+    while (newCap < needed) newCap *= 2; // Geometric growth keeps replay linear
+    Item *tmp = realloc(*arr, (size_t)newCap * sizeof *tmp);
+    if (!tmp) return -1; // Handle memory allocation failure
+    *arr = tmp;
+    *cap = newCap;
+    return 0;
+}
+
+typedef struct { // Array being rebuilt by applyLog
+    Item *arr;
+    int count, cap;
+    int removed; // Slots marked deleted
+    HashIndex *index; // id -> slot
+} ReplayState;
+
+static int recordValid(uint32_t op, uint32_t len) { // Known data record with the right payload size
+    return (op == WAL_OP_ADD && len == ITEMS_RECORD_SIZE) || (op == WAL_OP_QTY && len == 8) || (op == WAL_OP_DEL && len == 4);
+}
+
+static int applyRecord(WalApplyFn apply, void *ctx, uint32_t op, const unsigned char *payload) { // Decodes one validated data record
+    Item it;
+    memset(&it, 0, sizeof it);
+    if (op == WAL_OP_ADD) {
+        decodeItemRecord(&it, payload);
+    } else {
+        it.id = (int32_t)getU32(payload);
+        if (op == WAL_OP_QTY) it.quantity = (int32_t)getU32(payload + 4);
+    }
+    return apply(ctx, (WalOp)op, &it);
+}
+
+static int applyToArray(void *ctx, WalOp op, const Item *it) { // Replay target of loadItems: the snapshot's array
+    ReplayState *st = ctx;
+    int slot = hashIndexFind(st->index, it->id);
+    if (op == WAL_OP_ADD) {
+        if (slot >= 0) {
+            st->arr[slot] = *it; // Already present: overwrite (upsert)
+        } else {
+            if (growArray(&st->arr, &st->cap, st->count + 1) != 0) return -1;
+            if (hashIndexInsert(st->index, it->id, st->count) < 0) return -1;
+            st->arr[st->count++] = *it; // Append the new item
+        }
+    } else if (op == WAL_OP_QTY) {
+        if (slot >= 0) st->arr[slot].quantity = it->quantity; // Unknown ids are ignored
+    } else if (op == WAL_OP_DEL) {
+        if (slot >= 0) {
+            st->arr[slot].id = 0; // Mark the slot, squeezed out by applyLog
+            hashIndexRemove(st->index, it->id);
+            st->removed++;
+        }
+    }
+    return 0;
+}
+
+/*
+Replays the log at 'path' through 'apply'. Records are upserts, so
+replaying a log over a snapshot that already contains it is harmless.
+Records between BEGIN and COMMIT are staged and applied together; an
+aborted or unfinished transaction is skipped.
+*validPtr receives the byte length of the intact prefix of the log.
+*/
+static int replayLog(const char *path, WalApplyFn apply, void *ctx, long *validPtr) {
+    *validPtr = 0;
+    FILE *fp = fopen(path, "rb"); // Open the log in binary read mode
+    if (!fp) return 1; // No log yet is ok
+    setvbuf(fp, NULL, _IOFBF, WAL_IO_BUFFER); // Large buffer, the log is read front to back
+    unsigned char start[WAL_HEADER_SIZE];
+    if (fread(start, 1, sizeof start, fp) != sizeof start || memcmp(start, WAL_MAGIC, 4) != 0) {
+        fclose(fp);
+        return 1; // Empty or foreign file, treat as no log (it gets rewritten on open)
+    }
+    uint32_t version = getU32(start + 4);
+    if (version < WAL_OLDEST_VERSION || version > WAL_VERSION) { fclose(fp); return -5; } // Our log, but a layout we cannot read
+    long valid = WAL_HEADER_SIZE; // Bytes of the log known to be good
+
+    int rc = 0;
+    unsigned char h[WAL_RECORD_HEADER];
+    unsigned char payload[WAL_MAX_PAYLOAD];
+    unsigned char *txn = NULL; // Records of the open transaction, applied at its COMMIT
+    size_t txnLen = 0, txnCap = 0;
+    long txnStart = -1; // Offset of the open transaction's BEGIN, -1 outside one
+    while (fread(h, 1, sizeof h, fp) == sizeof h) { // One record per iteration
+        uint32_t op = getU32(h), len = getU32(h + 4);
+        if (len > sizeof payload || fread(payload, 1, len, fp) != len) break; // Torn tail
+        if (walChecksum(h, payload, len) != getU32(h + 8)) break; // Torn or corrupt record, stop here
+        if (op == WAL_OP_BEGIN) {
+            if (len != 0) break; // Malformed, treat like corruption
+            txnStart = valid; // Inside one already: that one lost its ABORT, drop what it staged and start over
+            txnLen = 0;
+        } else if (op == WAL_OP_COMMIT || op == WAL_OP_ABORT) {
+            if (txnStart < 0 || len != 0) break;
+            for (size_t pos = 0; op == WAL_OP_COMMIT && pos < txnLen && rc == 0; ) { // Apply the whole transaction at once
+                uint32_t sop = getU32(txn + pos), slen = getU32(txn + pos + 4);
+                rc = applyRecord(apply, ctx, sop, txn + pos + 8);
+                pos += 8 + slen;
+            }
+            txnStart = -1;
+            if (rc != 0) break;
+        } else if (!recordValid(op, len)) {
+            break; // Unknown record type, treat like corruption
+        } else if (txnStart >= 0) { // Inside a transaction: stage it
+            if (txnLen + 8 + len > txnCap) {
+                size_t newCap = txnCap ? txnCap * 2 : 4096;
+                while (newCap < txnLen + 8 + len) newCap *= 2;
+                unsigned char *tmp = realloc(txn, newCap);
+                if (!tmp) { rc = -1; break; }
+                txn = tmp;
+                txnCap = newCap;
+            }
+            putU32(txn + txnLen, op);
+            putU32(txn + txnLen + 4, len);
+            memcpy(txn + txnLen + 8, payload, len);
+            txnLen += 8 + len;
+        } else if ((rc = applyRecord(apply, ctx, op, payload)) != 0) {
+            break;
+        }
+        valid += (long)(sizeof h + len); // Record applied (or staged)
+    }
+    free(txn);
+    if (txnStart >= 0) valid = txnStart; // Unfinished transaction: never happened, and cut it off
+    fclose(fp);
+    *validPtr = valid;
+    metricsAddRead((uint64_t)valid);
+    return rc;
+}
+
+static long fileSize(const char *path) { // Size of 'path' in bytes, or -1 if it cannot be opened
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+int walReplay(const char *filename, WalApplyFn apply, void *ctx) {
+    char logPath[WAL_PATH_MAX];
+    walLogPath(logPath, filename);
+    long valid = 0;
+    int replay = replayLog(logPath, apply, ctx, &valid); // Apply logged mutations
+    if (replay == 0 && fileSize(logPath) > valid) truncateFile(logPath, valid); // Drop a partial record so new appends are reachable
+    return replay;
+}
+
+/*
+Replays <filename>.wal over 'count' items in *arrayPtr. Every record costs
+one hash lookup; deletes only mark the slot (id 0) and the array is
+squeezed once at the end, so replay is linear in log size.
+Returns replayLog's code
+*/
+static int applyLog(const char *filename, Item **arrayPtr, int *countptr) {
+    HashIndex index = {0};
+    if (hashIndexBuild(&index, *arrayPtr, *countptr, NULL) != 0) return -1; // Map ids to slots
+    ReplayState state = { *arrayPtr, *countptr, *countptr, 0, &index };
+    int replay = walReplay(filename, applyToArray, &state);
+    hashIndexFree(&index);
+    Item *arr = state.arr;
+    int count = state.count;
+    if (state.removed > 0) { // Squeeze out deleted slots in one pass, keeping order
+        int w = 0;
+        for (int r = 0; r < count; ++r) {
+            if (arr[r].id != 0) arr[w++] = arr[r];
+        }
+        count = w;
+    }
+    *arrayPtr = arr;
+    *countptr = count;
+    return replay;
+}
+
+static int loadItemsFile(const char *filename, Item **arrayPtr, int *countptr){ // loadItems without the metrics
+    if (shardFileDetect(filename)) return loadShardedItems(filename, arrayPtr, countptr, 0); // Every shard at once, one per CPU
+    int count = 0;
+    int result = loadSnapshot(filename, arrayPtr, &count); // Read the last snapshot
+    if (result < 0) return result; // Snapshot exists but is unreadable
+    if (result == 1) *arrayPtr = NULL; // No snapshot, start from an empty array
+
+    int replay = applyLog(filename, arrayPtr, &count);
+    if (replay < 0) {
+        free(*arrayPtr);
+        *arrayPtr = NULL;
+        return replay == -1 ? -3 : replay; // Ran out of memory while replaying, or an unreadable log
+    }
+    *countptr = count;
+    if (result == 1 && replay == 1) return 1; // Neither snapshot nor log, no file yet
+    return 0;
+}
+
+int loadItems(const char *filename, Item **arrayPtr, int *countptr){ // Loads the snapshot, then replays the log over it
+    uint64_t start = metricsBegin(MET_LOAD);
+    int rc = loadItemsFile(filename, arrayPtr, countptr);
+    metricsFinish(MET_LOAD, start);
+    return rc;
+}
+
+static int mapItems(const char *filename, Item **arrayPtr, int *countptr, ItemMapping *map) { // loadItemsMapped without the metrics
+    map->base = NULL;
+    map->length = 0;
+    if (shardFileDetect(filename)) return loadItems(filename, arrayPtr, countptr); // Shards are concatenated on the heap
+#ifdef _WIN32
+    return loadItems(filename, arrayPtr, countptr); // No mmap here, fall back to a normal load
+#else
+    char logPath[WAL_PATH_MAX];
+    walLogPath(logPath, filename);
+    if (fileSize(logPath) > WAL_HEADER_SIZE) { // Pending log records may add or delete items
+        return loadItems(filename, arrayPtr, countptr); // so the array has to be a growable heap copy
+    }
+
+    int fd = open(filename, O_RDONLY); // Open the snapshot for mapping
+    if (fd < 0) {
+        *arrayPtr = NULL;
+        *countptr = 0;
+        return 1; // no file yet is ok
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); *arrayPtr = NULL; return -2; }
+    if (st.st_size == 0 || !itemsLayoutIsNative()) { // Nothing to map, or records need decoding
+        close(fd);
+        return loadItems(filename, arrayPtr, countptr);
+    }
+    size_t length = (size_t)st.st_size; // Map header, records and CRC table
+    // MAP_PRIVATE: in-place edits are copy-on-write and never reach the file, pages fault in lazily on first touch
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (base == MAP_FAILED) { *arrayPtr = NULL; return -2; }
+    uint64_t count = 0;
+    int rc = parseHeader(base, (long long)st.st_size, &count); // Touches only the first page
+    if (rc != 0) { munmap(base, length); *arrayPtr = NULL; return rc; }
+    map->base = base;
+    map->length = length;
+    *arrayPtr = (Item *)((unsigned char *)base + ITEMS_HEADER_SIZE); // Items are read straight out of the page cache
+    *countptr = (int)count;
+    metricsAddRead(length); // Counted as mapped, the pages are only read as they are touched
+    return 0;
+#endif
+}
+
+int loadItemsMapped(const char *filename, Item **arrayPtr, int *countptr, ItemMapping *map) {
+    uint64_t start = metricsBegin(MET_LOAD); // A fallback to loadItems is part of this load
+    int rc = mapItems(filename, arrayPtr, countptr, map);
+    metricsFinish(MET_LOAD, start);
+    return rc;
+}
+
+int verifyMappedItems(const ItemMapping *map) {
+    if (!map->base) return 0; // Heap arrays were checked while loading
+    const unsigned char *base = map->base;
+    uint64_t count = getU64(base + 24);
+    const unsigned char *records = base + ITEMS_HEADER_SIZE;
+    const unsigned char *crcs = records + count * ITEMS_RECORD_SIZE;
+    for (uint32_t b = 0; b < blockCount(count); ++b) { // Reads every page once, sequentially
+        uint64_t first = (uint64_t)b * ITEMS_BLOCK_RECORDS;
+        uint64_t n = count - first < ITEMS_BLOCK_RECORDS ? count - first : ITEMS_BLOCK_RECORDS;
+        if (crc32c(0, records + first * ITEMS_RECORD_SIZE, n * ITEMS_RECORD_SIZE) != getU32(crcs + 4 * b)) return -7;
+    }
+    return 0;
+}
+
+int promoteMappedItems(ItemMapping *map, Item **arrayPtr, int count) {
+    if (!map->base) return 0; // Already a heap array
+    Item *copy = malloc(count > 0 ? (size_t)count * sizeof(Item) : 1); // Heap copy that realloc can grow
+    if (!copy) return -1; // Check if memory allocation was successful
+    memcpy(copy, *arrayPtr, (size_t)count * sizeof(Item));
+    releaseItems(*arrayPtr, map); // Drop the mapping
+    *arrayPtr = copy;
+    return 0;
+}
+
+void releaseItems(Item *array, ItemMapping *map) {
+    if (map && map->base) {
+#ifndef _WIN32
+        munmap(map->base, map->length); // Unmap instead of free()
+#endif
+        map->base = NULL;
+        map->length = 0;
+    } else {
+        free(array); // Ordinary malloc'd array
+    }
+}
+
+typedef int (*ItemsSink)(void *ctx, const void *data, size_t len); // Where encoded snapshot bytes go; 0 on success
+
+static int encodeItems(ItemsSink put, void *ctx, const Item *array, int live, int skipDeleted) { // Header, records, CRC table
+    uint32_t blocks = blockCount((uint64_t)live);
+    unsigned char *buf = malloc((size_t)ITEMS_BLOCK_RECORDS * ITEMS_RECORD_SIZE); // One block of encoded records
+    unsigned char *crcs = malloc(blocks ? (size_t)blocks * 4 : 1); // CRC table, written last
+    if (!buf || !crcs) { free(buf); free(crcs); return -3; }
+
+    unsigned char hdr[ITEMS_HEADER_SIZE];
+    encodeHeader(hdr, (uint64_t)live);
+    int rc = put(ctx, hdr, sizeof hdr);
+    int src = 0; // Next slot of 'array' to look at
+    for (uint32_t b = 0; rc == 0 && b < blocks; ++b) {
+        int first = (int)(b * ITEMS_BLOCK_RECORDS);
+        int n = live - first < ITEMS_BLOCK_RECORDS ? live - first : ITEMS_BLOCK_RECORDS;
+        for (int i = 0; i < n; ++i) {
+            while (skipDeleted && array[src].id == 0) src++; // Step over deleted slots
+            encodeItemRecord(buf + (size_t)i * ITEMS_RECORD_SIZE, &array[src++]); // Fixed layout, zeroed padding
+        }
+        size_t bytes = (size_t)n * ITEMS_RECORD_SIZE;
+        putU32(crcs + 4 * b, crc32c(0, buf, bytes));
+        rc = put(ctx, buf, bytes); // Write the the items to the file but check if the write was successful
+    }
+    if (rc == 0) rc = put(ctx, crcs, (size_t)blocks * 4);
+    free(buf);
+    free(crcs);
+    return rc;
+}
+
+static int stdioSink(void *ctx, const void *data, size_t len) {
+    return fwrite(data, 1, len, (FILE *)ctx) == len ? 0 : -2;
+}
+
+#ifdef __linux__
+typedef struct RingSave RingSave;
+
+typedef struct { // One write of a ring save
+    IoRequest req; // First, so the completion leads back here
+    RingSave *save;
+    unsigned char *buf; // ITEMS_RING_CHUNK bytes, page-aligned
+    uint32_t len, done; // Bytes filled, bytes written so far
+    uint64_t offset;
+    int busy;
+} SaveChunk;
+
+struct RingSave {
+    IoRing ring;
+    int fd;
+    int rc;
+    uint64_t offset; // File offset of the next chunk
+    SaveChunk *cur; // Being filled, NULL if none
+    SaveChunk chunks[IO_RING_DEPTH / 2];
+    IoRequest sync;
+    int synced; // 1 once the fdatasync completed, -1 while it has not run (cancelled)
+};
+
+static void saveChunkDone(IoRequest *req, int res) {
+    SaveChunk *c = (SaveChunk *)req;
+    RingSave *s = c->save;
+    if (res < 0) {
+        if (s->rc == 0) s->rc = -2;
+        c->busy = 0;
+        return;
+    }
+    c->done += (uint32_t)res;
+    if (res > 0 && c->done < c->len) { // Short write (its linked sync, if any, was cancelled): write the rest
+        if (ioRingWrite(&s->ring, &c->req, s->fd, c->buf + c->done, c->len - c->done, c->offset + c->done, 0) != 0 && s->rc == 0) s->rc = -2;
+        return;
+    }
+    if (c->done < c->len && s->rc == 0) s->rc = -2; // Wrote nothing: out of space
+    c->busy = 0;
+}
+
+static void saveSyncDone(IoRequest *req, int res) {
+    RingSave *s = (RingSave *)((char *)req - offsetof(RingSave, sync));
+    if (res == 0) s->synced = 1;
+    else if (res == -ECANCELED) s->synced = -1; // The write before it came up short; synced again below
+    else if (s->rc == 0) s->rc = -2;
+}
+
+static int ringSink(void *ctx, const void *data, size_t len) { // Fills 1 MB chunks and sends each one as soon as it is full
+    RingSave *s = ctx;
+    const unsigned char *p = data;
+    while (len > 0 && s->rc == 0) {
+        while (!s->cur && s->rc == 0) { // Take a free chunk, waiting for a write to finish if need be
+            for (int k = 0; k < IO_RING_DEPTH / 2 && !s->cur; ++k) {
+                if (!s->chunks[k].busy) s->cur = &s->chunks[k];
+            }
+            if (s->cur) s->cur->len = 0;
+            if (!s->cur && ioRingSubmit(&s->ring, 1) < 0) s->rc = -2;
+        }
+        if (s->rc != 0) break;
+        SaveChunk *c = s->cur;
+        size_t n = ITEMS_RING_CHUNK - c->len < len ? ITEMS_RING_CHUNK - c->len : len;
+        memcpy(c->buf + c->len, p, n);
+        c->len += (uint32_t)n;
+        p += n;
+        len -= n;
+        if (c->len == ITEMS_RING_CHUNK) { // Full: off it goes, encoding carries on in the next chunk
+            c->offset = s->offset;
+            c->done = 0;
+            c->busy = 1;
+            s->offset += c->len;
+            s->cur = NULL;
+            if (ioRingWrite(&s->ring, &c->req, s->fd, c->buf, c->len, c->offset, 0) != 0 || ioRingSubmit(&s->ring, 0) < 0) s->rc = -2;
+        }
+    }
+    return s->rc;
+}
+
+/*
+Snapshot save on io_uring: encoding fills the next 1 MB chunk while the
+previous ones are being written. The last chunk waits for all earlier
+writes (drain) and is linked to the fdatasync, so the sync goes out in the
+same submission and runs only once every byte is written
+*/
+static int writeItemsRing(const char *filename, const Item *array, int live, int skipDeleted) {
+    if (!ringWanted(itemsFileBytes((uint64_t)live))) return ITEMS_RING_SKIPPED;
+    RingSave *s = calloc(1, sizeof *s);
+    if (!s) return -3;
+    if (ioRingInit(&s->ring, IO_RING_DEPTH) != 0) { free(s); return ITEMS_RING_SKIPPED; }
+    int rc = 0;
+    for (int k = 0; k < IO_RING_DEPTH / 2 && rc == 0; ++k) {
+        s->chunks[k].req.done = saveChunkDone;
+        s->chunks[k].save = s;
+        if (posix_memalign((void **)&s->chunks[k].buf, 4096, ITEMS_RING_CHUNK) != 0) { s->chunks[k].buf = NULL; rc = -3; }
+    }
+    s->fd = rc == 0 ? open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666) : -1;
+    if (rc == 0 && s->fd < 0) rc = -1;
+    if (rc == 0) rc = encodeItems(ringSink, s, array, live, skipDeleted);
+    s->sync.done = saveSyncDone;
+    if (rc == 0) {
+        SaveChunk *c = s->cur;
+        int ok;
+        if (c && c->len > 0) { // Tail chunk + sync in one submission, ordered by the link
+            c->offset = s->offset;
+            c->done = 0;
+            c->busy = 1;
+            ok = ioRingWrite(&s->ring, &c->req, s->fd, c->buf, c->len, c->offset, IO_DRAIN | IO_LINK) == 0 &&
+                 ioRingFsync(&s->ring, &s->sync, s->fd, 0) == 0;
+        } else {
+            ok = ioRingFsync(&s->ring, &s->sync, s->fd, IO_DRAIN) == 0;
+        }
+        if (!ok || ioRingSubmit(&s->ring, 0) < 0) rc = -2;
+    }
+    while (s->ring.inFlight > 0 && ioRingSubmit(&s->ring, s->ring.inFlight) >= 0) {} // Every write and the sync
+    if (rc == 0) rc = s->rc;
+    if (rc == 0 && s->synced != 1 && syncFileData(s->fd) != 0) rc = -2; // The linked sync was cancelled by a short write
+    ioRingFree(&s->ring);
+    if (s->fd >= 0 && close(s->fd) != 0 && rc == 0) rc = -2;
+    for (int k = 0; k < IO_RING_DEPTH / 2; ++k) free(s->chunks[k].buf);
+    free(s);
+    return rc;
+}
+#endif
+
+static int writeItemsFile(const char *filename, const Item *array, int count, int skipDeleted) { // writeItems without the metrics
+    int live = count; // Records that end up in the file
+    if (skipDeleted) {
+        live = 0;
+        for (int i = 0; i < count; ++i) live += array[i].id != 0;
+    }
+    int rc;
+#ifdef __linux__
+    rc = writeItemsRing(filename, array, live, skipDeleted); // Large files go through io_uring when it is there
+    if (rc != ITEMS_RING_SKIPPED) {
+        if (rc == 0) metricsAddWritten((uint64_t)itemsFileBytes((uint64_t)live));
+        return rc;
+    }
+#endif
     FILE *fp = fopen(filename, "wb"); // Open the file in binary write mode
     if (!fp) {
         return -1; // Return an error code if the file could not be opened
     }
-    if (fwrite(array, sizeof(Item), count, fp) != (size_t)count) { // Write the the items to the file but check if the write was successful
-        fclose(fp); // Close the file
-        return -2; // Return an error code if writing failed
+    setvbuf(fp, NULL, _IOFBF, ITEMS_IO_BUFFER); // Write in large chunks
+    rc = encodeItems(stdioSink, fp, array, live, skipDeleted);
+    if (rc == 0 && syncFile(fp) != 0) rc = -2; // On disk before anyone renames it into place
+    if (fclose(fp) != 0 && rc == 0) rc = -2; // Close the file, buffered data is written here
+    if (rc == 0) metricsAddWritten((uint64_t)itemsFileBytes((uint64_t)live));
+    return rc; // Return success or an error code if writing failed
+}
+
+static int writeItems(const char *filename, const Item *array, int count, int skipDeleted) { // saveItems / saveLiveItems
+    uint64_t start = metricsBegin(MET_SAVE);
+    int rc = writeItemsFile(filename, array, count, skipDeleted);
+    metricsFinish(MET_SAVE, start);
+    return rc;
+}
+
+int saveItems(const char *filename, const Item *array, int count) { // Saves items to a file from a dynamically allocated array
+    return writeItems(filename, array, count, 0);
+}
+
+int saveLiveItems(const char *filename, const Item *array, int count) {
+    return writeItems(filename, array, count, 1);
+}
+
+int convertLegacyItems(const char *legacyFile, const char *newFile) {
+    FILE *fp = fopen(legacyFile, "rb"); // Old files are a raw dump of Item structs
+    if (!fp) return 1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    unsigned char hdr[8];
+    if (size >= 8 && fread(hdr, 1, 8, fp) == 8 && memcmp(hdr, ITEMS_MAGIC, 8) == 0) { fclose(fp); return -5; } // Already converted
+    rewind(fp);
+    if (size % (long)sizeof(Item) != 0) { fclose(fp); return -6; } // A partial trailing record means the dump was torn
+    int count = (int)(size / (long)sizeof(Item));
+    Item *arr = malloc(count ? (size_t)count * sizeof(Item) : 1);
+    if (!arr) { fclose(fp); return -1; }
+    if (fread(arr, sizeof(Item), (size_t)count, fp) != (size_t)count) { free(arr); fclose(fp); return -2; }
+    fclose(fp);
+    for (int i = 0; i < count; ++i) arr[i].name[sizeof arr[i].name - 1] = '\0'; // Old writers did not always terminate names
+    int rc = saveItems(newFile, arr, count); // Re-encode in the stable layout
+    free(arr);
+    return rc;
+}
+
+static int walStartLog(Wal *wal) { // (Re)creates the log holding only its header
+    if (wal->fp) fclose(wal->fp);
+    wal->fp = fopen(wal->path, "wb"); // Open the log in binary write mode, dropping old contents
+    if (!wal->fp) return -1;
+    unsigned char start[WAL_HEADER_SIZE];
+    memcpy(start, WAL_MAGIC, 4);
+    putU32(start + 4, WAL_VERSION);
+    if (fwrite(start, 1, sizeof start, wal->fp) != sizeof start || syncFile(wal->fp) != 0) {
+        fclose(wal->fp);
+        wal->fp = NULL;
+        return -1;
+    }
+    wal->size = WAL_HEADER_SIZE;
+    wal->generation++; // A different file from here on
+    syncParentDir(wal->path); // A new log must not vanish with its directory entry
+    return 0;
+}
+
+int walOpen(Wal *wal, const char *filename) {
+    snprintf(wal->snapshot, sizeof wal->snapshot, "%s", filename); // Remember which snapshot we belong to
+    walLogPath(wal->path, filename);
+    wal->threshold = WAL_COMPACT_THRESHOLD;
+    wal->deferFlush = 0;
+    wal->fp = NULL;
+    wal->generation = 0;
+    wal->tap = NULL;
+    wal->tapCtx = NULL;
+
+    int usable = 0; // Does an existing log start with our header?
+    FILE *fp = fopen(wal->path, "rb");
+    if (fp) {
+        unsigned char start[WAL_HEADER_SIZE];
+        if (fread(start, 1, sizeof start, fp) == sizeof start && memcmp(start, WAL_MAGIC, 4) == 0) {
+            uint32_t version = getU32(start + 4);
+            if (version < WAL_OLDEST_VERSION || version > WAL_VERSION) { fclose(fp); return -2; } // Never wipe a log we cannot read
+            usable = version == WAL_VERSION ? 1 : 2; // 2: an older layout, upgraded below
+        }
+        fclose(fp);
     }
-    fclose(fp); // Close the file
-    return 0; // Return success
-}
\ No newline at end of file
+    if (usable == 2) { // Same records plus new types: only the version needs bumping
+        unsigned char v[4];
+        putU32(v, WAL_VERSION);
+        fp = fopen(wal->path, "r+b");
+        if (!fp || fseek(fp, 4, SEEK_SET) != 0 || fwrite(v, 1, 4, fp) != 4) { if (fp) fclose(fp); return -1; }
+        if (fclose(fp) != 0) return -1;
+    }
+    if (!usable) return walStartLog(wal); // Missing or foreign log, start a new one
+
+    wal->fp = fopen(wal->path, "ab"); // Open the log in binary append mode
+    if (!wal->fp) return -1;
+    fseek(wal->fp, 0, SEEK_END);
+    wal->size = ftell(wal->fp); // Current log length
+    return 0;
+}
+
+static int walAppend(Wal *wal, WalOp op, const unsigned char *payload, uint32_t len) { // Writes one record and flushes it
+    if (!wal->fp) return -1;
+    unsigned char h[WAL_RECORD_HEADER];
+    putU32(h, (uint32_t)op);
+    putU32(h + 4, len);
+    putU32(h + 8, walChecksum(h, payload, len));
+    if (fwrite(h, 1, sizeof h, wal->fp) != sizeof h || fwrite(payload, 1, len, wal->fp) != len) return -2; // Check if the write was successful
+    if (!wal->deferFlush && fflush(wal->fp) != 0) return -2; // Hand the record to the OS now
+    wal->size += (long)(sizeof h + len);
+    metricsAddWritten(sizeof h + len);
+    if (wal->tap && (wal->tap(wal->tapCtx, (int)op, payload, len) != 0 ||
+                     (!wal->deferFlush && wal->tap(wal->tapCtx, WAL_TAP_FLUSH, NULL, 0) != 0))) return -2; // The observer never runs ahead of the log
+    return 0;
+}
+
+static int tapFlush(Wal *wal) { // Tells the observer the log reached the OS
+    return wal->tap && wal->tap(wal->tapCtx, WAL_TAP_FLUSH, NULL, 0) != 0 ? -2 : 0;
+}
+
+int walAppendAdd(Wal *wal, const Item *item) {
+    unsigned char rec[ITEMS_RECORD_SIZE];
+    encodeItemRecord(rec, item); // Same layout as a snapshot record
+    return walAppend(wal, WAL_OP_ADD, rec, sizeof rec);
+}
+
+int walAppendQty(Wal *wal, int id, int quantity) {
+    unsigned char p[8];
+    putU32(p, (uint32_t)id);
+    putU32(p + 4, (uint32_t)quantity);
+    return walAppend(wal, WAL_OP_QTY, p, sizeof p);
+}
+
+int walAppendDelete(Wal *wal, int id) {
+    unsigned char p[4];
+    putU32(p, (uint32_t)id);
+    return walAppend(wal, WAL_OP_DEL, p, sizeof p);
+}
+
+int walAppendMarker(Wal *wal, WalOp op) {
+    unsigned char none = 0; // Markers carry no payload
+    return walAppend(wal, op, &none, 0);
+}
+
+int walSync(Wal *wal) {
+    if (!wal->fp) return -1;
+    if (syncFile(wal->fp) != 0) return -2;
+    return tapFlush(wal);
+}
+
+int walFlush(Wal *wal) {
+    if (!wal->fp) return -1;
+    if (fflush(wal->fp) != 0) return -2;
+    return tapFlush(wal);
+}
+
+int walNeedsCompaction(const Wal *wal) {
+    return wal->size >= wal->threshold;
+}
+
+int walCompact(Wal *wal, const Item *array, int count) {
+    char tmp[WAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof tmp, "%s.tmp", wal->snapshot); // Write the new snapshot beside the old one
+    if (saveItems(tmp, array, count) != 0) { remove(tmp); return -1; }
+#ifdef _WIN32
+    remove(wal->snapshot); // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tmp, wal->snapshot) != 0) { remove(tmp); return -2; } // Swap it in
+    syncParentDir(wal->snapshot); // The rename itself must survive a crash before the log is emptied
+    // A crash from here until the log is emptied just replays the log again, which is harmless
+    if (walStartLog(wal) != 0) return -3; // Start an empty log
+    return 0;
+}
+
+int walTrimFront(Wal *wal, long keepFrom) {
+    if (!wal->fp) return -1;
+    if (fflush(wal->fp) != 0) return -2; // The tail must be in the file before it is copied
+    if (keepFrom < WAL_HEADER_SIZE || keepFrom > wal->size) return -1;
+    char tmp[WAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof tmp, "%s.tmp", wal->path);
+    FILE *in = fopen(wal->path, "rb");
+    FILE *out = in ? fopen(tmp, "wb") : NULL;
+    if (!out) { if (in) fclose(in); return -2; }
+    unsigned char buf[65536];
+    memcpy(buf, WAL_MAGIC, 4);
+    putU32(buf + 4, WAL_VERSION);
+    int rc = fwrite(buf, 1, WAL_HEADER_SIZE, out) == WAL_HEADER_SIZE ? 0 : -2;
+    long left = wal->size - keepFrom; // Records appended after 'keepFrom'
+    if (rc == 0 && fseek(in, keepFrom, SEEK_SET) != 0) rc = -2;
+    while (rc == 0 && left > 0) {
+        size_t want = left < (long)sizeof buf ? (size_t)left : sizeof buf;
+        if (fread(buf, 1, want, in) != want || fwrite(buf, 1, want, out) != want) rc = -2;
+        left -= (long)want;
+    }
+    fclose(in);
+    if (rc == 0) { metricsAddRead((uint64_t)(wal->size - keepFrom)); metricsAddWritten(WAL_HEADER_SIZE + (uint64_t)(wal->size - keepFrom)); }
+    if (rc == 0 && syncFile(out) != 0) rc = -2; // The short log replaces records that are only safe in the old one
+    if (fclose(out) != 0 && rc == 0) rc = -2;
+    if (rc != 0) { remove(tmp); return rc; }
+    fclose(wal->fp); // Swap the short log in, same dance as walCompact
+    wal->fp = NULL;
+#ifdef _WIN32
+    remove(wal->path);
+#endif
+    if (rename(tmp, wal->path) != 0) { remove(tmp); rc = -2; } // Same unsynced log as before: the syncer still has work
+    else { syncParentDir(wal->path); wal->generation++; } // A synced file from here on
+    wal->fp = fopen(wal->path, "ab"); // Keep appending to whichever log is now in place
+    if (!wal->fp) return -3;
+    fseek(wal->fp, 0, SEEK_END);
+    wal->size = ftell(wal->fp);
+    return rc;
+}
+
+int walReset(Wal *wal) {
+    return walStartLog(wal) == 0 ? 0 : -3;
+}
+
+int walClose(Wal *wal) {
+    int rc = 0;
+    if (wal->fp) rc = fclose(wal->fp); // Close the log
+    wal->fp = NULL;
+    return rc;
+}
@@ -2,18 +2,225 @@
 #define FILEIO_H
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include "item.h"
 
 /*
-Loads item from 'filename' into newly malloc'd array
+On-disk format of items files (all integers little-endian):
+  header, 64 bytes:
+     0 magic "INVITEMS"      8 version (u32)       12 header size (u32)
+    16 record size (u32)    20 records per block  24 record count (u64)
+    32 CRC table offset     40 flags, reserved    60 CRC32C of bytes 0..59
+  records, 68 bytes each, no implicit padding:
+     0 id (i32)   4 name (52 bytes, NUL-terminated, zero-filled)
+    56 quantity (i32)   60 price (IEEE-754 f32)   64 category (u32)
+  CRC table: one CRC32C (u32) per block of ITEMS_BLOCK_RECORDS records
+The header's count fixes the exact file length, so a torn file is rejected
+from its size alone. On little-endian hosts where Item has this exact layout
+records are read (or mapped) straight into Item structs.
+*/
+#define ITEMS_MAGIC "INVITEMS" // 8 bytes, no terminator stored
+#define ITEMS_FORMAT_VERSION 1
+#define ITEMS_HEADER_SIZE 64
+#define ITEMS_RECORD_SIZE 68
+#define ITEMS_BLOCK_RECORDS 1024 // Records covered by one CRC (about 68 KB)
+#define ITEMS_REC_ID 0 // Field offsets within a record
+#define ITEMS_REC_NAME 4
+#define ITEMS_REC_QUANTITY 56
+#define ITEMS_REC_PRICE 60
+#define ITEMS_REC_CATEGORY 64
+
+/*
+Loads item from 'filename' into newly malloc'd array, then replays the
+write-ahead log ('filename' + ".wal") over it if one exists. Every block
+checksum is verified. A shard manifest (see shardio.h) loads all of its
+shards concurrently, one after the other in the array.
 on success: *arrayptr points to the array, *countPtr is set to, 
-returns 0. On failure, returns non-zero value and *arrayptr= NULL
+returns 0. On failure, returns non-zero value and *arrayptr= NULL:
+1 no file, -1/-3 out of memory, -2 read error, -4 not an items file,
+-5 unsupported version, -6 truncated/torn, -7 checksum mismatch
 */
 int loadItems(const char *filename, Item **arrayPtr, int *countPtr);
 
+typedef struct { // Describes an items array that points into a file mapping
+    void *base; // Start of the mapping, NULL when the array is on the heap
+    size_t length; // Length of the mapping in bytes
+} ItemMapping;
+
+/*
+Like loadItems, but maps 'filename' copy-on-write (MAP_PRIVATE) so *arrayPtr
+points straight into the page cache and pages are read lazily on first touch.
+Items may be edited in place but the array cannot be realloc'd: call
+promoteMappedItems() before growing or shrinking it, and release it with
+releaseItems() instead of free(). If the log holds pending records (or mmap
+is not available) this falls back to loadItems and map->base stays NULL.
+Never save over the mapped file in place; walCompact's rename is fine.
+Only the header and file size are checked here (so torn files are still
+rejected); call verifyMappedItems() to check the block checksums as well.
+*/
+int loadItemsMapped(const char *filename, Item **arrayPtr, int *countPtr, ItemMapping *map);
+
+/*
+Verifies every block checksum of a mapped file. Call it before editing the
+array. Returns 0 if all blocks match (or the array is not mapped), -7 otherwise
+*/
+int verifyMappedItems(const ItemMapping *map);
+
+/*
+Copies a mapped array onto the heap and unmaps it, so it can be realloc'd.
+Does nothing if the array is already on the heap. Returns 0 on success, -1 on failure
+*/
+int promoteMappedItems(ItemMapping *map, Item **arrayPtr, int count);
+
+/* Releases an array from loadItems or loadItemsMapped (munmap or free as appropriate) */
+void releaseItems(Item *array, ItemMapping *map);
+
 /* Saves 'count' items from 'array' to 'filename'
 Returns 0 on success, non-zero on failure    
 */
 int saveItems(const char *filename, const Item *array, int count);
 
+/* Like saveItems, but slots whose id is 0 (deleted) are left out of the file */
+int saveLiveItems(const char *filename, const Item *array, int count);
+
+/*
+Rewrites a legacy items file (a raw dump of Item structs from older builds)
+in the current format. Returns 0 on success, 1 if 'legacyFile' does not exist,
+-5 if it is already in the current format, -6 if it ends in a partial record
+*/
+int convertLegacyItems(const char *legacyFile, const char *newFile);
+
+/* Short description of a loadItems/saveItems/convertLegacyItems return code */
+const char *itemsErrorString(int code);
+
+/* Encode/decode one ITEMS_RECORD_SIZE-byte record (shared with the log and other tools) */
+void encodeItemRecord(unsigned char *out, const Item *item);
+void decodeItemRecord(Item *item, const unsigned char *in);
+
+/* Returns 1 if Item matches the on-disk record layout exactly on this host */
+int itemsLayoutIsNative(void);
+
+/*
+How snapshots are read and written (loadItems, saveItems, saveLiveItems
+and the checkpoints built on them). ITEMS_IO_AUTO, the default, uses
+io_uring (see uring.h) for files of ITEMS_URING_MIN_BYTES or more when the
+kernel offers it, with large reads and writes in flight while blocks are
+checked or encoded; otherwise, and for small files, buffered stdio.
+ITEMS_IO_URING forces the ring for any size (still stdio without it).
+Both paths read and write exactly the same files. The log stays on stdio
+*/
+typedef enum {
+    ITEMS_IO_AUTO = 0,
+    ITEMS_IO_STDIO = 1,
+    ITEMS_IO_URING = 2
+} ItemsIoBackend;
+#define ITEMS_URING_MIN_BYTES (1L << 20)
+
+void itemsSetIoBackend(ItemsIoBackend backend); // Process-wide; set it before loading or saving
+ItemsIoBackend itemsIoBackend(void);
+
+/* Write-ahead log: small typed records appended instead of rewriting the whole file */
+#define WAL_SUFFIX ".wal" // Log lives next to the snapshot as <filename>.wal
+#define WAL_COMPACT_THRESHOLD (4L * 1024 * 1024) // Default log size (bytes) that triggers compaction
+#define WAL_PATH_MAX 512 // Longest log path we support
+
+typedef enum { // Record types stored in the log
+    WAL_OP_ADD = 1, // Payload: an encoded item record (upsert)
+    WAL_OP_QTY = 2, // Payload: id and new quantity
+    WAL_OP_DEL = 3, // Payload: id
+    WAL_OP_BEGIN = 4, // No payload: the records up to the next COMMIT apply together or not at all
+    WAL_OP_COMMIT = 5, // No payload: ends a transaction
+    WAL_OP_ABORT = 6 // No payload: ends a transaction that was rolled back
+} WalOp;
+
+/*
+Optional observer of a log (e.g. a change feed, see changefeed.h). Called
+with every record once it is written (op is the WalOp, the payload as
+logged), with WAL_TAP_FLUSH whenever the log is handed to the OS, and with
+WAL_TAP_UNLOGGED after changes were made without logging them (a bulk
+load). A non-zero return fails the append or flush with -2
+*/
+#define WAL_TAP_FLUSH 0
+#define WAL_TAP_UNLOGGED (-1)
+typedef int (*WalTapFn)(void *ctx, int op, const unsigned char *payload, uint32_t len);
+
+typedef struct { // Open handle on a snapshot's write-ahead log
+    FILE *fp; // Log opened for appending
+    char snapshot[WAL_PATH_MAX]; // Snapshot file the log belongs to
+    char path[WAL_PATH_MAX]; // Path of the log itself
+    long size; // Current size of the log in bytes
+    long threshold; // Size at which walNeedsCompaction() says yes
+    int deferFlush; // When set, appends stay in the stdio buffer until walFlush()
+    int generation; // Bumped whenever a checkpoint or trim puts a different file under 'fp'
+    WalTapFn tap; // Observer of the records, NULL for none (walOpen clears it)
+    void *tapCtx;
+} Wal;
+
+/*
+Opens (creating if needed) the log for snapshot 'filename'.
+Returns 0 on success, -1 if the log could not be opened
+*/
+int walOpen(Wal *wal, const char *filename);
+
+/* Append one record and flush it to the OS (unless deferFlush is set). Return 0 on success, non-zero on failure */
+int walAppendAdd(Wal *wal, const Item *item);
+int walAppendQty(Wal *wal, int id, int quantity);
+int walAppendDelete(Wal *wal, int id);
+
+/* Appends a transaction marker (WAL_OP_BEGIN, WAL_OP_COMMIT or WAL_OP_ABORT). Returns 0 on success */
+int walAppendMarker(Wal *wal, WalOp op);
+
+/* Hands any buffered records to the OS. Returns 0 on success */
+int walFlush(Wal *wal);
+
+/* Flushes and forces the log to stable storage (fdatasync). Returns 0 on success */
+int walSync(Wal *wal);
+
+/* Returns 1 once the log has grown past wal->threshold, 0 otherwise */
+int walNeedsCompaction(const Wal *wal);
+
+/*
+Folds the log into a fresh snapshot: writes 'count' items to a temp file,
+renames it over the snapshot and empties the log.
+Returns 0 on success, non-zero on failure (the log is left untouched)
+*/
+int walCompact(Wal *wal, const Item *array, int count);
+
+/*
+Rewrites the log keeping only the records from byte offset 'keepFrom' on
+(an earlier wal->size), then swaps it in with a rename. Used once a
+background snapshot that already holds the older records is in place.
+Returns 0 on success, non-zero on failure
+*/
+int walTrimFront(Wal *wal, long keepFrom);
+
+/* Empties the log once its records are safe somewhere else (e.g. a paged store's checkpoint). Returns 0 on success */
+int walReset(Wal *wal);
+
+/* Closes the log. Returns 0 on success */
+int walClose(Wal *wal);
+
+/*
+Called for every committed data record during replay: an ADD carries the
+whole item, a QTY only id and quantity, a DEL only the id.
+Returns 0 to go on, negative to stop the replay with that code
+*/
+typedef int (*WalApplyFn)(void *ctx, WalOp op, const Item *item);
+
+/*
+Replays <filename>.wal through 'apply' (e.g. into a store other than an
+items array) and cuts off a torn tail. Returns 0, 1 if there is no log,
+-5 for a log layout we cannot read, or apply's code
+*/
+int walReplay(const char *filename, WalApplyFn apply, void *ctx);
+
+/*
+Durability helpers. Writes only reach the OS cache until synced: snapshots
+are synced before they are renamed into place, and the directory after.
+Return 0 on success, -1 on failure
+*/
+int syncFileData(int fd); // fdatasync (fsync where that is missing)
+int syncFile(FILE *fp); // fflush, then syncFileData
+int syncParentDir(const char *path); // fsync of the directory holding 'path' (no-op on Windows)
+
 #endif // FILEIO_H
\ No newline at end of file
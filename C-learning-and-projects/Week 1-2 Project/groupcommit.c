@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include "groupcommit.h"
+#include "fileio.h"
+
+#define GC_RETRY_NS 10000000u // Pause after a failed sync before trying again (10 ms)
+
+uint64_t groupCommitClock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int queuePush(GcQueue *q, uint64_t ticket, uint64_t since, int commits) { // Appends one request, growing geometrically
+    if (q->count == q->capacity) {
+        int newCap = q->capacity ? q->capacity * 2 : 64;
+        uint64_t *t = realloc(q->ticket, (size_t)newCap * sizeof *t);
+        if (t) q->ticket = t;
+        uint64_t *s = t ? realloc(q->since, (size_t)newCap * sizeof *s) : NULL;
+        if (s) q->since = s;
+        int *c = s ? realloc(q->commits, (size_t)newCap * sizeof *c) : NULL;
+        if (!c) return -1; // Arrays that did grow are simply larger than needed
+        q->commits = c;
+        q->capacity = newCap;
+    }
+    q->ticket[q->count] = ticket;
+    q->since[q->count] = since;
+    q->commits[q->count++] = commits;
+    return 0;
+}
+
+static void queueFree(GcQueue *q) {
+    free(q->ticket);
+    free(q->since);
+    free(q->commits);
+    memset(q, 0, sizeof *q);
+}
+
+static void complete(GroupCommit *gc, GcQueue *q, uint64_t upTo, uint64_t now) { // Records latencies of requests up to 'upTo' (lock held)
+    int commits = 0, w = 0;
+    for (int i = 0; i < q->count; ++i) {
+        if (q->ticket[i] > upTo) { // Queued after the sync started, keeps waiting
+            q->ticket[w] = q->ticket[i]; q->since[w] = q->since[i]; q->commits[w++] = q->commits[i];
+            continue;
+        }
+        histRecordN(&gc->stats->latency, now - q->since[i], (uint64_t)q->commits[i]);
+        commits += q->commits[i];
+    }
+    q->count = w;
+    if (commits == 0) return;
+    gc->stats->commits += commits;
+    histRecord(&gc->stats->batch, (uint64_t)commits);
+}
+
+static void markDurable(GroupCommit *gc, uint64_t upTo) { // Publishes progress and wakes waiters (lock held)
+    if (upTo > gc->durable) gc->durable = upTo;
+    pthread_cond_broadcast(&gc->done);
+    if (gc->notifyFd >= 0) {
+        char b = 1;
+        if (write(gc->notifyFd, &b, 1) < 0 && errno != EAGAIN) gc->notifyFd = -1; // A full pipe already has a wakeup in it
+    }
+}
+
+static void *syncer(void *arg) { // Waits for commits, then covers as many as possible with one fdatasync
+    GroupCommit *gc = arg;
+    pthread_mutex_lock(&gc->lock);
+    for (;;) {
+        while (gc->queue.count == 0 && !gc->stopping) pthread_cond_wait(&gc->wake, &gc->lock);
+        if (gc->queue.count == 0) break; // Stopping with nothing left to sync
+        uint64_t deadline = gc->queue.since[0] + (uint64_t)gc->maxDelayUs * 1000u; // Oldest commit's patience
+        while (!gc->stopping && gc->queued < gc->maxBatch && groupCommitClock() < deadline) {
+            struct timespec ts = { .tv_sec = (time_t)(deadline / 1000000000u), .tv_nsec = (long)(deadline % 1000000000u) };
+            pthread_cond_timedwait(&gc->wake, &gc->lock, &ts); // The clock is CLOCK_MONOTONIC, see groupCommitStart
+        }
+        GcQueue batch = gc->queue; // Take the whole queue; new commits go to the spare arrays
+        gc->queue = gc->spare;
+        gc->queue.count = 0;
+        gc->spare = batch;
+        gc->queued = 0;
+        uint64_t target = gc->requested; // Everything queued so far is already in the file
+        int fd = dup(gc->fd); // The log may be swapped (and gc->fd closed) while we sync
+        pthread_mutex_unlock(&gc->lock);
+
+        uint64_t t0 = groupCommitClock();
+        int rc = fd >= 0 ? syncFileData(fd) : -1;
+        uint64_t now = groupCommitClock();
+        if (fd >= 0) close(fd);
+
+        pthread_mutex_lock(&gc->lock);
+        gc->stats->syncs++;
+        histRecord(&gc->stats->syncTime, now - t0);
+        if (rc != 0) { // Put the batch back in front of newer commits and retry on the next round
+            gc->stats->failures++;
+            gc->error = 1;
+            for (int i = 0; i < gc->queue.count; ++i) queuePush(&gc->spare, gc->queue.ticket[i], gc->queue.since[i], gc->queue.commits[i]);
+            GcQueue tmp = gc->queue;
+            gc->queue = gc->spare;
+            gc->spare = tmp;
+            gc->spare.count = 0;
+            gc->queued = 0;
+            for (int i = 0; i < gc->queue.count; ++i) gc->queued += gc->queue.commits[i];
+            pthread_cond_broadcast(&gc->done); // Waiters see the error
+            if (gc->stopping) break;
+            uint64_t retry = now + GC_RETRY_NS; // Do not spin on a failing disk
+            struct timespec ts = { .tv_sec = (time_t)(retry / 1000000000u), .tv_nsec = (long)(retry % 1000000000u) };
+            while (!gc->stopping && pthread_cond_timedwait(&gc->wake, &gc->lock, &ts) != ETIMEDOUT);
+            continue;
+        }
+        gc->error = 0;
+        complete(gc, &gc->spare, target, now);
+        gc->spare.count = 0;
+        markDurable(gc, target);
+    }
+    pthread_mutex_unlock(&gc->lock);
+    return NULL;
+}
+
+int groupCommitStart(GroupCommit *gc, int fd, long maxDelayUs, int maxBatch) {
+    memset(gc, 0, sizeof *gc);
+    gc->fd = dup(fd); // Our own handle: the caller may close its log at any time
+    if (gc->fd < 0) return -1;
+    gc->notifyFd = -1;
+    gc->maxDelayUs = maxDelayUs < 0 ? 0 : maxDelayUs;
+    gc->maxBatch = maxBatch < 1 ? 1 : maxBatch;
+    if (!(gc->stats = calloc(1, sizeof *gc->stats))) { close(gc->fd); return -1; }
+    histInit(&gc->stats->latency);
+    histInit(&gc->stats->batch);
+    histInit(&gc->stats->syncTime);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); // Deadlines come from groupCommitClock
+    pthread_mutex_init(&gc->lock, NULL);
+    pthread_cond_init(&gc->wake, &attr);
+    pthread_cond_init(&gc->done, NULL);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&gc->thread, NULL, syncer, gc) != 0) {
+        pthread_mutex_destroy(&gc->lock);
+        pthread_cond_destroy(&gc->wake);
+        pthread_cond_destroy(&gc->done);
+        free(gc->stats);
+        gc->stats = NULL;
+        close(gc->fd);
+        return -1;
+    }
+    return 0;
+}
+
+int groupCommitStop(GroupCommit *gc) {
+    pthread_mutex_lock(&gc->lock);
+    gc->stopping = 1; // The syncer drains the queue before it leaves
+    pthread_cond_signal(&gc->wake);
+    pthread_mutex_unlock(&gc->lock);
+    pthread_join(gc->thread, NULL);
+    int rc = gc->durable == gc->requested ? 0 : -2;
+    pthread_mutex_destroy(&gc->lock);
+    pthread_cond_destroy(&gc->wake);
+    pthread_cond_destroy(&gc->done);
+    queueFree(&gc->queue);
+    queueFree(&gc->spare);
+    if (gc->fd >= 0) close(gc->fd);
+    free(gc->stats);
+    gc->stats = NULL;
+    return rc;
+}
+
+uint64_t groupCommitRequest(GroupCommit *gc, int commits, uint64_t since) {
+    pthread_mutex_lock(&gc->lock);
+    uint64_t ticket = gc->requested + 1;
+    if (queuePush(&gc->queue, ticket, since, commits) != 0) { pthread_mutex_unlock(&gc->lock); return 0; }
+    gc->requested = ticket;
+    int wasEmpty = gc->queued == 0;
+    gc->queued += commits;
+    if (wasEmpty || gc->queued >= gc->maxBatch || gc->maxDelayUs == 0) pthread_cond_signal(&gc->wake); // Start the clock, or sync now
+    pthread_mutex_unlock(&gc->lock);
+    return ticket;
+}
+
+int groupCommitWait(GroupCommit *gc, uint64_t ticket) {
+    pthread_mutex_lock(&gc->lock);
+    while (gc->durable < ticket && !gc->error) pthread_cond_wait(&gc->done, &gc->lock);
+    int rc = gc->durable >= ticket ? 0 : -2;
+    pthread_mutex_unlock(&gc->lock);
+    return rc;
+}
+
+uint64_t groupCommitLastTicket(GroupCommit *gc) {
+    pthread_mutex_lock(&gc->lock);
+    uint64_t t = gc->requested;
+    pthread_mutex_unlock(&gc->lock);
+    return t;
+}
+
+uint64_t groupCommitDurable(GroupCommit *gc) {
+    pthread_mutex_lock(&gc->lock);
+    uint64_t t = gc->durable;
+    pthread_mutex_unlock(&gc->lock);
+    return t;
+}
+
+void groupCommitLogSwapped(GroupCommit *gc, int fd) {
+    pthread_mutex_lock(&gc->lock);
+    if (gc->fd >= 0) close(gc->fd); // A sync still running has its own dup
+    gc->fd = dup(fd);
+    complete(gc, &gc->queue, gc->requested, groupCommitClock()); // Nothing left for the syncer to do for them
+    gc->queued = 0;
+    gc->error = 0;
+    markDurable(gc, gc->requested);
+    pthread_mutex_unlock(&gc->lock);
+}
+
+void groupCommitConfigure(GroupCommit *gc, long maxDelayUs, int maxBatch) {
+    pthread_mutex_lock(&gc->lock);
+    gc->maxDelayUs = maxDelayUs < 0 ? 0 : maxDelayUs;
+    gc->maxBatch = maxBatch < 1 ? 1 : maxBatch;
+    pthread_cond_signal(&gc->wake); // A shorter deadline may already have passed
+    pthread_mutex_unlock(&gc->lock);
+}
+
+void groupCommitNotify(GroupCommit *gc, int fd) {
+    pthread_mutex_lock(&gc->lock);
+    gc->notifyFd = fd;
+    pthread_mutex_unlock(&gc->lock);
+}
+
+void groupCommitStats(GroupCommit *gc, GroupCommitStats *out) {
+    pthread_mutex_lock(&gc->lock);
+    *out = *gc->stats;
+    pthread_mutex_unlock(&gc->lock);
+}
+
+void groupCommitReport(GroupCommit *gc, FILE *out) {
+    GroupCommitStats *st = malloc(sizeof *st); // Too big for comfort on the stack
+    if (!st) return;
+    groupCommitStats(gc, st);
+    fprintf(out, "Group commit: %ld commits in %ld syncs (%.1f per sync, %ld failed); commit latency p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms; fdatasync p50 %.3f ms\n",
+            st->commits, st->syncs, histMean(&st->batch), st->failures, histPercentile(&st->latency, 50.0) / 1e6,
+            histPercentile(&st->latency, 99.0) / 1e6, histPercentile(&st->latency, 99.9) / 1e6, st->latency.max / 1e6,
+            histPercentile(&st->syncTime, 50.0) / 1e6);
+    free(st);
+}
@@ -0,0 +1,93 @@
+#ifndef GROUPCOMMIT_H
+#define GROUPCOMMIT_H
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "histogram.h"
+
+/*
+Group commit for the write-ahead log. Callers hand their records to the OS
+(walFlush) and queue a commit; a syncer thread makes everything queued so
+far durable with one fdatasync once the oldest commit has waited
+'maxDelayUs' or 'maxBatch' commits are queued, whichever comes first.
+Commits queued while a sync is running share the next one. Each commit
+gets a ticket; a commit is durable once groupCommitDurable() reaches it
+*/
+#define GC_DEFAULT_DELAY_US 1000 // Longest a commit waits for company before its sync starts
+#define GC_DEFAULT_BATCH 128 // Queued commits that start a sync straight away
+
+typedef struct { // Pending commit requests: (ticket, queue time, commits) per request
+    uint64_t *ticket;
+    uint64_t *since;
+    int *commits;
+    int count, capacity;
+} GcQueue;
+
+typedef struct { // Figures for tuning delay against batch size
+    long commits; // Commits made durable
+    long syncs; // fdatasync calls
+    long failures; // Syncs that failed (commits stay pending until a later sync works)
+    Histogram latency; // Commit queued -> durable, nanoseconds, one value per commit
+    Histogram batch; // Commits covered by each sync
+    Histogram syncTime; // Time inside fdatasync, nanoseconds
+} GroupCommitStats;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock; // Guards everything below
+    pthread_cond_t wake; // Syncer: new commits or stop
+    pthread_cond_t done; // Waiters: 'durable' moved
+    int fd; // Our dup of the log being synced, so the caller's handle may be closed any time
+    int notifyFd; // Written one byte after every sync when >= 0 (e.g. a pipe an event loop watches)
+    long maxDelayUs;
+    int maxBatch;
+    uint64_t requested; // Last ticket handed out
+    uint64_t durable; // Every ticket up to this one is on stable storage
+    int queued; // Commits waiting in 'queue'
+    int stopping;
+    int error; // Last sync failed
+    GcQueue queue, spare; // Requests waiting, and the batch the syncer is working on
+    GroupCommitStats *stats; // Allocated (the histograms are large)
+} GroupCommit;
+
+/* Monotonic clock in nanoseconds, the time base of every commit */
+uint64_t groupCommitClock(void);
+
+/* Starts the syncer for the log open on 'fd' (duplicated, the caller keeps it). Returns 0 on success, -1 on failure */
+int groupCommitStart(GroupCommit *gc, int fd, long maxDelayUs, int maxBatch);
+
+/* Makes everything queued durable, stops the syncer and frees 'gc'. Returns 0 if the final sync worked */
+int groupCommitStop(GroupCommit *gc);
+
+/*
+Queues 'commits' commits (first one made at 'since') whose records are
+already in the file. Returns their ticket, 0 on failure
+*/
+uint64_t groupCommitRequest(GroupCommit *gc, int commits, uint64_t since);
+
+/* Blocks until 'ticket' is durable. Returns 0, or -2 if syncing failed */
+int groupCommitWait(GroupCommit *gc, uint64_t ticket);
+
+/* Last ticket handed out and last ticket made durable */
+uint64_t groupCommitLastTicket(GroupCommit *gc);
+uint64_t groupCommitDurable(GroupCommit *gc);
+
+/*
+The log was replaced by a file that is already synced and holds every
+queued commit (a checkpoint or a trim): completes them all and syncs 'fd' from now on
+*/
+void groupCommitLogSwapped(GroupCommit *gc, int fd);
+
+/* Changes the limits while running */
+void groupCommitConfigure(GroupCommit *gc, long maxDelayUs, int maxBatch);
+
+/* Writes a byte to 'fd' after every sync (-1 stops it) */
+void groupCommitNotify(GroupCommit *gc, int fd);
+
+/* Copies the figures so far */
+void groupCommitStats(GroupCommit *gc, GroupCommitStats *out);
+
+/* Prints a one-line summary of the figures: commits per sync and commit latency percentiles */
+void groupCommitReport(GroupCommit *gc, FILE *out);
+
+#endif // GROUPCOMMIT_H
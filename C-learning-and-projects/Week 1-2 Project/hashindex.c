@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hashindex.h"
+
+#define HASH_MIN_CAPACITY 16 // Smallest bucket array we ever allocate
+
+static size_t hashId(int id, size_t mask) { // Fibonacci hashing spreads sequential ids across the table
+    uint32_t h = (uint32_t)id * 2654435769u; // Multiply by 2^32 / golden ratio
+    h ^= h >> 16; // Fold the high bits down so the low bits (used by the mask) are mixed
+    return (size_t)h & mask; // Reduce to a bucket number
+}
+
+static size_t capacityFor(size_t expected) { // Smallest power of two that keeps the load factor under 1/2
+    size_t cap = HASH_MIN_CAPACITY;
+    while (cap < expected * 2) cap <<= 1; // Double until there is room
+    return cap;
+}
+
+int hashIndexInit(HashIndex *idx, size_t expected) {
+    idx->capacity = capacityFor(expected); // Pick the bucket count
+    idx->size = 0; // Index starts empty
+    idx->entries = calloc(idx->capacity, sizeof *idx->entries); // Zeroed buckets are empty (id 0)
+    if (!idx->entries) { idx->capacity = 0; return -1; } // Check if memory allocation was successful
+    return 0;
+}
+
+void hashIndexFree(HashIndex *idx) {
+    free(idx->entries); // Release the bucket array
+    idx->entries = NULL;
+    idx->capacity = 0;
+    idx->size = 0;
+}
+
+static void placeEntry(HashEntry *entries, size_t mask, int id, int slot) { // Insert without checks, used while rehashing
+    size_t i = hashId(id, mask); // Home bucket
+    while (entries[i].id != 0) i = (i + 1) & mask; // Linear probe to the first empty bucket
+    entries[i].id = id;
+    entries[i].slot = slot;
+}
+
+static int growIndex(HashIndex *idx) { // Doubles the bucket array and rehashes every entry
+    size_t newCap = idx->capacity ? idx->capacity * 2 : HASH_MIN_CAPACITY;
+    HashEntry *fresh = calloc(newCap, sizeof *fresh); // New zeroed bucket array
+    if (!fresh) return -1; // Check if memory allocation was successful
+    for (size_t i = 0; i < idx->capacity; ++i) { // Move every occupied bucket over
+        if (idx->entries[i].id != 0) placeEntry(fresh, newCap - 1, idx->entries[i].id, idx->entries[i].slot);
+    }
+    free(idx->entries); // Drop the old buckets
+    idx->entries = fresh;
+    idx->capacity = newCap;
+    return 0;
+}
+
+static long findBucket(const HashIndex *idx, int id) { // Returns the bucket holding 'id', or -1
+    if (idx->capacity == 0 || id <= 0) return -1; // Empty index or an id we never store
+    size_t mask = idx->capacity - 1;
+    size_t i = hashId(id, mask); // Start at the home bucket
+    while (idx->entries[i].id != 0) { // An empty bucket ends the probe sequence
+        if (idx->entries[i].id == id) return (long)i; // Found it
+        i = (i + 1) & mask; // Try the next bucket
+    }
+    return -1; // Not present
+}
+
+int hashIndexBuild(HashIndex *idx, const Item *array, int count, int *dupPtr) {
+    hashIndexFree(idx); // Throw away whatever was there before
+    if (hashIndexInit(idx, (size_t)count) != 0) return -1; // Size the table for the whole array up front
+    int dups = 0; // Number of repeated ids we skipped
+    for (int i = 0; i < count; ++i) {
+        if (array[i].id <= 0) continue; // Ids must be positive, skip anything else
+        if (hashIndexInsert(idx, array[i].id, i) == 1) dups++; // First occurrence wins
+    }
+    if (dupPtr) *dupPtr = dups; // Report duplicates to the caller
+    return 0;
+}
+
+int hashIndexFind(const HashIndex *idx, int id) {
+    long b = findBucket(idx, id); // Locate the bucket
+    return b < 0 ? -1 : idx->entries[b].slot; // Translate to an array slot
+}
+
+int hashIndexFindCounted(const HashIndex *idx, int id, int *probesPtr) { // Same walk as findBucket, counting as it goes
+    *probesPtr = 0;
+    if (idx->capacity == 0 || id <= 0) return -1;
+    size_t mask = idx->capacity - 1;
+    size_t i = hashId(id, mask);
+    for (;;) {
+        ++*probesPtr; // Every bucket looked at, the empty one that ends a miss included
+        if (idx->entries[i].id == 0) return -1;
+        if (idx->entries[i].id == id) return idx->entries[i].slot;
+        i = (i + 1) & mask;
+    }
+}
+
+int hashIndexInsert(HashIndex *idx, int id, int slot) {
+    if (id <= 0) return 1; // 0 marks an empty bucket, so it can never be a key
+    if (findBucket(idx, id) >= 0) return 1; // Reject duplicate ids
+    if ((idx->size + 1) * 2 > idx->capacity) { // Keep the load factor at or below 1/2
+        if (growIndex(idx) != 0) return -1; // Handle memory allocation failure
+    }
+    placeEntry(idx->entries, idx->capacity - 1, id, slot); // Store the new id
+    idx->size++;
+    return 0;
+}
+
+int hashIndexSetSlot(HashIndex *idx, int id, int slot) {
+    long b = findBucket(idx, id); // Locate the bucket
+    if (b < 0) return 1; // Id is not indexed
+    idx->entries[b].slot = slot; // Point it at the new slot
+    return 0;
+}
+
+int hashIndexRemove(HashIndex *idx, int id) {
+    long b = findBucket(idx, id); // Locate the bucket to empty
+    if (b < 0) return 1; // Id is not indexed
+    size_t mask = idx->capacity - 1;
+    size_t hole = (size_t)b; // Bucket that is now free
+    size_t i = (hole + 1) & mask;
+    while (idx->entries[i].id != 0) { // Backward-shift deletion: no tombstones needed with linear probing
+        size_t home = hashId(idx->entries[i].id, mask); // Where this entry would like to live
+        if (((i - home) & mask) >= ((i - hole) & mask)) { // The hole lies between its home and its bucket
+            idx->entries[hole] = idx->entries[i]; // Move it back into the hole
+            hole = i; // Its old bucket becomes the new hole
+        }
+        i = (i + 1) & mask;
+    }
+    idx->entries[hole].id = 0; // Mark the final hole empty
+    idx->entries[hole].slot = 0;
+    idx->size--;
+    return 0;
+}
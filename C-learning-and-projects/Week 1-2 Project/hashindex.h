@@ -0,0 +1,52 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+#include <stdlib.h>
+#include "item.h"
+
+typedef struct { // One bucket of the index: an item id and the slot it lives at in the items array
+    int id; // Item id stored in this bucket, 0 means the bucket is empty
+    int slot; // Index of the item in the items array
+} HashEntry;
+
+typedef struct { // Open-addressing (linear probing) hash index keyed on Item.id
+    HashEntry *entries; // Bucket array, capacity is always a power of two
+    size_t capacity; // Number of buckets
+    size_t size; // Number of ids currently stored
+} HashIndex;
+
+/*
+Prepares an empty index sized for roughly 'expected' ids.
+Returns 0 on success, -1 if memory allocation failed
+*/
+int hashIndexInit(HashIndex *idx, size_t expected);
+
+/* Releases the bucket array and resets the index to empty */
+void hashIndexFree(HashIndex *idx);
+
+/*
+Rebuilds the index from 'count' items in 'array' (call once after loadItems).
+Items with an id <= 0 are skipped. If an id appears more than once the first
+slot wins and the number of skipped duplicates is written to *dupPtr (may be NULL).
+Returns 0 on success, -1 if memory allocation failed
+*/
+int hashIndexBuild(HashIndex *idx, const Item *array, int count, int *dupPtr);
+
+/* Returns the slot of item 'id', or -1 if the id is not in the index */
+int hashIndexFind(const HashIndex *idx, int id);
+
+/* hashIndexFind that also writes how many buckets it examined to *probesPtr (for the lookup metrics) */
+int hashIndexFindCounted(const HashIndex *idx, int id, int *probesPtr);
+
+/*
+Adds 'id' -> 'slot'. Returns 0 on success, 1 if the id is already present
+(nothing is changed), -1 if memory allocation failed
+*/
+int hashIndexInsert(HashIndex *idx, int id, int slot);
+
+/* Points an existing 'id' at a new 'slot'. Returns 0 on success, 1 if the id is not present */
+int hashIndexSetSlot(HashIndex *idx, int id, int slot);
+
+/* Removes 'id' from the index. Returns 0 on success, 1 if the id is not present */
+int hashIndexRemove(HashIndex *idx, int id);
+
+#endif // HASHINDEX_H
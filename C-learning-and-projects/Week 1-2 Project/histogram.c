@@ -0,0 +1,70 @@
+#include <string.h>
+#include "histogram.h"
+
+static int bucketOf(uint64_t v) { // 0..127 exact, then 64 buckets per power of two
+    if (v < 2 * HIST_SUB_BUCKETS) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - 6; // Keep the top 7 bits (64..127)
+    return shift * HIST_SUB_BUCKETS + (int)(v >> shift);
+}
+
+static uint64_t bucketTop(int b) { // Largest value that lands in bucket 'b'
+    if (b < 2 * HIST_SUB_BUCKETS) return (uint64_t)b;
+    int shift = b / HIST_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(b % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+void histInit(Histogram *h) {
+    memset(h, 0, sizeof *h);
+    h->min = UINT64_MAX;
+}
+
+void histRecordN(Histogram *h, uint64_t value, uint64_t count) {
+    if (count == 0) return;
+    h->counts[bucketOf(value)] += count;
+    h->total += count;
+    h->sum += (double)value * (double)count;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void histRecord(Histogram *h, uint64_t value) {
+    histRecordN(h, value, 1);
+}
+
+void histMerge(Histogram *into, const Histogram *from) {
+    if (from->total == 0) return;
+    for (int b = 0; b < HIST_BUCKETS; ++b) into->counts[b] += from->counts[b];
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+}
+
+uint64_t histPercentile(const Histogram *h, double p) {
+    if (h->total == 0) return 0;
+    if (p <= 0.0) return h->min;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)h->total + 0.5); // Values at or below the answer
+    if (rank < 1) rank = 1;
+    if (rank > h->total) rank = h->total;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            uint64_t top = bucketTop(b);
+            return top > h->max ? h->max : top;
+        }
+    }
+    return h->max;
+}
+
+double histMean(const Histogram *h) {
+    return h->total ? h->sum / (double)h->total : 0.0;
+}
+
+void histWriteJson(const Histogram *h, FILE *out) {
+    fprintf(out, "{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+            (unsigned long long)h->total, histMean(h), (unsigned long long)histPercentile(h, 50.0),
+            (unsigned long long)histPercentile(h, 90.0), (unsigned long long)histPercentile(h, 99.0),
+            (unsigned long long)histPercentile(h, 99.9), (unsigned long long)h->max);
+}
@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inventory.h"
+#include "shardio.h"
+#include "metrics.h"
+
+static int reserveUndo(Inventory *inv, int n) { // Room to remember 'n' more mutations of the open transaction
+    InvTxn *t = &inv->txn;
+    if (!t->active || t->count + n <= t->capacity) return 0;
+    int newCap = t->capacity ? t->capacity : INV_MIN_CAPACITY;
+    while (newCap < t->count + n) newCap *= 2;
+    TxnUndo *tmp = realloc(t->undo, (size_t)newCap * sizeof *tmp);
+    if (!tmp) return -1;
+    t->undo = tmp;
+    t->capacity = newCap;
+    return 0;
+}
+
+static void noteUndo(Inventory *inv, int op, const Item *before) { // Room was reserved
+    if (!inv->txn.active) return;
+    TxnUndo *u = &inv->txn.undo[inv->txn.count++];
+    u->op = op;
+    u->before = *before;
+}
+
+static uint64_t queueCommits(Inventory *inv) { // Hands commits already in the file to the syncer, returns their ticket (0: none)
+    if (!inv->group || inv->unsynced == 0 || inv->txn.active) return 0;
+    uint64_t ticket = groupCommitRequest(inv->group, inv->unsynced, inv->unsyncedSince);
+    inv->unsynced = 0;
+    return ticket;
+}
+
+static void logged(Inventory *inv) { // One more commit in the log (a transaction counts once, at COMMIT)
+    if (!inv->group || inv->txn.active) return;
+    if (inv->unsynced++ == 0) inv->unsyncedSince = groupCommitClock();
+    if (!inv->wal.deferFlush) queueCommits(inv); // walAppend already handed it to the OS
+}
+
+static void followLog(Inventory *inv) { // A checkpoint or trim replaced the (synced) log: tell the syncer
+    if (!inv->group || !inv->wal.fp || inv->wal.generation == inv->groupGeneration) return;
+    queueCommits(inv); // Deferred records went into the new files too
+    groupCommitLogSwapped(inv->group, fileno(inv->wal.fp));
+    inv->groupGeneration = inv->wal.generation;
+}
+
+int inventoryInit(Inventory *inv) {
+    memset(inv, 0, sizeof *inv); // No items, no mapping, no log
+    return hashIndexInit(&inv->index, 0);
+}
+
+int inventoryOpen(Inventory *inv, const char *filename, int flags) {
+    memset(inv, 0, sizeof *inv);
+    if (shardFileDetect(filename)) return -8; // One log here would bypass the shards' own, and compaction would overwrite the manifest
+    int result = (flags & INV_OPEN_MMAP) ? loadItemsMapped(filename, &inv->items, &inv->count, &inv->mapping) // Map the file, pages load lazily
+                                        : loadItems(filename, &inv->items, &inv->count); // Load items from file into a heap array
+    if (result < 0) return result; // Nothing to clean up, the loaders free on failure
+    if (result == 1) inv->count = 0; // No file yet, start empty
+    if ((flags & INV_OPEN_VERIFY) && verifyMappedItems(&inv->mapping) != 0) { // Full checksum pass over a mapped file
+        releaseItems(inv->items, &inv->mapping);
+        return -7;
+    }
+    inv->capacity = inv->mapping.base ? 0 : inv->count; // A mapping has no spare room
+    inv->live = inv->count;
+    if (hashIndexBuild(&inv->index, inv->items, inv->count, &inv->duplicates) != 0) { // Build the index once after loading
+        releaseItems(inv->items, &inv->mapping);
+        return -1;
+    }
+    if (walOpen(&inv->wal, filename) != 0) { // From now on mutations are appended to the log
+        releaseItems(inv->items, &inv->mapping);
+        hashIndexFree(&inv->index);
+        return -2;
+    }
+    inv->logging = 1;
+    return result;
+}
+
+int inventoryClose(Inventory *inv) {
+    if (inv->txn.active) inventoryRollback(inv); // Uncommitted work goes, as it would in a crash
+    free(inv->txn.undo);
+    if (snapshotRunning(&inv->snap)) snapshotPoll(&inv->snap, &inv->wal, 1); // Let the child finish and trim the log
+    int rc = 0;
+    if (inv->group) { // Last sync covers everything logged
+        followLog(inv);
+        if (inventoryFlushLog(inv) != 0) rc = -2;
+        if (groupCommitStop(inv->group) != 0) rc = -2;
+        free(inv->group);
+    }
+    if (inv->logging && walClose(&inv->wal) != 0) rc = -2; // Everything is already in the log
+    releaseItems(inv->items, &inv->mapping); // Free (or unmap) the items array
+    hashIndexFree(&inv->index);
+    if (inv->sec) { secIndexFree(inv->sec); free(inv->sec); }
+    if (inv->names) { nameIndexFree(inv->names); free(inv->names); }
+    if (inv->cols) { columnsFree(inv->cols); free(inv->cols); }
+    if (inv->shm) { shmStoreClose(inv->shm); free(inv->shm); }
+    memset(inv, 0, sizeof *inv);
+    return rc;
+}
+
+static int lookup(const Inventory *inv, int id) { // inventoryFind / inventoryGet: a counted, sometimes timed, index lookup
+    uint64_t start = metricsStart(MET_GET);
+    if (!start) return hashIndexFind(&inv->index, id);
+    int probes;
+    int slot = hashIndexFindCounted(&inv->index, id, &probes); // Only timed lookups pay for counting the probes
+    metricsEndLookup(MET_GET, start, probes);
+    return slot;
+}
+
+int inventoryFind(const Inventory *inv, int id) {
+    return lookup(inv, id);
+}
+
+const Item *inventoryGet(const Inventory *inv, int id) {
+    int slot = lookup(inv, id);
+    return slot < 0 ? NULL : &inv->items[slot];
+}
+
+int inventoryReserve(Inventory *inv, int n) {
+    if (inv->mapping.base) { // A mapping cannot grow, move it to the heap first
+        if (promoteMappedItems(&inv->mapping, &inv->items, inv->count) != 0) return -1;
+        inv->capacity = inv->count;
+    }
+    if (inv->cols && columnsReserve(inv->cols, n) != 0) return -1; // Columns grow alongside the rows
+    if (inv->shm && shmStoreReserve(inv->shm, n) != 0) return -1;
+    if (n <= inv->capacity) return 0;
+    int newCap = inv->capacity ? inv->capacity : INV_MIN_CAPACITY;
+    while (newCap < n) newCap = newCap > 0x3FFFFFFF ? n : newCap * 2; // Geometric growth: amortised O(1) per add
+    Item *tmp = realloc(inv->items, (size_t)newCap * sizeof *tmp);
+    if (!tmp) return -1; // Handle memory allocation failure
+    inv->items = tmp;
+    inv->capacity = newCap;
+    return 0;
+}
+
+static int prepareItem(Inventory *inv, const Item *item) { // Everything an add can fail on, done before it is logged
+    if (inventoryReserve(inv, inv->count + 1) != 0) return -1; // Rows, columns and the shared mirror
+    if (hashIndexInsert(&inv->index, item->id, inv->count) != 0) return -1; // Index the new slot first
+    if (inv->sec && secIndexAdd(inv->sec, inv->count, item) != 0) { hashIndexRemove(&inv->index, item->id); return -1; }
+    if (inv->names && nameIndexAdd(inv->names, inv->count, item->name) != 0) {
+        if (inv->sec) secIndexRemove(inv->sec, inv->count, item);
+        hashIndexRemove(&inv->index, item->id);
+        return -1;
+    }
+    return 0;
+}
+static void unprepareItem(Inventory *inv, const Item *item) { // The log write failed: the next slot stays empty
+    if (inv->names) nameIndexRemove(inv->names, inv->count, item->name);
+    if (inv->sec) secIndexRemove(inv->sec, inv->count, item);
+    hashIndexRemove(&inv->index, item->id);
+}
+static void placeItem(Inventory *inv, const Item *item) { // Fills the prepared slot, cannot fail
+    if (inv->cols) columnsSet(inv->cols, inv->count, item); // Room was reserved with the rows
+    if (inv->shm) shmStorePut(inv->shm, inv->count, item);
+    inv->items[inv->count++] = *item;
+    inv->live++;
+}
+static int logAndPlaceItem(Inventory *inv, const Item *item) { // Log before applying, with nothing left to fail once it is logged
+    if (prepareItem(inv, item) != 0) return -1;
+    if (inv->logging && walAppendAdd(&inv->wal, item) != 0) { unprepareItem(inv, item); return -2; }
+    placeItem(inv, item);
+    return 0;
+}
+static int appendItem(Inventory *inv, const Item *item) { // Puts a validated item in the next slot (not logged)
+    if (prepareItem(inv, item) != 0) return -1;
+    placeItem(inv, item);
+    return 0;
+}
+
+static void markDeleted(Inventory *inv, int slot) { // Turns a live slot into a tombstone
+    hashIndexRemove(&inv->index, inv->items[slot].id);
+    if (inv->sec) secIndexRemove(inv->sec, slot, &inv->items[slot]); // Needs the price and category, so before the id is cleared
+    if (inv->names) nameIndexRemove(inv->names, slot, inv->items[slot].name);
+    if (inv->cols) columnsKill(inv->cols, slot);
+    if (inv->shm) shmStoreKill(inv->shm, slot);
+    inv->items[slot].id = INV_TOMBSTONE;
+    inv->live--;
+    inv->tombstones++;
+}
+
+static int maybeCompact(Inventory *inv) { // Runs compaction once tombstones pile up
+    if (inv->tombstones < INV_COMPACT_MIN || inv->tombstones * INV_COMPACT_RATIO < inv->count) return 0;
+    return inventoryCompact(inv);
+}
+
+static int maybeCheckpoint(Inventory *inv) { // Folds the log into a snapshot once it is large
+    if (!inv->logging || inv->txn.active || !walNeedsCompaction(&inv->wal)) return 0; // Never snapshot half a transaction
+    if (inv->background) { // Fork a writer, or check on the one already running
+        if (snapshotRunning(&inv->snap)) {
+            int rc = snapshotPoll(&inv->snap, &inv->wal, 0);
+            followLog(inv);
+            return rc == -2 ? -1 : 0;
+        }
+        return snapshotStart(&inv->snap, &inv->wal, inv->items, inv->count) < 0 ? -1 : 0;
+    }
+    return inventoryCheckpoint(inv);
+}
+
+static int logWritable(Inventory *inv) { // After a lost ABORT the log ends in an open BEGIN: nothing may follow it until a checkpoint
+    if (!inv->logBroken || !inv->logging) return 0;
+    return inventoryCheckpoint(inv) == 0 ? 0 : -2; // Clears logBroken once it succeeds
+}
+
+static int addItem(Inventory *inv, const Item *item) {
+    if (item->id <= 0 || hashIndexFind(&inv->index, item->id) >= 0) return 1; // Reject invalid and duplicate ids
+    if (logWritable(inv) != 0) return -2;
+    if (reserveUndo(inv, 1) != 0) return -1;
+    int rc = logAndPlaceItem(inv, item);
+    if (rc != 0) return rc;
+    noteUndo(inv, WAL_OP_ADD, item);
+    logged(inv);
+    return maybeCheckpoint(inv) == 0 ? 0 : -3;
+}
+
+static int setQuantity(Inventory *inv, int id, int quantity) {
+    int slot = hashIndexFind(&inv->index, id);
+    if (slot < 0) return 1; // No such item
+    if (logWritable(inv) != 0) return -2;
+    if (reserveUndo(inv, 1) != 0) return -1;
+    if (inv->logging && walAppendQty(&inv->wal, id, quantity) != 0) return -2;
+    noteUndo(inv, WAL_OP_QTY, &inv->items[slot]);
+    inv->items[slot].quantity = quantity; // In place, even on a (copy-on-write) mapping
+    if (inv->cols) inv->cols->quantity[slot] = quantity;
+    if (inv->shm) shmStorePut(inv->shm, slot, &inv->items[slot]);
+    logged(inv);
+    return maybeCheckpoint(inv) == 0 ? 0 : -3;
+}
+
+static int deleteItem(Inventory *inv, int id) {
+    int slot = hashIndexFind(&inv->index, id);
+    if (slot < 0) return 1; // No such item
+    if (logWritable(inv) != 0) return -2;
+    if (reserveUndo(inv, 1) != 0) return -1;
+    if (inv->logging && walAppendDelete(&inv->wal, id) != 0) return -2;
+    noteUndo(inv, WAL_OP_DEL, &inv->items[slot]);
+    markDeleted(inv, slot); // O(1): no memmove, no realloc
+    logged(inv);
+    if (maybeCompact(inv) != 0) return -1;
+    return maybeCheckpoint(inv) == 0 ? 0 : -3;
+}
+
+int inventoryAdd(Inventory *inv, const Item *item) {
+    uint64_t start = metricsStart(MET_ADD);
+    int rc = addItem(inv, item);
+    metricsEnd(MET_ADD, start);
+    return rc;
+}
+
+int inventorySetQuantity(Inventory *inv, int id, int quantity) {
+    uint64_t start = metricsStart(MET_UPDATE);
+    int rc = setQuantity(inv, id, quantity);
+    metricsEnd(MET_UPDATE, start);
+    return rc;
+}
+
+int inventoryDelete(Inventory *inv, int id) {
+    uint64_t start = metricsStart(MET_DELETE);
+    int rc = deleteItem(inv, id);
+    metricsEnd(MET_DELETE, start);
+    return rc;
+}
+
+int inventoryAddBatch(Inventory *inv, const Item *items, int n, int *addedPtr) {
+    int added = 0, rc = 0;
+    if (logWritable(inv) != 0) return -2;
+    if (inventoryReserve(inv, inv->count + n) != 0 || reserveUndo(inv, n) != 0) return -1; // One allocation for the whole batch
+    int deferred = inv->wal.deferFlush; // Caller may already be deferring (batch mode)
+    if (inv->logging) inv->wal.deferFlush = 1; // Let stdio coalesce the records
+    for (int i = 0; i < n; ++i) {
+        if (items[i].id <= 0 || hashIndexFind(&inv->index, items[i].id) >= 0) continue; // Skip invalid and duplicate ids
+        if ((rc = logAndPlaceItem(inv, &items[i])) != 0) break;
+        noteUndo(inv, WAL_OP_ADD, &items[i]);
+        logged(inv);
+        added++;
+    }
+    if (inv->logging) {
+        inv->wal.deferFlush = deferred;
+        if (!deferred && inventoryFlushLog(inv) != 0 && rc == 0) rc = -2; // One flush (and one sync request) for the batch
+    }
+    if (addedPtr) *addedPtr = added;
+    if (rc == 0 && maybeCheckpoint(inv) != 0) rc = -3;
+    return rc;
+}
+
+int inventoryDeleteBatch(Inventory *inv, const int *ids, int n, int *deletedPtr) {
+    int deleted = 0, rc = 0;
+    if (logWritable(inv) != 0) return -2;
+    if (reserveUndo(inv, n) != 0) return -1;
+    int deferred = inv->wal.deferFlush;
+    if (inv->logging) inv->wal.deferFlush = 1;
+    for (int i = 0; i < n; ++i) {
+        int slot = hashIndexFind(&inv->index, ids[i]);
+        if (slot < 0) continue; // Missing ids are skipped
+        if (inv->logging && walAppendDelete(&inv->wal, ids[i]) != 0) { rc = -2; break; }
+        noteUndo(inv, WAL_OP_DEL, &inv->items[slot]);
+        markDeleted(inv, slot);
+        logged(inv);
+        deleted++;
+    }
+    if (inv->logging) {
+        inv->wal.deferFlush = deferred;
+        if (!deferred && inventoryFlushLog(inv) != 0 && rc == 0) rc = -2;
+    }
+    if (deletedPtr) *deletedPtr = deleted;
+    if (rc == 0 && maybeCompact(inv) != 0) rc = -1; // Compact once for the whole batch
+    if (rc == 0 && maybeCheckpoint(inv) != 0) rc = -3;
+    return rc;
+}
+
+int inventoryCompact(Inventory *inv) {
+    if (inv->tombstones == 0) return 0;
+    int *newSlot = NULL; // old slot -> new slot (-1 for tombstones), only needed by the secondary and name indexes
+    if ((inv->sec || inv->names) && !(newSlot = malloc((size_t)inv->count * sizeof *newSlot))) return -1;
+    int w = 0;
+    for (int r = 0; r < inv->count; ++r) { // Stable squeeze, listing order is kept
+        if (inv->items[r].id == INV_TOMBSTONE) {
+            if (newSlot) newSlot[r] = -1;
+            continue;
+        }
+        if (newSlot) newSlot[r] = w;
+        if (w != r) {
+            inv->items[w] = inv->items[r];
+            if (inv->cols) columnsMove(inv->cols, w, r);
+            if (hashIndexFind(&inv->index, inv->items[w].id) == r) hashIndexSetSlot(&inv->index, inv->items[w].id, w); // Re-point (skips unindexed duplicates)
+        }
+        w++;
+    }
+    inv->count = w;
+    if (inv->cols) inv->cols->count = w;
+    if (inv->shm) shmStorePublish(inv->shm, inv->items, w); // Readers see the old layout or the new one, never a mix
+    inv->tombstones = 0;
+    if (newSlot) {
+        int rc = inv->sec ? secIndexRemap(inv->sec, newSlot) : 0; // Order is unchanged, only slot numbers move
+        if (inv->names && nameIndexRemap(inv->names, newSlot) != 0) rc = -1;
+        free(newSlot);
+        if (rc != 0) return -1;
+    }
+    if (!inv->mapping.base && inv->capacity > INV_MIN_CAPACITY && inv->count < inv->capacity / 4) { // Give memory back after mass deletes
+        int newCap = inv->capacity / 2;
+        Item *tmp = realloc(inv->items, (size_t)newCap * sizeof *tmp);
+        if (tmp) { inv->items = tmp; inv->capacity = newCap; } // Keeping the larger block is fine too
+    }
+    return 0;
+}
+
+int inventoryCheckpoint(Inventory *inv) {
+    if (!inv->logging) return 0;
+    if (inv->txn.active) return 1; // The snapshot would hold uncommitted changes
+    if (snapshotRunning(&inv->snap)) snapshotPoll(&inv->snap, &inv->wal, 1); // Never race the child's rename
+    if (inventoryCompact(inv) != 0) return -1; // Snapshots never contain tombstones
+    int rc = walCompact(&inv->wal, inv->items, inv->count);
+    followLog(inv); // The synced snapshot now holds every commit
+    if (rc == 0) inv->logBroken = 0; // A fresh log: no BEGIN left open
+    return rc;
+}
+
+int inventoryEnableSecondary(Inventory *inv, int threads) {
+    if (!inv->sec && !(inv->sec = calloc(1, sizeof *inv->sec))) return -1;
+    if (secIndexBuild(inv->sec, inv->items, inv->count, threads) != 0) { // Parallel rebuild from the current slots
+        free(inv->sec);
+        inv->sec = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int inventoryFindByPrice(const Inventory *inv, int category, float lo, float hi, int *out, int maxOut) {
+    if (!inv->sec) return -1;
+    return secIndexQuery(inv->sec, category, lo, hi, out, maxOut);
+}
+
+int inventoryEnableNameIndex(Inventory *inv, int threads) {
+    if (!inv->names && !(inv->names = calloc(1, sizeof *inv->names))) return -1;
+    if (nameIndexBuild(inv->names, inv->items, inv->count, threads) != 0) { // Parallel rebuild from the current slots
+        free(inv->names);
+        inv->names = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+long inventoryFindByNamePrefix(const Inventory *inv, const char *prefix, int *out, int maxOut) {
+    if (!inv->names) return -1;
+    return nameIndexPrefix(inv->names, prefix, out, maxOut);
+}
+
+long inventoryFindByNameText(const Inventory *inv, const char *text, int *out, int maxOut) {
+    if (!inv->names) return -1;
+    return nameIndexSearch(inv->names, text, out, maxOut);
+}
+
+int inventoryEnableColumns(Inventory *inv) {
+    if (!inv->cols && !(inv->cols = calloc(1, sizeof *inv->cols))) return -1;
+    if (columnsBuild(inv->cols, inv->items, inv->count) != 0) { // Transpose the current slots
+        columnsFree(inv->cols);
+        free(inv->cols);
+        inv->cols = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int inventoryEnableShared(Inventory *inv, const char *name) {
+    if (inv->shm) return 0; // Already published
+    if (!(inv->shm = malloc(sizeof *inv->shm))) return -1;
+    if (shmStoreCreate(inv->shm, name, inv->items, inv->count) != 0) {
+        free(inv->shm);
+        inv->shm = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void inventorySummarize(const Inventory *inv, int category, ColumnSummary *out) {
+    if (inv->cols) columnsSummarize(inv->cols, category, out);
+    else rowsSummarize(inv->items, inv->count, category, out);
+}
+
+void inventoryValueByCategory(const Inventory *inv, double out[COL_CATEGORIES]) {
+    if (inv->cols) columnsValueByCategory(inv->cols, out);
+    else rowsValueByCategory(inv->items, inv->count, out);
+}
+
+int inventoryQuery(const Inventory *inv, const Query *q, QueryRowFn onRow, void *ctx, QueryResult *res) {
+    return queryRun(q, inv->items, inv->count, inv->cols, onRow, ctx, res); // Name tests always read the rows
+}
+
+int inventoryTopK(const Inventory *inv, TopKField field, int category, int largest, int k, int threads, TopKEntry *out) {
+    return topK(inv->items, inv->count, inv->cols, field, category, largest, k, threads, out);
+}
+
+void inventoryDeferLog(Inventory *inv, int on) {
+    inv->wal.deferFlush = on;
+}
+
+int inventoryFlushLog(Inventory *inv) {
+    if (!inv->logging) return 0;
+    if (walFlush(&inv->wal) != 0) return -2;
+    queueCommits(inv); // Everything flushed is now a sync candidate
+    return 0;
+}
+
+void inventoryBackgroundSnapshots(Inventory *inv, int on) {
+    inv->background = on;
+}
+
+int inventorySnapshotNow(Inventory *inv) {
+    if (!inv->logging || inv->txn.active) return 1; // Nothing on disk to refresh, or half a transaction in memory
+    return snapshotStart(&inv->snap, &inv->wal, inv->items, inv->count);
+}
+
+int inventoryPollSnapshot(Inventory *inv) {
+    int rc = snapshotPoll(&inv->snap, &inv->wal, 0);
+    followLog(inv); // A finished snapshot trims the log
+    return rc;
+}
+
+void inventoryBeginBulk(Inventory *inv) {
+    inv->bulkLogging = inv->logging; // Remember whether to checkpoint at the end
+    inv->logging = 0;
+}
+
+int inventoryEndBulk(Inventory *inv) {
+    inv->logging = inv->bulkLogging;
+    inv->bulkLogging = 0;
+    if (inv->logging && inv->wal.tap) inv->wal.tap(inv->wal.tapCtx, WAL_TAP_UNLOGGED, NULL, 0); // Its observer never saw the bulk load
+    return inventoryCheckpoint(inv); // One snapshot holds the whole bulk load
+}
+
+int inventoryAbortBulk(Inventory *inv, int added) {
+    for (int slot = inv->count - 1; slot >= 0 && added > 0; --slot) { // Adds go at the end, and compaction keeps their order
+        if (inventorySlotLive(inv, slot)) { markDeleted(inv, slot); added--; }
+    }
+    inv->logging = inv->bulkLogging; // The log and the last snapshot already describe what is left
+    inv->bulkLogging = 0;
+    return maybeCompact(inv);
+}
+
+int inventoryEnableGroupCommit(Inventory *inv, long maxDelayUs, int maxBatch) {
+    if (!inv->logging || !inv->wal.fp) return 1; // Nothing to sync
+    if (inv->group) { groupCommitConfigure(inv->group, maxDelayUs, maxBatch); return 0; }
+    if (inventoryFlushLog(inv) != 0) return -1;
+    if (!(inv->group = malloc(sizeof *inv->group))) return -1;
+    if (groupCommitStart(inv->group, fileno(inv->wal.fp), maxDelayUs, maxBatch) != 0) {
+        free(inv->group);
+        inv->group = NULL;
+        return -1;
+    }
+    inv->groupGeneration = inv->wal.generation;
+    return 0;
+}
+
+int inventoryWaitDurable(Inventory *inv) {
+    if (inventoryFlushLog(inv) != 0) return -2;
+    if (!inv->group) return inv->logging ? walSync(&inv->wal) : 0; // No syncer: do it here
+    return groupCommitWait(inv->group, groupCommitLastTicket(inv->group));
+}
+
+int inventoryBegin(Inventory *inv) {
+    if (inv->txn.active) return 1;
+    if (logWritable(inv) != 0) return -2;
+    inv->txn.savedDefer = inv->wal.deferFlush;
+    if (inv->logging) {
+        inv->wal.deferFlush = 1; // The whole transaction goes out in one write at COMMIT
+        if (walAppendMarker(&inv->wal, WAL_OP_BEGIN) != 0) { inv->wal.deferFlush = inv->txn.savedDefer; return -2; }
+    }
+    inv->txn.active = 1;
+    inv->txn.count = 0;
+    return 0;
+}
+
+int inventoryCommit(Inventory *inv) {
+    if (!inv->txn.active) return 1;
+    if (inv->logging && walAppendMarker(&inv->wal, WAL_OP_COMMIT) != 0) return -2; // Still open: the caller may roll back
+    inv->txn.active = 0;
+    inv->txn.count = 0;
+    inv->wal.deferFlush = inv->txn.savedDefer;
+    int rc = 0;
+    if (inv->logging) {
+        logged(inv); // The transaction is one commit; queued here unless the log is deferred
+        if (!inv->wal.deferFlush) rc = inventoryWaitDurable(inv);
+    }
+    if (rc == 0 && maybeCompact(inv) != 0) rc = -1;
+    if (rc == 0 && maybeCheckpoint(inv) != 0) rc = -3; // Skipped while it was open
+    return rc;
+}
+
+int inventoryRollback(Inventory *inv) {
+    if (!inv->txn.active) return 1;
+    int rc = 0;
+    int lost = inv->logging && walAppendMarker(&inv->wal, WAL_OP_ABORT) != 0; // Replay skips the transaction either way: it has no COMMIT
+    inv->txn.active = 0; // Undo below is not itself recorded
+    inv->wal.deferFlush = inv->txn.savedDefer;
+    if (inv->logging && !inv->wal.deferFlush && walFlush(&inv->wal) != 0) lost = 1;
+    for (int i = inv->txn.count - 1; i >= 0; --i) { // Newest first
+        const TxnUndo *u = &inv->txn.undo[i];
+        int slot = hashIndexFind(&inv->index, u->before.id);
+        if (u->op == WAL_OP_ADD) {
+            if (slot >= 0) markDeleted(inv, slot);
+        } else if (u->op == WAL_OP_QTY) {
+            if (slot < 0) continue;
+            inv->items[slot].quantity = u->before.quantity;
+            if (inv->cols) inv->cols->quantity[slot] = u->before.quantity;
+            if (inv->shm) shmStorePut(inv->shm, slot, &inv->items[slot]);
+        } else if (slot < 0 && appendItem(inv, &u->before) != 0) { // Deleted: bring it back (in a new slot)
+            rc = -1;
+        }
+    }
+    inv->txn.count = 0;
+    if (maybeCompact(inv) != 0 && rc == 0) rc = -1;
+    if (lost) { // Replay would stage every later record inside the open transaction and drop it
+        inv->logBroken = 1;
+        if (inventoryCheckpoint(inv) != 0 && rc == 0) rc = -2; // A snapshot of the rolled-back items replaces the log
+    }
+    return rc;
+}
+
+int inventorySaveAs(Inventory *inv, const char *filename) {
+    if (inventoryCompact(inv) != 0) return -3;
+    return saveItems(filename, inv->items, inv->count);
+}
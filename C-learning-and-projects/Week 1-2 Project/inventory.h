@@ -0,0 +1,280 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+#include <stdlib.h>
+#include "item.h"
+#include "fileio.h"
+#include "hashindex.h"
+#include "secindex.h"
+#include "nameindex.h"
+#include "shmstore.h"
+#include "columns.h"
+#include "snapshot.h"
+#include "groupcommit.h"
+#include "query.h"
+#include "topk.h"
+
+#define INV_TOMBSTONE 0 // Id written into a deleted slot (real ids are always positive)
+#define INV_MIN_CAPACITY 16 // First allocation when growing from empty
+#define INV_COMPACT_MIN 64 // Never compact for fewer tombstones than this
+#define INV_COMPACT_RATIO 4 // Compact once tombstones exceed 1/4 of the used slots
+
+#define INV_OPEN_MMAP 1 // inventoryOpen flag: map the file instead of copying it (see loadItemsMapped)
+#define INV_OPEN_VERIFY 2 // inventoryOpen flag: check block checksums of a mapped file up front
+
+typedef struct { // How to undo one mutation of an open transaction
+    int op; // WAL_OP_ADD, WAL_OP_QTY or WAL_OP_DEL: what was done
+    Item before; // The item before it (for ADD only the id matters)
+} TxnUndo;
+
+typedef struct { // State of an open transaction
+    int active;
+    int savedDefer; // Caller's deferFlush, restored when the transaction ends
+    TxnUndo *undo; // Mutations so far, undone newest first on rollback
+    int count, capacity;
+} InvTxn;
+
+typedef struct { // Growable item array with an id index, tombstone deletes and optional write-ahead logging
+    Item *items; // Slot array; deleted slots have id INV_TOMBSTONE until compaction
+    int count; // Slots in use, live items plus tombstones
+    int capacity; // Slots allocated (0 while the array is still a file mapping)
+    int live; // Items that have not been deleted
+    int tombstones; // Deleted slots waiting for compaction
+    int duplicates; // Repeated ids found on load (only the first of each is indexed)
+    HashIndex index; // id -> slot for every live item
+    SecIndex *sec; // Optional category/price indexes, NULL until inventoryEnableSecondary
+    NameIndex *names; // Optional name search, NULL until inventoryEnableNameIndex
+    ItemColumns *cols; // Optional columnar copy for reports, NULL until inventoryEnableColumns
+    ShmStore *shm; // Optional shared-memory copy for other processes, NULL until inventoryEnableShared
+    ItemMapping mapping; // Set while items still points into a file mapping
+    Wal wal; // Log that mutations are appended to
+    int logging; // 1 if the inventory was opened from a file and mutations are logged
+    int bulkLogging; // Saved value of 'logging' while a bulk load is running
+    int logBroken; // 1 after a rollback could not log its ABORT: mutations fail with -2 until a checkpoint succeeds
+    int background; // 1 if automatic checkpoints fork a background snapshot instead of writing in place
+    BgSnapshot snap; // Background snapshot state and metrics
+    GroupCommit *group; // Syncer making commits durable, NULL until inventoryEnableGroupCommit
+    int groupGeneration; // Log generation the syncer is pointed at
+    int unsynced; // Commits in the log not yet handed to the syncer (deferred log)
+    uint64_t unsyncedSince; // When the first of them was made
+    InvTxn txn; // Open transaction, if any
+} Inventory;
+
+/* Prepares an empty, in-memory inventory (nothing is persisted). Returns 0 on success, -1 on failure */
+int inventoryInit(Inventory *inv);
+
+/*
+Loads 'filename' (snapshot plus log), builds the id index and opens the log
+so every later mutation is persisted. 'flags' is a mix of INV_OPEN_*.
+Returns loadItems' codes: 0 loaded, 1 no file yet (empty inventory), negative on failure,
+-8 for a shard manifest (open that with shardedOpen, its shards have their own logs)
+*/
+int inventoryOpen(Inventory *inv, const char *filename, int flags);
+
+/* Waits for a running background snapshot, closes the log and releases everything. Returns 0 on success */
+int inventoryClose(Inventory *inv);
+
+/* Returns 1 if 'slot' holds a live item, 0 if it is a tombstone */
+static inline int inventorySlotLive(const Inventory *inv, int slot) { return inv->items[slot].id != INV_TOMBSTONE; }
+
+/* Returns the slot of item 'id', or -1. Slots stay valid until the next add, delete or compaction */
+int inventoryFind(const Inventory *inv, int id);
+
+/* Returns the item with 'id', or NULL */
+const Item *inventoryGet(const Inventory *inv, int id);
+
+/* Adds a copy of 'item'. Returns 0 on success, 1 if the id is invalid or already used, negative on failure */
+int inventoryAdd(Inventory *inv, const Item *item);
+
+/* Sets the quantity of item 'id'. Returns 0 on success, 1 if the id does not exist, negative on failure */
+int inventorySetQuantity(Inventory *inv, int id, int quantity);
+
+/* Deletes item 'id' (leaves a tombstone). Returns 0 on success, 1 if the id does not exist, negative on failure */
+int inventoryDelete(Inventory *inv, int id);
+
+/*
+Adds 'n' items with one capacity reservation and one log flush.
+Items with invalid or duplicate ids are skipped. *addedPtr (may be NULL)
+receives how many were added. Returns 0 on success, negative on failure
+*/
+int inventoryAddBatch(Inventory *inv, const Item *items, int n, int *addedPtr);
+
+/* Deletes 'n' ids with one log flush; missing ids are skipped. Same return convention as inventoryAddBatch */
+int inventoryDeleteBatch(Inventory *inv, const int *ids, int n, int *deletedPtr);
+
+/* Makes room for at least 'n' slots. Returns 0 on success, -1 on failure */
+int inventoryReserve(Inventory *inv, int n);
+
+/* Squeezes out tombstones (keeping order) and re-points the index. Returns 0 on success */
+int inventoryCompact(Inventory *inv);
+
+/*
+Compacts and folds the log into a fresh snapshot (see walCompact).
+Does nothing for in-memory inventories or while a transaction is open
+(returns 1). Returns 0 on success
+*/
+int inventoryCheckpoint(Inventory *inv);
+
+/*
+Switches automatic checkpoints (the log passing its size threshold) to
+background snapshots: a forked child writes the file while the inventory
+keeps serving, see snapshot.h. inventoryCheckpoint itself stays synchronous
+*/
+void inventoryBackgroundSnapshots(Inventory *inv, int on);
+
+/*
+Starts a background snapshot now. Returns 0 if one was started, 1 if one is
+already running (or the inventory is not backed by a file, or a transaction
+is open), negative on failure
+*/
+int inventorySnapshotNow(Inventory *inv);
+
+/*
+Finishes a background snapshot whose child is done (trimming the log).
+Call it regularly, e.g. once per menu loop. Returns snapshotPoll's codes
+*/
+int inventoryPollSnapshot(Inventory *inv);
+
+/*
+Starts a bulk load: mutations stop going to the log until inventoryEndBulk,
+which writes them all with one checkpoint. A crash in between loses the
+whole bulk load but never leaves half of it behind
+*/
+void inventoryBeginBulk(Inventory *inv);
+
+/* Ends a bulk load and checkpoints. Returns inventoryCheckpoint's code */
+int inventoryEndBulk(Inventory *inv);
+
+/*
+Ends a bulk load that only added items without keeping any of it: the
+'added' items added last are removed again and nothing is checkpointed.
+Returns 0, -1 if the compaction that may follow fails
+*/
+int inventoryAbortBulk(Inventory *inv, int added);
+
+/*
+Builds the category and price indexes (in parallel, see secIndexBuild) and
+keeps them up to date on every later add, delete and compaction.
+Returns 0 on success, -1 on failure
+*/
+int inventoryEnableSecondary(Inventory *inv, int threads);
+
+/*
+Finds live items with lo <= price <= hi, in 'category' unless it is -1.
+Writes up to 'maxOut' slots in ascending price order and returns the number
+of matches, or -1 if the secondary indexes are not enabled
+*/
+int inventoryFindByPrice(const Inventory *inv, int category, float lo, float hi, int *out, int maxOut);
+
+/*
+Builds the name search index (prefix trie and trigrams, in parallel, see
+nameIndexBuild) and keeps it up to date on every later add, delete and
+compaction. Returns 0 on success, -1 on failure
+*/
+int inventoryEnableNameIndex(Inventory *inv, int threads);
+
+/*
+Finds live items whose name starts with 'prefix' (case-insensitive), in
+name order. Writes up to 'maxOut' slots and returns the number of matches,
+or -1 if the name index is not enabled
+*/
+long inventoryFindByNamePrefix(const Inventory *inv, const char *prefix, int *out, int maxOut);
+
+/*
+Finds live items whose name contains 'text' (case-insensitive), best
+matches first (see nameIndexSearch). Writes up to 'maxOut' slots and
+returns the number of matches, or -1 if the name index is not enabled or
+memory ran out
+*/
+long inventoryFindByNameText(const Inventory *inv, const char *text, int *out, int maxOut);
+
+/*
+Builds a columnar copy of id/quantity/price/category (see columns.h) and
+keeps it in step with every later mutation, so reports scan only the
+fields they need. Returns 0 on success, -1 on failure
+*/
+int inventoryEnableColumns(Inventory *inv);
+
+/*
+Publishes the items in the POSIX shared memory segment 'name' (see
+shmstore.h) and keeps it in step with every later mutation, so other
+processes on this machine read them through shmreader.h without locks or
+system calls. The segment is removed by inventoryClose. Returns 0 on
+success, -1 on failure (errno set)
+*/
+int inventoryEnableShared(Inventory *inv, const char *name);
+
+/*
+Aggregates live items of 'category' (-1 for all): count, total quantity,
+total value and price range. Uses the columns when enabled, the rows otherwise
+*/
+void inventorySummarize(const Inventory *inv, int category, ColumnSummary *out);
+
+/* Total value (quantity * price) per category, columns or rows as above */
+void inventoryValueByCategory(const Inventory *inv, double out[COL_CATEGORIES]);
+
+/* Runs a parsed query (see query.h) over the live items, columns or rows as above. Returns queryRun's code */
+int inventoryQuery(const Inventory *inv, const Query *q, QueryRowFn onRow, void *ctx, QueryResult *res);
+
+/*
+The 'k' live items of 'category' (-1 for any) with the largest ('largest'
+set) or smallest quantity, price or value, best first (see topK), columns
+or rows as above. Returns how many were written to 'out', -1 if out of memory
+*/
+int inventoryTopK(const Inventory *inv, TopKField field, int category, int largest, int k, int threads, TopKEntry *out);
+
+/*
+While 'on' is set, mutations still go to the log but stay in its stdio
+buffer until inventoryFlushLog (or the buffer fills), so a burst of
+operations costs one write instead of one per operation
+*/
+void inventoryDeferLog(Inventory *inv, int on);
+
+/* Hands buffered log records to the OS. Returns 0 on success (or when not logging) */
+int inventoryFlushLog(Inventory *inv);
+
+/*
+Starts group commit: from now on every commit (each mutation outside a
+transaction, or a whole transaction) is made durable with fdatasync by a
+syncer thread that covers everything logged so far with one sync, at most
+'maxDelayUs' after the oldest waiting commit or as soon as 'maxBatch' are
+waiting. Mutations do not wait for it; inventoryWaitDurable and
+inventoryCommit do. Calling it again changes the limits. Returns 0 on
+success, 1 if the inventory is not logged, -1 on failure
+*/
+int inventoryEnableGroupCommit(Inventory *inv, long maxDelayUs, int maxBatch);
+
+/*
+Blocks until every mutation so far is on stable storage: waits for the
+syncer, or syncs the log itself without group commit.
+Returns 0 on success, -2 if syncing failed
+*/
+int inventoryWaitDurable(Inventory *inv);
+
+/*
+Opens a transaction: the following mutations are logged between BEGIN and
+COMMIT records, so after a crash either all of them or none are replayed.
+Checkpoints and snapshots wait until it ends. Returns 0, 1 if one is
+already open, -2 if the log could not be written
+*/
+int inventoryBegin(Inventory *inv);
+
+/*
+Commits the open transaction with one log write. Unless the log is
+deferred (see inventoryDeferLog) it returns once the commit is durable
+(group commit) or handed to the OS (without). Returns 0, 1 if no
+transaction is open, -2 if the log could not be written or synced
+*/
+int inventoryCommit(Inventory *inv);
+
+/*
+Undoes every mutation of the open transaction. If its ABORT cannot be
+logged, a checkpoint replaces the log; should that fail too, every later
+mutation returns -2 (retrying the checkpoint) until one succeeds.
+Returns 0, 1 if none is open, negative on failure
+*/
+int inventoryRollback(Inventory *inv);
+
+/* Compacts and writes the live items to 'filename' without touching the log. Returns saveItems' codes */
+int inventorySaveAs(Inventory *inv, const char *filename);
+
+#endif // INVENTORY_H
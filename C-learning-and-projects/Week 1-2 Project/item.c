@@ -17,10 +17,21 @@ void printItem(const Item *item){
     if (item == NULL) {
         printf("Item is NULL\n");
     } else{
-    printf("ID: %d\n", item->id);
-    printf("Name: %s\n", item->name);
-    printf("Quantity: %d\n", item->quantity);
-    printf("Price: %.2f\n", item->price);
-    printf("Category: %s\n", categorytostring(item->category));
+    printItemFields(item->id, item->name, item->quantity, item->price, item->category);
     }
-}
\ No newline at end of file
+}
+
+void printItemFields(int id, const char *name, int quantity, float price, Category category){
+    printf("ID: %d\n", id);
+    printf("Name: %s\n", name);
+    printf("Quantity: %d\n", quantity);
+    printf("Price: %.2f\n", price);
+    printf("Category: %s\n", categorytostring(category));
+}
+const char *itemInvalid(const Item *item){
+    if (item->id <= 0) return "id must be positive";
+    if (item->name[0] == '\0') return "name cannot be empty";
+    if (item->quantity <= 0) return "quantity must be positive";
+    if (!(item->price > 0)) return "price must be positive"; // Also turns NaN away
+    return NULL;
+}
@@ -19,6 +19,8 @@ typedef struct { // Item struct to represent an Item with its properties
 
 const char *categorytostring(Category c); // Function to convert Category enum to string representation
 void printItem(const Item *item); // Function to print the details of an Item
+void printItemFields(int id, const char *name, int quantity, float price, Category category); // Same output from loose fields (compact records)
+const char *itemInvalid(const Item *item); // Why a new item would be refused (menu, batch and server share the rules), NULL if it is fine
 
 #endif // ITEM_H
 
@@ -0,0 +1,250 @@
+// Load generator for the inventory server (see protocol.h).
+// Usage: loadgen <socket> [--conns C] [--depth D] [--requests N] [--get-pct P] [--keys K] [--preload]
+// Each of C connections runs on its own thread and keeps D requests in flight.
+// Requests are GETs (P percent) or quantity updates on random ids 1..K;
+// --preload ADDs ids 1..K first. Prints throughput and latency percentiles.
+#define _GNU_SOURCE // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "protocol.h"
+#include "fileio.h"
+
+typedef struct { // One connection's share of the run
+    const char *socketPath;
+    long requests;
+    int depth;
+    int getPct;
+    int keys;
+    uint64_t seed;
+    uint32_t *latencies; // Nanoseconds per request, saturating
+    long done;
+    long errors;
+    int failed;
+} Worker;
+
+static uint64_t nowNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t nextRandom(uint64_t *s) { // xorshift64
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static int connectTo(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) return -1;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+static int writeAll(int fd, const unsigned char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static size_t encodeRequest(unsigned char *p, Worker *w, uint32_t reqId) { // One random GET or QTY frame
+    uint32_t id = (uint32_t)(nextRandom(&w->seed) % (uint64_t)w->keys) + 1;
+    if ((int)(nextRandom(&w->seed) % 100) < w->getPct) {
+        protoPutHeader(p, PROTO_HEADER_SIZE + 4, reqId, PROTO_GET, 0);
+        protoPutU32(p + PROTO_HEADER_SIZE, id);
+        return PROTO_HEADER_SIZE + 4;
+    }
+    protoPutHeader(p, PROTO_HEADER_SIZE + 8, reqId, PROTO_QTY, 0);
+    protoPutU32(p + PROTO_HEADER_SIZE, id);
+    protoPutU32(p + PROTO_HEADER_SIZE + 4, (uint32_t)(nextRandom(&w->seed) % 1000));
+    return PROTO_HEADER_SIZE + 8;
+}
+
+static void *runWorker(void *arg) { // Pipelined request loop for one connection
+    Worker *w = arg;
+    int fd = connectTo(w->socketPath);
+    if (fd < 0) { w->failed = 1; return NULL; }
+    uint64_t *sentAt = malloc((size_t)w->depth * sizeof *sentAt); // Send time by reqId % depth (responses come back in order)
+    unsigned char *out = malloc((size_t)w->depth * PROTO_MAX_FRAME);
+    unsigned char *in = malloc(65536 + PROTO_MAX_FRAME);
+    if (!sentAt || !out || !in) { w->failed = 1; goto done; }
+    long sent = 0;
+    size_t inLen = 0;
+    int window = w->requests < w->depth ? (int)w->requests : w->depth;
+    size_t outLen = 0;
+    uint64_t t = nowNanos();
+    for (; sent < window; ++sent) { // Fill the pipeline
+        outLen += encodeRequest(out + outLen, w, (uint32_t)sent);
+        sentAt[sent % w->depth] = t;
+    }
+    if (writeAll(fd, out, outLen) != 0) { w->failed = 1; goto done; }
+    while (w->done < w->requests) {
+        ssize_t n = recv(fd, in + inLen, 65536, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            w->failed = 1;
+            break;
+        }
+        inLen += (size_t)n;
+        uint64_t now = nowNanos();
+        size_t pos = 0;
+        outLen = 0;
+        while (inLen - pos >= PROTO_HEADER_SIZE) {
+            uint32_t len = protoGetU32(in + pos);
+            if (len < PROTO_HEADER_SIZE || len > PROTO_MAX_FRAME) { w->failed = 1; goto done; }
+            if (inLen - pos < len) break;
+            uint32_t reqId = protoGetU32(in + pos + 4);
+            uint8_t status = in[pos + 9];
+            if (status != PROTO_OK && status != PROTO_NOT_FOUND) w->errors++;
+            uint64_t lat = now - sentAt[reqId % (uint32_t)w->depth];
+            w->latencies[w->done++] = lat > UINT32_MAX ? UINT32_MAX : (uint32_t)lat;
+            pos += len;
+            if (sent < w->requests) { // Replace the finished request to keep the depth
+                outLen += encodeRequest(out + outLen, w, (uint32_t)sent);
+                sentAt[sent % w->depth] = now;
+                sent++;
+            }
+        }
+        memmove(in, in + pos, inLen - pos);
+        inLen -= pos;
+        if (outLen && writeAll(fd, out, outLen) != 0) { w->failed = 1; break; }
+    }
+done:
+    free(sentAt);
+    free(out);
+    free(in);
+    close(fd);
+    return NULL;
+}
+
+static int preload(const char *path, int keys) { // ADD ids 1..keys, pipelined in chunks; returns how many were new
+    int fd = connectTo(path);
+    if (fd < 0) return -1;
+    enum { CHUNK = 1024 };
+    unsigned char *buf = malloc((size_t)CHUNK * PROTO_MAX_FRAME);
+    if (!buf) { close(fd); return -1; }
+    int added = 0;
+    for (int base = 1; base <= keys; base += CHUNK) {
+        int n = keys - base + 1 < CHUNK ? keys - base + 1 : CHUNK;
+        size_t len = 0;
+        for (int i = 0; i < n; ++i) {
+            Item it;
+            memset(&it, 0, sizeof it);
+            it.id = base + i;
+            snprintf(it.name, sizeof it.name, "Item %d", it.id);
+            it.quantity = 100;
+            it.price = (float)(1 + it.id % 500);
+            it.category = (Category)(it.id % 4);
+            protoPutHeader(buf + len, PROTO_HEADER_SIZE + ITEMS_RECORD_SIZE, (uint32_t)it.id, PROTO_ADD, 0);
+            encodeItemRecord(buf + len + PROTO_HEADER_SIZE, &it);
+            len += PROTO_HEADER_SIZE + ITEMS_RECORD_SIZE;
+        }
+        if (writeAll(fd, buf, len) != 0) { added = -1; break; }
+        size_t have = 0, want = (size_t)n * PROTO_HEADER_SIZE; // ADD responses have no payload
+        while (have < want) {
+            ssize_t r = recv(fd, buf + have, want - have, 0);
+            if (r <= 0) { added = -1; break; }
+            have += (size_t)r;
+        }
+        if (added < 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (buf[i * PROTO_HEADER_SIZE + 9] == PROTO_OK) added++;
+        }
+    }
+    free(buf);
+    close(fd);
+    return added;
+}
+
+static int compareU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <socket> [--conns C] [--depth D] [--requests N] [--get-pct P] [--keys K] [--preload]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    int conns = 4, depth = 32, getPct = 90, keys = 100000, doPreload = 0;
+    long requests = 1000000;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--preload") == 0) doPreload = 1;
+        else if (i + 1 < argc && strcmp(argv[i], "--conns") == 0) conns = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--depth") == 0) depth = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--requests") == 0) requests = strtol(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "--get-pct") == 0) getPct = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--keys") == 0) keys = atoi(argv[++i]);
+        else { fprintf(stderr, "Unknown option %s\n", argv[i]); return 1; }
+    }
+    if (conns < 1 || depth < 1 || requests < 1 || keys < 1) { fprintf(stderr, "Counts must be positive.\n"); return 1; }
+    if (doPreload) {
+        int added = preload(path, keys);
+        if (added < 0) { fprintf(stderr, "Preload failed, is the server running on %s?\n", path); return 1; }
+        printf("Preloaded %d new items (ids 1..%d).\n", added, keys);
+    }
+    Worker *workers = calloc((size_t)conns, sizeof *workers);
+    pthread_t *threads = malloc((size_t)conns * sizeof *threads);
+    uint32_t *latencies = malloc((size_t)requests * sizeof *latencies);
+    if (!workers || !threads || !latencies) { fprintf(stderr, "Not enough memory.\n"); return 1; }
+    long offset = 0;
+    for (int i = 0; i < conns; ++i) { // Split the requests evenly
+        Worker *w = &workers[i];
+        w->socketPath = path;
+        w->requests = requests / conns + (i < requests % conns);
+        w->depth = depth;
+        w->getPct = getPct;
+        w->keys = keys;
+        w->seed = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+        w->latencies = latencies + offset;
+        offset += w->requests;
+    }
+    uint64_t start = nowNanos();
+    for (int i = 0; i < conns; ++i) pthread_create(&threads[i], NULL, runWorker, &workers[i]);
+    long done = 0, errors = 0;
+    int failed = 0;
+    for (int i = 0; i < conns; ++i) {
+        pthread_join(threads[i], NULL);
+        failed += workers[i].failed;
+        errors += workers[i].errors;
+    }
+    double secs = (double)(nowNanos() - start) / 1e9;
+    for (int i = 0; i < conns; ++i) { // Pack the recorded latencies together
+        memmove(latencies + done, workers[i].latencies, (size_t)workers[i].done * sizeof *latencies);
+        done += workers[i].done;
+    }
+    if (failed) fprintf(stderr, "%d connection(s) failed.\n", failed);
+    if (done == 0) { fprintf(stderr, "No responses received.\n"); return 1; }
+    qsort(latencies, (size_t)done, sizeof *latencies, compareU32);
+    printf("%ld requests over %d connection(s), depth %d, %d%% GET: %.3f s, %.0f ops/s\n",
+           done, conns, depth, getPct, secs, done / secs);
+    printf("latency us: p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  (%ld error responses)\n",
+           latencies[(size_t)(done * 0.50)] / 1e3, latencies[(size_t)(done * 0.99)] / 1e3,
+           latencies[(size_t)(done * 0.999)] / 1e3, latencies[done - 1] / 1e3, errors);
+    free(workers);
+    free(threads);
+    free(latencies);
+    return failed ? 1 : 0;
+}
@@ -3,44 +3,792 @@
 #include <string.h>
 #include "item.h"
 #include "fileio.h"
+#include "inventory.h"
+#include "csvio.h"
+#include "batch.h"
+#include "server.h"
+#include "compact.h"
+#include "synth.h"
+#include "pagedstore.h"
+#include "sharded.h"
+#include "changefeed.h"
+#include "replica.h"
+#include "shmreader.h"
+#include "metrics.h"
+#include <time.h>
+#include <math.h>
+
+#define MENU_LAST 14 // Highest menu choice (6 stays "exit")
+#define NAME_RESULTS 10 // Name search shows the best this many
+
+typedef struct { // Group commit settings from the command line
+    long delayUs; // --commit-delay
+    int batch; // --commit-batch
+    int off; // --no-sync: log to the OS cache only, as before group commit
+} CommitOptions;
+
+static double nowSeconds(void) { // Wall-clock time for the throughput reports
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void printQueryItem(const Item *item, void *ctx) { // Menu query rows: the usual item block for *, CSV for chosen fields
+    const Query *q = ctx;
+    if (q->star) printItem(item);
+    else queryPrintRow(q, item, stdout);
+}
+
+static int commitOption(int argc, char *argv[], int *i, CommitOptions *co) { // Consumes a group commit option at argv[*i], returns 1 if it was one
+    if (strcmp(argv[*i], "--no-sync") == 0) { co->off = 1; return 1; }
+    if (*i + 1 >= argc) return 0;
+    if (strcmp(argv[*i], "--commit-delay") == 0) { co->delayUs = strtol(argv[++*i], NULL, 10); return 1; }
+    if (strcmp(argv[*i], "--commit-batch") == 0) { co->batch = atoi(argv[++*i]); return 1; }
+    return 0;
+}
+
+static void startGroupCommit(Inventory *inv, const CommitOptions *co) { // Every commit durable, syncs shared
+    if (co->off) return;
+    if (inventoryEnableGroupCommit(inv, co->delayUs, co->batch) < 0) {
+        fprintf(stderr, "Warning: could not start group commit, changes reach the OS but are not synced.\n");
+    }
+}
+
+static int openFeed(Inventory *inv, ChangeFeed *cf, int on) { // --cdc: every logged change also goes to <filename>.cdc for followers
+    memset(cf, 0, sizeof *cf); // changeFeedClose of a feed never opened does nothing
+    if (!on) return 0;
+    int rc = changeFeedOpen(cf, inv);
+    if (rc == 1) fprintf(stderr, "Change feed: new stream %016llx from sequence %llu.\n", (unsigned long long)cf->stream, (unsigned long long)cf->base);
+    else if (rc < 0) fprintf(stderr, "Could not open the change feed (%d).\n", rc);
+    return rc < 0 ? rc : 0;
+}
+
+static void openShared(Inventory *inv, const char *name) { // --shm: other processes read the items through shmreader.h
+    if (!name) return;
+    if (inventoryEnableShared(inv, name) != 0) perror("Warning: could not publish the items in shared memory");
+    else fprintf(stderr, "Items shared as %s (read them with: shm-get %s <id>...).\n", inv->shm->name, name);
+}
+
+static int runCsvCommand(const char *cmd, const char *csvFile, const char *filename) { // import/export subcommands
+    Inventory inv;
+    int result = inventoryOpen(&inv, filename, 0); // Load (or start) the inventory
+    if (result < 0) {
+        printf("Error %d loading items: %s\n", result, itemsErrorString(result));
+        return 1;
+    }
+    double start = nowSeconds();
+    int rc;
+    if (strcmp(cmd, "import") == 0) {
+        CsvImportStats stats;
+        rc = importCsv(&inv, csvFile, &stats); // Stream the CSV in batches
+        double secs = nowSeconds() - start;
+        printf("Imported %ld of %ld rows (%ld rejected, %ld malformed) in %.3f s, %.0f rows/s\n",
+               stats.added, stats.rows, stats.skipped, stats.malformed, secs, secs > 0 ? stats.rows / secs : 0.0);
+    } else {
+        long rows = 0;
+        rc = exportCsv(&inv, csvFile, &rows); // Write every live item
+        double secs = nowSeconds() - start;
+        printf("Exported %ld rows in %.3f s, %.0f rows/s\n", rows, secs, secs > 0 ? rows / secs : 0.0);
+    }
+    if (rc != 0) printf("%s of %s failed (%d).\n", cmd, csvFile, rc);
+    inventoryClose(&inv);
+    return rc == 0 ? 0 : 1;
+}
+
+static int runBatchCommand(int argc, char *argv[]) { // batch <commands|-> [filename] [--sync-every N] [--commit-delay US] [--commit-batch N] [--no-sync] [--cdc] [--shm NAME]
+    const char *source = argv[2];
+    const char *filename = "items.dat";
+    const char *shmName = NULL;
+    long syncEvery = 0;
+    int cdc = 0;
+    CommitOptions co = { GC_DEFAULT_DELAY_US, GC_DEFAULT_BATCH, 0 };
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "--sync-every") == 0 && i + 1 < argc) syncEvery = strtol(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) shmName = argv[++i];
+        else if (strcmp(argv[i], "--cdc") == 0) cdc = 1;
+        else if (!commitOption(argc, argv, &i, &co)) filename = argv[i];
+    }
+    FILE *in = strcmp(source, "-") == 0 ? stdin : fopen(source, "r"); // "-" reads commands from a pipe
+    if (!in) { perror(source); return 1; }
+    Inventory inv;
+    int result = inventoryOpen(&inv, filename, 0);
+    if (result < 0) {
+        fprintf(stderr, "Error %d loading items: %s\n", result, itemsErrorString(result));
+        if (in != stdin) fclose(in);
+        return 1;
+    }
+    ChangeFeed cf;
+    if (openFeed(&inv, &cf, cdc) != 0) {
+        if (in != stdin) fclose(in);
+        inventoryClose(&inv);
+        return 1;
+    }
+    inventoryEnableColumns(&inv); // STATS/VALUE fall back to the rows if this fails
+    openShared(&inv, shmName);
+    inventoryBackgroundSnapshots(&inv, 1); // Checkpoints never stall the command stream
+    startGroupCommit(&inv, &co);
+    BatchStats stats;
+    double start = nowSeconds();
+    int rc = runBatch(&inv, in, stdout, syncEvery, &stats); // Results go to stdout, the report to stderr
+    double secs = nowSeconds() - start;
+    fprintf(stderr, "%ld ops (%ld failed, %ld syncs) in %.3f s, %.0f ops/s\n",
+            stats.ops, stats.failed, stats.syncs, secs, secs > 0 ? stats.ops / secs : 0.0);
+    if (rc != 0) fprintf(stderr, "Error saving items to file.\n");
+    if (inv.group) groupCommitReport(inv.group, stderr);
+    if (cdc) changeFeedReport(&cf, stderr);
+    if (in != stdin) fclose(in);
+    inventoryClose(&inv);
+    if (changeFeedClose(&cf) != 0) rc = -2;
+    return rc == 0 ? 0 : 1;
+}
+
+static int runColumnsBenchmark(int argc, char *argv[]) { // colbench [filename] [--synthetic N] [--rounds R]
+    const char *filename = "items.dat";
+    long synthetic = 0;
+    int rounds = 20;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) synthetic = strtol(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) rounds = atoi(argv[++i]);
+        else filename = argv[i];
+    }
+    if (rounds < 1) rounds = 1;
+    Inventory inv;
+    if (synthetic > 0) { // In-memory items, nothing touches the disk
+        inventoryInit(&inv);
+        enum { CHUNK = 65536 };
+        Item *chunk = malloc(CHUNK * sizeof *chunk);
+        if (!chunk) { perror("malloc failed"); return 1; }
+        for (long done = 0; done < synthetic; done += CHUNK) {
+            int n = synthetic - done < CHUNK ? (int)(synthetic - done) : CHUNK;
+            synthItems(chunk, n, (int)done + 1, SYNTH_DEFAULT_SEED); // Same data as the bench program
+            if (inventoryAddBatch(&inv, chunk, n, NULL) != 0) { fprintf(stderr, "Not enough memory.\n"); free(chunk); inventoryClose(&inv); return 1; }
+        }
+        free(chunk);
+    } else {
+        int result = inventoryOpen(&inv, filename, 0);
+        if (result < 0) { fprintf(stderr, "Error %d loading items: %s\n", result, itemsErrorString(result)); return 1; }
+    }
+    if (inventoryEnableColumns(&inv) != 0) { fprintf(stderr, "Not enough memory for the columns.\n"); inventoryClose(&inv); return 1; }
+    printf("%d items, %d rounds. Row layout: %zu bytes/item, columns: %zu bytes/item\n", inv.count, rounds,
+           sizeof(Item), sizeof(int32_t) * 2 + sizeof(float) + sizeof(uint8_t));
+
+    ColumnSummary expect, got;
+    double expectValue[COL_CATEGORIES], gotValue[COL_CATEGORIES];
+    double start = nowSeconds();
+    for (int r = 0; r < rounds; ++r) rowsSummarize(inv.items, inv.count, -1, &expect);
+    double rowSummary = (nowSeconds() - start) / rounds;
+    start = nowSeconds();
+    for (int r = 0; r < rounds; ++r) rowsValueByCategory(inv.items, inv.count, expectValue);
+    double rowGroup = (nowSeconds() - start) / rounds;
+    printf("%-8s summary %8.3f ms  by-category %8.3f ms\n", "rows", rowSummary * 1e3, rowGroup * 1e3);
+
+    int best = columnsUseKernels(COL_KERNEL_AVX2);
+    for (int k = COL_KERNEL_SCALAR; k <= best; ++k) { // Every kernel set this CPU can run
+        columnsUseKernels(k);
+        start = nowSeconds();
+        for (int r = 0; r < rounds; ++r) columnsSummarize(inv.cols, -1, &got);
+        double summary = (nowSeconds() - start) / rounds;
+        start = nowSeconds();
+        for (int r = 0; r < rounds; ++r) columnsValueByCategory(inv.cols, gotValue);
+        double group = (nowSeconds() - start) / rounds;
+        int same = got.count == expect.count && got.quantity == expect.quantity && got.minPrice == expect.minPrice &&
+                   got.maxPrice == expect.maxPrice && fabs(got.value - expect.value) <= 1e-9 * fabs(expect.value) + 1e-6;
+        for (int c = 0; c < COL_CATEGORIES; ++c) same &= fabs(gotValue[c] - expectValue[c]) <= 1e-9 * fabs(expectValue[c]) + 1e-6; // Sums differ only by rounding order
+        printf("%-8s summary %8.3f ms (%.1fx)  by-category %8.3f ms (%.1fx)%s\n", columnsKernelName(k),
+               summary * 1e3, summary > 0 ? rowSummary / summary : 0.0, group * 1e3, group > 0 ? rowGroup / group : 0.0,
+               same ? "" : "  MISMATCH");
+    }
+    columnsUseKernels(best);
+    inventoryClose(&inv);
+    return 0;
+}
+
+static int runServeCommand(int argc, char *argv[]) { // serve <socket> [filename] [--commit-delay US] [--commit-batch N] [--no-sync] [--cdc] [--shm NAME]
+    const char *socketPath = argv[2];
+    const char *filename = "items.dat";
+    const char *shmName = NULL;
+    int cdc = 0;
+    CommitOptions co = { GC_DEFAULT_DELAY_US, GC_DEFAULT_BATCH, 0 };
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "--cdc") == 0) cdc = 1;
+        else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) shmName = argv[++i];
+        else if (!commitOption(argc, argv, &i, &co)) filename = argv[i];
+    }
+    Inventory inv;
+    int result = inventoryOpen(&inv, filename, 0);
+    if (result < 0) {
+        fprintf(stderr, "Error %d loading items: %s\n", result, itemsErrorString(result));
+        return 1;
+    }
+    ChangeFeed cf;
+    if (openFeed(&inv, &cf, cdc) != 0) { inventoryClose(&inv); return 1; }
+    openShared(&inv, shmName); // Local readers skip the socket altogether
+    inventoryBackgroundSnapshots(&inv, 1); // Checkpoints never stall the event loop
+    startGroupCommit(&inv, &co); // Replies wait for their sync, which clients share
+    fprintf(stderr, "Serving %d items on %s (Ctrl+C to stop).\n", inv.live, socketPath);
+    int rc = runServer(&inv, socketPath); // Runs until SIGINT/SIGTERM
+    if (rc != 0) fprintf(stderr, "Could not serve on %s (%d).\n", socketPath, rc);
+    if (cdc) changeFeedReport(&cf, stderr);
+    inventoryClose(&inv);
+    if (changeFeedClose(&cf) != 0) rc = -2;
+    return rc == 0 ? 0 : 1;
+}
+
+static int runPublishCommand(int argc, char *argv[]) { // publish <filename> <socket|-> [replica copy]
+    const char *filename = argv[2], *target = argv[3];
+    if (strcmp(target, "-") != 0) { // One forked publisher per follower that connects
+        fprintf(stderr, "Publishing the change feed of %s on %s (Ctrl+C to stop).\n", filename, target);
+        int rc = changeFeedServe(filename, target);
+        if (rc != 0) fprintf(stderr, "Could not serve on %s (%d).\n", target, rc);
+        return rc == 0 ? 0 : 1;
+    }
+    ReplicaPosition pos; // Over a pipe the follower cannot say where it is: read it from its position file
+    if (argc < 5 || replicaReadPosition(argv[4], &pos) != 0) memset(&pos, 0, sizeof pos);
+    int rc = changeFeedPublish(filename, 1, pos.stream, pos.applied + 1); // Frames on stdout, messages on stderr
+    if (rc == 1) fprintf(stderr, "%s has no change feed (run it with --cdc).\n", filename);
+    else if (rc < 0) fprintf(stderr, "Publishing failed (%d).\n", rc);
+    return rc == 0 ? 0 : 1;
+}
+
+static int runFollowCommand(const char *filename, const char *source) { // follow <filename> <socket|->
+    Replica r;
+    int rc = replicaOpen(&r, filename);
+    if (rc < 0) {
+        fprintf(stderr, "Error %d loading items: %s\n", rc, itemsErrorString(rc));
+        return 1;
+    }
+    fprintf(stderr, rc == 1 ? "Following %s into %s from a fresh snapshot.\n" : "Following %s into %s from sequence %llu.\n",
+            source, filename, (unsigned long long)r.pos.applied + 1);
+    rc = replicaFollow(&r, source); // Until SIGINT/SIGTERM, or the end of the pipe
+    if (rc != 0) fprintf(stderr, "Following stopped with an error (%d).\n", rc);
+    replicaReport(&r, stderr);
+    if (replicaClose(&r) != 0) rc = -2;
+    return rc == 0 ? 0 : 1;
+}
+
+static int runReplicaStatus(const char *filename) { // replica-status <filename>: position and lag as of the last checkpoint
+    ReplicaPosition pos;
+    int rc = replicaReadPosition(filename, &pos);
+    if (rc != 0) {
+        printf(rc == 1 ? "%s is not a replica.\n" : "The position of %s is damaged, the next follow takes a snapshot.\n", filename);
+        return 1;
+    }
+    uint64_t behind;
+    double ms;
+    replicaLag(&pos, &behind, &ms);
+    printf("Stream %016llx: applied %llu, primary at %llu when last heard from, lag %llu records / %.0f ms\n",
+           (unsigned long long)pos.stream, (unsigned long long)pos.applied, (unsigned long long)pos.primaryLast,
+           (unsigned long long)behind, ms);
+    return 0;
+}
+
+static int runSharedGet(int argc, char *argv[]) { // shm-get <name> <id>...: reads a running inventory's items from shared memory
+    ShmReader r;
+    int rc = shmReaderOpen(&r, argv[2]);
+    if (rc != 0) {
+        if (rc == -1) perror(argv[2]);
+        else fprintf(stderr, rc == -4 ? "%s is not a shared inventory.\n" : "%s was written by a different version.\n", argv[2]);
+        return 1;
+    }
+    if (shmReaderClosed(&r)) fprintf(stderr, "Warning: the writer of %s has exited, these items may be stale.\n", argv[2]);
+    int failed = 0;
+    for (int i = 3; i < argc; ++i) {
+        Item item;
+        rc = shmReaderGet(&r, atoi(argv[i]), &item);
+        if (rc == 0) printItem(&item);
+        else {
+            printf(rc == 1 ? "Item %s not found.\n" : "Item %s could not be read (%d).\n", argv[i], rc);
+            failed = 1;
+        }
+    }
+    fprintf(stderr, "%u live items, %llu retries.\n", shmReaderLive(&r), (unsigned long long)r.retries);
+    shmReaderClose(&r);
+    return failed;
+}
+
+static void reportCompactMemory(const CompactStore *cs) { // What interning the names saved
+    size_t compactBytes, itemBytes;
+    compactMemory(cs, &compactBytes, &itemBytes);
+    printf("Names: %u distinct for %d items (%u bytes). Memory: %.1f KB compact vs %.1f KB as full records (%.0f%% less).\n",
+           strArenaCount(&cs->names), cs->live, cs->names.size, compactBytes / 1024.0, itemBytes / 1024.0,
+           itemBytes ? 100.0 * (1.0 - (double)compactBytes / (double)itemBytes) : 0.0);
+}
+
+static int runCompactCommand(const char *cmd, const char *in, const char *out) { // --compact / --expand <in> <out>
+    CompactStore cs;
+    Item *items = NULL;
+    int count = 0, rc;
+    if (strcmp(cmd, "--compact") == 0) {
+        rc = loadItems(in, &items, &count); // Snapshot plus log
+        if (rc != 0) { printf("Error %d loading %s: %s\n", rc, in, itemsErrorString(rc)); return 1; }
+        rc = compactFromItems(&cs, items, count);
+        free(items);
+        if (rc != 0) { printf("Not enough memory.\n"); return 1; }
+        rc = compactSave(&cs, out);
+        if (rc == 0) reportCompactMemory(&cs);
+    } else {
+        rc = compactLoad(&cs, in);
+        if (rc != 0) { printf("Error %d loading %s: %s\n", rc, in, itemsErrorString(rc)); return 1; }
+        rc = compactToItems(&cs, &items, &count) == 0 ? saveItems(out, items, count) : -3;
+        free(items);
+    }
+    printf("%s %s -> %s: %s\n", cmd + 2, in, out, rc == 0 ? "ok" : "failed");
+    compactFree(&cs);
+    return rc == 0 ? 0 : 1;
+}
+
+typedef struct { // A storage backend behind the shared menu: options 1-5 go through these, 7 and up to 'extra'
+    const char *title; // Shown as "Inventory Menu (title)"
+    const char *const *extras; // Lines for options 7, 8, ... NULL-terminated, or NULL for none
+    void *ctx; // Passed to every call
+    long (*live)(void *ctx); // Items in the store
+    int (*list)(void *ctx); // Prints every item. Returns 0, negative on a read error
+    int (*get)(void *ctx, int id, Item *out); // Returns 0 found, 1 not found, negative on a read error
+    int (*add)(void *ctx, const Item *item); // The add made durable. Returns 0 on success
+    int (*setQuantity)(void *ctx, int id, int quantity); // Same for an update of an existing item
+    int (*del)(void *ctx, int id); // And a delete
+    void (*extra)(void *ctx, int choice); // Option 'choice' (7 or more) of 'extras'
+} MenuOps;
+
+static int clearInput(void) { // Drops the rest of the input line, returns EOF if the input ended
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF);
+    return c;
+}
+
+static void menuAddItem(const MenuOps *ops) { // Option 2, validated like the default menu and batch ADD
+    Item newItem, found;
+    int cat, rc;
+    memset(&newItem, 0, sizeof newItem);
+    printf("ID: ");
+    if (scanf("%d", &newItem.id) != 1 || newItem.id <= 0) {
+        printf("Invalid ID. Please enter a positive integer.\n");
+        clearInput();
+        return;
+    }
+    rc = ops->get(ops->ctx, newItem.id, &found);
+    if (rc < 0) { printf("Error %d reading items from file.\n", rc); clearInput(); return; } // Not the same as the id being taken
+    if (rc == 0) { printf("An item with ID %d already exists.\n", newItem.id); clearInput(); return; }
+    getchar(); // Newline after the ID
+    printf("Name: ");
+    if (!fgets(newItem.name, sizeof newItem.name, stdin) || newItem.name[0] == '\n') { printf("Name cannot be empty.\n"); return; }
+    newItem.name[strcspn(newItem.name, "\n")] = 0;
+    printf("Quantity, price and category (0: Electronics, 1: Clothing, 2: Food, 3: Other): ");
+    if (scanf("%d %f %d", &newItem.quantity, &newItem.price, &cat) != 3 || itemInvalid(&newItem)) {
+        printf("Invalid input. Quantity and price must be positive.\n");
+        clearInput();
+        return;
+    }
+    newItem.category = (cat >= 0 && cat <= 3) ? (Category)cat : OTHER;
+    printf(ops->add(ops->ctx, &newItem) == 0 ? "Item added successfully.\n" : "Error saving items to file.\n");
+}
+
+static void runMenu(const MenuOps *ops) { // The menu of the compact, paged and sharded stores, until 6 or the input ends
+    int extras = 0;
+    while (ops->extras && ops->extras[extras]) ++extras;
+    int last = extras ? 6 + extras : 5; // Highest option number, 6 is exit and the extras start at 7
+    while (1) {
+        int choice, targetId, rc;
+        Item found;
+        printf("Inventory Menu (%s):\n", ops->title);
+        printf("1. List all items\n");
+        printf("2. Add new item\n");
+        printf("3. Search by ID\n");
+        printf("4. Update quantity\n");
+        printf("5. Delete item\n");
+        for (int i = 7; i <= last; ++i) printf("%d. %s\n", i, ops->extras[i - 7]);
+        printf("Enter choice (1-%d, 6 to exit): ", last);
+        if (scanf("%d", &choice) != 1) {
+            printf("Invalid input. Please enter a number between 1 and %d.\n", last);
+            if (clearInput() == EOF) break;
+            continue;
+        }
+        if (choice == 6) break;
+        if (choice == 1) {
+            if (ops->live(ops->ctx) == 0) printf("No items to display.\n");
+            else if (ops->list(ops->ctx) != 0) printf("Error reading items from file.\n");
+            continue;
+        }
+        if (choice == 2) { menuAddItem(ops); continue; }
+        if (choice >= 7 && choice <= last) { ops->extra(ops->ctx, choice); continue; }
+        if (choice < 3 || choice > 5) {
+            printf("Invalid choice. Please enter a number between 1 and %d.\n", last);
+            continue;
+        }
+        printf("Enter item ID: ");
+        if (scanf("%d", &targetId) != 1) {
+            printf("Invalid input. Please enter a valid ID.\n");
+            clearInput();
+            continue;
+        }
+        rc = ops->get(ops->ctx, targetId, &found);
+        if (rc < 0) { printf("Error %d reading items from file.\n", rc); continue; }
+        if (rc == 1) { printf("Item with ID %d not found.\n", targetId); continue; }
+        if (choice == 3) {
+            printf("Item found:\n");
+            printItem(&found);
+        } else if (choice == 4) {
+            int newQty;
+            printf("Enter new quantity for item ID %d: ", targetId);
+            if (scanf("%d", &newQty) != 1) {
+                printf("Invalid input. Please enter a valid quantity.\n");
+                clearInput();
+                continue;
+            }
+            printf(ops->setQuantity(ops->ctx, targetId, newQty) == 0 ? "Quantity updated successfully.\n" : "Error saving items to file.\n");
+        } else {
+            printf(ops->del(ops->ctx, targetId) == 0 ? "Item with ID %d deleted successfully.\n" : "Error saving after deleting item %d.\n", targetId);
+        }
+    }
+    printf("Exiting program.\n");
+}
+
+typedef struct { // Compact menu state: the store and the file every change is saved to
+    CompactStore cs;
+    const char *filename;
+} CompactMenu;
+
+static long compactMenuLive(void *ctx) { return ((CompactMenu *)ctx)->cs.live; }
+
+static int compactMenuList(void *ctx) {
+    const CompactStore *cs = &((CompactMenu *)ctx)->cs;
+    for (int i = 0; i < cs->count; ++i) {
+        if (cs->items[i].id != 0) printCompactItem(cs, &cs->items[i]); // Skip deleted slots, names printed from the arena
+    }
+    return 0;
+}
+
+static int compactMenuGet(void *ctx, int id, Item *out) {
+    const CompactStore *cs = &((CompactMenu *)ctx)->cs;
+    int slot = compactFind(cs, id);
+    if (slot < 0) return 1;
+    compactExpand(cs, &cs->items[slot], out);
+    return 0;
+}
+
+static int compactMenuAdd(void *ctx, const Item *item) { // Every change rewrites the file, there is no log
+    CompactMenu *m = ctx;
+    return compactAdd(&m->cs, item) != 0 || compactSave(&m->cs, m->filename) != 0 ? -1 : 0;
+}
+
+static int compactMenuSetQuantity(void *ctx, int id, int quantity) {
+    CompactMenu *m = ctx;
+    int slot = compactFind(&m->cs, id);
+    if (slot < 0) return 1;
+    m->cs.items[slot].quantity = quantity;
+    return compactSave(&m->cs, m->filename);
+}
+
+static int compactMenuDelete(void *ctx, int id) {
+    CompactMenu *m = ctx;
+    return compactDelete(&m->cs, id) != 0 || compactSave(&m->cs, m->filename) != 0 ? -1 : 0;
+}
+
+static int runCompactMenu(const char *filename) { // Menu over a compact file, names stay in the arena
+    CompactMenu m = { .filename = filename };
+    int result = compactLoad(&m.cs, filename); // Two allocations, no matter how many names
+    if (result != 0) {
+        printf("Error %d loading items: %s\n", result, itemsErrorString(result));
+        return 1;
+    }
+    printf("Loaded %d items successfully (compact records).\n", m.cs.live);
+    reportCompactMemory(&m.cs);
+    MenuOps ops = { "compact", NULL, &m, compactMenuLive, compactMenuList, compactMenuGet, compactMenuAdd,
+                    compactMenuSetQuantity, compactMenuDelete, NULL };
+    runMenu(&ops);
+    compactFree(&m.cs);
+    return 0;
+}
+
+static int printPagedItem(const Item *item, void *ctx) { // pagedScan callback for the listings
+    (void)ctx;
+    printItem(item);
+    return 0;
+}
+
+static void reportPagedStats(PagedStore *ps) { // Cache and filter behaviour since the store was opened
+    const BpStats *b = &ps->pool.stats;
+    long fetches = b->hits + b->misses;
+    printf("Items: %lld in %u pages (%.1f MB), tree height %d, checkpoint %llu.\n", ps->count, pagedPageCount(ps),
+           pagedPageCount(ps) * (PAGE_SIZE / 1048576.0), ps->height, (unsigned long long)ps->checkpoint);
+    printf("Buffer pool: %d frames (%.1f MB), %ld hits, %ld misses (%.1f%% hit rate), %ld evictions, %ld written back, %ld read from the journal.\n",
+           ps->pool.nFrames, ps->pool.nFrames * (PAGE_SIZE / 1048576.0), b->hits, b->misses, fetches ? 100.0 * b->hits / fetches : 0.0,
+           b->evictions, b->writeBacks, b->journalReads);
+    printf("Journal: %ld pages since the last checkpoint; %ld checkpoints copied %ld pages.\n", bpJournalPages(&ps->pool),
+           ps->stats.checkpoints, b->checkpointPages);
+    printf("Bloom filter: %.1f KB, %d hashes; %ld lookups, %ld answered by the filter alone, %ld false positives.\n",
+           bloomBytes(&ps->bloom) / 1024.0, ps->bloom.hashes, ps->stats.lookups, ps->stats.bloomNegatives, ps->stats.bloomFalsePositives);
+    printf("Node splits: %ld. Log records replayed on open: %ld.\n", ps->stats.splits, ps->stats.replayed);
+}
+
+static long pagedMenuLive(void *ctx) { return (long)((PagedStore *)ctx)->count; }
+
+static int pagedMenuList(void *ctx) { return pagedScan(ctx, 1, 2147483647, printPagedItem, NULL); } // In id order, one leaf at a time
+
+static int pagedMenuGet(void *ctx, int id, Item *out) { return pagedGet(ctx, id, out); } // The Bloom filter turns most unknown ids away
+
+static int pagedMenuAdd(void *ctx, const Item *item) { return pagedAdd(ctx, item) != 0 || pagedSync(ctx) != 0 ? -1 : 0; }
+
+static int pagedMenuSetQuantity(void *ctx, int id, int quantity) { return pagedSetQuantity(ctx, id, quantity) != 0 || pagedSync(ctx) != 0 ? -1 : 0; }
+
+static int pagedMenuDelete(void *ctx, int id) { return pagedDelete(ctx, id) != 0 || pagedSync(ctx) != 0 ? -1 : 0; }
+
+static void pagedMenuExtra(void *ctx, int choice) { // Options 7-10
+    PagedStore *ps = ctx;
+    int rc;
+    if (choice == 7) {
+        int lo, hi;
+        printf("Lowest and highest ID: ");
+        if (scanf("%d %d", &lo, &hi) != 2) {
+            printf("Invalid input. Please enter two IDs.\n");
+            clearInput();
+            return;
+        }
+        if (ps->count == 0) printf("No items to display.\n");
+        else if (pagedScan(ps, lo, hi, printPagedItem, NULL) != 0) printf("Error reading items from file.\n");
+    } else if (choice == 8) {
+        char path[256];
+        long added;
+        printf("Items file to import: ");
+        if (scanf("%255s", path) != 1) return;
+        double start = nowSeconds();
+        rc = pagedImportItems(ps, path, &added);
+        if (rc != 0) printf("Error %d importing %s: %s\n", rc, path, itemsErrorString(rc));
+        else printf("Imported %ld new items in %.2f s, %lld items in the store.\n", added, nowSeconds() - start, ps->count);
+    } else if (choice == 9) {
+        rc = pagedCheckpoint(ps);
+        if (rc == 0) printf("Checkpoint %llu written.\n", (unsigned long long)ps->checkpoint);
+        else printf("Error %d writing the checkpoint, the log still has every change.\n", rc);
+    } else {
+        reportPagedStats(ps);
+    }
+}
+
+static int runPagedMenu(const char *filename, int poolPages) { // Menu over a paged store: only the pool's pages are in memory
+    PagedStore ps;
+    int result = pagedOpen(&ps, filename, poolPages); // Recovers an interrupted checkpoint and replays the log
+    if (result < 0) {
+        printf("Error %d opening paged store %s.\n", result, filename);
+        return 1;
+    }
+    if (result == 1) printf("No file found, starting a new paged store.\n");
+    else printf("Loaded %lld items successfully (paged store, %d pool pages).\n", ps.count, ps.pool.nFrames);
+    static const char *const extras[] = { "List an ID range", "Import an items file", "Checkpoint", "Storage statistics", NULL };
+    MenuOps ops = { "paged", extras, &ps, pagedMenuLive, pagedMenuList, pagedMenuGet, pagedMenuAdd,
+                    pagedMenuSetQuantity, pagedMenuDelete, pagedMenuExtra };
+    runMenu(&ops);
+    if (pagedClose(&ps) != 0) printf("Warning: final checkpoint failed, the log still has every change.\n");
+    return 0;
+}
+
+static int runSplitCommand(int argc, char *argv[]) { // --split <source> <manifest> <shards> [hash|range]
+    int shards = atoi(argv[4]);
+    ShardScheme scheme = argc >= 6 && strcmp(argv[5], "range") == 0 ? SHARD_BY_RANGE : SHARD_BY_HASH;
+    if (shards < 1 || shards > SHARD_MAX) { printf("Shard count must be between 1 and %d.\n", SHARD_MAX); return 1; }
+    double start = nowSeconds();
+    int rc = shardSplit(argv[2], argv[3], shards, scheme, 0); // Shard files written in parallel, manifest renamed in last
+    if (rc != 0) { printf("Split %s -> %s failed: %s\n", argv[2], argv[3], itemsErrorString(rc)); return 1; }
+    printf("Split %s -> %s: %d shards by %s in %.2f s\n", argv[2], argv[3], shards, scheme == SHARD_BY_RANGE ? "id range" : "id hash", nowSeconds() - start);
+    return 0;
+}
+
+typedef struct { // Sharded menu state, the statistics also show where the shards are and how they were opened
+    ShardedInventory si;
+    const char *filename;
+    int loadThreads;
+} ShardedMenu;
+
+static long shardedMenuLive(void *ctx) { return shardedLive(&((ShardedMenu *)ctx)->si); }
+
+static int shardedMenuList(void *ctx) { // Shard by shard
+    const ShardedInventory *si = &((ShardedMenu *)ctx)->si;
+    uint64_t listStart = metricsBegin(MET_LIST);
+    for (int s = 0; s < si->layout.count; ++s) {
+        const Inventory *inv = &si->shards[s];
+        for (int i = 0; i < inv->count; ++i) {
+            if (inventorySlotLive(inv, i)) printItem(&inv->items[i]); // Skip deleted slots
+        }
+    }
+    metricsFinish(MET_LIST, listStart);
+    return 0;
+}
+
+static int shardedMenuGet(void *ctx, int id, Item *out) {
+    const Item *found = shardedGet(&((ShardedMenu *)ctx)->si, id); // One shard's index
+    if (!found) return 1;
+    *out = *found;
+    return 0;
+}
+
+static int shardedMenuAdd(void *ctx, const Item *item) {
+    ShardedInventory *si = &((ShardedMenu *)ctx)->si;
+    return shardedAdd(si, item) != 0 || shardedWaitDurable(si) != 0 ? -1 : 0;
+}
+
+static int shardedMenuSetQuantity(void *ctx, int id, int quantity) {
+    ShardedInventory *si = &((ShardedMenu *)ctx)->si;
+    return shardedSetQuantity(si, id, quantity) != 0 || shardedWaitDurable(si) != 0 ? -1 : 0;
+}
+
+static int shardedMenuDelete(void *ctx, int id) {
+    ShardedInventory *si = &((ShardedMenu *)ctx)->si;
+    return shardedDelete(si, id) != 0 || shardedWaitDurable(si) != 0 ? -1 : 0;
+}
+
+static void shardedMenuExtra(void *ctx, int choice) { // Option 7, shard statistics
+    const ShardedMenu *m = ctx;
+    (void)choice;
+    printf("%d shards by %s, opened on %s in %.3f s:\n", m->si.layout.count, m->si.layout.scheme == SHARD_BY_RANGE ? "id range" : "id hash",
+           m->loadThreads > 0 ? "the given threads" : "one thread per CPU", m->si.openSeconds);
+    for (int s = 0; s < m->si.layout.count; ++s) {
+        char path[WAL_PATH_MAX];
+        shardPath(path, sizeof path, m->filename, &m->si.layout, s);
+        printf("  %-40s %8d items, log %ld bytes\n", path, m->si.shards[s].live, m->si.shards[s].wal.size);
+    }
+}
+
+static int runShardedMenu(const char *filename, int loadThreads) { // Menu over a shard manifest, each change touches one shard
+    ShardedMenu m = { .filename = filename, .loadThreads = loadThreads };
+    int result = shardedOpen(&m.si, filename, 0, loadThreads); // Shards loaded and indexed concurrently
+    if (result != 0) {
+        printf("Error %d loading items: %s\n", result, itemsErrorString(result));
+        return 1;
+    }
+    printf("Loaded %ld items successfully (%d shards in %.3f s).\n", shardedLive(&m.si), m.si.layout.count, m.si.openSeconds);
+    static const char *const extras[] = { "Shard statistics", NULL };
+    MenuOps ops = { "sharded", extras, &m, shardedMenuLive, shardedMenuList, shardedMenuGet, shardedMenuAdd,
+                    shardedMenuSetQuantity, shardedMenuDelete, shardedMenuExtra };
+    runMenu(&ops);
+    shardedClose(&m.si);
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
-    const char *filename = (argc >= 2) ? argv[1] : "items.dat"; // Default filename for items
-    Item *items = NULL; // Pointer to dynamically allocated array of items
-    int count = 0; // Number of items loaded
+    const char *filename = "items.dat"; // Default filename for items
+    metricsDumpOnSignal(); // kill -USR1 / -USR2 prints the metrics (text / JSON) to stderr; before any other thread starts
+    int useMmap = 0; // --mmap maps the file instead of copying it into memory
+    int verify = 0; // --verify checks block checksums of a mapped file up front
+    if (argc == 4 && strcmp(argv[1], "--convert") == 0) { // --convert <legacy file> <new file>
+        int rc = convertLegacyItems(argv[2], argv[3]); // Rewrite an old raw dump in the current format
+        printf("Convert %s -> %s: %s\n", argv[2], argv[3], itemsErrorString(rc));
+        return rc == 0 ? 0 : 1;
+    }
+    if (argc == 4 && (strcmp(argv[1], "--compact") == 0 || strcmp(argv[1], "--expand") == 0)) { // Switch a file between record layouts
+        return runCompactCommand(argv[1], argv[2], argv[3]);
+    }
+    if ((argc == 5 || argc == 6) && strcmp(argv[1], "--split") == 0) { // --split <source> <manifest> <shards> [hash|range]
+        return runSplitCommand(argc, argv);
+    }
+    if (argc >= 3 && (strcmp(argv[1], "import") == 0 || strcmp(argv[1], "export") == 0)) { // import|export <csv> [filename]
+        return runCsvCommand(argv[1], argv[2], argc >= 4 ? argv[3] : filename);
+    }
+    if (argc >= 3 && strcmp(argv[1], "batch") == 0) { // Non-interactive command stream
+        return runBatchCommand(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "colbench") == 0) { // Row vs column aggregation benchmark
+        return runColumnsBenchmark(argc, argv);
+    }
+    if (argc >= 3 && strcmp(argv[1], "serve") == 0) { // Network server on a Unix socket
+        return runServeCommand(argc, argv);
+    }
+    if (argc >= 4 && strcmp(argv[1], "publish") == 0) { // Change feed to followers
+        return runPublishCommand(argc, argv);
+    }
+    if (argc == 4 && strcmp(argv[1], "follow") == 0) { // Read replica of a published feed
+        return runFollowCommand(argv[2], argv[3]);
+    }
+    if (argc == 3 && strcmp(argv[1], "replica-status") == 0) {
+        return runReplicaStatus(argv[2]);
+    }
+    if (argc >= 4 && strcmp(argv[1], "shm-get") == 0) { // Lock-free reads from another process's inventory
+        return runSharedGet(argc, argv);
+    }
+    CommitOptions co = { GC_DEFAULT_DELAY_US, GC_DEFAULT_BATCH, 0 };
+    int paged = 0, poolPages = BP_DEFAULT_FRAMES; // --paged: items live in a page file, only --pool-pages of it in memory
+    int loadThreads = 0; // --load-threads: threads opening the shards of a manifest, 0 for one per CPU
+    int cdc = 0; // --cdc: keep a change feed for followers
+    const char *shmName = NULL; // --shm: publish the items in shared memory for readers in other processes
+    for (int i = 1; i < argc; ++i) { // Parse command line: [--mmap] [--verify] [--paged] [--pool-pages N] [--load-threads N] [--commit-delay US] [--commit-batch N] [--no-sync] [--cdc] [--shm NAME] [filename]
+        if (strcmp(argv[i], "--mmap") == 0) useMmap = 1;
+        else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) shmName = argv[++i];
+        else if (strcmp(argv[i], "--cdc") == 0) cdc = 1;
+        else if (strcmp(argv[i], "--verify") == 0) verify = 1;
+        else if (strcmp(argv[i], "--paged") == 0) paged = 1;
+        else if (strcmp(argv[i], "--pool-pages") == 0 && i + 1 < argc) poolPages = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--load-threads") == 0 && i + 1 < argc) loadThreads = atoi(argv[++i]);
+        else if (!commitOption(argc, argv, &i, &co)) filename = argv[i];
+    }
+    if (shmName && (paged || compactFileDetect(filename) || pagedFileDetect(filename) || shardFileDetect(filename))) {
+        printf("--shm needs a plain items file, %s is compact, paged or a shard manifest.\n", filename); // Their menus have no shared copy
+        return 1;
+    }
+    if (compactFileDetect(filename)) return runCompactMenu(filename); // Compact files get their own, arena-backed menu
+    if (paged || pagedFileDetect(filename)) return runPagedMenu(filename, poolPages); // So do page files
+    if (shardFileDetect(filename)) return runShardedMenu(filename, loadThreads); // and shard manifests
+    Inventory inv; // Items, id index and write-ahead log
     // Example usage of the item and fileio functions
-    int result = loadItems(filename, &items, &count); // Load items from file and store in items array
+    int flags = (useMmap ? INV_OPEN_MMAP : 0) | (verify ? INV_OPEN_VERIFY : 0);
+    int result = inventoryOpen(&inv, filename, flags); // Load items from file, index them and open the log
     if (result == 1){
-        printf("No file found, starting with %d items.\n", count); // If no file is found, we start with a count of 2 items
+        printf("No file found, starting with %d items.\n", inv.live); // If no file is found, we start with no items
     } else if (result == 0){
-        printf("Loaded %d items successfully. \n", count); // If items are loaded successfully, print the count
+        printf("Loaded %d items successfully. \n", inv.live); // If items are loaded successfully, print the count
     } else {
-        printf("Error %d loading items\n", result); // If there is an error loading items, print the error code
+        printf("Error %d loading items: %s\n", result, itemsErrorString(result)); // If there is an error loading items, print the error code
+        return 1; // Carrying on would overwrite the file with an empty inventory
+    }
+    if (inv.duplicates > 0) {
+        printf("Warning: %d duplicate item IDs in file, only the first of each is searchable.\n", inv.duplicates); // Let the user know about bad data
+    }
+    if (inventoryEnableSecondary(&inv, 0) != 0) { // Category and price indexes, built in parallel
+        printf("Warning: not enough memory for the category/price index, option 7 is unavailable.\n");
+    }
+    if (inventoryEnableNameIndex(&inv, 0) != 0) { // Prefix trie and trigrams, built in parallel
+        printf("Warning: not enough memory for the name index, option 14 is unavailable.\n");
+    }
+    if (inventoryEnableColumns(&inv) != 0) { // Columnar copy for option 8, the rows are used without it
+        printf("Warning: not enough memory for the columnar copy, option 8 will scan the rows.\n");
     }
+    ChangeFeed cf;
+    if (openFeed(&inv, &cf, cdc) != 0) { inventoryClose(&inv); return 1; }
+    openShared(&inv, shmName);
+    inventoryBackgroundSnapshots(&inv, 1); // Saving a large file happens in a forked child, the menu stays responsive
+    startGroupCommit(&inv, &co); // Each change is synced within the commit delay, exit waits for the last sync
 
     while(1){
         int choice;
+        if (inventoryPollSnapshot(&inv) < 0) printf("Warning: background snapshot failed, the log still has every change.\n"); // Reap a finished child
         printf("Inventory Menu:\n"); // Display the inventory menu
         printf("1. List all items\n"); // Placeholder for listing all items
         printf("2. Add new item\n"); // Placeholder for adding new item
         printf("3. Search by ID\n"); // Placeholder for other options
         printf("4. Update quantity\n");
         printf("5. Delete item\n");
-        printf("Enter choice (1-5, 6 to exit): ");
+        printf("7. Find by category and price range\n");
+        printf("8. Stock summary\n");
+        printf("9. Save snapshot in background\n");
+        printf("10. Durability statistics\n");
+        printf("11. Query\n");
+        printf("12. Highest / lowest items\n");
+        printf("13. Operation metrics\n");
+        printf("14. Search by name\n");
+        printf("Enter choice (1-%d, 6 to exit): ", MENU_LAST);
         if (scanf("%d", &choice) != 1){ // Get user choice
-            printf("Invalid input. Please enter a number between 1 and 6.\n"); //handle invalid input
+            printf("Invalid input. Please enter a number between 1 and %d.\n", MENU_LAST); //handle invalid input
             int c; while ((c = getchar()) != '\n' && c != EOF); // Clear the input buffer
             continue; // Skip to the next iteration
         } 
         switch (choice){
             case 1: // List all items
-                if (count == 0){
+                if (inv.live == 0){
                     printf("No items to display.\n"); // If no items are loaded, display this message
                     break; // Break out of the switch case
                  } else {
-                    for (int i = 0; i < count; ++i){
-                        printItem(&items[i]);
+                    uint64_t listStart = metricsBegin(MET_LIST); // Timed with the printing, that is what the user waits for
+                    for (int i = 0; i < inv.count; ++i){
+                        if (inventorySlotLive(&inv, i)) printItem(&inv.items[i]); // Skip deleted slots
                     }
+                    metricsFinish(MET_LIST, listStart);
                  }
                 break; // Break out of the switch case
             // Add new item
@@ -54,6 +802,11 @@ int main(int argc, char *argv[]) {
                     int c; while ((c = getchar()) != '\n' && c != EOF); // Clear the input buffer
                     break; // Break out of the switch case
                 }
+                if (inventoryFind(&inv, newItem.id) >= 0) { // Reject ids that are already in use
+                    printf("An item with ID %d already exists.\n", newItem.id); // If ID is taken, display this message
+                    int c; while ((c = getchar()) != '\n' && c != EOF); // Clear the input buffer
+                    break; // Break out of the switch case
+                }
                 getchar(); // Clear the newline character left in the input buffer after reading ID
 
                 printf("Name: "); // Prompt for item name
@@ -88,14 +841,8 @@ int main(int argc, char *argv[]) {
                 scanf("%d", &cat); // Read item category
                 newItem.category = (cat >= 0 && cat <= 3) ? (Category)cat : OTHER; // Validate category input
                 
-                //Expand the items array to accommodate the new item
-                Item *temp = realloc(items, (count + 1) * sizeof *temp); // Reallocate memory for items array
-                if (!temp){ perror("realloc failed"); break; } // Handle memory allocation failure
-                items = temp; // Update items pointer to the newly allocated memory
-
-                // Assign and save the new item
-                items[count++] = newItem; // Add the new item to the items array
-                if (saveItems("items.dat", items, count) != 0) { // Save items to file
+                // Add and save the new item (the container grows geometrically and logs it)
+                if (inventoryAdd(&inv, &newItem) != 0) {
                     printf("Error saving items to file.\n"); // If saving fails, display this message
                 } else {
                     printf("Item added successfully.\n"); // If saving is successful, display this message
@@ -111,17 +858,12 @@ int main(int argc, char *argv[]) {
                     break; // Break out of the switch case
                 }
 
-                //search loop
-                int found = 0; // Flag to indicate if item is found
-                for (int i =0; i < count; ++i){
-                    if (items[i].id == targetId) { // Check if item ID matches
-                        printf("Item found:\n"); // If item is found, display this message
-                        printItem(&items[i]); // Print the found item
-                        found = 1; // Set found flag to true
-                        break; // Break out of the loop
-                    }
-                }
-                if (!found) { // If item is not found
+                //search the index
+                const Item *found = inventoryGet(&inv, targetId); // The item, or NULL
+                if (found) {
+                    printf("Item found:\n"); // If item is found, display this message
+                    printItem(found); // Print the found item
+                } else { // If item is not found
                     printf("Item with ID %d not found.\n", targetId); // Display this message
                 }
                 break; // Break out of the switch case
@@ -136,13 +878,7 @@ int main(int argc, char *argv[]) {
                 }
                 
                 //find item to update
-                int foundIndex = -1; // Initialize found index to -1
-                for (int i = 0; i < count; ++i) { // Loop through items to find the item with the given ID
-                    if (items[i].id == targetId) { // Check if item ID matches
-                        foundIndex = i; // Set found index to current index
-                        break; // Break out of the loop
-                    }
-                }
+                int foundIndex = inventoryFind(&inv, targetId); // Look the item up in the index
                 if (foundIndex < 0) { // If item is not found
                     printf("No Item with ID %d exists.\n", targetId); // Display this message
                     break; // Break out of the switch case
@@ -158,8 +894,7 @@ int main(int argc, char *argv[]) {
                 }
 
                 // Update and save the new quantity
-                items[foundIndex].quantity = newQty; // Update the quantity of the found item
-                if(saveItems("items.dat", items, count) != 0) { // Save items to file
+                if(inventorySetQuantity(&inv, targetId, newQty) != 0) { // Update and log the quantity change
                     printf("Error saving items to file.\n"); // If saving fails, display this message
                 } else {
                     printf("Quantity updated successfully.\n"); // If saving is successful, display this message
@@ -174,32 +909,11 @@ int main(int argc, char *argv[]) {
                     break; // Break out of the switch case
                 }
 
-                int idx = -1; // Initialize index to -1
-                for(int i = 0; i < count; ++i) { // Loop through items to find the item with the given ID
-                    if (items[i].id == targetId) { // Check if item ID matches
-                        idx = i; // Set index to current index
-                        break; // Break out of the loop
-                    }
-                }
-                if (idx < 0) { // If item is not found
+                // delete leaves a tombstone, the container compacts once enough pile up
+                int rc = inventoryDelete(&inv, targetId);
+                if (rc == 1) { // If item is not found
                     printf("No Item with ID %d exists.\n", targetId); // Display this message
-                    break; // Break out of the switch case
-                }
-
-                // shift items to delete the found item
-                memmove(&items[idx], &items[idx + 1], (count - idx - 1) * sizeof(Item)); // Shift items to delete the found item
-                count--; // Decrease the count of items
-
-                // Shrink the items array
-                Item *tmpd = realloc(items, count * sizeof *tmpd); // Reallocate memory for items array
-                if (tmpd || count == 0) items = tmpd; // Update items pointer to the newly allocated memory if successful
-                if (!tmpd && count > 0) { // If memory allocation fails and count is greater than 0
-                    perror("realloc failed"); // Handle memory allocation failure
-                    break; // Break out of the switch case
-                }
-
-                //persist the changes
-                if(saveItems("items.dat", items, count) == 0){ // Save items to file
+                } else if (rc == 0) {
                     printf("Item with ID %d deleted successfully.\n", targetId); // If saving is successful, display this message
                 } else {
                     printf("Error saving after deleting.\n"); // If saving fails, display this message
@@ -208,18 +922,183 @@ int main(int argc, char *argv[]) {
             
             case 6: // Exit the program
                  // save items to file before exiting
-                 saveItems("items.dat", items, count); // Save items to file
-                 free(items); // Free the dynamically allocated memory for items
+                 // everything is already in the log, just close it
+                 inventoryClose(&inv); // Close the log and free the items
+                 changeFeedClose(&cf); // Marked clean, so followers carry on next time
                     printf("Exiting program.\n");
                     return 0; // Exit the program
             
+            case 7: { // Category + price range through the secondary indexes
+                int qcat;
+                float lo, hi;
+                printf("Category (-1: Any, 0: Electronics, 1: Clothing, 2: Food, 3: Other): "); // Prompt for the category filter
+                if (scanf("%d", &qcat) != 1) {
+                    printf("Invalid input. Please enter a valid category.\n");
+                    int c; while ((c = getchar()) != '\n'&& c != EOF); // Clear the input buffer
+                    break;
+                }
+                printf("Minimum and maximum price: "); // Prompt for the price range
+                if (scanf("%f %f", &lo, &hi) != 2) {
+                    printf("Invalid input. Please enter two prices.\n");
+                    int c; while ((c = getchar()) != '\n'&& c != EOF); // Clear the input buffer
+                    break;
+                }
+                int matches = inventoryFindByPrice(&inv, qcat, lo, hi, NULL, 0); // Count first
+                if (matches < 0) { printf("The category/price index is unavailable.\n"); break; }
+                if (matches == 0) { printf("No matching items.\n"); break; }
+                int *slots = malloc((size_t)matches * sizeof *slots);
+                if (!slots) { perror("malloc failed"); break; }
+                inventoryFindByPrice(&inv, qcat, lo, hi, slots, matches); // Then collect, cheapest first
+                for (int i = 0; i < matches; ++i) printItem(&inv.items[slots[i]]);
+                printf("%d matching items.\n", matches);
+                free(slots);
+                break;
+            }
+
+            case 8: { // Aggregates over the columnar copy
+                ColumnSummary sum;
+                double value[COL_CATEGORIES];
+                inventoryValueByCategory(&inv, value); // One pass for all categories
+                printf("%-12s %8s %12s %14s %10s %10s\n", "Category", "Items", "Quantity", "Value", "Min price", "Max price");
+                for (int k = -1; k < COL_CATEGORIES; ++k) {
+                    inventorySummarize(&inv, k, &sum);
+                    printf("%-12s %8ld %12lld %14.2f %10.2f %10.2f\n", k < 0 ? "All" : categorytostring((Category)k),
+                           sum.count, sum.quantity, k < 0 ? sum.value : value[k], sum.minPrice, sum.maxPrice);
+                }
+                break;
+            }
+
+            case 9: { // Fork a snapshot writer and show how the previous ones went
+                int src = inventorySnapshotNow(&inv);
+                if (src == 0) printf("Snapshot started in the background.\n");
+                else if (src == 1) printf(snapshotRunning(&inv.snap) ? "A snapshot is already running.\n" : "Nothing to save, the inventory is not backed by a file.\n");
+                else printf("Could not start a snapshot (%d).\n", src);
+                const SnapshotMetrics *m = &inv.snap.metrics;
+                printf("Snapshots: %ld completed, %ld failed\n", m->completed, m->failed);
+                if (m->completed > 0) {
+                    printf("Last: %ld items in %.1f ms, parent stalled %.3f ms in fork + %.3f ms trimming the log\n",
+                           m->items, m->durationMs, m->forkMs, m->trimMs);
+                    printf("Copy-on-write: %ld page faults in the parent (~%.1f MB copied)\n", m->cowFaults,
+                           m->cowFaults * (double)m->pageSize / (1024.0 * 1024.0));
+                }
+                break;
+            }
+
+            case 10: // Group commit figures, to tune the delay against the batch size
+                if (!inv.group) {
+                    printf("Group commit is off: changes reach the OS but are not synced.\n");
+                } else {
+                    if (inventoryWaitDurable(&inv) != 0) printf("Warning: syncing the log failed.\n");
+                    groupCommitReport(inv.group, stdout);
+                }
+                if (cdc) changeFeedReport(&cf, stdout);
+                break;
+
+            case 11: { // Filters, projections and aggregates, see query.h
+                char text[BATCH_LINE_MAX], err[QUERY_ERROR_MAX];
+                Query q;
+                QueryResult res;
+                int c; while ((c = getchar()) != '\n' && c != EOF); // Drop the rest of the choice line
+                printf("Query (e.g. category=food and quantity<10, or select count, sum(value) where price>100): ");
+                if (!fgets(text, sizeof text, stdin)) break;
+                text[strcspn(text, "\n")] = 0;
+                if (queryParse(text, &q, err) != 0) { printf("Invalid query: %s\n", err); break; }
+                double start = nowSeconds();
+                if (inventoryQuery(&inv, &q, q.aggregate ? NULL : printQueryItem, &q, &res) != 0) { perror("Query failed"); break; }
+                double ms = (nowSeconds() - start) * 1e3;
+                if (q.aggregate) queryPrintAggregates(&q, &res, stdout, 1);
+                printf("%ld matching items (%ld slots scanned in %.3f ms).\n", res.matched, res.scanned, ms);
+                break;
+            }
+
+            case 12: { // Top-K / bottom-K through bounded heaps, no full sort
+                int field, largest, k, qcat;
+                printf("Rank by (0: Quantity, 1: Price, 2: Value): ");
+                if (scanf("%d", &field) != 1 || field < TOPK_QUANTITY || field > TOPK_VALUE) {
+                    printf("Invalid input. Please enter 0, 1 or 2.\n");
+                    int c; while ((c = getchar()) != '\n'&& c != EOF); // Clear the input buffer
+                    break;
+                }
+                printf("1: Highest, 0: Lowest: ");
+                if (scanf("%d", &largest) != 1) {
+                    printf("Invalid input. Please enter 1 or 0.\n");
+                    int c; while ((c = getchar()) != '\n'&& c != EOF); // Clear the input buffer
+                    break;
+                }
+                printf("How many items: ");
+                if (scanf("%d", &k) != 1 || k <= 0) {
+                    printf("Invalid input. Please enter a positive number.\n");
+                    int c; while ((c = getchar()) != '\n'&& c != EOF); // Clear the input buffer
+                    break;
+                }
+                printf("Category (-1: Any, 0: Electronics, 1: Clothing, 2: Food, 3: Other): ");
+                if (scanf("%d", &qcat) != 1) {
+                    printf("Invalid input. Please enter a valid category.\n");
+                    int c; while ((c = getchar()) != '\n'&& c != EOF); // Clear the input buffer
+                    break;
+                }
+                if (k > inv.live) k = inv.live; // No more than there are
+                TopKEntry *best = malloc((k ? (size_t)k : 1) * sizeof *best);
+                if (!best) { perror("malloc failed"); break; }
+                double start = nowSeconds();
+                int n = inventoryTopK(&inv, (TopKField)field, qcat, largest != 0, k, 0, best); // One thread per CPU on large inventories
+                double ms = (nowSeconds() - start) * 1e3;
+                if (n < 0) { perror("Top-K failed"); free(best); break; }
+                for (int i = 0; i < n; ++i) {
+                    printf("#%d (%s %.2f)\n", i + 1, topKFieldName((TopKField)field), best[i].key);
+                    printItem(&inv.items[best[i].slot]);
+                }
+                printf("%d items in %.3f ms.\n", n, ms);
+                free(best);
+                break;
+            }
+
+            case 13: { // Latency per operation, bytes moved and probes per lookup, see metrics.h
+                int format;
+                printf("Format (1: table, 2: JSON): ");
+                if (scanf("%d", &format) != 1 || (format != 1 && format != 2)) {
+                    printf("Invalid input. Please enter 1 or 2.\n");
+                    int c; while ((c = getchar()) != '\n' && c != EOF); // Clear the input buffer
+                    break;
+                }
+                if (metricsDump(stdout, format == 2) != 0) printf("Not enough memory for the metrics.\n");
+                break;
+            }
+
+            case 14: { // Type-ahead style: the best few matches and how many there are, see nameindex.h
+                int mode;
+                char text[sizeof(((Item *)0)->name) + 1];
+                printf("Match (1: name starts with, 2: name contains): ");
+                if (scanf("%d", &mode) != 1 || (mode != 1 && mode != 2)) {
+                    printf("Invalid input. Please enter 1 or 2.\n");
+                    int c; while ((c = getchar()) != '\n' && c != EOF); // Clear the input buffer
+                    break;
+                }
+                int c; while ((c = getchar()) != '\n' && c != EOF); // Drop the rest of the choice line
+                printf("Text: ");
+                if (!fgets(text, sizeof text, stdin)) break;
+                if (!strchr(text, '\n')) { while ((c = getchar()) != '\n' && c != EOF); } // Longer than any name: the rest cannot match anyway
+                text[strcspn(text, "\n")] = 0;
+                int slots[NAME_RESULTS];
+                double start = nowSeconds();
+                long matches = mode == 1 ? inventoryFindByNamePrefix(&inv, text, slots, NAME_RESULTS)
+                                         : inventoryFindByNameText(&inv, text, slots, NAME_RESULTS);
+                double ms = (nowSeconds() - start) * 1e3;
+                if (matches < 0) { printf("The name index is unavailable.\n"); break; }
+                long shown = matches < NAME_RESULTS ? matches : NAME_RESULTS;
+                for (long i = 0; i < shown; ++i) printItem(&inv.items[slots[i]]);
+                printf("%ld matching items (best %ld shown) in %.3f ms.\n", matches, shown, ms);
+                break;
+            }
+
             default: // Handle invalid choice
-                printf("Invalid choice. Please enter a number between 1 and 6.\n"); // If the choice is invalid, display this message
+                printf("Invalid choice. Please enter a number between 1 and %d.\n", MENU_LAST); // If the choice is invalid, display this message
                 break; // Break out of the switch case
         }
     }
 
-    free(items); // Free the dynamically allocated memory for items
+    inventoryClose(&inv); // Close the log and free the items
+    changeFeedClose(&cf);
 
     return 0;
 }
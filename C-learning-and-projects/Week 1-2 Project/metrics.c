@@ -0,0 +1,208 @@
+#define _GNU_SOURCE // clock_gettime
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include "metrics.h"
+
+int metricsEnabled = 1;
+uint64_t metricsBytes[2];
+__thread uint64_t metricsTick[MET_OPS];
+
+typedef struct ThreadTicks { // A thread's per-item counts, linked in so metricsRead can add them up
+    uint64_t *tick; // Its metricsTick
+    uint64_t base[MET_OPS]; // Its counts at the last reset
+    struct ThreadTicks *prev, *next;
+} ThreadTicks;
+
+static __thread ThreadTicks self;
+static __thread int joined; // 'self' is in the list
+static __thread int depth; // Bulk operations running on this thread (plus metricsNest)
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; // Guards everything below
+static ThreadTicks *threads; // Threads that recorded and are still running
+static uint64_t opCount[MET_OPS]; // Bulk operations, plus the per-item ones of threads that exited
+static pthread_key_t exitKey; // Its destructor takes a finished thread out of the list
+static Histogram latency[MET_OPS];
+static Histogram probes;
+static uint64_t since; // When recording started
+static const char *const opNames[MET_OPS] = {"load", "save", "add", "get", "update", "delete", "list"};
+
+uint64_t metricsClock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec; // Time since boot, so never 0
+}
+
+static void clearHistograms(void) { // Called with the lock held (or before main)
+    for (int op = 0; op < MET_OPS; ++op) histInit(&latency[op]); // histInit sets the minimum, a zeroed histogram would not
+    histInit(&probes);
+    since = metricsClock();
+}
+
+static void leave(void *arg) { // Thread exit: its counts move into opCount
+    ThreadTicks *t = arg;
+    pthread_mutex_lock(&lock);
+    for (int op = 0; op < MET_OPS; ++op) opCount[op] += t->tick[op] - t->base[op];
+    if (t->prev) t->prev->next = t->next;
+    else threads = t->next;
+    if (t->next) t->next->prev = t->prev;
+    pthread_mutex_unlock(&lock);
+}
+
+static void join(void) { // Called with the lock held: the first operation a thread times is its first of all
+    self.tick = metricsTick;
+    memset(self.base, 0, sizeof self.base);
+    self.prev = NULL;
+    self.next = threads;
+    if (threads) threads->prev = &self;
+    threads = &self;
+    joined = 1;
+    pthread_setspecific(exitKey, &self);
+}
+
+static void lockForFork(void) { pthread_mutex_lock(&lock); } // A forked snapshot writer records its save: never inherit a held lock
+static void unlockAfterFork(void) { pthread_mutex_unlock(&lock); }
+
+__attribute__((constructor)) static void metricsInit(void) {
+    clearHistograms();
+    pthread_key_create(&exitKey, leave);
+    pthread_atfork(lockForFork, unlockAfterFork, unlockAfterFork);
+}
+
+void metricsRecord(MetricsOp op, uint64_t start) {
+    uint64_t now = metricsClock();
+    pthread_mutex_lock(&lock);
+    if (!joined) join();
+    histRecord(&latency[op], now - start);
+    pthread_mutex_unlock(&lock);
+}
+
+void metricsEndLookup(MetricsOp op, uint64_t start, int probeCount) {
+    if (!start) return;
+    uint64_t now = metricsClock();
+    pthread_mutex_lock(&lock);
+    if (!joined) join();
+    histRecord(&latency[op], now - start);
+    histRecord(&probes, (uint64_t)probeCount);
+    pthread_mutex_unlock(&lock);
+}
+
+uint64_t metricsBegin(MetricsOp op) {
+    if (depth++ > 0 || !metricsEnabled) return 0; // Part of an operation already being timed
+    pthread_mutex_lock(&lock); // Rare enough for the lock
+    opCount[op]++;
+    pthread_mutex_unlock(&lock);
+    return metricsClock();
+}
+
+void metricsFinish(MetricsOp op, uint64_t start) {
+    depth--;
+    if (start) metricsRecord(op, start);
+}
+
+void metricsNest(int delta) {
+    depth += delta;
+}
+
+void metricsEnable(int on) {
+    metricsEnabled = on;
+}
+
+void metricsReset(void) {
+    pthread_mutex_lock(&lock);
+    clearHistograms();
+    memset(opCount, 0, sizeof opCount);
+    for (ThreadTicks *t = threads; t; t = t->next) {
+        for (int op = 0; op < MET_OPS; ++op) t->base[op] = __atomic_load_n(&t->tick[op], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&metricsBytes[0], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&metricsBytes[1], 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&lock);
+}
+
+void metricsRead(MetricsSnapshot *out) {
+    uint64_t now = metricsClock();
+    pthread_mutex_lock(&lock);
+    memcpy(out->latency, latency, sizeof latency);
+    out->probes = probes;
+    out->seconds = (now - since) / 1e9;
+    for (int op = 0; op < MET_OPS; ++op) {
+        out->ops[op] = opCount[op];
+        for (ThreadTicks *t = threads; t; t = t->next) out->ops[op] += __atomic_load_n(&t->tick[op], __ATOMIC_RELAXED) - t->base[op];
+    }
+    pthread_mutex_unlock(&lock);
+    out->bytesRead = __atomic_load_n(&metricsBytes[0], __ATOMIC_RELAXED);
+    out->bytesWritten = __atomic_load_n(&metricsBytes[1], __ATOMIC_RELAXED);
+}
+
+const char *metricsOpName(MetricsOp op) {
+    return op >= 0 && op < MET_OPS ? opNames[op] : "?";
+}
+
+static void dumpText(const MetricsSnapshot *m, FILE *out) {
+    fprintf(out, "Operation metrics over %.1f s (add/get/update/delete timed 1 in %d):\n", m->seconds, METRICS_SAMPLE_EVERY);
+    fprintf(out, "%-8s %12s %10s %10s %10s %10s %10s %10s\n", "op", "count", "timed", "mean us", "p50 us", "p99 us", "p99.9 us", "max us");
+    for (int op = 0; op < MET_OPS; ++op) {
+        const Histogram *h = &m->latency[op];
+        fprintf(out, "%-8s %12llu %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", opNames[op], (unsigned long long)m->ops[op],
+                (unsigned long long)h->total, histMean(h) / 1e3, histPercentile(h, 50.0) / 1e3, histPercentile(h, 99.0) / 1e3,
+                histPercentile(h, 99.9) / 1e3, h->max / 1e3);
+    }
+    fprintf(out, "Bytes read: %llu, written: %llu\n", (unsigned long long)m->bytesRead, (unsigned long long)m->bytesWritten);
+    fprintf(out, "Buckets probed per lookup: mean %.2f, p99 %llu, max %llu (%llu lookups timed)\n", histMean(&m->probes),
+            (unsigned long long)histPercentile(&m->probes, 99.0), (unsigned long long)m->probes.max,
+            (unsigned long long)m->probes.total);
+}
+
+static void dumpJson(const MetricsSnapshot *m, FILE *out) {
+    fprintf(out, "{\"seconds\":%.3f,\"sample_every\":%d,\"bytes_read\":%llu,\"bytes_written\":%llu,\"ops\":{", m->seconds,
+            METRICS_SAMPLE_EVERY, (unsigned long long)m->bytesRead, (unsigned long long)m->bytesWritten);
+    for (int op = 0; op < MET_OPS; ++op) {
+        fprintf(out, "%s\"%s\":{\"count\":%llu,\"latency_ns\":", op ? "," : "", opNames[op], (unsigned long long)m->ops[op]);
+        histWriteJson(&m->latency[op], out);
+        fputc('}', out);
+    }
+    fputs("},\"probes_per_lookup\":", out);
+    histWriteJson(&m->probes, out);
+    fputs("}\n", out);
+}
+
+int metricsDump(FILE *out, int json) {
+    MetricsSnapshot *m = malloc(sizeof *m); // The histograms are large
+    if (!m) return -1;
+    metricsRead(m);
+    if (json) dumpJson(m, out);
+    else dumpText(m, out);
+    fflush(out);
+    free(m);
+    return 0;
+}
+
+#if defined(SIGUSR1) && defined(SIGUSR2)
+static void *signalDumper(void *arg) { // Waits for the blocked signals, outside any handler so stdio is safe
+    sigset_t *set = arg;
+    for (;;) {
+        int sig;
+        if (sigwait(set, &sig) != 0) continue;
+        metricsDump(stderr, sig == SIGUSR2);
+    }
+    return NULL;
+}
+
+int metricsDumpOnSignal(void) {
+    static sigset_t set; // Read by the dumper for as long as the process lives
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) return -1;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, signalDumper, &set) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+#else
+int metricsDumpOnSignal(void) {
+    return -1; // No user signals on this platform
+}
+#endif
@@ -0,0 +1,96 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <stdio.h>
+#include <stdint.h>
+#include "histogram.h"
+
+/*
+Process-wide operation metrics, always on: a latency histogram per kind of
+operation, the bytes read and written by items files and logs, and how
+many index buckets each lookup probed. Every operation is counted, but only
+bulk ones (load, save, list) are timed every time; the per-item ones (add,
+get, update, delete) are timed one in METRICS_SAMPLE_EVERY per thread, so
+their cost is a thread-local increment most of the time. The histograms
+and the other counters are shared (behind a mutex, or atomic), so any
+thread (shard loaders, the server) may record. metricsDump prints
+everything as text or JSON; after metricsDumpOnSignal, SIGUSR1 prints the
+text form and SIGUSR2 the JSON form to stderr at any time.
+*/
+#define METRICS_SAMPLE_EVERY 1024 // Per-item operations: one in this many is timed (a power of two)
+
+typedef enum { MET_LOAD, MET_SAVE, MET_ADD, MET_GET, MET_UPDATE, MET_DELETE, MET_LIST, MET_OPS } MetricsOp;
+
+typedef struct { // A copy of everything, see metricsRead
+    uint64_t ops[MET_OPS]; // Operations of each kind
+    uint64_t bytesRead, bytesWritten; // Items files and logs, in bytes
+    Histogram latency[MET_OPS]; // Nanoseconds of the timed operations
+    Histogram probes; // Index buckets examined per timed lookup
+    double seconds; // Since the process started recording (or the last reset)
+} MetricsSnapshot;
+
+extern int metricsEnabled; // 0 stops all recording (see metricsEnable)
+extern uint64_t metricsBytes[2]; // Read, written
+extern __thread uint64_t metricsTick[MET_OPS]; // Per-item operations of each kind on this thread (summed by metricsRead)
+
+/* Monotonic clock in nanoseconds (never 0) */
+uint64_t metricsClock(void);
+
+/*
+Counts one per-item operation and returns its start time if this one is
+timed, 0 otherwise. Pass the result to metricsEnd
+*/
+static inline uint64_t metricsStart(MetricsOp op) {
+    if (!metricsEnabled) return 0;
+    uint64_t n = metricsTick[op];
+    __atomic_store_n(&metricsTick[op], n + 1, __ATOMIC_RELAXED); // A plain store, only this thread writes it
+    if ((n & (METRICS_SAMPLE_EVERY - 1)) != 0) return 0; // The first of each kind is timed, then one in N
+    return metricsClock();
+}
+
+/* Records the latency of an operation started with metricsStart or metricsBegin (nothing if 'start' is 0) */
+void metricsRecord(MetricsOp op, uint64_t start);
+static inline void metricsEnd(MetricsOp op, uint64_t start) {
+    if (start) metricsRecord(op, start);
+}
+
+/* metricsEnd for a lookup that examined 'probes' index buckets */
+void metricsEndLookup(MetricsOp op, uint64_t start, int probes);
+
+/*
+Counts and times a bulk operation; end it with metricsFinish. One started
+while another is running on the same thread (or inside metricsNest) is
+part of it and not recorded on its own, e.g. the shards of a sharded load
+*/
+uint64_t metricsBegin(MetricsOp op);
+void metricsFinish(MetricsOp op, uint64_t start);
+
+/* Marks the calling thread as working for a bulk operation (+1) or done with it (-1) */
+void metricsNest(int delta);
+
+static inline void metricsAddRead(uint64_t bytes) { __atomic_fetch_add(&metricsBytes[0], bytes, __ATOMIC_RELAXED); }
+static inline void metricsAddWritten(uint64_t bytes) { __atomic_fetch_add(&metricsBytes[1], bytes, __ATOMIC_RELAXED); }
+
+/* Turns recording on (the default) or off, e.g. to measure what it costs */
+void metricsEnable(int on);
+
+/* Clears every counter and histogram */
+void metricsReset(void);
+
+/* Copies the current figures into 'out' (large: allocate it) */
+void metricsRead(MetricsSnapshot *out);
+
+/* "load", "save", "add", "get", "update", "delete" or "list" */
+const char *metricsOpName(MetricsOp op);
+
+/* Prints the figures as a table ('json' 0) or one JSON object. Returns 0, -1 if out of memory */
+int metricsDump(FILE *out, int json);
+
+/*
+Starts a thread that dumps the metrics to stderr on SIGUSR1 (text) and
+SIGUSR2 (JSON). Call it before any other thread is started: both signals
+are blocked in the caller, and threads inherit that. Returns 0, -1 if the
+thread could not be started (or there are no such signals here)
+*/
+int metricsDumpOnSignal(void);
+
+#endif // METRICS_H
@@ -0,0 +1,558 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nameindex.h"
+#include "shardio.h"
+
+#define NAME_LEN_MAX ((int)sizeof(((Item *)0)->name) - 1) // Longest name an item can hold
+
+static inline unsigned char lower(unsigned char c) { // ASCII only, other bytes compare as they are
+    return c >= 'A' && c <= 'Z' ? (unsigned char)(c + 32) : c;
+}
+
+static inline uint32_t gramSymbol(unsigned char c) { // Folds a byte to 0..63: space, letters, digits, then the rest hashed
+    c = lower(c);
+    if (c >= 'a' && c <= 'z') return (uint32_t)(c - 'a' + 1);
+    if (c >= '0' && c <= '9') return (uint32_t)(c - '0' + 27);
+    if (c == ' ') return 0;
+    return 37 + c % 27u;
+}
+
+static inline uint32_t gramOf(const char *p) {
+    return gramSymbol((unsigned char)p[0]) << 12 | gramSymbol((unsigned char)p[1]) << 6 | gramSymbol((unsigned char)p[2]);
+}
+
+static int nameLength(const char *name) { // Names are NUL-terminated inside the field, but never trust that
+    return (int)strnlen(name, NAME_LEN_MAX);
+}
+
+static int lowerCopy(char *out, const char *s, int len) {
+    for (int i = 0; i < len; ++i) out[i] = (char)lower((unsigned char)s[i]);
+    out[len] = '\0';
+    return len;
+}
+
+static int slotsReserve(NameSlots *l, int n) { // Grows geometrically
+    if (n <= l->capacity) return 0;
+    int newCap = l->capacity ? l->capacity * 2 : 4;
+    while (newCap < n) newCap *= 2;
+    int32_t *tmp = realloc(l->slots, (size_t)newCap * sizeof *tmp);
+    if (!tmp) return -1;
+    l->slots = tmp;
+    l->capacity = newCap;
+    return 0;
+}
+
+static int slotsAppend(NameSlots *l, int32_t slot) {
+    if (slotsReserve(l, l->count + 1) != 0) return -1;
+    l->slots[l->count++] = slot;
+    return 0;
+}
+
+static int slotsRemove(NameSlots *l, int32_t slot) { // Binary search, then close the gap. Returns 0, 1 if absent
+    int lo = 0, hi = l->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (l->slots[mid] < slot) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == l->count || l->slots[lo] != slot) return 1;
+    memmove(l->slots + lo, l->slots + lo + 1, (size_t)(l->count - lo - 1) * sizeof *l->slots);
+    l->count--;
+    return 0;
+}
+
+static void slotsRemap(NameSlots *l, const int *newSlot) { // Order is kept, deleted slots are dropped
+    int w = 0;
+    for (int r = 0; r < l->count; ++r) {
+        int s = newSlot[l->slots[r]];
+        if (s >= 0) l->slots[w++] = s;
+    }
+    l->count = w;
+}
+
+static int trieReserve(NameTrie *t, int len) { // Room for one insert: two nodes, the label bytes and a slot list
+    if (!t->nodes) {
+        t->nodes = calloc(16, sizeof *t->nodes);
+        t->lists = calloc(4, sizeof *t->lists);
+        if (!t->nodes || !t->lists) { free(t->nodes); free(t->lists); t->nodes = NULL; t->lists = NULL; return -1; }
+        t->nodeCount = 1; // The root
+        t->nodeCap = 16;
+        t->listCount = 1; // lists[0] means "none"
+        t->listCap = 4;
+    }
+    if (t->nodeCount + 2 > t->nodeCap) {
+        NameNode *tmp = realloc(t->nodes, (size_t)t->nodeCap * 2 * sizeof *tmp);
+        if (!tmp) return -1;
+        t->nodes = tmp;
+        t->nodeCap *= 2;
+    }
+    if (t->arenaLen + (uint32_t)len > t->arenaCap) {
+        uint32_t newCap = t->arenaCap ? t->arenaCap : 256;
+        while (newCap < t->arenaLen + (uint32_t)len) newCap *= 2;
+        char *tmp = realloc(t->arena, newCap);
+        if (!tmp) return -1;
+        t->arena = tmp;
+        t->arenaCap = newCap;
+    }
+    if (t->listCount + 1 > t->listCap) {
+        NameSlots *tmp = realloc(t->lists, (size_t)t->listCap * 2 * sizeof *tmp);
+        if (!tmp) return -1;
+        t->lists = tmp;
+        t->listCap *= 2;
+    }
+    return 0;
+}
+
+static uint32_t findChild(const NameTrie *t, uint32_t n, unsigned char b, uint32_t *prevPtr) { // Child whose label starts with 'b', or 0
+    uint32_t prev = 0, c = t->nodes[n].child;
+    while (c && (unsigned char)t->arena[t->nodes[c].label] < b) { // Siblings are ordered by first byte
+        prev = c;
+        c = t->nodes[c].sibling;
+    }
+    if (prevPtr) *prevPtr = prev;
+    return c && (unsigned char)t->arena[t->nodes[c].label] == b ? c : 0;
+}
+
+static int trieInsert(NameTrie *t, const char *key, int len, int32_t slot, int *created) { // Sets *created for a name not seen before
+    if (trieReserve(t, len) != 0) return -1; // Nothing below can fail half way, except the slot append
+    uint32_t path[NAME_LEN_MAX + 2]; // Nodes whose count goes up once the slot is in
+    int depth = 0;
+    uint32_t n = 0;
+    int pos = 0;
+    while (pos < len) {
+        path[depth++] = n;
+        uint32_t prev;
+        uint32_t c = findChild(t, n, (unsigned char)key[pos], &prev);
+        if (!c) { // New leaf for the rest of the key
+            uint32_t leaf = t->nodeCount++;
+            NameNode *l = &t->nodes[leaf];
+            memset(l, 0, sizeof *l);
+            l->label = t->arenaLen;
+            l->labelLen = (uint8_t)(len - pos);
+            memcpy(t->arena + t->arenaLen, key + pos, (size_t)(len - pos));
+            t->arenaLen += (uint32_t)(len - pos);
+            l->sibling = prev ? t->nodes[prev].sibling : t->nodes[n].child;
+            if (prev) t->nodes[prev].sibling = leaf;
+            else t->nodes[n].child = leaf;
+            n = leaf;
+            break;
+        }
+        NameNode *cn = &t->nodes[c];
+        int m = 1; // The first byte matched already
+        while (m < cn->labelLen && pos + m < len && t->arena[cn->label + m] == key[pos + m]) m++;
+        if (m < cn->labelLen) { // Key leaves the edge part way: split it
+            uint32_t mid = t->nodeCount++;
+            NameNode *s = &t->nodes[mid];
+            s->label = cn->label;
+            s->labelLen = (uint8_t)m;
+            s->child = c;
+            s->sibling = cn->sibling;
+            s->slots = 0;
+            s->count = cn->count;
+            cn->label += (uint32_t)m;
+            cn->labelLen = (uint8_t)(cn->labelLen - m);
+            cn->sibling = 0;
+            if (prev) t->nodes[prev].sibling = mid;
+            else t->nodes[n].child = mid;
+            c = mid;
+        }
+        n = c;
+        pos += m;
+    }
+    path[depth++] = n;
+    *created = !t->nodes[n].slots;
+    if (*created) {
+        t->nodes[n].slots = t->listCount;
+        memset(&t->lists[t->listCount++], 0, sizeof *t->lists);
+    }
+    if (slotsAppend(&t->lists[t->nodes[n].slots], slot) != 0) { // Nodes made on the way stay, empty
+        if (*created) { t->nodes[n].slots = 0; t->listCount--; } // A list stands for a numbered name: never leave one unnumbered
+        return -1;
+    }
+    for (int i = 0; i < depth; ++i) t->nodes[path[i]].count++;
+    return 0;
+}
+
+static int trieRemove(NameTrie *t, const char *key, int len, int32_t slot) {
+    if (!t->nodes) return 1;
+    uint32_t path[NAME_LEN_MAX + 2];
+    int depth = 0;
+    uint32_t n = 0;
+    int pos = 0;
+    while (pos < len) {
+        path[depth++] = n;
+        uint32_t c = findChild(t, n, (unsigned char)key[pos], NULL);
+        if (!c) return 1;
+        const NameNode *cn = &t->nodes[c];
+        if (cn->labelLen > len - pos || memcmp(t->arena + cn->label, key + pos, cn->labelLen) != 0) return 1;
+        n = c;
+        pos += cn->labelLen;
+    }
+    path[depth++] = n;
+    if (!t->nodes[n].slots || slotsRemove(&t->lists[t->nodes[n].slots], slot) != 0) return 1;
+    for (int i = 0; i < depth; ++i) t->nodes[path[i]].count--; // Empty nodes stay for the next add of the name
+    return 0;
+}
+
+static long triePrefix(const NameTrie *t, const char *key, int len) { // Node holding every name that starts with 'key', or -1
+    if (!t->nodes) return -1;
+    uint32_t n = 0;
+    int pos = 0;
+    while (pos < len) {
+        uint32_t c = findChild(t, n, (unsigned char)key[pos], NULL);
+        if (!c) return -1;
+        const NameNode *cn = &t->nodes[c];
+        int m = cn->labelLen < len - pos ? cn->labelLen : len - pos; // The key may end inside the edge
+        if (memcmp(t->arena + cn->label, key + pos, (size_t)m) != 0) return -1;
+        n = c;
+        pos += m;
+    }
+    return (long)n;
+}
+
+static void collect(const NameTrie *t, uint32_t n, int *out, int maxOut, int *written) { // Depth first, children in byte order
+    const NameNode *node = &t->nodes[n];
+    if (node->count == 0) return;
+    if (node->slots) {
+        const NameSlots *l = &t->lists[node->slots];
+        for (int i = 0; i < l->count && *written < maxOut; ++i) out[(*written)++] = l->slots[i];
+    }
+    for (uint32_t c = node->child; c && *written < maxOut; c = t->nodes[c].sibling) collect(t, c, out, maxOut, written);
+}
+
+static void trieFree(NameTrie *t) {
+    for (uint32_t i = 1; i < t->listCount; ++i) free(t->lists[i].slots);
+    free(t->lists);
+    free(t->nodes);
+    free(t->arena);
+    memset(t, 0, sizeof *t);
+}
+
+void nameIndexFree(NameIndex *idx) {
+    for (int b = 0; b < NAME_TRIES; ++b) trieFree(&idx->tries[b]);
+    if (idx->grams) {
+        for (int g = 0; g < NAME_GRAMS; ++g) free(idx->grams[g].slots);
+        free(idx->grams);
+    }
+    free(idx->names);
+    free(idx->text);
+    idx->grams = NULL;
+    idx->names = NULL;
+    idx->text = NULL;
+    idx->nameCount = idx->nameCap = 0;
+    idx->textLen = idx->textCap = 0;
+}
+
+typedef struct { // nameIndexBuild: the tasks share this
+    NameIndex *idx;
+    const Item *items;
+    int parts; // Trigram slices: slice p owns the trigrams g with g % parts == p
+    int *order; // Live slots grouped by trie, ascending within each
+    int start[NAME_TRIES + 1]; // Where each trie's group begins in 'order'
+    int failed;
+} NameBuild;
+
+static int reserveName(NameIndex *idx, int len) { // Room to number one more name of 'len' bytes
+    if (idx->nameCount == idx->nameCap) {
+        uint32_t newCap = idx->nameCap ? idx->nameCap * 2 : 64;
+        NameRef *tmp = realloc(idx->names, (size_t)newCap * sizeof *tmp);
+        if (!tmp) return -1;
+        idx->names = tmp;
+        idx->nameCap = newCap;
+    }
+    if (idx->textLen + (uint32_t)len > idx->textCap) {
+        uint32_t newCap = idx->textCap ? idx->textCap : 4096;
+        while (newCap < idx->textLen + (uint32_t)len) newCap *= 2;
+        char *tmp = realloc(idx->text, newCap);
+        if (!tmp) return -1;
+        idx->text = tmp;
+        idx->textCap = newCap;
+    }
+    return 0;
+}
+
+static uint32_t pushName(NameIndex *idx, uint32_t trie, uint32_t list, const char *low, int len) { // Room was reserved
+    NameRef *r = &idx->names[idx->nameCount];
+    r->list = list;
+    r->text = idx->textLen;
+    r->trie = (uint8_t)trie;
+    r->len = (uint8_t)len;
+    memcpy(idx->text + idx->textLen, low, (size_t)len);
+    idx->textLen += (uint32_t)len;
+    return idx->nameCount++;
+}
+
+static void buildTrie(void *ctx, int trie) {
+    NameBuild *b = ctx;
+    char low[NAME_LEN_MAX + 1];
+    int created;
+    for (int i = b->start[trie]; i < b->start[trie + 1]; ++i) {
+        int slot = b->order[i];
+        int len = lowerCopy(low, b->items[slot].name, nameLength(b->items[slot].name));
+        if (trieInsert(&b->idx->tries[trie], low, len, slot, &created) != 0) { b->failed = 1; return; }
+    }
+}
+
+static void buildGrams(void *ctx, int part) { // Counts, then fills, the lists of one slice: exact sizes, no regrowth
+    NameBuild *b = ctx;
+    NameIndex *idx = b->idx;
+    NameSlots *grams = idx->grams;
+    uint32_t *seen = calloc(NAME_GRAMS, sizeof *seen); // Name number + 1 that last touched each trigram
+    if (!seen) { b->failed = 1; return; }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint32_t name = 0; name < idx->nameCount; ++name) {
+            const char *text = idx->text + idx->names[name].text;
+            int len = idx->names[name].len;
+            for (int i = 0; i + 3 <= len; ++i) {
+                uint32_t g = gramOf(text + i);
+                if (g % (uint32_t)b->parts != (uint32_t)part || seen[g] == name + 1) continue; // Not ours, or twice in one name
+                seen[g] = name + 1;
+                if (pass == 0) grams[g].capacity++;
+                else grams[g].slots[grams[g].count++] = (int32_t)name;
+            }
+        }
+        if (pass == 1) break;
+        memset(seen, 0, NAME_GRAMS * sizeof *seen);
+        for (uint32_t g = (uint32_t)part; g < NAME_GRAMS; g += (uint32_t)b->parts) {
+            if (grams[g].capacity == 0) continue;
+            if (!(grams[g].slots = malloc((size_t)grams[g].capacity * sizeof *grams[g].slots))) { b->failed = 1; break; }
+        }
+        if (b->failed) break;
+    }
+    free(seen);
+}
+
+int nameIndexBuild(NameIndex *idx, const Item *items, int count, int threads) {
+    nameIndexFree(idx);
+    memset(idx, 0, sizeof *idx);
+    NameBuild *b = calloc(1, sizeof *b);
+    idx->grams = calloc(NAME_GRAMS, sizeof *idx->grams);
+    int *order = malloc((count ? (size_t)count : 1) * sizeof *order);
+    if (!b || !idx->grams || !order) { free(b); free(order); nameIndexFree(idx); return -1; }
+    for (int slot = 0; slot < count; ++slot) { // Group the live slots by first byte (counting sort, stays ascending)
+        if (items[slot].id != 0 && items[slot].name[0]) b->start[lower((unsigned char)items[slot].name[0]) + 1]++;
+    }
+    for (int t = 0; t < NAME_TRIES; ++t) b->start[t + 1] += b->start[t];
+    int fill[NAME_TRIES];
+    memcpy(fill, b->start, sizeof fill);
+    for (int slot = 0; slot < count; ++slot) {
+        if (items[slot].id != 0 && items[slot].name[0]) order[fill[lower((unsigned char)items[slot].name[0])]++] = slot;
+    }
+    b->idx = idx;
+    b->items = items;
+    b->order = order;
+    shardParallel(NAME_TRIES, threads, buildTrie, b); // One task per trie
+    char low[NAME_LEN_MAX + 1];
+    for (uint32_t t = 0; t < NAME_TRIES && !b->failed; ++t) { // Number the distinct names, trie by trie, and copy their text
+        const NameTrie *trie = &idx->tries[t];
+        for (uint32_t l = 1; l < trie->listCount; ++l) {
+            const char *name = items[trie->lists[l].slots[0]].name; // Every list has an item right after a build
+            int len = lowerCopy(low, name, nameLength(name));
+            if (reserveName(idx, len) != 0) { b->failed = 1; break; }
+            pushName(idx, t, l, low, len);
+        }
+    }
+    if (!b->failed) {
+        int parts = threads > 0 ? threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (parts < 1) parts = 1;
+        if (parts > SHARD_MAX_THREADS) parts = SHARD_MAX_THREADS;
+        b->parts = parts;
+        shardParallel(parts, threads, buildGrams, b); // Then the trigram slices over the names
+    }
+    int failed = b->failed;
+    free(order);
+    free(b);
+    if (failed) { nameIndexFree(idx); return -1; }
+    return 0;
+}
+
+int nameIndexAdd(NameIndex *idx, int slot, const char *name) {
+    char low[NAME_LEN_MAX + 1];
+    int len = lowerCopy(low, name, nameLength(name));
+    if (len == 0) return 0; // Nothing to find it by
+    if (reserveName(idx, len) != 0) return -1; // Room for a new name and its trigrams first: after the trie insert nothing may fail
+    for (int i = 0; i + 3 <= len; ++i) {
+        NameSlots *l = &idx->grams[gramOf(low + i)];
+        if (slotsReserve(l, l->count + 1) != 0) return -1;
+    }
+    uint32_t trie = (unsigned char)low[0];
+    int created;
+    if (trieInsert(&idx->tries[trie], low, len, slot, &created) != 0) return -1;
+    if (!created) return 0; // Known name: its trigrams are in already
+    uint32_t number = pushName(idx, trie, idx->tries[trie].listCount - 1, low, len); // The list just made
+    for (int i = 0; i + 3 <= len; ++i) {
+        NameSlots *l = &idx->grams[gramOf(low + i)];
+        if (l->count == 0 || l->slots[l->count - 1] != (int32_t)number) l->slots[l->count++] = (int32_t)number; // Same trigram twice in one name
+    }
+    return 0;
+}
+
+int nameIndexRemove(NameIndex *idx, int slot, const char *name) {
+    char low[NAME_LEN_MAX + 1];
+    int len = lowerCopy(low, name, nameLength(name));
+    if (len == 0) return 1;
+    return trieRemove(&idx->tries[(unsigned char)low[0]], low, len, slot); // The name keeps its number and trigrams
+}
+
+int nameIndexRemap(NameIndex *idx, const int *newSlot) {
+    for (int b = 0; b < NAME_TRIES; ++b) {
+        NameTrie *t = &idx->tries[b];
+        for (uint32_t i = 1; i < t->listCount; ++i) slotsRemap(&t->lists[i], newSlot); // Trigram lists hold names, not slots
+    }
+    return 0;
+}
+
+long nameIndexPrefix(const NameIndex *idx, const char *prefix, int *out, int maxOut) {
+    int len = (int)strlen(prefix);
+    if (len > NAME_LEN_MAX) return 0; // Longer than any name
+    char low[NAME_LEN_MAX + 1];
+    lowerCopy(low, prefix, len);
+    int written = 0;
+    if (len == 0) { // Every name, in order
+        long total = 0;
+        for (int b = 0; b < NAME_TRIES; ++b) {
+            const NameTrie *t = &idx->tries[b];
+            if (!t->nodes) continue;
+            total += t->nodes[0].count;
+            collect(t, 0, out, maxOut, &written);
+        }
+        return total;
+    }
+    const NameTrie *t = &idx->tries[(unsigned char)low[0]];
+    long n = triePrefix(t, low, len);
+    if (n < 0) return 0;
+    collect(t, (uint32_t)n, out, maxOut, &written);
+    return t->nodes[n].count;
+}
+
+typedef struct { // A matching name and how good it is
+    uint32_t key; // rank * 64 + name length: lower is better
+    int32_t slot; // Its first item, breaks ties
+    uint32_t name;
+} NameHit;
+
+static int hitWorse(NameHit a, NameHit b) {
+    return a.key != b.key ? a.key > b.key : a.slot > b.slot;
+}
+
+static void siftDown(NameHit *heap, int size, NameHit h) { // Puts 'h' at the top and lets it sink
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= size) break;
+        if (c + 1 < size && hitWorse(heap[c + 1], heap[c])) c++;
+        if (!hitWorse(heap[c], h)) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = h;
+}
+
+static void heapPush(NameHit *heap, int *size, int cap, NameHit h) { // Keeps the 'cap' best hits, worst on top
+    if (*size < cap) {
+        int i = (*size)++;
+        while (i > 0 && hitWorse(h, heap[(i - 1) / 2])) { heap[i] = heap[(i - 1) / 2]; i = (i - 1) / 2; }
+        heap[i] = h;
+    } else if (cap > 0 && hitWorse(heap[0], h)) { // Better than the worst kept
+        siftDown(heap, *size, h);
+    }
+}
+
+static int isWordByte(unsigned char c) {
+    c = lower(c);
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+static int matchRank(const char *name, int len, const char *q, int qlen) { // Both lowercased. 0 starts the name, 1 starts a word, 2 inside one, -1 no match
+    int best = -1;
+    for (int i = 0; i + qlen <= len; ++i) {
+        if (name[i] != q[0]) continue;
+        int k = 1;
+        while (k < qlen && name[i + k] == q[k]) k++;
+        if (k < qlen) continue;
+        int rank = i == 0 ? 0 : !isWordByte((unsigned char)name[i - 1]) ? 1 : 2;
+        if (best < 0 || rank < best) best = rank;
+        if (best < 2) break; // Later occurrences cannot beat the start of a word
+    }
+    return best;
+}
+
+static int gallop(const NameSlots *l, int from, int32_t value) { // First index >= from holding a value >= 'value'
+    for (int i = 0; i < 4; ++i, ++from) { // Lists of similar length advance a step or two: look before leaping
+        if (from == l->count || l->slots[from] >= value) return from;
+    }
+    int step = 1, lo = from, hi = from;
+    while (hi < l->count && l->slots[hi] < value) { lo = hi + 1; hi += step; step *= 2; }
+    if (hi > l->count) hi = l->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (l->slots[mid] < value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static long checkName(const NameIndex *idx, uint32_t name, const char *q, int qlen, NameHit *heap, int *size,
+                      int maxOut) { // Items of one candidate name that match, 0 if it does not
+    const NameRef *r = &idx->names[name];
+    const char *text = idx->text + r->text;
+    int len = r->len;
+    if (len < qlen) return 0;
+    const NameSlots *l = &idx->tries[r->trie].lists[r->list];
+    if (l->count == 0) return 0; // Every item of it was deleted
+    int rank = matchRank(text, len, q, qlen); // Trigrams can all be there without the text
+    if (rank < 0) return 0;
+    heapPush(heap, size, maxOut, (NameHit){ (uint32_t)(rank * 64 + len), l->slots[0], name });
+    return l->count;
+}
+
+long nameIndexSearch(const NameIndex *idx, const char *text, int *out, int maxOut) {
+    int qlen = (int)strlen(text);
+    if (qlen == 0 || qlen > NAME_LEN_MAX || !idx->grams) return 0;
+    char q[NAME_LEN_MAX + 1];
+    lowerCopy(q, text, qlen);
+    NameHit *heap = malloc((maxOut > 0 ? (size_t)maxOut : 1) * sizeof *heap); // Never more names than slots wanted
+    if (!heap) return -1;
+    int size = 0;
+    long matches = 0;
+    if (qlen < NAME_SHORT_QUERY) { // No trigram to narrow it down: check every distinct name
+        for (uint32_t name = 0; name < idx->nameCount; ++name) matches += checkName(idx, name, q, qlen, heap, &size, maxOut);
+    } else {
+        const NameSlots *lists[NAME_LEN_MAX];
+        int n = 0;
+        for (int i = 0; i + 3 <= qlen; ++i) { // Distinct trigram lists of the query, rarest first
+            const NameSlots *l = &idx->grams[gramOf(q + i)];
+            int dup = 0;
+            for (int j = 0; j < n; ++j) dup |= lists[j] == l;
+            if (dup) continue;
+            int j = n++;
+            while (j > 0 && lists[j - 1]->count > l->count) { lists[j] = lists[j - 1]; j--; }
+            lists[j] = l;
+        }
+        int cursor[NAME_LEN_MAX] = {0};
+        for (int i = 0; i < lists[0]->count; ++i) {
+            int32_t name = lists[0]->slots[i];
+            int all = 1, exhausted = 0;
+            for (int j = 1; j < n && all; ++j) { // Merge-intersect: the lists only move forward
+                cursor[j] = gallop(lists[j], cursor[j], name);
+                if (cursor[j] == lists[j]->count) exhausted = 1;
+                all = !exhausted && lists[j]->slots[cursor[j]] == name;
+            }
+            if (exhausted) break;
+            if (all) matches += checkName(idx, (uint32_t)name, q, qlen, heap, &size, maxOut);
+        }
+    }
+    for (int i = size - 1; i > 0; --i) { // Heap sort in place: best name first
+        NameHit worst = heap[0];
+        siftDown(heap, i, heap[i]);
+        heap[i] = worst;
+    }
+    int written = 0;
+    for (int i = 0; i < size && written < maxOut; ++i) { // Each name's items in slot order
+        const NameSlots *l = &idx->tries[idx->names[heap[i].name].trie].lists[idx->names[heap[i].name].list];
+        for (int k = 0; k < l->count && written < maxOut; ++k) out[written++] = l->slots[k];
+    }
+    free(heap);
+    return matches;
+}
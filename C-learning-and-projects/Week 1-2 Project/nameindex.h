@@ -0,0 +1,107 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+#include <stdint.h>
+#include "item.h"
+
+/*
+Name search, case-insensitive (ASCII):
+- prefix lookup in a radix trie of the lowercased names, one trie per
+  first byte so they can be built on separate threads. Nodes live in one
+  array per trie and name each other by index; edge labels are stored once
+  in a byte arena. Every node knows how many names are below it, so the
+  number of matches is known as soon as the prefix is found.
+- substring search through a trigram index over the distinct names (the
+  trie's terminal nodes, numbered in order of appearance): one list of
+  name numbers per trigram (letters folded to lower case, other bytes to 64
+  symbols), ascending, so the lists of a query intersect by merging. The
+  rarest list drives, and each candidate is checked and ranked once per
+  distinct name however many items share it, against a lowercased copy of
+  the name kept with the index (the items themselves are never touched).
+Adds append to the slot list of their name; only a name never seen before
+touches the trigram lists. Deletes only take the slot out of its name's list
+(a name left without items stays known, and is skipped by searches).
+*/
+#define NAME_TRIES 256 // One trie per (lowercased) first byte
+#define NAME_GRAM_SYMBOLS 64 // Folded byte values in a trigram
+#define NAME_GRAMS (NAME_GRAM_SYMBOLS * NAME_GRAM_SYMBOLS * NAME_GRAM_SYMBOLS)
+#define NAME_SHORT_QUERY 3 // Substring queries shorter than this (no trigram) scan the distinct names
+
+typedef struct { // One trie node: the edge into it and what lies below
+    uint32_t label; // Offset of the edge label in the trie's arena
+    uint8_t labelLen;
+    uint32_t child; // First child (children are ordered by their first byte), 0 for none
+    uint32_t sibling; // Next child of the same parent, 0 for none
+    uint32_t slots; // Index of the slot list of names ending here, 0 for none
+    uint32_t count; // Names ending at or below this node
+} NameNode;
+
+typedef struct { // Growable slot list, ascending
+    int32_t *slots;
+    int count, capacity;
+} NameSlots;
+
+typedef struct { // Radix trie over the names starting with one byte
+    NameNode *nodes; // nodes[0] is the root (empty label)
+    uint32_t nodeCount, nodeCap;
+    char *arena; // Edge labels
+    uint32_t arenaLen, arenaCap;
+    NameSlots *lists; // Slots per name, lists[0] unused
+    uint32_t listCount, listCap;
+} NameTrie;
+
+typedef struct { // A distinct name
+    uint32_t list; // Its slot list in its trie
+    uint32_t text; // Offset of its lowercased text in the index's text arena
+    uint8_t trie; // Index in 'tries'
+    uint8_t len;
+} NameRef;
+
+typedef struct {
+    NameTrie tries[NAME_TRIES];
+    NameSlots *grams; // NAME_GRAMS lists of name numbers
+    NameRef *names; // Name number -> its trie, slot list and text
+    uint32_t nameCount, nameCap;
+    char *text; // The distinct names, lowercased, back to back
+    uint32_t textLen, textCap;
+} NameIndex;
+
+/*
+Rebuilds the index from 'count' slots of 'items' (id 0 marks a deleted
+slot). The tries are built as separate tasks on 'threads' threads (<= 0:
+one per CPU), then the slices of the trigram table. Returns 0 on success, -1 on failure
+*/
+int nameIndexBuild(NameIndex *idx, const Item *items, int count, int threads);
+
+/* Releases everything */
+void nameIndexFree(NameIndex *idx);
+
+/*
+Indexes 'name' at 'slot', which must be above every slot indexed so far
+(adds always take the next slot). Returns 0 on success, -1 on failure
+*/
+int nameIndexAdd(NameIndex *idx, int slot, const char *name);
+
+/* Forgets 'name' at 'slot'. Returns 0, 1 if it was not indexed */
+int nameIndexRemove(NameIndex *idx, int slot, const char *name);
+
+/*
+Re-points every entry after compaction: 'newSlot[old]' is the new slot of
+a surviving slot and -1 for a deleted one. Returns 0 on success
+*/
+int nameIndexRemap(NameIndex *idx, const int *newSlot);
+
+/*
+Slots of the names starting with 'prefix', in name order (shorter names
+first among equal prefixes, equal names by slot). Writes up to 'maxOut'
+slots and returns the number of matches. Cost is O(prefix length + maxOut)
+*/
+long nameIndexPrefix(const NameIndex *idx, const char *prefix, int *out, int maxOut);
+
+/*
+Slots of the items whose name contains 'text', best first: names starting with it, then names with a word starting with
+it, then the rest, shorter names before longer ones within each group.
+Writes up to 'maxOut' slots and returns the number of matches, -1 if out of memory
+*/
+long nameIndexSearch(const NameIndex *idx, const char *text, int *out, int maxOut);
+
+#endif // NAMEINDEX_H
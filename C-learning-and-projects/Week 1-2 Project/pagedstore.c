@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "pagedstore.h"
+#include "byteorder.h"
+
+#define NODE_LEAF 1
+#define NODE_INNER 2
+#define NODE_HEADER 16 // Type, entries, next leaf, reserved, CRC
+#define META_VERSION 8 // Field offsets within page 0
+#define META_PAGE_SIZE 16
+#define META_ROOT 20
+#define META_HEIGHT 24
+#define META_COUNT 32
+#define META_CHECKPOINT 40
+#define META_BLOOM_DELETES 48
+
+static inline unsigned char *leafRec(unsigned char *p, int i) { return p + NODE_HEADER + (size_t)i * ITEMS_RECORD_SIZE; }
+static inline int32_t recId(unsigned char *p, int i) { return (int32_t)getU32(leafRec(p, i) + ITEMS_REC_ID); }
+static inline uint32_t childAt(const unsigned char *p, int i) { return getU32(p + 16 + 8 * i); } // Child i sits just before key i
+static inline int32_t keyAt(const unsigned char *p, int i) { return (int32_t)getU32(p + 20 + 8 * i); }
+
+static int leafSearch(unsigned char *p, int n, int32_t id) { // First record with an id >= 'id'
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (recId(p, mid) < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int innerChild(const unsigned char *p, int n, int32_t id) { // Child whose range holds 'id': keys <= id are passed
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (keyAt(p, mid) <= id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static unsigned char *findLeaf(PagedStore *ps, int32_t id, uint32_t *pagePtr, int *errPtr) { // Pinned leaf that holds (or would hold) 'id'
+    uint32_t page = ps->root;
+    for (int level = ps->height;; --level) {
+        unsigned char *p = bpFetch(&ps->pool, page, errPtr);
+        if (!p) return NULL;
+        int type = getU16(p);
+        if (type == NODE_LEAF && level == 1) { *pagePtr = page; return p; }
+        uint32_t child = childAt(p, innerChild(p, getU16(p + 2), id));
+        bpUnpin(&ps->pool, page, 0);
+        if (type != NODE_INNER || level <= 1 || child == 0) { *errPtr = -7; return NULL; } // Not the tree the meta page describes
+        page = child;
+    }
+}
+
+typedef struct { // What a split pushes into the parent
+    int32_t key; // Lowest id of the new right node
+    uint32_t right; // Its page
+} Split;
+
+static int leafInsert(PagedStore *ps, unsigned char *p, const unsigned char *rec, int32_t id, Split *up, int *split) { // 0 added, 1 replaced
+    int n = getU16(p + 2), pos = leafSearch(p, n, id);
+    if (pos < n && recId(p, pos) == id) { memcpy(leafRec(p, pos), rec, ITEMS_RECORD_SIZE); return 1; } // Upsert
+    if (n < PAGED_LEAF_MAX) {
+        memmove(leafRec(p, pos + 1), leafRec(p, pos), (size_t)(n - pos) * ITEMS_RECORD_SIZE);
+        memcpy(leafRec(p, pos), rec, ITEMS_RECORD_SIZE);
+        putU16(p + 2, (uint16_t)(n + 1));
+        return 0;
+    }
+    uint32_t rightPage;
+    unsigned char *r = bpNew(&ps->pool, &rightPage);
+    if (!r) return -1;
+    unsigned char all[(PAGED_LEAF_MAX + 1) * ITEMS_RECORD_SIZE]; // The full leaf plus the new record, in order
+    memcpy(all, leafRec(p, 0), (size_t)pos * ITEMS_RECORD_SIZE);
+    memcpy(all + (size_t)pos * ITEMS_RECORD_SIZE, rec, ITEMS_RECORD_SIZE);
+    memcpy(all + (size_t)(pos + 1) * ITEMS_RECORD_SIZE, leafRec(p, pos), (size_t)(n - pos) * ITEMS_RECORD_SIZE);
+    int keep = pos == n && getU32(p + 4) == 0 ? n : (n + 1) / 2; // Appending to the last leaf: keep it full, rising ids pack the leaves
+    putU16(r, NODE_LEAF);
+    putU16(r + 2, (uint16_t)(n + 1 - keep));
+    putU32(r + 4, getU32(p + 4));
+    memcpy(leafRec(r, 0), all + (size_t)keep * ITEMS_RECORD_SIZE, (size_t)(n + 1 - keep) * ITEMS_RECORD_SIZE);
+    memcpy(leafRec(p, 0), all, (size_t)keep * ITEMS_RECORD_SIZE);
+    putU16(p + 2, (uint16_t)keep);
+    putU32(p + 4, rightPage);
+    *up = (Split){ recId(r, 0), rightPage };
+    *split = 1;
+    bpUnpin(&ps->pool, rightPage, 1);
+    ps->stats.splits++;
+    return 0;
+}
+
+static void writeInner(unsigned char *p, const int32_t *keys, const uint32_t *kids, int n) { // n keys, n + 1 children
+    putU16(p, NODE_INNER);
+    putU16(p + 2, (uint16_t)n);
+    for (int i = 0; i < n; ++i) {
+        putU32(p + 16 + 8 * i, kids[i]);
+        putU32(p + 20 + 8 * i, (uint32_t)keys[i]);
+    }
+    putU32(p + 16 + 8 * n, kids[n]);
+}
+
+static int innerInsert(PagedStore *ps, unsigned char *p, int ci, const Split *in, Split *up, int *split) { // Child 'ci' split into it and in->right
+    int n = getU16(p + 2);
+    if (n < PAGED_INNER_MAX) {
+        memmove(p + 28 + 8 * ci, p + 20 + 8 * ci, (size_t)8 * (n - ci)); // Keys from ci on and the children after them
+        putU32(p + 20 + 8 * ci, (uint32_t)in->key);
+        putU32(p + 24 + 8 * ci, in->right);
+        putU16(p + 2, (uint16_t)(n + 1));
+        return 0;
+    }
+    uint32_t rightPage;
+    unsigned char *r = bpNew(&ps->pool, &rightPage);
+    if (!r) return -1;
+    int32_t keys[PAGED_INNER_MAX + 1];
+    uint32_t kids[PAGED_INNER_MAX + 2];
+    for (int i = 0; i < n; ++i) keys[i + (i >= ci)] = keyAt(p, i); // Copy with the new pair in place
+    for (int i = 0; i <= n; ++i) kids[i + (i > ci)] = childAt(p, i);
+    keys[ci] = in->key;
+    kids[ci + 1] = in->right;
+    int mid = ci == n ? n : (n + 1) / 2; // keys[mid] moves up; appending keeps this node full like the leaves
+    writeInner(p, keys, kids, mid);
+    writeInner(r, keys + mid + 1, kids + mid + 1, n - mid);
+    *up = (Split){ keys[mid], rightPage };
+    *split = 1;
+    bpUnpin(&ps->pool, rightPage, 1);
+    ps->stats.splits++;
+    return 0;
+}
+
+static int insertAt(PagedStore *ps, uint32_t page, int level, const unsigned char *rec, int32_t id, Split *up, int *split) {
+    int err = -2;
+    unsigned char *p = bpFetch(&ps->pool, page, &err);
+    if (!p) return err;
+    int type = getU16(p), rc, changed = 0;
+    *split = 0;
+    if (type != (level == 1 ? NODE_LEAF : NODE_INNER)) rc = -7;
+    else if (type == NODE_LEAF) {
+        rc = leafInsert(ps, p, rec, id, up, split);
+        changed = rc >= 0;
+    } else { // The parent stays pinned while the child is changed: paths are short
+        int ci = innerChild(p, getU16(p + 2), id), childSplit;
+        Split in;
+        rc = childAt(p, ci) == 0 ? -7 : insertAt(ps, childAt(p, ci), level - 1, rec, id, &in, &childSplit);
+        if (rc >= 0 && childSplit) {
+            int irc = innerInsert(ps, p, ci, &in, up, split);
+            if (irc < 0) rc = irc;
+            changed = 1;
+        }
+    }
+    bpUnpin(&ps->pool, page, changed);
+    return rc;
+}
+
+static int insertRecord(PagedStore *ps, const Item *item) { // Upsert. Returns 0 added, 1 replaced, negative on error
+    unsigned char rec[ITEMS_RECORD_SIZE];
+    encodeItemRecord(rec, item);
+    Split up;
+    int split;
+    int rc = insertAt(ps, ps->root, ps->height, rec, item->id, &up, &split);
+    if (rc >= 0 && split) { // The root split: grow the tree by one level
+        uint32_t page;
+        unsigned char *p = ps->height < PAGED_MAX_HEIGHT ? bpNew(&ps->pool, &page) : NULL;
+        if (!p) return -1;
+        int32_t keys[1] = { up.key };
+        uint32_t kids[2] = { ps->root, up.right };
+        writeInner(p, keys, kids, 1);
+        bpUnpin(&ps->pool, page, 1);
+        ps->root = page;
+        ps->height++;
+    }
+    if (rc == 0) {
+        ps->count++;
+        bloomAdd(&ps->bloom, item->id);
+    }
+    return rc;
+}
+
+static int removeRecord(PagedStore *ps, int32_t id) { // 0 removed, 1 absent
+    uint32_t page;
+    int err = -2;
+    unsigned char *p = findLeaf(ps, id, &page, &err);
+    if (!p) return err;
+    int n = getU16(p + 2), pos = leafSearch(p, n, id);
+    if (pos >= n || recId(p, pos) != id) { bpUnpin(&ps->pool, page, 0); return 1; }
+    memmove(leafRec(p, pos), leafRec(p, pos + 1), (size_t)(n - pos - 1) * ITEMS_RECORD_SIZE);
+    putU16(p + 2, (uint16_t)(n - 1));
+    bpUnpin(&ps->pool, page, 1);
+    ps->count--;
+    ps->bloomDeletes++;
+    return 0;
+}
+
+static int updateQuantity(PagedStore *ps, int32_t id, int quantity) { // 0 updated, 1 absent
+    uint32_t page;
+    int err = -2;
+    unsigned char *p = findLeaf(ps, id, &page, &err);
+    if (!p) return err;
+    int n = getU16(p + 2), pos = leafSearch(p, n, id);
+    int found = pos < n && recId(p, pos) == id;
+    if (found) putU32(leafRec(p, pos) + ITEMS_REC_QUANTITY, (uint32_t)quantity);
+    bpUnpin(&ps->pool, page, found);
+    return found ? 0 : 1;
+}
+
+static int writeMeta(PagedStore *ps, uint64_t checkpoint) { // Fills page 0 from the in-memory fields
+    int err = -2;
+    unsigned char *m = bpFetch(&ps->pool, 0, &err);
+    if (!m) return err;
+    memset(m, 0, PAGE_SIZE);
+    memcpy(m, PAGED_MAGIC, 8);
+    putU32(m + META_VERSION, PAGED_FORMAT_VERSION);
+    putU32(m + META_PAGE_SIZE, PAGE_SIZE);
+    putU32(m + META_ROOT, ps->root);
+    putU32(m + META_HEIGHT, (uint32_t)ps->height);
+    putU64(m + META_COUNT, (uint64_t)ps->count);
+    putU64(m + META_CHECKPOINT, checkpoint);
+    putU64(m + META_BLOOM_DELETES, (uint64_t)ps->bloomDeletes);
+    bpUnpin(&ps->pool, 0, 1);
+    return 0;
+}
+
+static int readMeta(PagedStore *ps) {
+    int err = -2;
+    unsigned char *m = bpFetch(&ps->pool, 0, &err);
+    if (!m) return err;
+    int rc = 0;
+    if (memcmp(m, PAGED_MAGIC, 8) != 0 || getU32(m + META_PAGE_SIZE) != PAGE_SIZE) rc = -4;
+    else if (getU32(m + META_VERSION) != PAGED_FORMAT_VERSION) rc = -5;
+    ps->root = getU32(m + META_ROOT);
+    ps->height = (int)getU32(m + META_HEIGHT);
+    ps->count = (long long)getU64(m + META_COUNT);
+    ps->checkpoint = getU64(m + META_CHECKPOINT);
+    ps->bloomDeletes = (long)getU64(m + META_BLOOM_DELETES);
+    bpUnpin(&ps->pool, 0, 0);
+    if (rc == 0 && (ps->root == 0 || ps->root >= ps->pool.pageCount || ps->height < 1 || ps->height > PAGED_MAX_HEIGHT)) rc = -7;
+    return rc;
+}
+
+static int commitPages(PagedStore *ps) { // Meta page plus every dirty page into the file, atomically
+    int rc = writeMeta(ps, ps->checkpoint + 1);
+    if (rc == 0) rc = bpCheckpoint(&ps->pool);
+    if (rc != 0) return rc;
+    ps->checkpoint++;
+    ps->stats.checkpoints++;
+    return 0;
+}
+
+static int createTree(PagedStore *ps) { // Meta page and an empty root leaf
+    uint32_t meta, leaf;
+    if (!bpNew(&ps->pool, &meta)) return -1;
+    bpUnpin(&ps->pool, meta, 1);
+    unsigned char *p = bpNew(&ps->pool, &leaf);
+    if (!p) return -1;
+    putU16(p, NODE_LEAF);
+    bpUnpin(&ps->pool, leaf, 1);
+    ps->root = leaf;
+    ps->height = 1;
+    return commitPages(ps);
+}
+
+static void bloomPath(char *out, size_t size, const char *path) { snprintf(out, size, "%s%s", path, PAGED_BLOOM_SUFFIX); }
+
+static int addId(const Item *item, void *ctx) { bloomAdd(ctx, item->id); return 0; }
+
+static int rebuildBloom(PagedStore *ps, long expected) { // Refills the filter from the leaves
+    BloomFilter b;
+    if (bloomInit(&b, expected, BLOOM_BITS_PER_ID) != 0) {
+        bloomFree(&b);
+        return ps->bloom.bits ? 0 : -1; // The old filter is still correct, only less selective
+    }
+    int rc = pagedScan(ps, INT_MIN, INT_MAX, addId, &b);
+    if (rc < 0) { bloomFree(&b); return rc; }
+    bloomFree(&ps->bloom);
+    ps->bloom = b;
+    ps->bloomDeletes = 0;
+    return 0;
+}
+
+static int maintain(PagedStore *ps) { // Keeps the filter selective and the log and journal bounded
+    if (ps->bloom.added > ps->bloom.expected || ps->bloomDeletes > ps->count / 4 + 1024) {
+        int rc = rebuildBloom(ps, (long)ps->count * 2); // Lasts until the store doubles
+        if (rc < 0) return rc;
+    }
+    if (walNeedsCompaction(&ps->wal) || bpJournalPages(&ps->pool) >= PAGED_JOURNAL_LIMIT) return pagedCheckpoint(ps);
+    return 0;
+}
+
+static int finishChange(PagedStore *ps, int rc) { // After a logged change was applied to the tree
+    if (rc < 0) { ps->broken = 1; return rc; } // The tree may be half changed; the log has the change
+    return maintain(ps);
+}
+
+static int applyLogged(void *ctx, WalOp op, const Item *item) { // walReplay callback: upserts, so replaying twice is harmless
+    PagedStore *ps = ctx;
+    int rc;
+    if (op == WAL_OP_ADD) rc = insertRecord(ps, item);
+    else if (op == WAL_OP_QTY) rc = updateQuantity(ps, item->id, item->quantity);
+    else rc = removeRecord(ps, item->id);
+    ps->stats.replayed++;
+    return rc < 0 ? rc : 0;
+}
+
+int pagedOpen(PagedStore *ps, const char *filename, int poolPages) {
+    memset(ps, 0, sizeof *ps);
+    snprintf(ps->path, sizeof ps->path, "%s", filename);
+    int rc = bpOpen(&ps->pool, filename, poolPages);
+    if (rc < 0) return rc;
+    int isNew = rc == 1;
+    rc = isNew ? createTree(ps) : readMeta(ps);
+    if (rc == 0) {
+        char path[WAL_PATH_MAX + 8];
+        bloomPath(path, sizeof path, filename);
+        if (isNew) remove(path); // A filter left by an earlier file could come to carry a matching tag
+        if (bloomLoad(&ps->bloom, path, ps->checkpoint) != 0) rc = rebuildBloom(ps, (long)ps->count * 2); // Missing, or saved before a later checkpoint
+    }
+    if (rc == 0) {
+        rc = walReplay(filename, applyLogged, ps); // Changes after the last checkpoint
+        rc = rc == 1 ? 0 : rc;
+    }
+    if (rc == 0 && walOpen(&ps->wal, filename) != 0) rc = -3;
+    if (rc == 0 && ps->stats.replayed > 0) { // Fold the replayed changes in, so the next crash does not replay them again
+        rc = pagedCheckpoint(ps);
+        if (rc != 0) walClose(&ps->wal);
+    }
+    if (rc != 0) {
+        bloomFree(&ps->bloom);
+        bpClose(&ps->pool);
+        return rc;
+    }
+    return isNew;
+}
+
+int pagedClose(PagedStore *ps) {
+    int rc = ps->broken ? -2 : pagedCheckpoint(ps); // Broken: the log still has everything since the last checkpoint
+    walClose(&ps->wal);
+    bpClose(&ps->pool);
+    bloomFree(&ps->bloom);
+    return rc;
+}
+
+int pagedFileDetect(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 0;
+    char magic[8];
+    int found = fread(magic, 1, sizeof magic, fp) == sizeof magic && memcmp(magic, PAGED_MAGIC, 8) == 0;
+    fclose(fp);
+    return found;
+}
+
+int pagedGet(PagedStore *ps, int id, Item *out) {
+    ps->stats.lookups++;
+    if (id <= 0) return 1;
+    if (!bloomMayContain(&ps->bloom, id)) { ps->stats.bloomNegatives++; return 1; } // No page touched
+    uint32_t page;
+    int err = -2;
+    unsigned char *p = findLeaf(ps, id, &page, &err);
+    if (!p) return err;
+    int n = getU16(p + 2), pos = leafSearch(p, n, id);
+    int found = pos < n && recId(p, pos) == id;
+    if (found) decodeItemRecord(out, leafRec(p, pos));
+    else ps->stats.bloomFalsePositives++;
+    bpUnpin(&ps->pool, page, 0);
+    return found ? 0 : 1;
+}
+
+int pagedAdd(PagedStore *ps, const Item *item) {
+    if (ps->broken) return -2;
+    Item old;
+    int rc = pagedGet(ps, item->id, &old);
+    if (rc <= 0) return rc == 0 ? 1 : rc; // Taken, or the lookup failed
+    if (walAppendAdd(&ps->wal, item) != 0) return -3;
+    return finishChange(ps, insertRecord(ps, item));
+}
+
+int pagedSetQuantity(PagedStore *ps, int id, int quantity) {
+    if (ps->broken) return -2;
+    Item old;
+    int rc = pagedGet(ps, id, &old);
+    if (rc != 0) return rc;
+    if (walAppendQty(&ps->wal, id, quantity) != 0) return -3;
+    return finishChange(ps, updateQuantity(ps, id, quantity));
+}
+
+int pagedDelete(PagedStore *ps, int id) {
+    if (ps->broken) return -2;
+    Item old;
+    int rc = pagedGet(ps, id, &old);
+    if (rc != 0) return rc;
+    if (walAppendDelete(&ps->wal, id) != 0) return -3;
+    return finishChange(ps, removeRecord(ps, id));
+}
+
+int pagedSync(PagedStore *ps) {
+    return walSync(&ps->wal) == 0 ? 0 : -3;
+}
+
+int pagedScan(PagedStore *ps, int lo, int hi, PagedScanFn fn, void *ctx) {
+    uint32_t page;
+    int err = -2;
+    unsigned char *p = findLeaf(ps, lo, &page, &err);
+    if (!p) return err;
+    int i = leafSearch(p, getU16(p + 2), lo);
+    for (;;) { // Along the leaf chain until an id passes 'hi'
+        int n = getU16(p + 2);
+        for (; i < n; ++i) {
+            Item item;
+            if (recId(p, i) > hi) { bpUnpin(&ps->pool, page, 0); return 0; }
+            decodeItemRecord(&item, leafRec(p, i));
+            if (fn(&item, ctx)) { bpUnpin(&ps->pool, page, 0); return 0; }
+        }
+        uint32_t next = getU32(p + 4);
+        bpUnpin(&ps->pool, page, 0);
+        if (next == 0) return 0;
+        p = bpFetch(&ps->pool, next, &err);
+        if (!p) return err;
+        if (getU16(p) != NODE_LEAF) { bpUnpin(&ps->pool, next, 0); return -7; }
+        page = next;
+        i = 0;
+    }
+}
+
+int pagedCheckpoint(PagedStore *ps) {
+    if (ps->broken) return -2;
+    int rc = commitPages(ps);
+    if (rc != 0) return rc;
+    if (walReset(&ps->wal) != 0) return -3; // Replaying the old log again would only repeat upserts
+    char path[WAL_PATH_MAX + 8];
+    bloomPath(path, sizeof path, ps->path);
+    bloomSave(&ps->bloom, path, ps->checkpoint); // Best effort: a missing filter is rebuilt on open
+    return 0;
+}
+
+int pagedImportItems(PagedStore *ps, const char *itemsFile, long *addedPtr) {
+    Item *items;
+    int count;
+    ItemMapping map;
+    long added = 0;
+    if (addedPtr) *addedPtr = 0;
+    if (ps->broken) return -2;
+    int rc = loadItemsMapped(itemsFile, &items, &count, &map);
+    if (rc != 0) return rc;
+    if (ps->count + count > ps->bloom.expected) rc = rebuildBloom(ps, (long)(ps->count + count) * 2); // Sized for the result up front, not in doublings
+    for (int i = 0; rc >= 0 && i < count; ++i) {
+        Item old;
+        if (items[i].id <= 0) continue; // Deleted slot
+        rc = pagedGet(ps, items[i].id, &old);
+        if (rc == 1) {
+            rc = insertRecord(ps, &items[i]);
+            if (rc < 0) ps->broken = 1;
+            else added++;
+        }
+        if (rc >= 0 && bpJournalPages(&ps->pool) >= PAGED_JOURNAL_LIMIT) rc = pagedCheckpoint(ps); // Not logged: checkpoints are what keep it
+    }
+    releaseItems(items, &map);
+    if (rc >= 0) rc = pagedCheckpoint(ps);
+    if (addedPtr) *addedPtr = added;
+    return rc < 0 ? rc : 0;
+}
@@ -0,0 +1,119 @@
+#ifndef PAGEDSTORE_H
+#define PAGEDSTORE_H
+#include <stdint.h>
+#include "item.h"
+#include "fileio.h"
+#include "bufpool.h"
+#include "bloom.h"
+
+/*
+Inventory kept in a file of PAGE_SIZE pages instead of an in-memory array,
+so it can be larger than RAM. Items live in the leaves of a B+tree on id
+(sorted encoded records, leaves chained for range scans); only the pages
+in the buffer pool are in memory. A Bloom filter over the ids answers most
+lookups of missing ids without touching the tree.
+
+Page layout (all integers little-endian, bytes 12..15 are the page CRC):
+  page 0, meta:  0 magic "INVPAGES"  8 version (u32)  16 page size (u32)
+                20 root page (u32)   24 height (u32)  32 item count (u64)
+                40 checkpoint number (u64)   48 deletes since the filter was built (u64)
+  nodes:         0 type (u16, 1 leaf / 2 internal)    2 entries (u16)
+                 4 next leaf (u32, 0 for none)
+  leaf:         16 records of ITEMS_RECORD_SIZE bytes in id order
+  internal:     16 child 0 (u32), then (key i32, child u32) pairs;
+                child i holds the ids below key i, the last one the rest
+Changes are logged to <file>.wal as usual and reach the page file at
+checkpoints (see bufpool.h), so reopening after a crash replays the log
+over the last checkpoint. Deletes do not merge nodes: the room comes back
+as ids in the same range are added again. After an I/O error the store
+refuses further changes and checkpoints; reopening recovers from the last
+checkpoint and the log. The filter is saved next to the file as
+<file>.bloom, tagged with the checkpoint number; a missing or stale one
+is rebuilt from the leaves.
+*/
+#define PAGED_MAGIC "INVPAGES" // 8 bytes, no terminator stored
+#define PAGED_FORMAT_VERSION 1
+#define PAGED_BLOOM_SUFFIX ".bloom"
+#define PAGED_LEAF_MAX ((PAGE_SIZE - 16) / ITEMS_RECORD_SIZE) // 60 records per leaf
+#define PAGED_INNER_MAX ((PAGE_SIZE - 20) / 8) // 509 keys per internal node
+#define PAGED_JOURNAL_LIMIT 16384L // Journaled pages (64 MB) that force a checkpoint
+#define PAGED_MAX_HEIGHT 16
+
+typedef struct { // Lookup behaviour, for the statistics screen
+    long lookups; // pagedGet calls
+    long bloomNegatives; // Lookups the filter answered alone
+    long bloomFalsePositives; // "Maybe" answers for ids that were not there
+    long splits; // Nodes split by inserts
+    long checkpoints; // Checkpoints taken by this process
+    long replayed; // Log records applied on open
+} PagedStats;
+
+typedef struct {
+    BufferPool pool;
+    BloomFilter bloom;
+    Wal wal;
+    char path[WAL_PATH_MAX]; // The page file
+    uint32_t root;
+    int height; // Levels, 1 while the root is a leaf
+    long long count; // Live items
+    uint64_t checkpoint; // Number of the last checkpoint, tags the saved filter
+    long bloomDeletes; // Deletes since the filter was built, their ids still answer "maybe"
+    int broken; // An I/O error left the pages behind the log: no more changes
+    PagedStats stats;
+} PagedStore;
+
+/*
+Opens (creating if needed) the page file 'filename' with a pool of
+'poolPages' pages, recovers an interrupted checkpoint and replays the log.
+Returns 0 on success, 1 if the file is new, -1 out of memory, -2 I/O
+error, -3 the log cannot be opened, -4 not a page file, -5 unsupported
+version, -7 checksum mismatch
+*/
+int pagedOpen(PagedStore *ps, const char *filename, int poolPages);
+
+/* Takes a checkpoint and closes everything. Returns 0 if the checkpoint succeeded */
+int pagedClose(PagedStore *ps);
+
+/* Returns 1 if 'filename' starts with the page file magic */
+int pagedFileDetect(const char *filename);
+
+/* Copies the item with 'id' into *out. Returns 0 if found, 1 if not, negative on I/O error */
+int pagedGet(PagedStore *ps, int id, Item *out);
+
+/*
+Changes, each logged before it is applied. Return 0 on success, 1 if the
+id is taken (add) or missing (update, delete) or not positive, -3 if the
+log cannot be written, other negative codes on I/O errors
+*/
+int pagedAdd(PagedStore *ps, const Item *item);
+int pagedSetQuantity(PagedStore *ps, int id, int quantity);
+int pagedDelete(PagedStore *ps, int id);
+
+/* Forces the log to stable storage, so the changes so far survive a crash. Returns 0 on success */
+int pagedSync(PagedStore *ps);
+
+/* Called by pagedScan for every item in id order; non-zero stops the scan */
+typedef int (*PagedScanFn)(const Item *item, void *ctx);
+
+/* Visits the items with lo <= id <= hi in id order; 'fn' must not change the store. Returns 0, or negative on I/O error */
+int pagedScan(PagedStore *ps, int lo, int hi, PagedScanFn fn, void *ctx);
+
+/*
+Writes every change into the page file, saves the filter and empties the
+log. Also taken on its own once the log or the page journal grows large.
+Returns 0 on success, negative on failure
+*/
+int pagedCheckpoint(PagedStore *ps);
+
+/*
+Adds the items of the items file 'itemsFile' (mapped, so it may be large
+too) without logging them, checkpointing as the journal fills and once at
+the end. Ids already in the store are kept. *addedPtr (may be NULL)
+receives how many were added. Returns 0, or a loadItems/paged error code
+*/
+int pagedImportItems(PagedStore *ps, const char *itemsFile, long *addedPtr);
+
+/* Pages in the file, nodes of the tree included */
+static inline uint32_t pagedPageCount(const PagedStore *ps) { return ps->pool.pageCount; }
+
+#endif // PAGEDSTORE_H
@@ -0,0 +1,58 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+#include <stdint.h>
+
+/*
+Binary request/response protocol spoken over the server's Unix socket.
+Every frame starts with a 12-byte little-endian header:
+   0 frame length (u32, header included)   4 request id (u32, echoed back)
+   8 op (u8)   9 status (u8, responses only)   10 reserved (u16)
+Payloads (little-endian):
+   PROTO_GET  request: id (i32)                 response: item record (68 bytes, see fileio.h)
+   PROTO_QTY  request: id (i32), quantity (i32)
+   PROTO_DEL  request: id (i32)
+   PROTO_ADD  request: item record (68 bytes)
+   PROTO_PING request: empty
+Responses other than a successful GET carry no payload. A client may send
+any number of requests before reading responses (pipelining); responses
+on one connection come back in request order.
+*/
+#define PROTO_HEADER_SIZE 12
+#define PROTO_MAX_FRAME 256 // Largest frame either side will accept
+
+enum { // Request ops
+    PROTO_GET = 1,
+    PROTO_QTY = 2,
+    PROTO_DEL = 3,
+    PROTO_ADD = 4,
+    PROTO_PING = 5
+};
+
+enum { // Response status codes
+    PROTO_OK = 0,
+    PROTO_NOT_FOUND = 1,
+    PROTO_DUPLICATE = 2,
+    PROTO_BAD_REQUEST = 3,
+    PROTO_IO_ERROR = 4
+};
+
+static inline void protoPutU32(unsigned char *p, uint32_t v) { // Store 'v' little-endian
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static inline uint32_t protoGetU32(const unsigned char *p) { // Load a little-endian u32
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void protoPutHeader(unsigned char *p, uint32_t length, uint32_t reqId, uint8_t op, uint8_t status) {
+    protoPutU32(p, length);
+    protoPutU32(p + 4, reqId);
+    p[8] = op;
+    p[9] = status;
+    p[10] = p[11] = 0;
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,618 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "query.h"
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define QUERY_X86 1 // AVX2 is checked at runtime
+#endif
+
+#define QUERY_WORDS (QUERY_BLOCK / 64) // Mask words per block
+
+static const char *const fieldNames[] = {"id", "name", "quantity", "price", "value", "category"};
+static const char *const aggNames[] = {"", "count", "sum", "avg", "min", "max"};
+
+/* Tokenizer */
+
+typedef enum { T_END, T_WORD, T_NUM, T_STR, T_OP, T_COMMA, T_LPAREN, T_RPAREN, T_STAR, T_BAD } TokType;
+
+typedef struct {
+    TokType type;
+    char text[64]; // Word (lower-cased), string contents or operator
+    double num;
+} Token;
+
+typedef struct {
+    const char *p; // Next character
+    Token tok; // Current token
+} Lexer;
+
+static void next(Lexer *lx) { // Reads the next token into lx->tok
+    Token *t = &lx->tok;
+    while (isspace((unsigned char)*lx->p)) lx->p++;
+    const char *p = lx->p;
+    t->text[0] = '\0';
+    if (!*p) { t->type = T_END; return; }
+    if (isalpha((unsigned char)*p) || *p == '_') {
+        size_t n = 0;
+        while (isalnum((unsigned char)*p) || *p == '_') {
+            if (n < sizeof t->text - 1) t->text[n++] = (char)tolower((unsigned char)*p);
+            p++;
+        }
+        t->text[n] = '\0';
+        t->type = T_WORD;
+    } else if (isdigit((unsigned char)*p) || ((*p == '-' || *p == '.') && (isdigit((unsigned char)p[1]) || p[1] == '.'))) {
+        char *end;
+        t->num = strtod(p, &end);
+        t->type = end == p ? T_BAD : T_NUM;
+        p = end == p ? p + 1 : end;
+    } else if (*p == '\'' || *p == '"') { // Quoted text, no escapes
+        char quote = *p++;
+        size_t n = 0;
+        while (*p && *p != quote) {
+            if (n < sizeof t->text - 1) t->text[n++] = *p;
+            p++;
+        }
+        t->text[n] = '\0';
+        t->type = *p == quote ? T_STR : T_BAD;
+        if (*p) p++;
+    } else if (strchr("=!<>~", *p)) {
+        size_t n = 0;
+        t->text[n++] = *p++;
+        if ((*p == '=' && t->text[0] != '~') || (t->text[0] == '<' && *p == '>')) t->text[n++] = *p++; // ==, !=, <=, >=, <>
+        t->text[n] = '\0';
+        t->type = strcmp(t->text, "!") == 0 ? T_BAD : T_OP;
+    } else {
+        t->type = *p == ',' ? T_COMMA : *p == '(' ? T_LPAREN : *p == ')' ? T_RPAREN : *p == '*' ? T_STAR : T_BAD;
+        t->text[0] = *p++;
+        t->text[1] = '\0';
+    }
+    lx->p = p;
+}
+
+static int isWord(const Lexer *lx, const char *w) {
+    return lx->tok.type == T_WORD && strcmp(lx->tok.text, w) == 0;
+}
+
+static int fieldOf(const char *word) { // QueryField for a name, -1 if unknown
+    for (int f = 0; f < (int)(sizeof fieldNames / sizeof fieldNames[0]); ++f) {
+        if (strcmp(word, fieldNames[f]) == 0) return f;
+    }
+    return -1;
+}
+
+static int categoryOf(const char *word) { // Category for a (lower-case) name, -1 if unknown
+    for (int c = 0; c < COL_CATEGORIES; ++c) {
+        const char *n = categorytostring((Category)c);
+        size_t k = 0;
+        while (n[k] && tolower((unsigned char)n[k]) == word[k]) k++;
+        if (!n[k] && !word[k]) return c;
+    }
+    return -1;
+}
+
+static int opOf(const char *text) { // QueryOp for an operator token
+    if (strcmp(text, "=") == 0 || strcmp(text, "==") == 0) return QO_EQ;
+    if (strcmp(text, "!=") == 0 || strcmp(text, "<>") == 0) return QO_NE;
+    if (strcmp(text, "<") == 0) return QO_LT;
+    if (strcmp(text, "<=") == 0) return QO_LE;
+    if (strcmp(text, ">") == 0) return QO_GT;
+    if (strcmp(text, ">=") == 0) return QO_GE;
+    return QO_CONTAINS; // "~"
+}
+
+/* Parser */
+
+static int fail(char *err, const char *msg, const Lexer *lx) {
+    if (lx && lx->tok.type != T_END) snprintf(err, QUERY_ERROR_MAX, "%s near '%.32s'", msg, lx->tok.text);
+    else snprintf(err, QUERY_ERROR_MAX, "%s", msg);
+    return -1;
+}
+
+static void integerBounds(QueryTerm *t, double c) { // Integer column against a real constant: round so the test stays exact
+    if (c != c) { t->constant = t->op == QO_NE ? 1 : -1; return; } // NaN: only != holds
+    if (c > 2147483647.0) { t->constant = (t->op == QO_LT || t->op == QO_LE || t->op == QO_NE) ? 1 : -1; return; } // Same answer for every row
+    if (c < -2147483648.0) { t->constant = (t->op == QO_GT || t->op == QO_GE || t->op == QO_NE) ? 1 : -1; return; }
+    long long whole = (long long)c; // Truncated towards zero
+    long long below = whole - (whole > c), above = whole + (whole < c); // floor and ceil
+    switch (t->op) {
+        case QO_LT: case QO_GE: t->i = (int32_t)above; break; // q < 2.5  <=>  q < 3
+        case QO_LE: case QO_GT: t->i = (int32_t)below; break; // q <= 2.5 <=>  q <= 2
+        default:
+            t->i = (int32_t)whole;
+            if (below != above) t->constant = t->op == QO_NE ? 1 : -1; // Never equal to a fraction
+            break;
+    }
+}
+
+static int parseCondition(Lexer *lx, QueryTerm *t, char *err) { // field op constant
+    memset(t, 0, sizeof *t);
+    int f = lx->tok.type == T_WORD ? fieldOf(lx->tok.text) : -1;
+    if (f < 0) return fail(err, "expected a field", lx);
+    t->field = (QueryField)f;
+    next(lx);
+    if (lx->tok.type != T_OP) return fail(err, "expected an operator", lx);
+    t->op = (QueryOp)opOf(lx->tok.text);
+    next(lx);
+    if (t->field == QF_NAME) { // Text: exact (case-insensitive) or contains
+        if (lx->tok.type != T_STR && lx->tok.type != T_WORD) return fail(err, "expected a name", lx);
+        if (t->op != QO_EQ && t->op != QO_NE && t->op != QO_CONTAINS) return fail(err, "name takes =, != or ~", NULL);
+        snprintf(t->text, sizeof t->text, "%.50s", lx->tok.text); // Names hold at most 50 characters
+        for (char *c = t->text; *c; ++c) *c = (char)tolower((unsigned char)*c);
+        next(lx);
+        return 0;
+    }
+    if (t->op == QO_CONTAINS) return fail(err, "~ only works on name", NULL);
+    double c;
+    if (lx->tok.type == T_NUM) {
+        c = lx->tok.num;
+    } else if (t->field == QF_CATEGORY && lx->tok.type == T_WORD) {
+        int k = categoryOf(lx->tok.text);
+        if (k < 0) return fail(err, "unknown category", lx);
+        c = k;
+    } else {
+        return fail(err, "expected a number", lx);
+    }
+    next(lx);
+    if (t->field == QF_PRICE) t->f = (float)c;
+    else if (t->field == QF_VALUE) t->d = c;
+    else integerBounds(t, c);
+    if (t->field == QF_CATEGORY && t->constant == 0 && (t->i < 0 || t->i > 255)) { // Outside the byte column
+        t->constant = (t->op == QO_NE || (t->i < 0 ? t->op >= QO_GT : t->op == QO_LT || t->op == QO_LE)) ? 1 : -1;
+    }
+    return 0;
+}
+
+static int parseItem(Lexer *lx, QueryItem *it, char *err) { // count | agg(field) | field
+    if (lx->tok.type != T_WORD) return fail(err, "expected a field or aggregate", lx);
+    int agg = 0;
+    for (int a = QA_COUNT; a <= QA_MAX; ++a) if (strcmp(lx->tok.text, aggNames[a]) == 0) agg = a;
+    if (agg == 0) { // Plain field
+        int f = fieldOf(lx->tok.text);
+        if (f < 0) return fail(err, "unknown field", lx);
+        it->agg = QA_FIELD;
+        it->field = (QueryField)f;
+        next(lx);
+        return 0;
+    }
+    it->agg = (QueryAgg)agg;
+    it->field = QF_ID;
+    next(lx);
+    if (agg == QA_COUNT && lx->tok.type != T_LPAREN) return 0; // Bare "count"
+    if (lx->tok.type != T_LPAREN) return fail(err, "expected (", lx);
+    next(lx);
+    if (agg == QA_COUNT && lx->tok.type == T_STAR) {
+        next(lx);
+    } else {
+        int f = lx->tok.type == T_WORD ? fieldOf(lx->tok.text) : -1;
+        if (f < 0 || f == QF_NAME) return fail(err, "expected a numeric field", lx);
+        it->field = (QueryField)f;
+        next(lx);
+    }
+    if (lx->tok.type != T_RPAREN) return fail(err, "expected )", lx);
+    next(lx);
+    return 0;
+}
+
+static void orderTerms(Query *q) { // Cheap first: name tests go last in each "and" group, groups with names go last
+    QueryTerm out[QUERY_MAX_TERMS];
+    int n = 0;
+    for (int pass = 0; pass < 2; ++pass) { // Groups without a name test, then groups with one
+        for (int start = 0, end; start < q->nTerms; start = end + 1) {
+            int hasName = 0;
+            for (end = start; end + 1 < q->nTerms && !q->terms[end].orNext; ++end) hasName |= q->terms[end].field == QF_NAME;
+            hasName |= q->terms[end].field == QF_NAME;
+            if (hasName != pass) continue;
+            for (int name = 0; name < 2; ++name) { // Stable within the group
+                for (int k = start; k <= end; ++k) if ((q->terms[k].field == QF_NAME) == name) out[n++] = q->terms[k];
+            }
+            for (int k = n - (end - start + 1); k < n; ++k) out[k].orNext = 0;
+            out[n - 1].orNext = 1;
+        }
+    }
+    out[n - 1].orNext = 0;
+    memcpy(q->terms, out, (size_t)n * sizeof *out);
+}
+
+int queryParse(const char *text, Query *q, char err[QUERY_ERROR_MAX]) {
+    memset(q, 0, sizeof *q);
+    q->limit = -1;
+    err[0] = '\0';
+    Lexer lx = { text, {0} };
+    next(&lx);
+    if (isWord(&lx, "select")) next(&lx);
+    int conditionsFirst = 0; // "quantity<10 and ..." with no select list
+    if (lx.tok.type == T_WORD && fieldOf(lx.tok.text) >= 0) {
+        Lexer peek = lx;
+        next(&peek);
+        conditionsFirst = peek.tok.type == T_OP;
+    }
+    if (conditionsFirst || isWord(&lx, "where") || isWord(&lx, "limit") || lx.tok.type == T_END) {
+        q->star = 1;
+    } else if (lx.tok.type == T_STAR) {
+        q->star = 1;
+        next(&lx);
+    } else {
+        for (;;) {
+            if (q->nItems == QUERY_MAX_ITEMS) return fail(err, "too many columns", NULL);
+            if (parseItem(&lx, &q->items[q->nItems], err) != 0) return -1;
+            int isAgg = q->items[q->nItems].agg != QA_FIELD;
+            if (q->nItems > 0 && isAgg != q->aggregate) return fail(err, "cannot mix fields and aggregates", NULL);
+            q->aggregate = isAgg;
+            q->nItems++;
+            if (lx.tok.type != T_COMMA) break;
+            next(&lx);
+        }
+    }
+    if (conditionsFirst || isWord(&lx, "where")) {
+        if (!conditionsFirst) next(&lx);
+        for (;;) {
+            if (q->nTerms == QUERY_MAX_TERMS) return fail(err, "too many conditions", NULL);
+            if (parseCondition(&lx, &q->terms[q->nTerms], err) != 0) return -1;
+            q->nTerms++;
+            if (isWord(&lx, "and")) { next(&lx); continue; }
+            if (isWord(&lx, "or")) { q->terms[q->nTerms - 1].orNext = 1; next(&lx); continue; }
+            break;
+        }
+        orderTerms(q);
+    }
+    if (isWord(&lx, "limit")) {
+        next(&lx);
+        if (lx.tok.type != T_NUM || lx.tok.num < 0) return fail(err, "expected a row count", &lx);
+        q->limit = (long)lx.tok.num;
+        next(&lx);
+    }
+    if (lx.tok.type != T_END) return fail(err, "unexpected text", &lx);
+    return 0;
+}
+
+/* Mask kernels: AND the test "col[i] op c" for n slots into mask words, bit j of word w is slot 64w + j */
+
+#define SCALAR_WORDS(T, CMP) \
+    for (int w = 0; w * 64 < n; ++w) { \
+        const T *p = col + w * 64; \
+        int m = n - w * 64 < 64 ? n - w * 64 : 64; \
+        uint64_t bits = 0; \
+        for (int j = 0; j < m; ++j) bits |= (uint64_t)(p[j] CMP c) << j; /* No branch per slot */ \
+        mask[w] &= bits; \
+    }
+
+#define SCALAR_KERNEL(name, T) \
+    static void name(const T *col, int n, QueryOp op, T c, uint64_t *mask) { \
+        switch (op) { /* Once per block, not per slot */ \
+            case QO_EQ: SCALAR_WORDS(T, ==) break; \
+            case QO_NE: SCALAR_WORDS(T, !=) break; \
+            case QO_LT: SCALAR_WORDS(T, <) break; \
+            case QO_LE: SCALAR_WORDS(T, <=) break; \
+            case QO_GT: SCALAR_WORDS(T, >) break; \
+            case QO_GE: SCALAR_WORDS(T, >=) break; \
+            default: break; \
+        } \
+    }
+
+SCALAR_KERNEL(maskI32Scalar, int32_t)
+SCALAR_KERNEL(maskF32Scalar, float)
+SCALAR_KERNEL(maskF64Scalar, double)
+SCALAR_KERNEL(maskU8Scalar, uint8_t)
+
+typedef struct { // One set of mask kernels
+    void (*i32)(const int32_t *col, int n, QueryOp op, int32_t c, uint64_t *mask);
+    void (*f32)(const float *col, int n, QueryOp op, float c, uint64_t *mask);
+    void (*f64)(const double *col, int n, QueryOp op, double c, uint64_t *mask);
+    void (*u8)(const uint8_t *col, int n, QueryOp op, uint8_t c, uint64_t *mask);
+} MaskKernels;
+
+static const MaskKernels scalarMasks = { maskI32Scalar, maskF32Scalar, maskF64Scalar, maskU8Scalar };
+
+#ifdef QUERY_X86
+/* AVX2: compare a vector of lanes, movemask turns it into bits; the last partial word runs scalar */
+
+#define AVX2 __attribute__((target("avx2")))
+
+#define AVX_WORDS(V, lanes, load, test, movemask, pred, flip) \
+    for (int w = 0; w < full; ++w) { \
+        uint64_t bits = 0; \
+        for (int k = 0; k < 64 / (lanes); ++k) { \
+            V x = load(col + w * 64 + k * (lanes)); \
+            bits |= (uint64_t)(unsigned)movemask(test(x, vc, pred)) << (k * (lanes)); \
+        } \
+        mask[w] &= bits ^ (flip); \
+    }
+
+#define LOAD_SI(p) _mm256_loadu_si256((const __m256i *)(p))
+#define I32_EQ(x, c, unused) _mm256_castsi256_ps(_mm256_cmpeq_epi32(x, c))
+#define I32_GT(x, c, unused) _mm256_castsi256_ps(_mm256_cmpgt_epi32(x, c))
+#define I32_LT(x, c, unused) _mm256_castsi256_ps(_mm256_cmpgt_epi32(c, x))
+#define U8_EQ(x, c, unused) _mm256_cmpeq_epi8(x, c)
+#define U8_GE(x, c, unused) _mm256_cmpeq_epi8(_mm256_max_epu8(x, c), x) // Unsigned: max(x, c) == x
+#define U8_LE(x, c, unused) _mm256_cmpeq_epi8(_mm256_min_epu8(x, c), x)
+
+AVX2 static void maskI32Avx2(const int32_t *col, int n, QueryOp op, int32_t c, uint64_t *mask) {
+    int full = n / 64;
+    __m256i vc = _mm256_set1_epi32(c);
+    switch (op) { // Only = > < exist for integers; the others are their complements
+        case QO_EQ: AVX_WORDS(__m256i, 8, LOAD_SI, I32_EQ, _mm256_movemask_ps, 0, 0) break;
+        case QO_NE: AVX_WORDS(__m256i, 8, LOAD_SI, I32_EQ, _mm256_movemask_ps, 0, ~0ull) break;
+        case QO_LT: AVX_WORDS(__m256i, 8, LOAD_SI, I32_LT, _mm256_movemask_ps, 0, 0) break;
+        case QO_LE: AVX_WORDS(__m256i, 8, LOAD_SI, I32_GT, _mm256_movemask_ps, 0, ~0ull) break;
+        case QO_GT: AVX_WORDS(__m256i, 8, LOAD_SI, I32_GT, _mm256_movemask_ps, 0, 0) break;
+        case QO_GE: AVX_WORDS(__m256i, 8, LOAD_SI, I32_LT, _mm256_movemask_ps, 0, ~0ull) break;
+        default: break;
+    }
+    if (full * 64 < n) maskI32Scalar(col + full * 64, n - full * 64, op, c, mask + full);
+}
+
+AVX2 static void maskF32Avx2(const float *col, int n, QueryOp op, float c, uint64_t *mask) {
+    int full = n / 64;
+    __m256 vc = _mm256_set1_ps(c);
+    switch (op) { // Same answers as C for NaN: only != is true
+        case QO_EQ: AVX_WORDS(__m256, 8, _mm256_loadu_ps, _mm256_cmp_ps, _mm256_movemask_ps, _CMP_EQ_OQ, 0) break;
+        case QO_NE: AVX_WORDS(__m256, 8, _mm256_loadu_ps, _mm256_cmp_ps, _mm256_movemask_ps, _CMP_NEQ_UQ, 0) break;
+        case QO_LT: AVX_WORDS(__m256, 8, _mm256_loadu_ps, _mm256_cmp_ps, _mm256_movemask_ps, _CMP_LT_OQ, 0) break;
+        case QO_LE: AVX_WORDS(__m256, 8, _mm256_loadu_ps, _mm256_cmp_ps, _mm256_movemask_ps, _CMP_LE_OQ, 0) break;
+        case QO_GT: AVX_WORDS(__m256, 8, _mm256_loadu_ps, _mm256_cmp_ps, _mm256_movemask_ps, _CMP_GT_OQ, 0) break;
+        case QO_GE: AVX_WORDS(__m256, 8, _mm256_loadu_ps, _mm256_cmp_ps, _mm256_movemask_ps, _CMP_GE_OQ, 0) break;
+        default: break;
+    }
+    if (full * 64 < n) maskF32Scalar(col + full * 64, n - full * 64, op, c, mask + full);
+}
+
+AVX2 static void maskF64Avx2(const double *col, int n, QueryOp op, double c, uint64_t *mask) {
+    int full = n / 64;
+    __m256d vc = _mm256_set1_pd(c);
+    switch (op) {
+        case QO_EQ: AVX_WORDS(__m256d, 4, _mm256_loadu_pd, _mm256_cmp_pd, _mm256_movemask_pd, _CMP_EQ_OQ, 0) break;
+        case QO_NE: AVX_WORDS(__m256d, 4, _mm256_loadu_pd, _mm256_cmp_pd, _mm256_movemask_pd, _CMP_NEQ_UQ, 0) break;
+        case QO_LT: AVX_WORDS(__m256d, 4, _mm256_loadu_pd, _mm256_cmp_pd, _mm256_movemask_pd, _CMP_LT_OQ, 0) break;
+        case QO_LE: AVX_WORDS(__m256d, 4, _mm256_loadu_pd, _mm256_cmp_pd, _mm256_movemask_pd, _CMP_LE_OQ, 0) break;
+        case QO_GT: AVX_WORDS(__m256d, 4, _mm256_loadu_pd, _mm256_cmp_pd, _mm256_movemask_pd, _CMP_GT_OQ, 0) break;
+        case QO_GE: AVX_WORDS(__m256d, 4, _mm256_loadu_pd, _mm256_cmp_pd, _mm256_movemask_pd, _CMP_GE_OQ, 0) break;
+        default: break;
+    }
+    if (full * 64 < n) maskF64Scalar(col + full * 64, n - full * 64, op, c, mask + full);
+}
+
+AVX2 static void maskU8Avx2(const uint8_t *col, int n, QueryOp op, uint8_t c, uint64_t *mask) {
+    int full = n / 64;
+    __m256i vc = _mm256_set1_epi8((char)c);
+    switch (op) { // Bytes compare unsigned through min/max
+        case QO_EQ: AVX_WORDS(__m256i, 32, LOAD_SI, U8_EQ, _mm256_movemask_epi8, 0, 0) break;
+        case QO_NE: AVX_WORDS(__m256i, 32, LOAD_SI, U8_EQ, _mm256_movemask_epi8, 0, ~0ull) break;
+        case QO_LT: AVX_WORDS(__m256i, 32, LOAD_SI, U8_GE, _mm256_movemask_epi8, 0, ~0ull) break;
+        case QO_LE: AVX_WORDS(__m256i, 32, LOAD_SI, U8_LE, _mm256_movemask_epi8, 0, 0) break;
+        case QO_GT: AVX_WORDS(__m256i, 32, LOAD_SI, U8_LE, _mm256_movemask_epi8, 0, ~0ull) break;
+        case QO_GE: AVX_WORDS(__m256i, 32, LOAD_SI, U8_GE, _mm256_movemask_epi8, 0, 0) break;
+        default: break;
+    }
+    if (full * 64 < n) maskU8Scalar(col + full * 64, n - full * 64, op, c, mask + full);
+}
+
+static const MaskKernels avx2Masks = { maskI32Avx2, maskF32Avx2, maskF64Avx2, maskU8Avx2 };
+
+#endif // QUERY_X86
+
+static const MaskKernels *masks = NULL; // Picked on first use
+
+int queryUseKernels(int kernels) {
+    masks = &scalarMasks;
+#ifdef QUERY_X86
+    __builtin_cpu_init();
+    if (kernels >= COL_KERNEL_AVX2 && __builtin_cpu_supports("avx2")) {
+        masks = &avx2Masks;
+        return COL_KERNEL_AVX2;
+    }
+#endif
+    (void)kernels;
+    return COL_KERNEL_SCALAR;
+}
+
+/* Evaluation */
+
+typedef struct { // One block of columns, borrowed from ItemColumns or gathered from the rows
+    const int32_t *id, *quantity;
+    const float *price;
+    const uint8_t *category;
+    double value[QUERY_BLOCK]; // quantity * price, filled only when something reads it
+    int32_t idBuf[QUERY_BLOCK], quantityBuf[QUERY_BLOCK];
+    float priceBuf[QUERY_BLOCK];
+    uint8_t categoryBuf[QUERY_BLOCK];
+} Block;
+
+static void loadBlock(Block *b, const Item *items, const ItemColumns *cols, int start, int n, int needValue) {
+    if (cols) {
+        b->id = cols->id + start;
+        b->quantity = cols->quantity + start;
+        b->price = cols->price + start;
+        b->category = cols->category + start;
+    } else { // Same layout as the columns, so one set of kernels serves both
+        for (int i = 0; i < n; ++i) {
+            const Item *it = &items[start + i];
+            b->idBuf[i] = it->id;
+            b->quantityBuf[i] = it->quantity;
+            b->priceBuf[i] = it->price;
+            b->categoryBuf[i] = it->id == 0 ? COL_DEAD : (unsigned)it->category < COL_CATEGORIES ? (uint8_t)it->category : COL_NO_CATEGORY;
+        }
+        b->id = b->idBuf;
+        b->quantity = b->quantityBuf;
+        b->price = b->priceBuf;
+        b->category = b->categoryBuf;
+    }
+    if (needValue) {
+        for (int i = 0; i < n; ++i) b->value[i] = (double)b->quantity[i] * b->price[i];
+    }
+}
+
+static int nameMatches(const char *name, const QueryTerm *t) { // Case-insensitive; the constant is already lower case
+    if (t->op == QO_CONTAINS) {
+        for (const char *s = name;; ++s) {
+            size_t k = 0;
+            while (t->text[k] && tolower((unsigned char)s[k]) == t->text[k]) k++;
+            if (!t->text[k]) return 1;
+            if (!*s) return 0;
+        }
+    }
+    size_t k = 0;
+    while (t->text[k] && tolower((unsigned char)name[k]) == t->text[k]) k++;
+    int equal = !t->text[k] && !name[k];
+    return t->op == QO_EQ ? equal : !equal;
+}
+
+static void applyTerm(const QueryTerm *t, const Block *b, const Item *rows, int n, uint64_t *cur) {
+    int words = (n + 63) / 64;
+    if (t->constant < 0) { memset(cur, 0, (size_t)words * sizeof *cur); return; }
+    if (t->constant > 0) return;
+    switch (t->field) {
+        case QF_ID: masks->i32(b->id, n, t->op, t->i, cur); break;
+        case QF_QUANTITY: masks->i32(b->quantity, n, t->op, t->i, cur); break;
+        case QF_PRICE: masks->f32(b->price, n, t->op, t->f, cur); break;
+        case QF_VALUE: masks->f64(b->value, n, t->op, t->d, cur); break;
+        case QF_CATEGORY: masks->u8(b->category, n, t->op, (uint8_t)t->i, cur); break;
+        case QF_NAME: // Strings cannot be vectorized; only rows still selected are looked at
+            for (int w = 0; w < words; ++w) {
+                for (uint64_t bits = cur[w]; bits; bits &= bits - 1) {
+                    int j = __builtin_ctzll(bits);
+                    if (!nameMatches(rows[w * 64 + j].name, t)) cur[w] &= ~(1ull << j);
+                }
+            }
+            break;
+    }
+}
+
+static void selectBlock(const Query *q, const Block *b, const Item *rows, int n, uint64_t *sel) { // Final mask of one block
+    int words = (n + 63) / 64;
+    uint64_t live[QUERY_WORDS], cur[QUERY_WORDS];
+    for (int w = 0; w < words; ++w) live[w] = ~0ull;
+    if (n % 64) live[words - 1] = (1ull << (n % 64)) - 1;
+    masks->u8(b->category, n, QO_NE, COL_DEAD, live);
+    if (q->nTerms == 0) { memcpy(sel, live, (size_t)words * sizeof *sel); return; }
+    memset(sel, 0, (size_t)words * sizeof *sel);
+    memcpy(cur, live, (size_t)words * sizeof *cur);
+    for (int t = 0; t < q->nTerms; ++t) {
+        applyTerm(&q->terms[t], b, rows, n, cur);
+        if (q->terms[t].orNext || t + 1 == q->nTerms) { // End of an "and" group
+            for (int w = 0; w < words; ++w) {
+                sel[w] |= cur[w];
+                cur[w] = live[w] & ~sel[w]; // Later groups only decide the rows not selected yet
+            }
+        }
+    }
+}
+
+#define AGG_LOOP(col) \
+    for (int s = 0; s < k; ++s) { \
+        double v = (col)[idx[s]]; \
+        *sum += v; \
+        *lo = v < *lo ? v : *lo; \
+        *hi = v > *hi ? v : *hi; \
+    }
+
+static void aggregate(const Block *b, QueryField f, const uint16_t *idx, int k, double *sum, double *lo, double *hi) {
+    switch (f) { // Walks the selection vector over one column
+        case QF_ID: AGG_LOOP(b->id) break;
+        case QF_QUANTITY: AGG_LOOP(b->quantity) break;
+        case QF_PRICE: AGG_LOOP(b->price) break;
+        case QF_VALUE: AGG_LOOP(b->value) break;
+        case QF_CATEGORY: AGG_LOOP(b->category) break;
+        default: break;
+    }
+}
+
+static int needsValue(const Query *q) {
+    for (int t = 0; t < q->nTerms; ++t) if (q->terms[t].field == QF_VALUE && q->terms[t].constant == 0) return 1;
+    for (int i = 0; i < q->nItems; ++i) if (q->aggregate && q->items[i].field == QF_VALUE) return 1;
+    return 0;
+}
+
+int queryRun(const Query *q, const Item *items, int count, const ItemColumns *cols, QueryRowFn onRow, void *ctx, QueryResult *res) {
+    memset(res, 0, sizeof *res);
+    if (!masks) queryUseKernels(COL_KERNEL_AVX2); // Best available
+    Block *b = malloc(sizeof *b);
+    if (!b) return -1;
+    double sum[QUERY_MAX_ITEMS], lo[QUERY_MAX_ITEMS], hi[QUERY_MAX_ITEMS];
+    for (int i = 0; i < QUERY_MAX_ITEMS; ++i) { sum[i] = 0; lo[i] = INFINITY; hi[i] = -INFINITY; }
+    int needValue = needsValue(q);
+    uint64_t sel[QUERY_WORDS];
+    uint16_t idx[QUERY_BLOCK];
+    for (int start = 0; start < count; start += QUERY_BLOCK) {
+        int n = count - start < QUERY_BLOCK ? count - start : QUERY_BLOCK;
+        int words = (n + 63) / 64;
+        loadBlock(b, items, cols, start, n, needValue);
+        selectBlock(q, b, items + start, n, sel);
+        res->scanned += n;
+        if (!q->aggregate) { // Rows in slot order until the limit
+            int stop = 0;
+            for (int w = 0; w < words && !stop; ++w) {
+                for (uint64_t bits = sel[w]; bits; bits &= bits - 1) {
+                    if (q->limit >= 0 && res->matched >= q->limit) { stop = 1; break; }
+                    if (onRow) onRow(&items[start + w * 64 + __builtin_ctzll(bits)], ctx);
+                    res->matched++;
+                }
+            }
+            if (stop) break;
+            continue;
+        }
+        int k = 0; // Selection vector of the block
+        for (int w = 0; w < words; ++w) {
+            for (uint64_t bits = sel[w]; bits; bits &= bits - 1) idx[k++] = (uint16_t)(w * 64 + __builtin_ctzll(bits));
+        }
+        res->matched += k;
+        for (int i = 0; i < q->nItems; ++i) {
+            if (q->items[i].agg != QA_COUNT && k > 0) aggregate(b, q->items[i].field, idx, k, &sum[i], &lo[i], &hi[i]);
+        }
+    }
+    free(b);
+    for (int i = 0; i < q->nItems && q->aggregate; ++i) {
+        switch (q->items[i].agg) {
+            case QA_COUNT: res->value[i] = (double)res->matched; break;
+            case QA_SUM: res->value[i] = sum[i]; break;
+            case QA_AVG: res->value[i] = res->matched ? sum[i] / (double)res->matched : 0; break;
+            case QA_MIN: res->value[i] = res->matched ? lo[i] : 0; break;
+            case QA_MAX: res->value[i] = res->matched ? hi[i] : 0; break;
+            default: break;
+        }
+    }
+    return 0;
+}
+
+/* Output */
+
+static void printField(const Item *it, QueryField f, FILE *out) {
+    switch (f) {
+        case QF_ID: fprintf(out, "%d", it->id); break;
+        case QF_NAME: fprintf(out, "%s", it->name); break;
+        case QF_QUANTITY: fprintf(out, "%d", it->quantity); break;
+        case QF_PRICE: fprintf(out, "%.2f", it->price); break;
+        case QF_VALUE: fprintf(out, "%.2f", (double)it->quantity * it->price); break;
+        case QF_CATEGORY: fprintf(out, "%s", categorytostring(it->category)); break;
+    }
+}
+
+void queryPrintRow(const Query *q, const Item *item, FILE *out) {
+    if (q->star) { // Same line as GET
+        fprintf(out, "%d,%s,%d,%.2f,%s\n", item->id, item->name, item->quantity, item->price, categorytostring(item->category));
+        return;
+    }
+    for (int i = 0; i < q->nItems; ++i) {
+        if (i) fputc(',', out);
+        printField(item, q->items[i].field, out);
+    }
+    fputc('\n', out);
+}
+
+void queryPrintAggregates(const Query *q, const QueryResult *res, FILE *out, int labels) {
+    for (int i = 0; i < q->nItems; ++i) {
+        const QueryItem *it = &q->items[i];
+        int whole = it->agg == QA_COUNT || (it->agg != QA_AVG && (it->field == QF_ID || it->field == QF_QUANTITY || it->field == QF_CATEGORY));
+        if (labels) {
+            if (it->agg == QA_COUNT) fprintf(out, "count = ");
+            else fprintf(out, "%s(%s) = ", aggNames[it->agg], fieldNames[it->field]);
+        } else if (i) {
+            fputc(',', out);
+        }
+        fprintf(out, whole ? "%.0f" : "%.2f", res->value[i]);
+        if (labels) fputc('\n', out);
+    }
+    if (!labels) fputc('\n', out);
+}
@@ -0,0 +1,92 @@
+#ifndef QUERY_H
+#define QUERY_H
+#include <stdio.h>
+#include <stdint.h>
+#include "item.h"
+#include "columns.h"
+
+/*
+Small query language over the items (keywords and field names are case-insensitive):
+
+  [select] <what> [where <condition> {and|or <condition>}] [limit N]
+  <condition> {and|or <condition>}                 (same as "select * where ...")
+
+  <what>      * | field {, field} | aggregate {, aggregate}
+  aggregate   count | count(*) | sum(f) | avg(f) | min(f) | max(f)
+  field       id | name | quantity | price | value | category   (value = quantity * price)
+  condition   field op constant, op one of = != <> < <= > >=; name also takes ~ (contains)
+  constant    number, category name (electronics, clothing, food, other) or 'quoted text'
+
+"and" binds tighter than "or", there are no parentheses. Example:
+  category=food and quantity<10 and price>2.5
+  select count, sum(value) where category=electronics or price>=100
+
+Queries are compiled into kernels that run over blocks of QUERY_BLOCK slots:
+each condition turns a column into a bitmask (AVX2 when available), masks
+are combined with AND/OR word by word, and only the final mask becomes a
+selection vector for the aggregates and the rows, so no row is branched on
+*/
+#define QUERY_BLOCK 1024 // Slots evaluated together (16 mask words)
+#define QUERY_MAX_TERMS 16 // Conditions per query
+#define QUERY_MAX_ITEMS 8 // Fields or aggregates per query
+#define QUERY_ERROR_MAX 96 // Room for a parse error message
+
+typedef enum { QF_ID, QF_NAME, QF_QUANTITY, QF_PRICE, QF_VALUE, QF_CATEGORY } QueryField;
+typedef enum { QO_EQ, QO_NE, QO_LT, QO_LE, QO_GT, QO_GE, QO_CONTAINS } QueryOp;
+typedef enum { QA_FIELD, QA_COUNT, QA_SUM, QA_AVG, QA_MIN, QA_MAX } QueryAgg;
+
+typedef struct { // One compiled condition
+    QueryField field;
+    QueryOp op;
+    int constant; // 1: always true, -1: never true (e.g. quantity = 2.5), 0: compare
+    int32_t i; // Constant for id, quantity and category
+    float f; // Constant for price
+    double d; // Constant for value
+    char text[sizeof(((Item *)0)->name)]; // Constant for name
+    int orNext; // An "or" follows this condition (ends its group of "and"s)
+} QueryTerm;
+
+typedef struct { // One output column
+    QueryAgg agg;
+    QueryField field; // Unused for count
+} QueryItem;
+
+typedef struct {
+    QueryTerm terms[QUERY_MAX_TERMS];
+    int nTerms; // 0: every live item matches
+    QueryItem items[QUERY_MAX_ITEMS];
+    int nItems; // 0 with star set: all fields
+    int star;
+    int aggregate; // Items are aggregates (else rows are listed)
+    long limit; // Rows to list, -1 for all
+} Query;
+
+typedef struct {
+    long matched; // Live items matching the conditions (rows listed when a limit stopped the scan)
+    long scanned; // Slots looked at
+    double value[QUERY_MAX_ITEMS]; // Aggregates in item order (min/max/avg are 0 without matches)
+} QueryResult;
+
+/* Called for every matching item, in slot order, until the limit */
+typedef void (*QueryRowFn)(const Item *item, void *ctx);
+
+/* Compiles 'text' into 'q'. Returns 0 on success, -1 with a message in 'err' otherwise */
+int queryParse(const char *text, Query *q, char err[QUERY_ERROR_MAX]);
+
+/*
+Runs 'q' over 'count' slots of 'items' (id 0 marks a deleted slot), reading
+the columns instead where 'cols' is not NULL. Rows are passed to 'onRow'
+(may be NULL). Returns 0, -1 if out of memory
+*/
+int queryRun(const Query *q, const Item *items, int count, const ItemColumns *cols, QueryRowFn onRow, void *ctx, QueryResult *res);
+
+/* Prints the selected fields of 'item' as one CSV line (all fields for *) */
+void queryPrintRow(const Query *q, const Item *item, FILE *out);
+
+/* Prints the aggregates as one CSV line, or with 'labels' as "name = value" lines */
+void queryPrintAggregates(const Query *q, const QueryResult *res, FILE *out, int labels);
+
+/* Selects the mask kernels (COL_KERNEL_*; SSE2 runs the scalar set). Returns the set now in use */
+int queryUseKernels(int kernels);
+
+#endif // QUERY_H
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#include "replica.h"
+#include "crc32c.h"
+#include "byteorder.h"
+
+/* Position file */
+
+int replicaReadPosition(const char *filename, ReplicaPosition *out) {
+    char path[WAL_PATH_MAX + 8];
+    unsigned char b[REPL_STATE_SIZE];
+    memset(out, 0, sizeof *out);
+    snprintf(path, sizeof path, "%s%s", filename, REPL_SUFFIX);
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 1;
+    size_t got = fread(b, 1, sizeof b, fp);
+    fclose(fp);
+    if (got != sizeof b || memcmp(b, REPL_MAGIC, 8) != 0 || getU32(b + 60) != crc32c(0, b, 60) || getU32(b + 8) != REPL_FORMAT_VERSION) return -7;
+    out->stream = getU64(b + 16);
+    out->applied = getU64(b + 24);
+    out->primaryLast = getU64(b + 32);
+    out->appliedTime = getU64(b + 40);
+    return 0;
+}
+
+static int writePosition(const char *filename, const ReplicaPosition *pos) { // Written aside and renamed over, never torn
+    char path[WAL_PATH_MAX + 8], tmp[WAL_PATH_MAX + 16];
+    unsigned char b[REPL_STATE_SIZE] = {0};
+    snprintf(path, sizeof path, "%s%s", filename, REPL_SUFFIX);
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    memcpy(b, REPL_MAGIC, 8);
+    putU32(b + 8, REPL_FORMAT_VERSION);
+    putU64(b + 16, pos->stream);
+    putU64(b + 24, pos->applied);
+    putU64(b + 32, pos->primaryLast);
+    putU64(b + 40, pos->appliedTime);
+    putU32(b + 60, crc32c(0, b, 60));
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return -2;
+    int ok = fwrite(b, 1, sizeof b, fp) == sizeof b && syncFile(fp) == 0;
+    if (fclose(fp) != 0) ok = 0;
+#ifdef _WIN32
+    if (ok) remove(path); // rename() does not replace an existing file on Windows
+#endif
+    if (!ok || rename(tmp, path) != 0) { remove(tmp); return -2; }
+    return 0;
+}
+
+/* Local copy */
+
+static int openLocal(Replica *r) {
+    int rc = inventoryOpen(&r->inv, r->filename, 0);
+    if (rc < 0) return rc;
+    inventoryDeferLog(&r->inv, 1); // One log write and one sync per batch read, see replicaCheckpoint
+    inventoryBackgroundSnapshots(&r->inv, 1); // Checkpoints do not hold up applying
+    cdcApplierInit(&r->applier, &r->inv);
+    return rc;
+}
+
+int replicaOpen(Replica *r, const char *filename) {
+    memset(r, 0, sizeof *r);
+    snprintf(r->filename, sizeof r->filename, "%s", filename);
+    ReplicaPosition pos;
+    int prc = replicaReadPosition(filename, &pos);
+    int rc = openLocal(r);
+    if (rc < 0) return rc;
+    if (prc == 0 && rc == 0) r->pos = pos; // A position without its copy is worthless
+    r->received = r->pos.applied;
+    return r->pos.stream ? 0 : 1;
+}
+
+int replicaCheckpoint(Replica *r) {
+    if (!r->dirty) return 0;
+    if (inventoryWaitDurable(&r->inv) != 0) return -2; // The position must never get ahead of the copy
+    if (writePosition(r->filename, &r->pos) != 0) return -2;
+    r->dirty = 0;
+    return 0;
+}
+
+int replicaClose(Replica *r) {
+    int rc = replicaCheckpoint(r);
+    if (inventoryClose(&r->inv) != 0) rc = -2;
+    cdcApplierFree(&r->applier);
+    free(r->staged);
+    r->staged = NULL;
+    return rc;
+}
+
+static int installSnapshot(Replica *r, const CdcRecord *end) { // Replaces the copy with the staged items
+    ReplicaPosition none = { 0, 0, r->pos.primaryLast, 0 };
+    if (writePosition(r->filename, &none) != 0) return -2; // A crash from here on takes the snapshot again
+    cdcApplierFree(&r->applier);
+    inventoryClose(&r->inv);
+    char tmp[WAL_PATH_MAX + 16], wal[WAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof tmp, "%s.tmp", r->filename);
+    snprintf(wal, sizeof wal, "%s%s", r->filename, WAL_SUFFIX);
+    int rc = saveItems(tmp, r->staged, (int)r->stagedCount) == 0 ? 0 : -2;
+    remove(wal); // The old copy's log must not replay over the snapshot
+#ifdef _WIN32
+    if (rc == 0) remove(r->filename);
+#endif
+    if (rc == 0 && rename(tmp, r->filename) != 0) rc = -2;
+    if (rc != 0) remove(tmp);
+    else syncParentDir(r->filename);
+    int orc = openLocal(r); // Even after a failure, so the replica stays usable
+    if (rc == 0 && orc < 0) rc = orc;
+    if (rc != 0) return rc;
+    r->pos.stream = end->stream;
+    r->pos.applied = r->received = end->seq;
+    r->pos.appliedTime = end->timeNs;
+    r->stagedCount = 0;
+    r->stats.snapshots++;
+    r->dirty = 0;
+    return writePosition(r->filename, &r->pos);
+}
+
+int replicaHandle(Replica *r, const CdcRecord *f) {
+    if (f->op != CDC_MSG_ITEM && f->seq > r->pos.primaryLast) r->pos.primaryLast = f->seq;
+    switch (f->op) {
+        case CDC_MSG_HELLO: // The publisher carries on from our position
+            return f->stream == r->pos.stream && f->seq == r->pos.applied ? 0 : -7;
+        case CDC_MSG_SNAPSHOT:
+            cdcApplierReset(&r->applier);
+            r->inSnapshot = 1;
+            r->stagedCount = 0;
+            if (f->count > (uint64_t)r->stagedCap) {
+                Item *tmp = realloc(r->staged, (size_t)f->count * sizeof *tmp);
+                if (!tmp) return -1;
+                r->staged = tmp;
+                r->stagedCap = (long)f->count;
+            }
+            return 0;
+        case CDC_MSG_ITEM:
+            if (!r->inSnapshot || r->stagedCount >= r->stagedCap) return -7;
+            r->staged[r->stagedCount++] = f->item;
+            return 0;
+        case CDC_MSG_SNAPSHOT_END:
+            if (!r->inSnapshot || (uint64_t)r->stagedCount != f->count) return -7;
+            r->inSnapshot = 0;
+            return installSnapshot(r, f);
+        case CDC_MSG_HEARTBEAT:
+            return 0;
+        default: { // A feed record: must be the next one
+            if (r->inSnapshot || r->pos.stream == 0 || f->seq != r->received + 1) return -7;
+            r->received = f->seq;
+            if (f->op == WAL_OP_ADD || f->op == WAL_OP_QTY || f->op == WAL_OP_DEL) r->stats.records++;
+            int rc = cdcApply(&r->applier, f);
+            if (rc < 0) return rc;
+            if (rc == 1) { // At a transaction boundary: safe to record as the position
+                if (f->op == WAL_OP_COMMIT) r->stats.transactions++;
+                r->pos.applied = f->seq;
+                r->pos.appliedTime = f->timeNs;
+                r->dirty = 1;
+            }
+            return 0;
+        }
+    }
+}
+
+void replicaLag(const ReplicaPosition *pos, uint64_t *records, double *ms) {
+    *records = pos->primaryLast > pos->applied ? pos->primaryLast - pos->applied : 0;
+    uint64_t now = cdcClock();
+    *ms = *records > 0 && pos->appliedTime && now > pos->appliedTime ? (double)(now - pos->appliedTime) / 1e6 : 0.0;
+}
+
+void replicaReport(const Replica *r, FILE *out) {
+    uint64_t behind;
+    double ms;
+    replicaLag(&r->pos, &behind, &ms);
+    fprintf(out, "Replica %s: stream %016llx, applied %llu of %llu, lag %llu records / %.0f ms; %ld records, %ld transactions, %ld snapshots, %ld reconnects\n",
+            r->filename, (unsigned long long)r->pos.stream, (unsigned long long)r->pos.applied, (unsigned long long)r->pos.primaryLast,
+            (unsigned long long)behind, ms, r->stats.records, r->stats.transactions, r->stats.snapshots, r->stats.reconnects);
+}
+
+/* Following */
+
+#ifndef _WIN32
+static volatile sig_atomic_t stopping = 0; // Set by SIGINT/SIGTERM
+
+static void onStopSignal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static int connectTo(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) return -1;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+static int sendHello(int fd, const ReplicaPosition *pos) { // Where to start: the publisher decides between records and a snapshot
+    unsigned char h[CDC_HELLO_SIZE];
+    memcpy(h, CDC_HELLO_MAGIC, 8);
+    putU64(h + 8, pos->stream);
+    putU64(h + 16, pos->applied + 1);
+    return send(fd, h, sizeof h, MSG_NOSIGNAL) == (ssize_t)sizeof h ? 0 : -1;
+}
+
+static void sleepMs(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int pump(Replica *r, int fd) { // Applies frames until the stream ends (0) or breaks (negative)
+    unsigned char *buf = malloc(REPL_READ_CHUNK);
+    if (!buf) return -1;
+    size_t have = 0;
+    uint64_t lastStatus = cdcClock();
+    int rc = 0;
+    while (!stopping) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        int ready = poll(&p, 1, REPL_STATUS_MS / 4);
+        if (ready > 0) {
+            ssize_t got = read(fd, buf + have, REPL_READ_CHUNK - have);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) break; // Publisher gone
+            have += (size_t)got;
+            size_t off = 0;
+            for (; rc == 0 && off + CDC_RECORD_SIZE <= have; off += CDC_RECORD_SIZE) {
+                CdcRecord f;
+                rc = cdcDecode(&f, buf + off);
+                if (rc == 0) rc = replicaHandle(r, &f);
+            }
+            if (rc != 0) break;
+            memmove(buf, buf + off, have - off);
+            have -= off;
+            if (replicaCheckpoint(r) != 0) { rc = -2; break; } // One sync per read
+        } else if (ready < 0 && errno != EINTR) {
+            rc = -2;
+            break;
+        }
+        if (cdcClock() - lastStatus >= (uint64_t)REPL_STATUS_MS * 1000000u) {
+            replicaReport(r, stderr);
+            lastStatus = cdcClock();
+        }
+    }
+    free(buf);
+    if (replicaCheckpoint(r) != 0 && rc == 0) rc = -2; // Whatever was applied before a break still counts
+    cdcApplierReset(&r->applier); // A transaction cut off by the break is sent again
+    r->received = r->pos.applied;
+    r->inSnapshot = 0;
+    return rc;
+}
+
+int replicaFollow(Replica *r, const char *source) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = onStopSignal; // No SA_RESTART: poll returns EINTR and the loop sees 'stopping'
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    if (strcmp(source, "-") == 0) return pump(r, 0); // A pipe cannot be reconnected: its end is the end
+    int rc = 0, connected = 0;
+    while (!stopping) {
+        int fd = connectTo(source);
+        if (fd < 0 || sendHello(fd, &r->pos) != 0) {
+            if (fd >= 0) close(fd);
+            sleepMs(REPL_RETRY_MS); // Primary not up (yet): keep trying
+            continue;
+        }
+        if (connected++) r->stats.reconnects++;
+        rc = pump(r, fd);
+        close(fd);
+        if (rc < 0 && rc != -7) break; // -7: out of step, the next hello resumes from the position
+        rc = 0;
+        if (!stopping) sleepMs(REPL_RETRY_MS);
+    }
+    return rc;
+}
+#else
+int replicaFollow(Replica *r, const char *source) {
+    (void)r; (void)source;
+    return -1; // Needs poll() and Unix sockets
+}
+#endif
@@ -0,0 +1,98 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+#include <stdio.h>
+#include <stdint.h>
+#include "inventory.h"
+#include "changefeed.h"
+
+/*
+Log-shipping read replica: a local items file kept in step with a primary
+by applying its change feed (see changefeed.h). The copy is an ordinary
+logged inventory, so it can be opened read-only by the other tools; it
+must not be changed by anything but the follower.
+
+The position (stream and last applied sequence) lives in <local>.repl,
+written after each batch of applied records is durable in the local log:
+  0 magic "INVREPLC"  8 version (u32)  16 stream id (u64)  24 applied (u64)
+ 32 newest primary sequence seen (u64)  40 primary time of 'applied' (ns, u64)
+ 60 CRC32C of bytes 0..59
+A crash between the two only makes the follower replay records it already
+has, which applying is immune to. Taking a snapshot clears the position
+first, so a crash half way through takes the snapshot again.
+*/
+#define REPL_SUFFIX ".repl"
+#define REPL_MAGIC "INVREPLC" // 8 bytes, no terminator stored
+#define REPL_FORMAT_VERSION 1
+#define REPL_STATE_SIZE 64
+#define REPL_READ_CHUNK (CDC_RECORD_SIZE * 1024) // Bytes read from the stream at a time
+#define REPL_RETRY_MS 500 // Socket mode: wait before reconnecting
+#define REPL_STATUS_MS 1000 // How often the status line is printed
+
+typedef struct { // What <local>.repl holds
+    uint64_t stream; // 0: none, the next connection takes a snapshot
+    uint64_t applied; // Last sequence applied, always a transaction boundary
+    uint64_t primaryLast; // Newest sequence the primary had when last heard from
+    uint64_t appliedTime; // Primary clock when 'applied' was logged
+} ReplicaPosition;
+
+typedef struct {
+    long records; // Change records received (markers excluded)
+    long transactions; // Transactions committed
+    long snapshots; // Full snapshots installed
+    long reconnects; // Connections after the first
+} ReplicaStats;
+
+typedef struct {
+    Inventory inv; // The local copy
+    char filename[WAL_PATH_MAX];
+    ReplicaPosition pos;
+    uint64_t received; // Last sequence received, ahead of pos.applied inside a transaction
+    CdcApplier applier;
+    Item *staged; // Snapshot items as they arrive
+    long stagedCount, stagedCap;
+    int inSnapshot;
+    int dirty; // Applied since the position was last written
+    ReplicaStats stats;
+} Replica;
+
+/*
+Opens the local copy 'filename' (created if missing) and its position.
+Returns 0, 1 if there was no usable position (the first connection takes a
+snapshot), negative as inventoryOpen
+*/
+int replicaOpen(Replica *r, const char *filename);
+
+/* Makes what was applied durable, writes the position and closes the copy. Returns 0 on success */
+int replicaClose(Replica *r);
+
+/*
+Handles one frame from the publisher. Returns 0, -7 if the stream is not
+what the position expects (a gap or an out-of-order frame: reconnect and
+resume from the position), other negative values if the copy failed
+*/
+int replicaHandle(Replica *r, const CdcRecord *frame);
+
+/* Syncs the local log, then writes the position if anything was applied. Returns 0 on success */
+int replicaCheckpoint(Replica *r);
+
+/*
+Follows the publisher at the Unix socket 'source' (reconnecting until
+SIGINT/SIGTERM), or the frames on standard input for "-" until it ends.
+Prints a status line with the lag to stderr every REPL_STATUS_MS.
+Returns 0 when stopped or the input ended, negative on failure
+*/
+int replicaFollow(Replica *r, const char *source);
+
+/*
+Replication lag: records the primary has that are not applied here, and
+how old the last applied change is on the primary's clock (0 when caught up)
+*/
+void replicaLag(const ReplicaPosition *pos, uint64_t *records, double *ms);
+
+/* Prints the position, lag and counters */
+void replicaReport(const Replica *r, FILE *out);
+
+/* Reads <filename>.repl. Returns 0, 1 if there is none, -7 if it is damaged */
+int replicaReadPosition(const char *filename, ReplicaPosition *out);
+
+#endif // REPLICA_H
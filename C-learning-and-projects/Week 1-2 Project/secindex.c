@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "secindex.h"
+
+#define DELTA_MIN 64 // Delta never merges before it holds this many entries
+
+static uint32_t priceKey(float price) { // Maps a float to a uint32 with the same ordering
+    uint32_t bits;
+    memcpy(&bits, &price, sizeof bits);
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u; // Negative: flip all bits, positive: flip the sign
+}
+
+static int32_t entrySlot(PriceEntry e) { // Slot of an entry, dead (~slot) or not
+    return e.slot < 0 ? ~e.slot : e.slot;
+}
+
+static int entryLess(PriceEntry a, PriceEntry b) { // Order by price, then slot
+    return a.key < b.key || (a.key == b.key && entrySlot(a) < entrySlot(b));
+}
+
+static int lowerBoundKey(const PriceEntry *arr, int n, uint32_t key) { // First position whose key is >= 'key'
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (arr[mid].key < key) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static int lowerBound(const PriceEntry *arr, int n, PriceEntry e) { // First position not less than 'e'
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (entryLess(arr[mid], e)) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static int deltaLimit(const PriceList *pl) { // About sqrt(n): balances delta inserts against merges
+    int n = pl->mainCount, r = DELTA_MIN;
+    while ((long long)r * r < n) r *= 2;
+    return r;
+}
+
+static void radixSort(PriceEntry *a, PriceEntry *tmp, int n) { // Stable LSD radix sort on the key, 4 passes of 8 bits
+    for (int shift = 0; shift < 32; shift += 8) {
+        int counts[256] = {0};
+        for (int i = 0; i < n; ++i) counts[(a[i].key >> shift) & 0xFF]++;
+        int sum = 0;
+        for (int b = 0; b < 256; ++b) { int c = counts[b]; counts[b] = sum; sum += c; } // Bucket starts
+        for (int i = 0; i < n; ++i) tmp[counts[(a[i].key >> shift) & 0xFF]++] = a[i];
+        PriceEntry *t = a; a = tmp; tmp = t; // Four passes: the result ends back in the caller's array
+    }
+}
+
+static void listFree(PriceList *pl) {
+    free(pl->main);
+    free(pl->delta);
+    memset(pl, 0, sizeof *pl);
+}
+
+static int mergeDelta(PriceList *pl) { // Folds delta into main and drops dead entries, O(n)
+    int live = pl->mainCount - pl->mainDead + pl->deltaCount;
+    PriceEntry *merged = malloc((live ? (size_t)live : 1) * sizeof *merged);
+    if (!merged) return -1;
+    int i = 0, j = 0, k = 0;
+    while (i < pl->mainCount || j < pl->deltaCount) {
+        if (i < pl->mainCount && pl->main[i].slot < 0) { ++i; continue; } // Skip deleted entries
+        if (j >= pl->deltaCount || (i < pl->mainCount && entryLess(pl->main[i], pl->delta[j]))) merged[k++] = pl->main[i++];
+        else merged[k++] = pl->delta[j++];
+    }
+    free(pl->main);
+    pl->main = merged;
+    pl->mainCount = k;
+    pl->mainDead = 0;
+    pl->deltaCount = 0;
+    return 0;
+}
+
+static int listAdd(PriceList *pl, PriceEntry e) {
+    if (pl->deltaCount == pl->deltaCap) { // Grow the delta buffer
+        int cap = pl->deltaCap ? pl->deltaCap * 2 : DELTA_MIN;
+        PriceEntry *tmp = realloc(pl->delta, (size_t)cap * sizeof *tmp);
+        if (!tmp) return -1;
+        pl->delta = tmp;
+        pl->deltaCap = cap;
+    }
+    int pos = lowerBound(pl->delta, pl->deltaCount, e);
+    memmove(&pl->delta[pos + 1], &pl->delta[pos], (size_t)(pl->deltaCount - pos) * sizeof e); // Small: delta stays ~sqrt(n)
+    pl->delta[pos] = e;
+    pl->deltaCount++;
+    if (pl->deltaCount >= deltaLimit(pl)) return mergeDelta(pl);
+    return 0;
+}
+
+static int listRemove(PriceList *pl, PriceEntry e) {
+    int pos = lowerBound(pl->delta, pl->deltaCount, e);
+    if (pos < pl->deltaCount && pl->delta[pos].key == e.key && pl->delta[pos].slot == e.slot) { // Recent insert: remove outright
+        memmove(&pl->delta[pos], &pl->delta[pos + 1], (size_t)(pl->deltaCount - pos - 1) * sizeof e);
+        pl->deltaCount--;
+        return 0;
+    }
+    pos = lowerBound(pl->main, pl->mainCount, e); // Dead entries keep their key and slot order, so the search still works
+    if (pos < pl->mainCount && pl->main[pos].key == e.key && pl->main[pos].slot == e.slot) {
+        pl->main[pos].slot = ~e.slot; // Mark dead (negative), dropped by the next merge
+        pl->mainDead++;
+        if (pl->mainDead * 4 > pl->mainCount) return mergeDelta(pl); // Keep dead entries a minority
+    }
+    return 0;
+}
+
+int secIndexAdd(SecIndex *idx, int slot, const Item *item) {
+    PriceEntry e = { priceKey(item->price), slot };
+    if (listAdd(&idx->all, e) != 0) return -1;
+    if ((unsigned)item->category < SEC_CATEGORIES) return listAdd(&idx->byCategory[item->category], e);
+    return 0;
+}
+
+int secIndexRemove(SecIndex *idx, int slot, const Item *item) {
+    PriceEntry e = { priceKey(item->price), slot };
+    if (listRemove(&idx->all, e) != 0) return -1;
+    if ((unsigned)item->category < SEC_CATEGORIES) return listRemove(&idx->byCategory[item->category], e);
+    return 0;
+}
+
+static int remapList(PriceList *pl, const int *newSlot) {
+    if ((pl->mainDead || pl->deltaCount) && mergeDelta(pl) != 0) return -1; // Dead slots have no new slot, drop them first
+    for (int i = 0; i < pl->mainCount; ++i) pl->main[i].slot = newSlot[pl->main[i].slot];
+    return 0;
+}
+
+int secIndexRemap(SecIndex *idx, const int *newSlot) {
+    if (remapList(&idx->all, newSlot) != 0) return -1;
+    for (int c = 0; c < SEC_CATEGORIES; ++c) {
+        if (remapList(&idx->byCategory[c], newSlot) != 0) return -1;
+    }
+    return 0;
+}
+
+typedef struct { // Work for one build thread
+    const Item *items;
+    int count;
+    int firstCategory, lastCategory; // Categories this thread builds, inclusive
+    PriceList *lists; // idx->byCategory
+    int failed;
+} BuildTask;
+
+static void *buildCategories(void *arg) { // Collects and radix-sorts the entries of some categories
+    BuildTask *t = arg;
+    for (int c = t->firstCategory; c <= t->lastCategory; ++c) {
+        int n = 0;
+        for (int i = 0; i < t->count; ++i) {
+            if (t->items[i].id != 0 && (int)t->items[i].category == c) n++;
+        }
+        PriceEntry *arr = malloc((n ? (size_t)n : 1) * sizeof *arr);
+        PriceEntry *tmp = malloc((n ? (size_t)n : 1) * sizeof *tmp);
+        if (!arr || !tmp) { free(arr); free(tmp); t->failed = 1; return NULL; }
+        int k = 0;
+        for (int i = 0; i < t->count; ++i) { // Slots go in ascending, radix sort is stable: ties stay in slot order
+            if (t->items[i].id != 0 && (int)t->items[i].category == c) arr[k++] = (PriceEntry){ priceKey(t->items[i].price), i };
+        }
+        radixSort(arr, tmp, n);
+        free(tmp);
+        t->lists[c].main = arr;
+        t->lists[c].mainCount = n;
+    }
+    return NULL;
+}
+
+int secIndexBuild(SecIndex *idx, const Item *items, int count, int threads) {
+    secIndexFree(idx);
+    if (threads <= 0 || threads > SEC_CATEGORIES) threads = SEC_CATEGORIES;
+    BuildTask tasks[SEC_CATEGORIES];
+    pthread_t tids[SEC_CATEGORIES];
+    int started[SEC_CATEGORIES] = {0};
+    int per = (SEC_CATEGORIES + threads - 1) / threads;
+    for (int t = 0; t < threads; ++t) { // Split the categories over the threads
+        tasks[t] = (BuildTask){ items, count, t * per, (t + 1) * per - 1, idx->byCategory, 0 };
+        if (tasks[t].lastCategory >= SEC_CATEGORIES) tasks[t].lastCategory = SEC_CATEGORIES - 1;
+        if (tasks[t].firstCategory > tasks[t].lastCategory) continue;
+        started[t] = pthread_create(&tids[t], NULL, buildCategories, &tasks[t]) == 0;
+        if (!started[t]) buildCategories(&tasks[t]); // No thread available, do it here
+    }
+
+    int others = 0; // Items whose category is outside the enum live only in the overall list
+    for (int i = 0; i < count; ++i) {
+        if (items[i].id != 0 && (unsigned)items[i].category >= SEC_CATEGORIES) others++;
+    }
+    PriceEntry *extra = malloc((others ? (size_t)others : 1) * sizeof *extra);
+    PriceEntry *tmp = malloc((others ? (size_t)others : 1) * sizeof *tmp);
+    int failed = !extra || !tmp;
+    if (!failed) {
+        int k = 0;
+        for (int i = 0; i < count; ++i) {
+            if (items[i].id != 0 && (unsigned)items[i].category >= SEC_CATEGORIES) extra[k++] = (PriceEntry){ priceKey(items[i].price), i };
+        }
+        radixSort(extra, tmp, others);
+    }
+    free(tmp);
+    for (int t = 0; t < threads; ++t) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        if (tasks[t].failed) failed = 1;
+    }
+
+    int total = others;
+    for (int c = 0; c < SEC_CATEGORIES; ++c) total += idx->byCategory[c].mainCount;
+    PriceEntry *all = failed ? NULL : malloc((total ? (size_t)total : 1) * sizeof *all);
+    if (!all) { free(extra); secIndexFree(idx); return -1; }
+    const PriceEntry *src[SEC_CATEGORIES + 1]; // Merge the sorted per-category runs into the overall list
+    int len[SEC_CATEGORIES + 1], pos[SEC_CATEGORIES + 1] = {0};
+    for (int c = 0; c < SEC_CATEGORIES; ++c) { src[c] = idx->byCategory[c].main; len[c] = idx->byCategory[c].mainCount; }
+    src[SEC_CATEGORIES] = extra;
+    len[SEC_CATEGORIES] = others;
+    for (int k = 0; k < total; ++k) {
+        int best = -1;
+        for (int r = 0; r <= SEC_CATEGORIES; ++r) {
+            if (pos[r] < len[r] && (best < 0 || entryLess(src[r][pos[r]], src[best][pos[best]]))) best = r;
+        }
+        all[k] = src[best][pos[best]++];
+    }
+    free(extra);
+    idx->all.main = all;
+    idx->all.mainCount = total;
+    return 0;
+}
+
+void secIndexFree(SecIndex *idx) {
+    listFree(&idx->all);
+    for (int c = 0; c < SEC_CATEGORIES; ++c) listFree(&idx->byCategory[c]);
+}
+
+int secIndexQuery(const SecIndex *idx, int category, float lo, float hi, int *out, int maxOut) {
+    const PriceList *pl = category < 0 ? &idx->all : ((unsigned)category < SEC_CATEGORIES ? &idx->byCategory[category] : NULL);
+    if (!pl) return 0; // Unknown category
+    uint32_t loKey = priceKey(lo), hiKey = priceKey(hi);
+    int i = lowerBoundKey(pl->main, pl->mainCount, loKey);
+    int j = lowerBoundKey(pl->delta, pl->deltaCount, loKey);
+    int found = 0;
+    for (;;) { // Walk both runs in price order
+        while (i < pl->mainCount && pl->main[i].slot < 0) ++i; // Skip deleted entries
+        int haveMain = i < pl->mainCount && pl->main[i].key <= hiKey;
+        int haveDelta = j < pl->deltaCount && pl->delta[j].key <= hiKey;
+        if (!haveMain && !haveDelta) break;
+        PriceEntry e = (haveMain && (!haveDelta || entryLess(pl->main[i], pl->delta[j]))) ? pl->main[i++] : pl->delta[j++];
+        if (found < maxOut) out[found] = e.slot;
+        found++;
+    }
+    return found;
+}
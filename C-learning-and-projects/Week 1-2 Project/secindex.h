@@ -0,0 +1,57 @@
+#ifndef SECINDEX_H
+#define SECINDEX_H
+#include <stdint.h>
+#include "item.h"
+
+#define SEC_CATEGORIES 4 // ELECTRONICS..OTHER get their own posting list
+
+typedef struct { // One entry of a price-ordered posting list
+    uint32_t key; // Price mapped to an order-preserving unsigned key
+    int32_t slot; // Slot of the item in the items array, ~slot (negative) once deleted
+} PriceEntry;
+
+typedef struct { // Slots ordered by (price, slot): a large sorted run plus a small sorted delta
+    PriceEntry *main; // Bulk of the entries, rebuilt by merges
+    int mainCount;
+    int mainDead; // Entries in 'main' marked deleted
+    PriceEntry *delta; // Recent inserts, kept sorted, merged into 'main' once it passes ~sqrt(n)
+    int deltaCount;
+    int deltaCap;
+} PriceList;
+
+typedef struct { // Secondary indexes: price order overall and per category
+    PriceList all; // Every item
+    PriceList byCategory[SEC_CATEGORIES]; // Items of one category (posting list in price order)
+} SecIndex;
+
+/*
+Rebuilds all lists from 'count' slots of 'items' (slots with id 0 are skipped).
+The per-category lists are built on separate threads ('threads' <= 0 means one
+per category) and merged into the overall list.
+Returns 0 on success, -1 on failure
+*/
+int secIndexBuild(SecIndex *idx, const Item *items, int count, int threads);
+
+/* Releases every list */
+void secIndexFree(SecIndex *idx);
+
+/* Adds / removes the entry for 'item' stored at 'slot'. Return 0 on success, -1 on failure */
+int secIndexAdd(SecIndex *idx, int slot, const Item *item);
+int secIndexRemove(SecIndex *idx, int slot, const Item *item);
+
+/*
+Re-points entries after the items array was squeezed: 'newSlot[old]' is the
+new slot of every surviving old slot. Survivors keep their relative order, so
+the lists stay sorted. Returns 0 on success
+*/
+int secIndexRemap(SecIndex *idx, const int *newSlot);
+
+/*
+Finds live items with lo <= price <= hi, restricted to 'category' unless it
+is -1. Writes up to 'maxOut' slots to 'out' in ascending price order and
+returns the number of matches (which may exceed maxOut). Cost is
+O(log n + matches).
+*/
+int secIndexQuery(const SecIndex *idx, int category, float lo, float hi, int *out, int maxOut);
+
+#endif // SECINDEX_H
@@ -0,0 +1,327 @@
+#define _GNU_SOURCE // accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "server.h"
+#include "protocol.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+
+typedef struct { // Responses up to 'end' wait until 'ticket' is durable
+    size_t end;
+    uint64_t ticket;
+} HeldReplies;
+
+typedef struct { // One client connection
+    int fd;
+    unsigned char *in; // Bytes received but not yet parsed into frames
+    size_t inLen, inCap;
+    unsigned char *out; // Responses waiting to be sent
+    size_t outLen, outSent, outCap;
+    size_t sendable; // Responses before this offset may go out (the rest wait for a sync)
+    HeldReplies *held; // Oldest first
+    int heldCount, heldCap;
+    int waitSlot; // Index in the waiting list, -1 if nothing is held
+    int paused; // Reading stopped until 'out' drains (backpressure)
+    int touched; // Already queued for sending in this wakeup
+} Conn;
+
+typedef struct { // Connections with held responses
+    Conn **conns;
+    int count, cap;
+} ConnList;
+
+static char notifyTag; // epoll data of the group commit pipe (the listening socket uses NULL)
+
+static volatile sig_atomic_t stopping = 0; // Set by SIGINT/SIGTERM
+
+static void onStopSignal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static int reserve(unsigned char **buf, size_t *cap, size_t need) { // Grows a connection buffer geometrically
+    if (need <= *cap) return 0;
+    size_t newCap = *cap ? *cap : 4096;
+    while (newCap < need) newCap *= 2;
+    unsigned char *tmp = realloc(*buf, newCap);
+    if (!tmp) return -1;
+    *buf = tmp;
+    *cap = newCap;
+    return 0;
+}
+
+static int respond(Conn *c, uint32_t reqId, uint8_t op, uint8_t status, const unsigned char *payload, uint32_t len) {
+    if (reserve(&c->out, &c->outCap, c->outLen + PROTO_HEADER_SIZE + len) != 0) return -1;
+    protoPutHeader(c->out + c->outLen, PROTO_HEADER_SIZE + len, reqId, op, status);
+    if (len) memcpy(c->out + c->outLen + PROTO_HEADER_SIZE, payload, len);
+    c->outLen += PROTO_HEADER_SIZE + len;
+    return 0;
+}
+
+static uint8_t mutationStatus(int rc) { // Maps inventory return codes onto protocol statuses
+    return rc == 0 ? PROTO_OK : rc == 1 ? PROTO_NOT_FOUND : PROTO_IO_ERROR;
+}
+
+static int handleFrame(Inventory *inv, Conn *c, const unsigned char *f, uint32_t len, long *served) { // Executes one request
+    uint32_t reqId = protoGetU32(f + 4);
+    uint8_t op = f[8];
+    const unsigned char *p = f + PROTO_HEADER_SIZE;
+    uint32_t plen = len - PROTO_HEADER_SIZE;
+    (*served)++;
+    switch (op) {
+        case PROTO_GET: {
+            if (plen != 4) break;
+            const Item *it = inventoryGet(inv, (int32_t)protoGetU32(p));
+            if (!it) return respond(c, reqId, op, PROTO_NOT_FOUND, NULL, 0);
+            unsigned char rec[ITEMS_RECORD_SIZE];
+            encodeItemRecord(rec, it);
+            return respond(c, reqId, op, PROTO_OK, rec, sizeof rec);
+        }
+        case PROTO_QTY:
+            if (plen != 8) break;
+            return respond(c, reqId, op, mutationStatus(inventorySetQuantity(inv, (int32_t)protoGetU32(p), (int32_t)protoGetU32(p + 4))), NULL, 0);
+        case PROTO_DEL:
+            if (plen != 4) break;
+            return respond(c, reqId, op, mutationStatus(inventoryDelete(inv, (int32_t)protoGetU32(p))), NULL, 0);
+        case PROTO_ADD: {
+            if (plen != ITEMS_RECORD_SIZE) break;
+            Item it;
+            decodeItemRecord(&it, p);
+            if (itemInvalid(&it)) break; // Same validation as the menu and batch ADD
+            if ((unsigned)it.category > OTHER) it.category = OTHER;
+            int rc = inventoryAdd(inv, &it);
+            return respond(c, reqId, op, rc == 0 ? PROTO_OK : rc == 1 ? PROTO_DUPLICATE : PROTO_IO_ERROR, NULL, 0);
+        }
+        case PROTO_PING:
+            return respond(c, reqId, op, PROTO_OK, NULL, 0);
+    }
+    return respond(c, reqId, op, PROTO_BAD_REQUEST, NULL, 0); // Unknown op or wrong payload size
+}
+
+static int readFrames(Inventory *inv, Conn *c, long *served) { // Drains the socket and runs every complete frame; -1 closes
+    for (;;) {
+        if (reserve(&c->in, &c->inCap, c->inLen + SERVER_READ_CHUNK) != 0) return -1;
+        ssize_t n = recv(c->fd, c->in + c->inLen, SERVER_READ_CHUNK, 0);
+        if (n == 0) return -1; // Peer closed
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break; // Drained
+            return -1;
+        }
+        c->inLen += (size_t)n;
+        if ((size_t)n < SERVER_READ_CHUNK) break; // Short read: nothing more right now
+    }
+    size_t pos = 0;
+    while (c->inLen - pos >= PROTO_HEADER_SIZE) { // Every pipelined request that is complete
+        uint32_t len = protoGetU32(c->in + pos);
+        if (len < PROTO_HEADER_SIZE || len > PROTO_MAX_FRAME) return -1; // Garbage, drop the client
+        if (c->inLen - pos < len) break; // Rest of the frame has not arrived
+        if (handleFrame(inv, c, c->in + pos, len, served) != 0) return -1;
+        pos += len;
+    }
+    memmove(c->in, c->in + pos, c->inLen - pos); // Keep a partial frame for next time
+    c->inLen -= pos;
+    return 0;
+}
+
+static int sendPending(Conn *c) { // Sends as much of the sendable responses as the socket takes; -1 closes
+    while (c->outSent < c->sendable) {
+        ssize_t n = send(c->fd, c->out + c->outSent, c->sendable - c->outSent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0; // Socket full, wait for EPOLLOUT
+            return -1;
+        }
+        c->outSent += (size_t)n;
+    }
+    if (c->outSent == c->outLen) c->outLen = c->outSent = c->sendable = 0; // Everything went out
+    return 0;
+}
+
+static int holdReplies(Conn *c, uint64_t ticket, ConnList *waiting) { // New responses wait for 'ticket'
+    size_t from = c->heldCount ? c->held[c->heldCount - 1].end : c->sendable;
+    if (c->outLen == from) return 0; // Nothing new
+    if (c->heldCount == c->heldCap) {
+        int newCap = c->heldCap ? c->heldCap * 2 : 8;
+        HeldReplies *tmp = realloc(c->held, (size_t)newCap * sizeof *tmp);
+        if (!tmp) return -1;
+        c->held = tmp;
+        c->heldCap = newCap;
+    }
+    c->held[c->heldCount++] = (HeldReplies){ c->outLen, ticket };
+    if (c->waitSlot < 0) {
+        if (waiting->count == waiting->cap) {
+            int newCap = waiting->cap ? waiting->cap * 2 : 64;
+            Conn **tmp = realloc(waiting->conns, (size_t)newCap * sizeof *tmp);
+            if (!tmp) return -1;
+            waiting->conns = tmp;
+            waiting->cap = newCap;
+        }
+        c->waitSlot = waiting->count;
+        waiting->conns[waiting->count++] = c;
+    }
+    return 0;
+}
+
+static void releaseReplies(Conn *c, uint64_t durable) { // Makes responses whose commits are durable sendable
+    int k = 0;
+    while (k < c->heldCount && c->held[k].ticket <= durable) c->sendable = c->held[k++].end;
+    memmove(c->held, c->held + k, (size_t)(c->heldCount - k) * sizeof *c->held);
+    c->heldCount -= k;
+}
+
+static void stopWaiting(ConnList *waiting, Conn *c) { // Takes 'c' off the waiting list
+    if (c->waitSlot < 0) return;
+    Conn *last = waiting->conns[--waiting->count];
+    waiting->conns[c->waitSlot] = last;
+    last->waitSlot = c->waitSlot;
+    c->waitSlot = -1;
+}
+
+static void updateInterest(int ep, Conn *c) { // Chooses EPOLLIN/EPOLLOUT from the connection's state
+    size_t backlog = c->outLen - c->outSent; // Held responses count against the high-water mark too
+    c->paused = backlog > SERVER_OUT_HIGH_WATER;
+    struct epoll_event ev = { .events = (c->paused ? 0 : EPOLLIN) | (c->sendable > c->outSent ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void closeConn(int ep, Conn *c, ConnList *waiting) {
+    stopWaiting(waiting, c);
+    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c->held);
+    free(c);
+}
+
+int runServer(Inventory *inv, const char *socketPath) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof addr.sun_path) return -1; // Path too long for a Unix socket
+    strcpy(addr.sun_path, socketPath);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (lfd < 0) return -2;
+    unlink(socketPath); // Remove a stale socket from an earlier run
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(lfd, SOMAXCONN) != 0) { close(lfd); return -3; }
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) { close(lfd); unlink(socketPath); return -4; }
+    struct epoll_event lev = { .events = EPOLLIN, .data.ptr = NULL }; // NULL marks the listening socket
+    epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &lev);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = onStopSignal; // No SA_RESTART: epoll_wait returns EINTR and the loop sees 'stopping'
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int notify[2] = {-1, -1}; // The syncer writes here after each sync, so held responses go out
+    if (inv->group && pipe2(notify, O_NONBLOCK | O_CLOEXEC) == 0) {
+        struct epoll_event nev = { .events = EPOLLIN, .data.ptr = &notifyTag };
+        epoll_ctl(ep, EPOLL_CTL_ADD, notify[0], &nev);
+        groupCommitNotify(inv->group, notify[1]);
+    }
+    ConnList waiting = {0};
+
+    inventoryDeferLog(inv, 1); // Log records from one wakeup are flushed together
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    Conn *touched[SERVER_MAX_EVENTS]; // Connections with new responses in this wakeup
+    long served = 0, clients = 0;
+    while (!stopping) {
+        int n = epoll_wait(ep, events, SERVER_MAX_EVENTS, snapshotRunning(&inv->snap) ? SERVER_POLL_MS : -1); // Wake up to reap a snapshot child
+        inventoryPollSnapshot(inv);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int nt = 0;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.ptr == &notifyTag) { // A sync finished: release what it made durable
+                char drain[64];
+                while (read(notify[0], drain, sizeof drain) > 0);
+                uint64_t durable = groupCommitDurable(inv->group);
+                for (int w = waiting.count - 1; w >= 0; --w) {
+                    Conn *c = waiting.conns[w];
+                    releaseReplies(c, durable);
+                    if (c->heldCount == 0) stopWaiting(&waiting, c);
+                    if (sendPending(c) == 0) updateInterest(ep, c); // A failed send shows up as EPOLLERR later (c may be in 'touched')
+                }
+                continue;
+            }
+            Conn *c = events[i].data.ptr;
+            if (!c) { // New connections
+                int fd;
+                while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    Conn *nc = calloc(1, sizeof *nc);
+                    if (!nc) { close(fd); continue; }
+                    nc->fd = fd;
+                    nc->waitSlot = -1;
+                    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = nc };
+                    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+                    clients++;
+                }
+                continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) { closeConn(ep, c, &waiting); continue; }
+            if ((events[i].events & EPOLLOUT) && sendPending(c) != 0) { closeConn(ep, c, &waiting); continue; }
+            if ((events[i].events & EPOLLIN) && !c->paused) {
+                if (readFrames(inv, c, &served) != 0) { closeConn(ep, c, &waiting); continue; }
+            }
+            if (!c->touched) { c->touched = 1; touched[nt++] = c; }
+        }
+        if (inventoryFlushLog(inv) != 0) fprintf(stderr, "Error saving items to file.\n"); // In the OS (and queued for a sync) before any reply
+        uint64_t ticket = 0, durable = 0; // Commit the replies of this wakeup depend on
+        if (inv->group && notify[0] >= 0) {
+            ticket = groupCommitLastTicket(inv->group);
+            durable = groupCommitDurable(inv->group);
+        }
+        for (int i = 0; i < nt; ++i) { // Now send the replies of this wakeup
+            Conn *c = touched[i];
+            c->touched = 0;
+            if (ticket > durable) { // Not durable yet: held until the syncer says so
+                if (holdReplies(c, ticket, &waiting) != 0) { closeConn(ep, c, &waiting); continue; }
+            } else {
+                releaseReplies(c, durable);
+                if (c->heldCount == 0) { c->sendable = c->outLen; stopWaiting(&waiting, c); }
+            }
+            if (sendPending(c) != 0) { closeConn(ep, c, &waiting); continue; }
+            updateInterest(ep, c);
+        }
+    }
+    inventoryDeferLog(inv, 0);
+    inventoryFlushLog(inv);
+    if (notify[0] >= 0) {
+        groupCommitNotify(inv->group, -1);
+        close(notify[0]);
+        close(notify[1]);
+    }
+    free(waiting.conns);
+    close(ep); // Open client connections are dropped with the process
+    close(lfd);
+    unlink(socketPath);
+    fprintf(stderr, "Server stopped: %ld requests from %ld connections.\n", served, clients);
+    if (inv->group) groupCommitReport(inv->group, stderr);
+    return 0;
+}
+
+#else
+
+int runServer(Inventory *inv, const char *socketPath) {
+    (void)inv;
+    (void)socketPath;
+    fprintf(stderr, "Server mode needs Linux (epoll and Unix sockets).\n");
+    return -1;
+}
+
+#endif
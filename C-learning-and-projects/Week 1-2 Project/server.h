@@ -0,0 +1,21 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include "inventory.h"
+
+#define SERVER_MAX_EVENTS 256 // epoll events handled per wakeup
+#define SERVER_READ_CHUNK 65536 // Bytes read from a socket per recv
+#define SERVER_OUT_HIGH_WATER (1 << 20) // Stop reading a client whose unsent responses exceed this
+#define SERVER_POLL_MS 100 // epoll timeout while a background snapshot is running
+
+/*
+Serves 'inv' on a Unix domain socket at 'socketPath' (see protocol.h) with a
+single-threaded epoll loop until SIGINT or SIGTERM. Log records produced by
+one wakeup are flushed together before any of their responses are sent.
+With group commit enabled (inventoryEnableGroupCommit) responses are held
+until the commit covering them is durable, so many clients share each sync.
+Returns 0 after a clean shutdown, negative if the socket could not be set up
+(or on platforms without epoll)
+*/
+int runServer(Inventory *inv, const char *socketPath);
+
+#endif // SERVER_H
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sharded.h"
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct { // shardedOpen: one inventoryOpen per shard
+    ShardedInventory *si;
+    int flags;
+    int *codes;
+} OpenTask;
+
+static void openShard(void *ctx, int s) { // Load, verify and index one shard; runs on a pool thread
+    OpenTask *t = ctx;
+    char path[WAL_PATH_MAX];
+    shardPath(path, sizeof path, t->si->filename, &t->si->layout, s);
+    t->codes[s] = inventoryOpen(&t->si->shards[s], path, t->flags);
+}
+
+int shardedOpen(ShardedInventory *si, const char *filename, int flags, int threads) {
+    memset(si, 0, sizeof *si);
+    snprintf(si->filename, sizeof si->filename, "%s", filename);
+    int rc = shardReadLayout(filename, &si->layout);
+    if (rc != 0) return rc;
+    int n = si->layout.count;
+    si->shards = calloc((size_t)n, sizeof *si->shards);
+    si->pending = calloc((size_t)n, 1);
+    int *codes = calloc((size_t)n, sizeof *codes);
+    if (!si->shards || !si->pending || !codes) { free(codes); shardedClose(si); return -1; }
+    double start = nowSeconds();
+    OpenTask task = { si, flags, codes };
+    shardParallel(n, threads, openShard, &task);
+    si->openSeconds = nowSeconds() - start;
+    for (int s = 0; s < n; ++s) {
+        if (codes[s] < 0 && rc == 0) rc = codes[s]; // 1 (no shard file yet) is just an empty shard
+    }
+    if (rc != 0) {
+        for (int s = 0; s < n; ++s) {
+            if (codes[s] >= 0) inventoryClose(&si->shards[s]);
+        }
+        free(si->shards);
+        si->shards = NULL;
+    }
+    free(codes);
+    if (rc != 0) shardedClose(si);
+    return rc;
+}
+
+int shardedClose(ShardedInventory *si) {
+    int rc = 0;
+    for (int s = 0; si->shards && s < si->layout.count; ++s) {
+        if (inventoryClose(&si->shards[s]) != 0) rc = -2;
+    }
+    free(si->shards);
+    free(si->pending);
+    si->shards = NULL;
+    si->pending = NULL;
+    return rc;
+}
+
+const Item *shardedGet(ShardedInventory *si, int id) {
+    return inventoryGet(shardedShard(si, id), id);
+}
+
+int shardedAdd(ShardedInventory *si, const Item *item) {
+    int rc = inventoryAdd(shardedShard(si, item->id), item);
+    if (rc == 0) si->pending[shardOf(&si->layout, item->id)] = 1;
+    return rc;
+}
+
+int shardedSetQuantity(ShardedInventory *si, int id, int quantity) {
+    int rc = inventorySetQuantity(shardedShard(si, id), id, quantity);
+    if (rc == 0) si->pending[shardOf(&si->layout, id)] = 1;
+    return rc;
+}
+
+int shardedDelete(ShardedInventory *si, int id) {
+    int rc = inventoryDelete(shardedShard(si, id), id);
+    if (rc == 0) si->pending[shardOf(&si->layout, id)] = 1;
+    return rc;
+}
+
+int shardedWaitDurable(ShardedInventory *si) {
+    int rc = 0;
+    for (int s = 0; s < si->layout.count; ++s) {
+        if (!si->pending[s]) continue; // Untouched shards cost nothing
+        if (inventoryWaitDurable(&si->shards[s]) != 0) rc = -2;
+        else si->pending[s] = 0;
+    }
+    return rc;
+}
+
+long shardedLive(const ShardedInventory *si) {
+    long live = 0;
+    for (int s = 0; s < si->layout.count; ++s) live += si->shards[s].live;
+    return live;
+}
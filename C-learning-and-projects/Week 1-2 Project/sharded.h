@@ -0,0 +1,45 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+#include "inventory.h"
+#include "shardio.h"
+
+/*
+Inventory over a shard manifest: one Inventory per shard file, each with
+its own id index and its own log. Opening loads, validates and indexes
+the shards concurrently (see shardParallel); every change goes to the one
+shard that owns the id, so only that shard's log and snapshot are written
+*/
+typedef struct {
+    ShardLayout layout;
+    Inventory *shards; // layout.count of them
+    unsigned char *pending; // Shards changed since the last shardedWaitDurable
+    char filename[WAL_PATH_MAX]; // The manifest
+    double openSeconds; // Wall time of the parallel open
+} ShardedInventory;
+
+/*
+Opens every shard of the manifest 'filename' on up to 'threads' threads
+(<= 0: one per CPU). 'flags' as for inventoryOpen. Returns 0 on success,
+or the manifest's or the first failing shard's code (see loadItems)
+*/
+int shardedOpen(ShardedInventory *si, const char *filename, int flags, int threads);
+
+/* Closes every shard. Returns 0 if they all closed cleanly */
+int shardedClose(ShardedInventory *si);
+
+/* The shard that owns 'id' */
+static inline Inventory *shardedShard(ShardedInventory *si, int id) { return &si->shards[shardOf(&si->layout, id)]; }
+
+/* Same as the inventory calls, routed to the owning shard */
+const Item *shardedGet(ShardedInventory *si, int id);
+int shardedAdd(ShardedInventory *si, const Item *item);
+int shardedSetQuantity(ShardedInventory *si, int id, int quantity);
+int shardedDelete(ShardedInventory *si, int id);
+
+/* Makes the changes so far durable; only shards with something logged are synced. Returns 0 on success */
+int shardedWaitDurable(ShardedInventory *si);
+
+/* Live items over all shards */
+long shardedLive(const ShardedInventory *si);
+
+#endif // SHARDED_H
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "shardio.h"
+#include "fileio.h"
+#include "crc32c.h"
+#include "metrics.h"
+#include "byteorder.h"
+
+int shardFileDetect(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 0;
+    char magic[8];
+    int found = fread(magic, 1, sizeof magic, fp) == sizeof magic && memcmp(magic, SHARD_MAGIC, 8) == 0;
+    fclose(fp);
+    return found;
+}
+
+int shardReadLayout(const char *filename, ShardLayout *out) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 1;
+    unsigned char m[SHARD_MANIFEST_SIZE];
+    size_t got = fread(m, 1, sizeof m, fp);
+    fclose(fp);
+    if (got < 8 || memcmp(m, SHARD_MAGIC, 8) != 0) return -4;
+    if (got != sizeof m) return -2;
+    if (getU32(m + 60) != crc32c(0, m, 60)) return -7;
+    if (getU32(m + 8) != SHARD_FORMAT_VERSION) return -5;
+    out->count = (int)getU32(m + 12);
+    out->scheme = (ShardScheme)getU32(m + 16);
+    out->rangeWidth = getU32(m + 20);
+    out->generation = getU32(m + 24);
+    if (out->count < 1 || out->count > SHARD_MAX || (out->scheme != SHARD_BY_HASH && out->scheme != SHARD_BY_RANGE) ||
+        (out->scheme == SHARD_BY_RANGE && out->rangeWidth == 0)) return -5;
+    return 0;
+}
+
+static int writeLayout(const char *filename, const ShardLayout *layout) { // Temp file, sync, rename over the old manifest
+    unsigned char m[SHARD_MANIFEST_SIZE] = {0};
+    memcpy(m, SHARD_MAGIC, 8);
+    putU32(m + 8, SHARD_FORMAT_VERSION);
+    putU32(m + 12, (uint32_t)layout->count);
+    putU32(m + 16, (uint32_t)layout->scheme);
+    putU32(m + 20, layout->rangeWidth);
+    putU32(m + 24, layout->generation);
+    putU32(m + 60, crc32c(0, m, 60));
+    char tmp[WAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof tmp, "%s.tmp", filename);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return -2;
+    int ok = fwrite(m, 1, sizeof m, fp) == sizeof m && syncFile(fp) == 0;
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok || rename(tmp, filename) != 0) { remove(tmp); return -2; }
+    syncParentDir(filename);
+    return 0;
+}
+
+void shardPath(char *out, size_t size, const char *manifest, const ShardLayout *layout, int shard) {
+    snprintf(out, size, "%s.g%u.s%d", manifest, layout->generation, shard);
+}
+
+static void removeShardFiles(const char *manifest, const ShardLayout *layout) { // Shard files of one generation and their logs
+    for (int s = 0; s < layout->count; ++s) {
+        char path[WAL_PATH_MAX], logPath[WAL_PATH_MAX + 8];
+        shardPath(path, sizeof path, manifest, layout, s);
+        snprintf(logPath, sizeof logPath, "%s%s", path, WAL_SUFFIX);
+        remove(path);
+        remove(logPath);
+    }
+}
+
+typedef struct { // Work queue shared by the shard threads
+    int n;
+    int next; // Next shard to hand out, taken with an atomic add
+    void (*fn)(void *ctx, int shard);
+    void *ctx;
+} ShardQueue;
+
+static void *shardWorker(void *arg) {
+    ShardQueue *q = arg;
+    for (int s; (s = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->n;) q->fn(q->ctx, s);
+    return NULL;
+}
+
+void shardParallel(int n, int threads, void (*fn)(void *ctx, int shard), void *ctx) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > n) threads = n;
+    if (threads > SHARD_MAX_THREADS) threads = SHARD_MAX_THREADS;
+    if (threads < 1) threads = 1;
+    unsigned char warm = 0;
+    crc32c(0, &warm, 1); // The CRC tables are built on first use: do that before the threads race for it
+    ShardQueue q = { n, 0, fn, ctx };
+    pthread_t tids[SHARD_MAX_THREADS];
+    int started[SHARD_MAX_THREADS] = {0};
+    for (int t = 1; t < threads; ++t) started[t] = pthread_create(&tids[t], NULL, shardWorker, &q) == 0; // Failed ones just leave more for the rest
+    shardWorker(&q);
+    for (int t = 1; t < threads; ++t) {
+        if (started[t]) pthread_join(tids[t], NULL);
+    }
+}
+
+typedef struct { // loadShardedItems: one result per shard
+    const char *manifest;
+    const ShardLayout *layout;
+    Item **arrays;
+    int *counts;
+    int *codes;
+} LoadTask;
+
+static void loadShard(void *ctx, int s) {
+    LoadTask *t = ctx;
+    char path[WAL_PATH_MAX];
+    shardPath(path, sizeof path, t->manifest, t->layout, s);
+    metricsNest(1); // One load of the whole manifest in the metrics, not one per shard
+    t->codes[s] = loadItems(path, &t->arrays[s], &t->counts[s]);
+    metricsNest(-1);
+    if (t->codes[s] == 1) { t->arrays[s] = NULL; t->counts[s] = 0; t->codes[s] = 0; } // Nothing written to this shard yet
+}
+
+int loadShardedItems(const char *filename, Item **arrayPtr, int *countPtr, int threads) {
+    ShardLayout layout;
+    *arrayPtr = NULL;
+    int rc = shardReadLayout(filename, &layout);
+    if (rc != 0) return rc;
+    int n = layout.count;
+    Item **arrays = calloc((size_t)n, sizeof *arrays);
+    int *counts = calloc((size_t)n, sizeof *counts), *codes = calloc((size_t)n, sizeof *codes);
+    if (!arrays || !counts || !codes) { free(arrays); free(counts); free(codes); return -1; }
+    LoadTask task = { filename, &layout, arrays, counts, codes };
+    shardParallel(n, threads, loadShard, &task);
+    size_t total = 0;
+    for (int s = 0; s < n; ++s) {
+        if (codes[s] != 0 && rc == 0) rc = codes[s]; // First failing shard decides
+        total += (size_t)counts[s];
+    }
+    Item *all = NULL;
+    if (rc == 0 && total > (size_t)INT32_MAX) rc = -1;
+    if (rc == 0 && !(all = malloc(total ? total * sizeof *all : 1))) rc = -1;
+    size_t at = 0;
+    for (int s = 0; s < n; ++s) {
+        if (rc == 0 && counts[s] > 0) memcpy(all + at, arrays[s], (size_t)counts[s] * sizeof *all);
+        at += (size_t)counts[s];
+        free(arrays[s]);
+    }
+    free(arrays);
+    free(counts);
+    free(codes);
+    if (rc != 0) return rc;
+    *arrayPtr = all;
+    *countPtr = (int)total;
+    return 0;
+}
+
+typedef struct { // shardSplit: the items of each shard, written in parallel
+    const char *manifest;
+    const ShardLayout *layout;
+    Item **arrays;
+    int *counts;
+    int *codes;
+} SaveTask;
+
+static void saveShard(void *ctx, int s) {
+    SaveTask *t = ctx;
+    char path[WAL_PATH_MAX], logPath[WAL_PATH_MAX + 8];
+    shardPath(path, sizeof path, t->manifest, t->layout, s);
+    snprintf(logPath, sizeof logPath, "%s%s", path, WAL_SUFFIX);
+    remove(logPath); // Left by an earlier split that never switched over
+    t->codes[s] = saveItems(path, t->arrays[s], t->counts[s]);
+}
+
+int shardSplit(const char *source, const char *manifest, int shards, ShardScheme scheme, int threads) {
+    if (shards < 1 || shards > SHARD_MAX) return -5;
+    Item *items = NULL;
+    int count = 0;
+    int rc = loadItems(source, &items, &count); // Snapshot plus log, or every shard of a manifest
+    if (rc < 0) return rc;
+    ShardLayout old, layout = { shards, scheme, 1, 1 };
+    int hadOld = shardReadLayout(manifest, &old) == 0;
+    if (hadOld) layout.generation = old.generation + 1;
+    int maxId = 0;
+    for (int i = 0; i < count; ++i) if (items[i].id > maxId) maxId = items[i].id;
+    layout.rangeWidth = (uint32_t)maxId / (uint32_t)shards + 1; // Even ranges over the ids in use; later, larger ids go to the last shard
+
+    int *counts = calloc((size_t)shards, sizeof *counts), *codes = calloc((size_t)shards, sizeof *codes);
+    Item **arrays = calloc((size_t)shards, sizeof *arrays);
+    rc = counts && codes && arrays ? 0 : -1;
+    for (int i = 0; rc == 0 && i < count; ++i) if (items[i].id > 0) counts[shardOf(&layout, items[i].id)]++;
+    for (int s = 0; rc == 0 && s < shards; ++s) {
+        arrays[s] = malloc(counts[s] ? (size_t)counts[s] * sizeof *arrays[s] : 1);
+        if (!arrays[s]) rc = -1;
+        counts[s] = 0;
+    }
+    for (int i = 0; rc == 0 && i < count; ++i) { // Keeps the order within each shard
+        if (items[i].id <= 0) continue;
+        int s = shardOf(&layout, items[i].id);
+        arrays[s][counts[s]++] = items[i];
+    }
+    free(items);
+    if (rc == 0) {
+        SaveTask task = { manifest, &layout, arrays, counts, codes };
+        shardParallel(shards, threads, saveShard, &task);
+        for (int s = 0; s < shards && rc == 0; ++s) rc = codes[s];
+    }
+    if (rc == 0) rc = writeLayout(manifest, &layout); // The switch-over
+    if (rc == 0) {
+        char logPath[WAL_PATH_MAX + 8];
+        snprintf(logPath, sizeof logPath, "%s%s", manifest, WAL_SUFFIX);
+        remove(logPath); // Replayed above if 'source' was this file; a manifest has no log of its own
+        if (hadOld) removeShardFiles(manifest, &old);
+    } else if (codes) {
+        removeShardFiles(manifest, &layout); // The old manifest still names the old generation
+    }
+    for (int s = 0; arrays && s < shards; ++s) free(arrays[s]);
+    free(arrays);
+    free(counts);
+    free(codes);
+    return rc;
+}
+
+int shardRemoveAll(const char *manifest) {
+    ShardLayout layout;
+    if (shardReadLayout(manifest, &layout) != 0) return 1;
+    removeShardFiles(manifest, &layout);
+    remove(manifest);
+    return 0;
+}
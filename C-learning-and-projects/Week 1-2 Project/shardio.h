@@ -0,0 +1,80 @@
+#ifndef SHARDIO_H
+#define SHARDIO_H
+#include <stdint.h>
+#include "item.h"
+
+/*
+Sharded items files. A shard manifest takes the place of an items file and
+splits the ids over N ordinary items files, by hash or by contiguous id
+range; every shard has its own log, so a change only writes to the shard
+that owns the id. Manifest, 64 bytes, all integers little-endian:
+   0 magic "INVSHARD"   8 version (u32)         12 shard count (u32)
+  16 scheme (u32, 0 hash / 1 range)             20 ids per range (u32)
+  24 generation (u32)  28 reserved              60 CRC32C of bytes 0..59
+Shard i of generation g is the items file "<manifest>.g<g>.s<i>". A split
+writes a new generation next to the old one and switches over by renaming
+the manifest into place, so a crash leaves either the old or the new set.
+*/
+#define SHARD_MAGIC "INVSHARD" // 8 bytes, no terminator stored
+#define SHARD_FORMAT_VERSION 1
+#define SHARD_MANIFEST_SIZE 64
+#define SHARD_MAX 1024
+#define SHARD_MAX_THREADS 64
+
+typedef enum { SHARD_BY_HASH = 0, SHARD_BY_RANGE = 1 } ShardScheme;
+
+typedef struct { // What a manifest says
+    int count; // Shards
+    ShardScheme scheme;
+    uint32_t rangeWidth; // SHARD_BY_RANGE: ids per shard, the last shard takes the rest
+    uint32_t generation; // Bumped by every split, part of the shard file names
+} ShardLayout;
+
+/* Returns 1 if 'filename' starts with the manifest magic */
+int shardFileDetect(const char *filename);
+
+/* Reads a manifest. Returns 0, 1 no file, -2 read error, -4 not a manifest, -5 unsupported version, -7 checksum mismatch */
+int shardReadLayout(const char *filename, ShardLayout *out);
+
+/* Path of shard 'shard' of the manifest 'manifest' */
+void shardPath(char *out, size_t size, const char *manifest, const ShardLayout *layout, int shard);
+
+/* Shard that owns 'id' */
+static inline int shardOf(const ShardLayout *layout, int id) {
+    if (layout->scheme == SHARD_BY_RANGE) {
+        uint32_t s = id > 0 ? ((uint32_t)id - 1) / layout->rangeWidth : 0;
+        return s >= (uint32_t)layout->count ? layout->count - 1 : (int)s;
+    }
+    uint32_t h = (uint32_t)id * 2654435761u; // Multiplicative hash, then mapped onto [0, count) without a division
+    return (int)(((uint64_t)h * (uint32_t)layout->count) >> 32);
+}
+
+/*
+Runs fn(ctx, s) for every shard s in [0, n) on up to 'threads' threads
+(<= 0: one per CPU). The threads take the next shard as they finish, so
+a large shard does not hold up the small ones. The calling thread works too
+*/
+void shardParallel(int n, int threads, void (*fn)(void *ctx, int shard), void *ctx);
+
+/*
+Loads every shard (snapshot plus its log, checksums verified) concurrently
+and returns them as one array, shard by shard; loadItems does this for a
+manifest. A missing shard file is an empty shard. Same return codes as
+loadItems, plus the manifest's own from shardReadLayout
+*/
+int loadShardedItems(const char *filename, Item **arrayPtr, int *countPtr, int threads);
+
+/*
+Splits the items of 'source' (an items file or a manifest, logs included)
+into 'shards' shard files and writes the manifest 'manifest' over the old
+one last; 'source' and 'manifest' may be the same path. Files of the
+previous generation and any log of 'manifest' itself are removed once the
+new manifest is in place. Returns 0 on success, loadItems/saveItems codes
+on failure, -5 if 'shards' is out of range
+*/
+int shardSplit(const char *source, const char *manifest, int shards, ShardScheme scheme, int threads);
+
+/* Removes the manifest, its shard files and their logs. Returns 0, or 1 if it was not a manifest */
+int shardRemoveAll(const char *manifest);
+
+#endif // SHARDIO_H
@@ -0,0 +1,80 @@
+#ifndef SHMLAYOUT_H
+#define SHMLAYOUT_H
+#include <stdint.h>
+#include <stdio.h>
+#include "item.h"
+
+/*
+Layout of the POSIX shared memory segment an inventory publishes its items
+in (written by shmstore.c, read by shmreader.c in other processes):
+  header (128 bytes)   records[capacity]   id table[tableMask + 1]
+The writer is the only process that changes it; readers map it read-only
+and never make a system call to read, only to map it again after it grew.
+
+Every record carries a sequence lock: the writer makes the sequence odd,
+changes the item, then makes it even again. A reader copies the item
+between two loads of the sequence and retries unless both are the same
+even value, so it never sees half of a change. The id table maps ids to
+slots; each entry is one 64-bit word (id << 32 | slot) stored atomically,
+so readers probe it without locks and check the id of the record they land
+on. Moving everything at once (growing the segment, compaction) happens
+under the header's layout sequence, which readers check the same way around
+each whole lookup.
+*/
+#define SHM_MAGIC "INVSHM01" // 8 bytes, no terminator stored
+#define SHM_FORMAT_VERSION 1
+#define SHM_HEADER_SIZE 128
+#define SHM_NAME_MAX 64 // Longest segment name, '/' included
+#define SHM_EMPTY 0u // Id half of a never-used table entry
+#define SHM_DELETED 0xFFFFFFFFu // Id half of an entry whose item was deleted (probes go past it)
+
+enum { SHM_LIVE = 1, SHM_CLOSED = 2 }; // Header state
+
+typedef struct { // First cache line: what a lookup needs, changed only by a relayout
+    char magic[8];
+    uint32_t version;
+    uint32_t state; // SHM_LIVE, or SHM_CLOSED once the writer has let go of it
+    uint64_t layoutSeq; // Odd while the writer lays the segment out again
+    uint64_t bytes; // Size of the segment
+    uint64_t tableOffset; // Records start right after the header
+    uint32_t capacity; // Records there is room for
+    uint32_t tableMask; // Table entries - 1 (a power of two minus one)
+    uint32_t recordSize; // sizeof(ShmRecord), checked by readers
+    uint32_t writerPid;
+    char pad1[64 - 56];
+    // Second cache line: moves with every change, kept away from the first
+    uint32_t count; // Slots in use, deleted ones included
+    uint32_t live; // Items not deleted
+    uint64_t writes; // Record changes so far
+    char pad2[64 - 16];
+} ShmHeader;
+
+typedef struct { // One slot of the items array
+    uint32_t seq; // Sequence lock: odd while the writer is changing 'item'
+    uint32_t pad;
+    Item item; // id 0 in a deleted slot
+} ShmRecord;
+
+static inline uint32_t shmHash(uint32_t id) { // Table position of an id before probing
+    id ^= id >> 16;
+    id *= 0x7FEB352Du;
+    id ^= id >> 15;
+    id *= 0x846CA68Bu;
+    return id ^ (id >> 16);
+}
+
+static inline uint64_t shmEntry(uint32_t id, uint32_t slot) { return (uint64_t)id << 32 | slot; }
+static inline uint32_t shmEntryId(uint64_t e) { return (uint32_t)(e >> 32); }
+static inline uint32_t shmEntrySlot(uint64_t e) { return (uint32_t)e; }
+
+static inline void shmSegmentName(char *out, const char *name) { // POSIX names start with a slash
+    snprintf(out, SHM_NAME_MAX, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+static inline void shmRelax(void) { // Polite spin while the writer finishes a change
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+#endif // SHMLAYOUT_H
@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmreader.h"
+
+static const ShmHeader *header(const ShmReader *r) { return (const ShmHeader *)r->base; }
+
+static int remap(ShmReader *r) { // The writer grew the segment: map all of it
+    struct stat st;
+    if (fstat(r->fd, &st) != 0) return -1;
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, r->fd, 0);
+    if (p == MAP_FAILED) return -1;
+    munmap((void *)r->base, r->mapped);
+    r->base = p;
+    r->mapped = (size_t)st.st_size;
+    r->remaps++;
+    return 0;
+}
+
+int shmReaderOpen(ShmReader *r, const char *name) {
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+    shmSegmentName(r->name, name);
+    int fd = shm_open(r->name, O_RDONLY, 0);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    if ((size_t)st.st_size < SHM_HEADER_SIZE) { close(fd); return -4; } // Still being created, or not ours
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) { int saved = errno; close(fd); errno = saved; return -1; }
+    const ShmHeader *h = p;
+    int rc = 0;
+    if (memcmp(h->magic, SHM_MAGIC, sizeof h->magic) != 0) rc = -4;
+    else if (h->version != SHM_FORMAT_VERSION || h->recordSize != sizeof(ShmRecord)) rc = -5;
+    if (rc != 0) {
+        munmap(p, (size_t)st.st_size);
+        close(fd);
+        return rc;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE); // Pairs with the fence before the writer stored the magic
+    r->fd = fd;
+    r->base = p;
+    r->mapped = (size_t)st.st_size;
+    return 0;
+}
+
+int shmReaderGet(ShmReader *r, int id, Item *out) {
+    if (id <= 0) return 1; // 0 marks deleted slots, never a real item
+    for (long spins = 0; spins < SHM_READ_SPINS; ++spins) {
+        const ShmHeader *h = header(r);
+        uint64_t layout = __atomic_load_n(&h->layoutSeq, __ATOMIC_ACQUIRE);
+        if (layout & 1) { shmRelax(); continue; } // Segment being laid out again
+        uint64_t bytes = h->bytes;
+        if (bytes > r->mapped) { // Grew: the old mapping stops short of the table
+            if (remap(r) != 0) return -1;
+            continue;
+        }
+        uint64_t offset = h->tableOffset;
+        uint32_t mask = h->tableMask;
+        uint32_t capacity = h->capacity;
+        if (offset + ((uint64_t)mask + 1) * sizeof(uint64_t) > r->mapped || SHM_HEADER_SIZE + (uint64_t)capacity * sizeof(ShmRecord) > offset) {
+            r->retries++; // Torn header read during a relayout
+            continue;
+        }
+        const uint64_t *table = (const uint64_t *)(r->base + offset);
+        const ShmRecord *records = (const ShmRecord *)(r->base + SHM_HEADER_SIZE);
+        int found = 0, retry = 0;
+        uint32_t i = shmHash((uint32_t)id) & mask;
+        for (uint32_t probes = 0; probes <= mask; ++probes, i = (i + 1) & mask) {
+            uint64_t e = __atomic_load_n(&table[i], __ATOMIC_ACQUIRE);
+            uint32_t eid = shmEntryId(e);
+            if (eid == SHM_EMPTY) break;
+            if (eid != (uint32_t)id) continue;
+            uint32_t slot = shmEntrySlot(e);
+            if (slot >= capacity) { retry = 1; break; }
+            const ShmRecord *rec = &records[slot];
+            uint32_t s1 = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+            memcpy(out, &rec->item, sizeof *out);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE); // The copy is done before the second load
+            uint32_t s2 = __atomic_load_n(&rec->seq, __ATOMIC_RELAXED);
+            if ((s1 & 1) || s1 != s2) { retry = 1; break; } // Copied while it changed
+            if (out->id != id) { retry = 1; break; } // Deleted or reused after we found the entry
+            found = 1;
+            break;
+        }
+        if (__atomic_load_n(&h->layoutSeq, __ATOMIC_ACQUIRE) != layout) retry = 1; // Everything may have moved under us
+        if (retry) {
+            r->retries++;
+            shmRelax();
+            continue;
+        }
+        return found ? 0 : 1;
+    }
+    return -2;
+}
+
+uint32_t shmReaderLive(const ShmReader *r) {
+    return __atomic_load_n(&header(r)->live, __ATOMIC_RELAXED);
+}
+
+int shmReaderClosed(const ShmReader *r) {
+    return __atomic_load_n(&header(r)->state, __ATOMIC_ACQUIRE) == SHM_CLOSED;
+}
+
+void shmReaderClose(ShmReader *r) {
+    if (r->base) munmap((void *)r->base, r->mapped);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+}
@@ -0,0 +1,50 @@
+#ifndef SHMREADER_H
+#define SHMREADER_H
+#include <stddef.h>
+#include <stdint.h>
+#include "item.h"
+#include "shmlayout.h"
+
+/*
+Reader side of a shared-memory inventory (layout in shmlayout.h), for
+processes other than the one that owns it. Needs only this file, shmreader.c,
+shmlayout.h and item.h. A lookup is loads from the mapping and nothing else:
+no lock is taken and no system call made, unless the segment grew since it
+was mapped. Every item returned is one the writer wrote whole.
+*/
+#define SHM_READ_SPINS 100000000 // Retries before a lookup gives up on a writer that stopped in the middle of a change
+
+typedef struct {
+    int fd;
+    const unsigned char *base; // The mapping, read-only
+    size_t mapped;
+    char name[SHM_NAME_MAX];
+    uint64_t retries; // Lookups repeated because the writer was changing what they read
+    uint64_t remaps; // Times the segment had grown
+} ShmReader;
+
+/*
+Maps the segment 'name' ("/" is added in front if missing). Returns 0 on
+success, -1 if there is no such segment or it cannot be mapped (errno set),
+-4 if it is not an inventory segment, -5 if it was written by a different
+version
+*/
+int shmReaderOpen(ShmReader *r, const char *name);
+
+/*
+Copies the item with 'id' into 'out'. Returns 0 if found, 1 if there is no
+such item, -1 if the grown segment cannot be mapped again, -2 if the writer
+never finished the change it was making
+*/
+int shmReaderGet(ShmReader *r, int id, Item *out);
+
+/* Items not deleted, as of the last change */
+uint32_t shmReaderLive(const ShmReader *r);
+
+/* Nonzero once the writer has closed the segment (what is mapped stays readable) */
+int shmReaderClosed(const ShmReader *r);
+
+/* Unmaps the segment */
+void shmReaderClose(ShmReader *r);
+
+#endif // SHMREADER_H
@@ -0,0 +1,240 @@
+#define _GNU_SOURCE // mremap
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmstore.h"
+
+static uint32_t tableEntries(uint32_t capacity) { // At least twice the records, so probes stay short
+    uint64_t e = 16;
+    while (e < (uint64_t)capacity * 2) e <<= 1;
+    return (uint32_t)e;
+}
+
+static size_t tableOffset(uint32_t capacity) { // After the records, on a cache line
+    size_t end = SHM_HEADER_SIZE + (size_t)capacity * sizeof(ShmRecord);
+    return (end + 63) & ~(size_t)63;
+}
+
+static void beginWrite(uint32_t *seq) { // Odd: readers of this record retry
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); // The odd value is out before any of the change
+}
+
+static void endWrite(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static void beginLayout(ShmStore *s) { // Odd: every lookup retries
+    __atomic_store_n(&s->hdr->layoutSeq, s->hdr->layoutSeq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void endLayout(ShmStore *s) {
+    __atomic_store_n(&s->hdr->layoutSeq, s->hdr->layoutSeq + 1, __ATOMIC_RELEASE);
+}
+
+static void setPointers(ShmStore *s) {
+    s->hdr = (ShmHeader *)s->base;
+    s->records = (ShmRecord *)(s->base + SHM_HEADER_SIZE);
+    s->table = (uint64_t *)(s->base + s->hdr->tableOffset);
+}
+
+static void tableInsert(ShmStore *s, uint32_t id, uint32_t slot) { // Of a repeated id the first stays
+    uint32_t mask = s->hdr->tableMask;
+    uint32_t i = shmHash(id) & mask;
+    int64_t reuse = -1;
+    for (;;) {
+        uint32_t eid = shmEntryId(s->table[i]);
+        if (eid == id) return;
+        if (eid == SHM_DELETED && reuse < 0) reuse = i;
+        if (eid == SHM_EMPTY) break;
+        i = (i + 1) & mask;
+    }
+    if (reuse >= 0) { i = (uint32_t)reuse; s->deleted--; }
+    __atomic_store_n(&s->table[i], shmEntry(id, slot), __ATOMIC_RELEASE); // One store: readers see all of it or none
+}
+
+static void tableRemove(ShmStore *s, uint32_t id, uint32_t slot) {
+    uint32_t mask = s->hdr->tableMask;
+    for (uint32_t i = shmHash(id) & mask;; i = (i + 1) & mask) {
+        uint64_t e = s->table[i];
+        if (shmEntryId(e) == SHM_EMPTY) return;
+        if (shmEntryId(e) != id) continue;
+        if (shmEntrySlot(e) != slot) return; // A repeated id that was never in the table
+        __atomic_store_n(&s->table[i], shmEntry(SHM_DELETED, 0), __ATOMIC_RELEASE); // Probes still go past it
+        s->deleted++;
+        return;
+    }
+}
+
+static void rebuildTable(ShmStore *s) { // Called under the layout lock
+    memset(s->table, 0, ((size_t)s->hdr->tableMask + 1) * sizeof *s->table);
+    s->deleted = 0;
+    for (uint32_t slot = 0; slot < s->hdr->count; ++slot) {
+        int id = s->records[slot].item.id;
+        if (id > 0) tableInsert(s, (uint32_t)id, slot);
+    }
+}
+
+static int mapSize(ShmStore *s, size_t bytes) { // Grows the segment and the mapping to 'bytes'
+    if (ftruncate(s->fd, (off_t)bytes) != 0) return -1;
+#ifdef __linux__
+    void *p = mremap(s->base, s->mapped, bytes, MREMAP_MAYMOVE);
+#else
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+    if (p != MAP_FAILED) munmap(s->base, s->mapped);
+#endif
+    if (p == MAP_FAILED) return -1;
+    s->base = p;
+    s->mapped = bytes;
+    setPointers(s);
+    return 0;
+}
+
+static int writerRunning(const char *name) { // Is an existing segment 'name' still owned by a live writer?
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return 0;
+    struct stat st;
+    int running = 0;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= SHM_HEADER_SIZE) {
+        const ShmHeader *h = mmap(NULL, SHM_HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        if (h != MAP_FAILED) {
+            pid_t pid = (pid_t)h->writerPid;
+            if (memcmp(h->magic, SHM_MAGIC, sizeof h->magic) == 0 && __atomic_load_n(&h->state, __ATOMIC_ACQUIRE) == SHM_LIVE && pid > 0) {
+                running = kill(pid, 0) == 0 || errno == EPERM; // EPERM: alive, just not ours to signal
+            }
+            munmap((void *)h, SHM_HEADER_SIZE);
+        }
+    }
+    close(fd);
+    return running;
+}
+
+int shmStoreCreate(ShmStore *s, const char *name, const Item *items, int count) {
+    memset(s, 0, sizeof *s);
+    s->fd = -1;
+    shmSegmentName(s->name, name);
+    if (writerRunning(s->name)) { errno = EEXIST; return -1; } // Never take a segment from a writer that is still running
+    shm_unlink(s->name); // Left behind by a writer that died: readers of it keep their mapping
+    uint32_t capacity = SHM_MIN_CAPACITY;
+    while (capacity < (uint32_t)count) capacity *= 2; // Room to grow before the first relayout
+    uint32_t entries = tableEntries(capacity);
+    size_t bytes = tableOffset(capacity) + (size_t)entries * sizeof(uint64_t);
+    int fd = shm_open(s->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return -1;
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, (off_t)bytes) != 0 || (p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        shm_unlink(s->name);
+        errno = saved;
+        return -1;
+    }
+    s->fd = fd;
+    s->base = p;
+    s->mapped = bytes;
+    ShmHeader *h = (ShmHeader *)s->base; // The new segment is all zeroes
+    h->version = SHM_FORMAT_VERSION;
+    h->state = SHM_LIVE;
+    h->bytes = bytes;
+    h->tableOffset = tableOffset(capacity);
+    h->capacity = capacity;
+    h->tableMask = entries - 1;
+    h->recordSize = sizeof(ShmRecord);
+    h->writerPid = (uint32_t)getpid();
+    setPointers(s);
+    uint32_t live = 0;
+    for (int slot = 0; slot < count; ++slot) {
+        s->records[slot].item = items[slot];
+        if (items[slot].id > 0) { tableInsert(s, (uint32_t)items[slot].id, (uint32_t)slot); live++; }
+    }
+    h->count = (uint32_t)count;
+    h->live = live;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(h->magic, SHM_MAGIC, sizeof h->magic); // Last: a reader that sees the magic sees the rest
+    return 0;
+}
+
+int shmStoreReserve(ShmStore *s, int n) {
+    uint32_t old = s->hdr->capacity;
+    if ((uint32_t)n <= old) return 0;
+    uint32_t capacity = old;
+    while (capacity < (uint32_t)n) capacity *= 2;
+    uint32_t entries = tableEntries(capacity);
+    size_t offset = tableOffset(capacity);
+    beginLayout(s);
+    if (mapSize(s, offset + (size_t)entries * sizeof(uint64_t)) != 0) { endLayout(s); return -1; } // Nothing moved yet
+    memset(&s->records[old], 0, (size_t)(capacity - old) * sizeof(ShmRecord)); // Was table: sequences must start even
+    s->hdr->bytes = s->mapped;
+    s->hdr->capacity = capacity;
+    s->hdr->tableOffset = offset;
+    s->hdr->tableMask = entries - 1;
+    setPointers(s);
+    rebuildTable(s);
+    endLayout(s);
+    return 0;
+}
+
+void shmStorePut(ShmStore *s, int slot, const Item *item) {
+    ShmRecord *r = &s->records[slot];
+    int old = r->item.id; // 0 for a slot not used before
+    beginWrite(&r->seq);
+    r->item = *item;
+    endWrite(&r->seq);
+    if (old != item->id) {
+        if (old > 0) tableRemove(s, (uint32_t)old, (uint32_t)slot);
+        if (item->id > 0) tableInsert(s, (uint32_t)item->id, (uint32_t)slot); // After the record: a reader that finds it finds the item
+    }
+    if ((uint32_t)slot >= s->hdr->count) __atomic_store_n(&s->hdr->count, (uint32_t)slot + 1, __ATOMIC_RELAXED);
+    if (old <= 0 && item->id > 0) __atomic_store_n(&s->hdr->live, s->hdr->live + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->hdr->writes, s->hdr->writes + 1, __ATOMIC_RELAXED);
+}
+
+void shmStoreKill(ShmStore *s, int slot) {
+    ShmRecord *r = &s->records[slot];
+    int id = r->item.id;
+    if (id <= 0) return;
+    tableRemove(s, (uint32_t)id, (uint32_t)slot); // Before the record: new lookups miss it from here on
+    beginWrite(&r->seq);
+    r->item.id = 0;
+    endWrite(&r->seq);
+    __atomic_store_n(&s->hdr->live, s->hdr->live - 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->hdr->writes, s->hdr->writes + 1, __ATOMIC_RELAXED);
+    if (s->deleted > (s->hdr->tableMask + 1) / SHM_TABLE_REBUILD) { // Long probes past deleted entries: start the table over
+        beginLayout(s);
+        rebuildTable(s);
+        endLayout(s);
+    }
+}
+
+void shmStorePublish(ShmStore *s, const Item *items, int count) {
+    beginLayout(s);
+    uint32_t live = 0;
+    for (int slot = 0; slot < count; ++slot) {
+        s->records[slot].item = items[slot]; // Sequences stay even: the layout lock covers the whole copy
+        if (items[slot].id > 0) live++;
+    }
+    for (uint32_t slot = (uint32_t)count; slot < s->hdr->count; ++slot) memset(&s->records[slot].item, 0, sizeof(Item));
+    s->hdr->count = (uint32_t)count;
+    s->hdr->live = live;
+    s->hdr->writes += (uint64_t)count;
+    rebuildTable(s);
+    endLayout(s);
+}
+
+void shmStoreClose(ShmStore *s) {
+    if (s->base) {
+        __atomic_store_n(&s->hdr->state, SHM_CLOSED, __ATOMIC_RELEASE);
+        munmap(s->base, s->mapped);
+    }
+    if (s->fd >= 0) {
+        close(s->fd);
+        shm_unlink(s->name);
+    }
+    memset(s, 0, sizeof *s);
+    s->fd = -1;
+}
@@ -0,0 +1,58 @@
+#ifndef SHMSTORE_H
+#define SHMSTORE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "item.h"
+#include "shmlayout.h"
+
+/*
+Writer side of a shared-memory inventory (layout in shmlayout.h): a POSIX
+shared memory segment holding the items, slot for slot as the owning
+inventory has them, and an id table, so processes on the same machine read
+current stock through shmreader.h without copying the items file. Only one
+process may write a segment; it creates it, keeps it in step with every
+change, and unlinks it when it closes.
+*/
+#define SHM_MIN_CAPACITY 1024 // Records in a new segment at least
+#define SHM_TABLE_REBUILD 4 // Rebuild the table once deleted entries pass 1/4 of it
+
+typedef struct {
+    int fd;
+    unsigned char *base; // The mapping
+    size_t mapped;
+    ShmHeader *hdr;
+    ShmRecord *records;
+    uint64_t *table;
+    uint32_t deleted; // SHM_DELETED entries in the table
+    char name[SHM_NAME_MAX];
+} ShmStore;
+
+/*
+Creates the segment 'name' ("/" is added in front if missing) with 'count'
+slots of 'items' (id 0 marks a deleted slot; of repeated ids only the first
+is found). A segment left behind by a writer that died is replaced. Returns
+0 on success, -1 on failure (errno set; EEXIST if its writer is still
+running)
+*/
+int shmStoreCreate(ShmStore *s, const char *name, const Item *items, int count);
+
+/* Makes room for 'n' slots, growing the segment if needed. Returns 0 on success, -1 on failure */
+int shmStoreReserve(ShmStore *s, int n);
+
+/* Writes the item in 'slot', the next free one or an existing one (room was reserved) */
+void shmStorePut(ShmStore *s, int slot, const Item *item);
+
+/* Marks 'slot' deleted */
+void shmStoreKill(ShmStore *s, int slot);
+
+/*
+Replaces everything with 'count' slots of 'items' (no more than were
+reserved) in one step readers never see half of, e.g. after compaction
+moved the slots
+*/
+void shmStorePublish(ShmStore *s, const Item *items, int count);
+
+/* Marks the segment closed, unmaps and unlinks it (readers keep what they mapped) */
+void shmStoreClose(ShmStore *s);
+
+#endif // SHMSTORE_H
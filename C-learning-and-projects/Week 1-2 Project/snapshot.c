@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "snapshot.h"
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+typedef struct { // What the child sends back through the pipe
+    int rc; // 0 if the snapshot is in place
+    int pad;
+    long items;
+    double durationMs;
+} ChildReport;
+
+static double nowMs(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int writeSnapshot(const char *snapshot, const Item *items, int count) { // Temp file, then an atomic rename
+    char tmp[WAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof tmp, "%s.tmp", snapshot);
+    if (saveLiveItems(tmp, items, count) != 0) { remove(tmp); return -1; } // Deleted slots are skipped, no compaction needed
+#ifdef _WIN32
+    remove(snapshot); // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tmp, snapshot) != 0) { remove(tmp); return -2; }
+    syncParentDir(snapshot); // Only then may the parent trim the log
+    return 0;
+}
+
+static long liveCount(const Item *items, int count) {
+    long n = 0;
+    for (int i = 0; i < count; ++i) n += items[i].id != 0;
+    return n;
+}
+
+#ifndef _WIN32
+
+static long minorFaults(void) { // Page faults served without I/O, which includes copy-on-write copies
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+int snapshotStart(BgSnapshot *snap, Wal *wal, const Item *items, int count) {
+    if (snap->pid) return 1;
+    if (walFlush(wal) != 0) return -2; // The offset below must cover everything the child will see
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    snap->logOffset = wal->size;
+    snap->faultsAtFork = minorFaults();
+    double start = nowMs();
+    pid_t pid = fork(); // The child gets a frozen, shared image of every page
+    if (pid < 0) { close(fds[0]); close(fds[1]); return -1; }
+    if (pid == 0) { // Child: write, report, leave without running the parent's atexit or stdio flushes
+        close(fds[0]);
+        ChildReport rep;
+        memset(&rep, 0, sizeof rep);
+        rep.rc = writeSnapshot(wal->snapshot, items, count);
+        rep.items = liveCount(items, count);
+        rep.durationMs = nowMs() - start;
+        ssize_t ignored = write(fds[1], &rep, sizeof rep); // Smaller than PIPE_BUF, so it arrives whole
+        (void)ignored;
+        _exit(rep.rc == 0 ? 0 : 1);
+    }
+    snap->metrics.forkMs = nowMs() - start;
+    close(fds[1]);
+    snap->pipeFd = fds[0];
+    snap->pid = (int)pid;
+    snap->metrics.pageSize = sysconf(_SC_PAGESIZE);
+    return 0;
+}
+
+int snapshotPoll(BgSnapshot *snap, Wal *wal, int wait) {
+    if (!snap->pid) return 0;
+    int status;
+    pid_t r;
+    do {
+        r = waitpid((pid_t)snap->pid, &status, wait ? 0 : WNOHANG);
+    } while (r < 0 && errno == EINTR);
+    if (r == 0) return 0; // Still writing
+    snap->metrics.cowFaults = minorFaults() - snap->faultsAtFork;
+    ChildReport rep;
+    memset(&rep, 0, sizeof rep);
+    rep.rc = -1;
+    if (read(snap->pipeFd, &rep, sizeof rep) != (ssize_t)sizeof rep) rep.rc = -1; // Child died before reporting
+    close(snap->pipeFd);
+    snap->pid = 0;
+    if (r < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || rep.rc != 0) {
+        snap->metrics.failed++;
+        return -1;
+    }
+    snap->metrics.items = rep.items;
+    snap->metrics.durationMs = rep.durationMs;
+    double start = nowMs();
+    int rc = walTrimFront(wal, snap->logOffset); // Records before the fork are now in the snapshot
+    snap->metrics.trimMs = nowMs() - start;
+    snap->metrics.completed++;
+    return rc == 0 ? 1 : -2; // A failed trim only means replaying some records twice, which is harmless
+}
+
+#else
+
+int snapshotStart(BgSnapshot *snap, Wal *wal, const Item *items, int count) { // No fork(): write it here and now
+    if (walFlush(wal) != 0) return -2;
+    double start = nowMs();
+    long offset = wal->size;
+    int rc = writeSnapshot(wal->snapshot, items, count);
+    snap->metrics.forkMs = 0.0;
+    snap->metrics.cowFaults = 0;
+    if (rc != 0) { snap->metrics.failed++; return -1; }
+    snap->metrics.items = liveCount(items, count);
+    snap->metrics.durationMs = nowMs() - start;
+    double trim = nowMs();
+    rc = walTrimFront(wal, offset);
+    snap->metrics.trimMs = nowMs() - trim;
+    snap->metrics.completed++;
+    return rc == 0 ? 0 : -2;
+}
+
+int snapshotPoll(BgSnapshot *snap, Wal *wal, int wait) {
+    (void)snap;
+    (void)wal;
+    (void)wait;
+    return 0;
+}
+
+#endif
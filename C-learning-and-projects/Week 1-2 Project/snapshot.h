@@ -0,0 +1,45 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "item.h"
+#include "fileio.h"
+
+typedef struct { // Figures about background snapshots, the "last" ones describe the most recent finished snapshot
+    long completed; // Snapshots swapped in
+    long failed; // Snapshots whose child failed (the log was left alone)
+    long items; // Items written by the last snapshot
+    double durationMs; // Last snapshot, fork to the new file being in place (measured by the child)
+    double forkMs; // Parent stall inside fork() for the last snapshot (page tables are copied here)
+    double trimMs; // Parent stall trimming the log once the last snapshot was in place
+    long cowFaults; // Page faults taken by the parent while the last child ran: each write to a shared page copies it
+    long pageSize; // Bytes per page, to turn cowFaults into memory
+} SnapshotMetrics;
+
+typedef struct { // A background snapshot, at most one runs at a time
+    int pid; // Child writing the snapshot, 0 when idle
+    int pipeFd; // Read end of the pipe the child reports its result on
+    long logOffset; // Log size when the child was forked: everything before it is in the snapshot
+    long faultsAtFork; // Parent's minor fault count at fork time
+    SnapshotMetrics metrics;
+} BgSnapshot;
+
+/*
+Forks a child that writes the live slots of 'items' (a copy-on-write image
+as of now) to '<snapshot>.tmp' and renames it over the snapshot of 'wal',
+while the caller carries on. Returns 0 if a snapshot was started, 1 if one
+is already running, negative on failure. Without fork() (Windows) the
+snapshot is written in the foreground and finished before returning
+*/
+int snapshotStart(BgSnapshot *snap, Wal *wal, const Item *items, int count);
+
+/*
+Checks on a running snapshot; with 'wait' set it blocks until the child is
+done. When the new file is in place the log is trimmed to the records
+written after the fork. Returns 0 if nothing finished, 1 if a snapshot was
+completed, negative if it failed (the old snapshot and full log still hold everything)
+*/
+int snapshotPoll(BgSnapshot *snap, Wal *wal, int wait);
+
+/* Returns 1 while a child is writing a snapshot */
+static inline int snapshotRunning(const BgSnapshot *snap) { return snap->pid != 0; }
+
+#endif // SNAPSHOT_H
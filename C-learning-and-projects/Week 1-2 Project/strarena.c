@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+#include "strarena.h"
+#include "crc32c.h"
+
+#define ARENA_MIN_CAPACITY 4096 // First allocation for the string bytes
+#define ARENA_MIN_TABLE 64 // Smallest intern table
+
+void strArenaInit(StrArena *a) {
+    memset(a, 0, sizeof *a);
+}
+
+void strArenaFree(StrArena *a) {
+    free(a->data);
+    free(a->table);
+    memset(a, 0, sizeof *a);
+}
+
+int strArenaAdopt(StrArena *a, char *data, uint32_t size) {
+    if (size > 0 && data[size - 1] != '\0') return -1; // A string would run off the end
+    strArenaFree(a);
+    a->data = data;
+    a->size = a->cap = size;
+    return 0;
+}
+
+static uint32_t hashString(const char *s, uint32_t len) { // CRC32C runs on the hardware instruction where there is one
+    return crc32c(0, s, len);
+}
+
+static void tablePlace(uint32_t *table, uint32_t mask, uint32_t hash, uint32_t off) { // Insert without checks
+    uint32_t i = hash & mask;
+    while (table[i] != 0) i = (i + 1) & mask; // Linear probing
+    table[i] = off + 1;
+}
+
+static int growTable(StrArena *a, uint32_t need) { // Rebuilds the table with room for 'need' strings at load <= 1/2
+    uint32_t cap = a->tableCap ? a->tableCap : ARENA_MIN_TABLE;
+    while (cap < need * 2) cap *= 2;
+    if (cap == a->tableCap) return 0;
+    uint32_t *fresh = calloc(cap, sizeof *fresh);
+    if (!fresh) return -1;
+    for (uint32_t i = 0; i < a->tableCap; ++i) {
+        if (a->table[i]) {
+            const char *s = a->data + a->table[i] - 1;
+            tablePlace(fresh, cap - 1, hashString(s, (uint32_t)strlen(s)), a->table[i] - 1);
+        }
+    }
+    free(a->table);
+    a->table = fresh;
+    a->tableCap = cap;
+    return 0;
+}
+
+static long tableFind(const StrArena *a, const char *s, uint32_t len, uint32_t hash) { // Offset of an equal string, or -1
+    uint32_t mask = a->tableCap - 1;
+    for (uint32_t i = hash & mask; a->table[i] != 0; i = (i + 1) & mask) {
+        const char *t = a->data + a->table[i] - 1;
+        if (memcmp(t, s, len) == 0 && t[len] == '\0') return (long)(a->table[i] - 1);
+    }
+    return -1;
+}
+
+static int buildTable(StrArena *a) { // Indexes an adopted block, first copy of a string wins
+    if (growTable(a, strArenaCount(a) + 1) != 0) return -1;
+    for (uint32_t off = 0; off < a->size;) {
+        uint32_t len = (uint32_t)strlen(a->data + off);
+        uint32_t h = hashString(a->data + off, len);
+        if (tableFind(a, a->data + off, len, h) < 0) {
+            tablePlace(a->table, a->tableCap - 1, h, off);
+            a->unique++;
+        }
+        off += len + 1;
+    }
+    return 0;
+}
+
+int strArenaIntern(StrArena *a, const char *s, uint32_t len, uint32_t *offPtr) {
+    if (!a->table && buildTable(a) != 0) return -1;
+    uint32_t h = hashString(s, len);
+    long found = tableFind(a, s, len, h);
+    if (found >= 0) { *offPtr = (uint32_t)found; return 0; } // Already stored once
+    if (len + 1 > UINT32_MAX - a->size) return -1; // Offsets are 32-bit
+    if (a->size + len + 1 > a->cap) {
+        uint64_t cap = a->cap ? a->cap : ARENA_MIN_CAPACITY;
+        while (cap < (uint64_t)a->size + len + 1) cap *= 2; // Geometric growth
+        if (cap > UINT32_MAX) cap = UINT32_MAX;
+        char *tmp = realloc(a->data, (size_t)cap);
+        if (!tmp) return -1;
+        a->data = tmp;
+        a->cap = (uint32_t)cap;
+    }
+    if ((a->unique + 1) * 2 > a->tableCap && growTable(a, a->unique + 1) != 0) return -1;
+    uint32_t off = a->size;
+    memcpy(a->data + off, s, len);
+    a->data[off + len] = '\0';
+    a->size += len + 1;
+    tablePlace(a->table, a->tableCap - 1, h, off);
+    a->unique++;
+    *offPtr = off;
+    return 0;
+}
+
+uint32_t strArenaCount(const StrArena *a) {
+    uint32_t n = 0;
+    for (uint32_t off = 0; off < a->size; ++off) n += a->data[off] == '\0'; // One terminator per string
+    return n;
+}
@@ -0,0 +1,39 @@
+#ifndef STRARENA_H
+#define STRARENA_H
+#include <stdint.h>
+
+typedef struct { // Shared storage for interned strings, each NUL-terminated so it can be printed in place
+    char *data; // Strings back to back
+    uint32_t size; // Bytes used, terminators included
+    uint32_t cap;
+    uint32_t *table; // Open-addressing table of offset + 1 (0 is empty), built on the first intern
+    uint32_t tableCap; // Power of two
+    uint32_t unique; // Strings in the table
+} StrArena;
+
+/* Prepares an empty arena */
+void strArenaInit(StrArena *a);
+
+/* Releases the strings and the table */
+void strArenaFree(StrArena *a);
+
+/*
+Takes over a malloc'd block of 'size' bytes holding NUL-terminated strings
+(e.g. read from a file in one piece). No per-string work is done until the
+first strArenaIntern. Returns 0 on success, -1 if the block does not end in a NUL
+*/
+int strArenaAdopt(StrArena *a, char *data, uint32_t size);
+
+/*
+Stores 's' (length 'len', need not be terminated) unless an equal string is
+already there, and writes its offset to *offPtr. Returns 0 on success, -1 on failure
+*/
+int strArenaIntern(StrArena *a, const char *s, uint32_t len, uint32_t *offPtr);
+
+/* Number of strings stored back to back in the arena (counts duplicates of an adopted block) */
+uint32_t strArenaCount(const StrArena *a);
+
+/* The string at 'off' */
+static inline const char *strArenaGet(const StrArena *a, uint32_t off) { return a->data + off; }
+
+#endif // STRARENA_H
@@ -0,0 +1,303 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "striped.h"
+#include "fileio.h"
+
+/*
+Why reclamation is safe. A scan takes a place in 'scans' holding the epoch
+it saw (a), then moves the epoch on, getting its own epoch S >= a. Writers
+read the epoch under their stripe's lock, and a scan copies a stripe's
+versions under that lock after moving the epoch on, so every write it copied
+is tagged <= S and every write after the copy is tagged > S; walking back to
+the newest version tagged <= S therefore sees each item as of that moment.
+
+A version replaced by a write tagged t is only read by scans with S < t;
+it is freed once every announced epoch is >= t (a <= S). A scan that
+announces after that check moves the epoch on afterwards and so gets S >= t.
+A delete's version is the head of its slot until the slot is emptied, and a
+scan that copied the slot before then may still look at it: it was copied
+before the epoch read just before emptying the slot ('now'), so its a is
+lower, and the version waits until every announced epoch reaches 'now'.
+Epoch loads and stores around the places are sequentially consistent, so
+the scan's announcement and the writer's check cannot both miss each other.
+*/
+
+static Stripe *stripeOf(StripedInventory *si, int id) { // Unrelated to the index's own hash, so a stripe's ids still spread over its buckets
+    uint32_t h = (uint32_t)id;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return &si->stripes[h & (uint32_t)(si->stripeCount - 1)];
+}
+
+static uint64_t currentEpoch(StripedInventory *si) {
+    return __atomic_load_n(&si->epoch, __ATOMIC_SEQ_CST);
+}
+
+static uint64_t oldestScan(StripedInventory *si) { // Lowest epoch an open scan announced, UINT64_MAX if none
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < STRIPED_MAX_SCANS; ++i) {
+        uint64_t e = __atomic_load_n(&si->scans[i], __ATOMIC_SEQ_CST);
+        if (e && e < oldest) oldest = e;
+    }
+    return oldest;
+}
+
+static void setLive(Stripe *st, int live) { // stripedLive reads it without the lock
+    __atomic_store_n(&st->live, live, __ATOMIC_RELAXED);
+}
+
+int stripedInit(StripedInventory *si, int stripes) {
+    memset(si, 0, sizeof *si);
+    int bits = 0;
+    while ((1 << bits) < (stripes > 0 ? stripes : STRIPED_DEFAULT_STRIPES) && bits < 16) bits++;
+    void *mem;
+    if (posix_memalign(&mem, 64, ((size_t)1 << bits) * sizeof(Stripe)) != 0) return -1; // Stripes never share a cache line
+    memset(mem, 0, ((size_t)1 << bits) * sizeof(Stripe));
+    si->stripes = mem;
+    si->stripeBits = bits;
+    for (int s = 0; s < (1 << bits); ++s) {
+        Stripe *st = &si->stripes[s];
+        pthread_mutex_init(&st->lock, NULL);
+        st->reclaimAt = STRIPED_RETIRE_BATCH;
+        si->stripeCount = s + 1; // So stripedFree releases exactly those set up
+        if (hashIndexInit(&st->index, 16) != 0) { stripedFree(si); return -1; }
+    }
+    si->epoch = 1; // 0 marks a free place in 'scans'
+    return 0;
+}
+
+void stripedFree(StripedInventory *si) {
+    for (int s = 0; s < si->stripeCount; ++s) {
+        Stripe *st = &si->stripes[s];
+        for (int i = 0; i < st->count; ++i) {
+            if (st->heads[i] && !st->heads[i]->deleted) free(st->heads[i]); // A delete's version is in 'retired' as well
+        }
+        for (int i = 0; i < st->retiredCount; ++i) free(st->retired[i].v);
+        free(st->heads);
+        free(st->freeSlots);
+        free(st->retired);
+        hashIndexFree(&st->index);
+        pthread_mutex_destroy(&st->lock);
+    }
+    free(si->stripes);
+    memset(si, 0, sizeof *si);
+}
+
+static int takeSlot(Stripe *st) { // An emptied slot, or a new one. -1 if out of memory
+    if (st->freeCount > 0) return st->freeSlots[--st->freeCount];
+    if (st->count == st->capacity) {
+        int cap = st->capacity ? st->capacity * 2 : 16;
+        ItemVersion **heads = realloc(st->heads, (size_t)cap * sizeof *heads);
+        if (!heads) return -1;
+        st->heads = heads;
+        int *freeSlots = realloc(st->freeSlots, (size_t)cap * sizeof *freeSlots); // Room for every slot, so emptying one never allocates
+        if (!freeSlots) return -1;
+        st->freeSlots = freeSlots;
+        st->capacity = cap;
+    }
+    return st->count++;
+}
+
+static int reserveRetired(Stripe *st, int n) { // Room to retire 'n' more versions, so a write cannot fail halfway
+    if (st->retiredCount + n <= st->retiredCap) return 0;
+    int cap = st->retiredCap ? st->retiredCap * 2 : STRIPED_RETIRE_BATCH * 2;
+    while (cap < st->retiredCount + n) cap *= 2;
+    RetiredVersion *tmp = realloc(st->retired, (size_t)cap * sizeof *tmp);
+    if (!tmp) return -1;
+    st->retired = tmp;
+    st->retiredCap = cap;
+    return 0;
+}
+
+static void retire(Stripe *st, ItemVersion *v, uint64_t until, int slot) { // Room was reserved
+    st->retired[st->retiredCount++] = (RetiredVersion){ v, until, slot };
+}
+
+static void reclaim(StripedInventory *si, Stripe *st) { // Frees what no open scan can reach; called with the lock held
+    uint64_t now = currentEpoch(si); // Before the places are read (see the top of the file)
+    uint64_t oldest = oldestScan(si);
+    int w = 0;
+    for (int i = 0; i < st->retiredCount; ++i) {
+        RetiredVersion r = st->retired[i];
+        if (r.until > oldest) { // An open scan may still read it
+            st->retired[w++] = r;
+            continue;
+        }
+        if (r.slot >= 0) { // A delete's version: empty its slot first
+            st->heads[r.slot] = NULL;
+            st->freeSlots[st->freeCount++] = r.slot;
+            if (oldest < now) { // A scan that copied the slot may still look at it
+                st->retired[w++] = (RetiredVersion){ r.v, now, -1 };
+                continue;
+            }
+        }
+        free(r.v);
+    }
+    st->retiredCount = w;
+    st->reclaimAt = w * 2 > STRIPED_RETIRE_BATCH ? w * 2 : STRIPED_RETIRE_BATCH; // A long scan pins versions: do not retry on every write
+}
+
+int stripedGet(StripedInventory *si, int id, Item *out) {
+    if (id <= 0) return 1;
+    Stripe *st = stripeOf(si, id);
+    pthread_mutex_lock(&st->lock);
+    int slot = hashIndexFind(&st->index, id);
+    if (slot >= 0) *out = st->heads[slot]->item;
+    pthread_mutex_unlock(&st->lock);
+    return slot >= 0 ? 0 : 1;
+}
+
+int stripedAdd(StripedInventory *si, const Item *item) {
+    if (item->id <= 0) return 1;
+    ItemVersion *v = malloc(sizeof *v); // Outside the lock
+    if (!v) return -1;
+    v->item = *item;
+    v->deleted = 0;
+    v->prev = NULL;
+    Stripe *st = stripeOf(si, item->id);
+    pthread_mutex_lock(&st->lock);
+    int rc = 0;
+    if (hashIndexFind(&st->index, item->id) >= 0) rc = 1; // Taken
+    else {
+        int slot = takeSlot(st);
+        if (slot < 0 || hashIndexInsert(&st->index, item->id, slot) != 0) {
+            if (slot >= 0) { st->heads[slot] = NULL; st->freeSlots[st->freeCount++] = slot; }
+            rc = -1;
+        } else {
+            v->epoch = currentEpoch(si);
+            st->heads[slot] = v;
+            setLive(st, st->live + 1);
+            v = NULL; // Linked in
+        }
+    }
+    pthread_mutex_unlock(&st->lock);
+    free(v);
+    return rc;
+}
+
+static int replace(StripedInventory *si, int id, int quantity, int deleting) { // Links a new version of 'id' in front of the current one
+    if (id <= 0) return 1;
+    ItemVersion *v = malloc(sizeof *v);
+    if (!v) return -1;
+    Stripe *st = stripeOf(si, id);
+    pthread_mutex_lock(&st->lock);
+    int rc = 1;
+    int slot = hashIndexFind(&st->index, id);
+    if (slot >= 0 && reserveRetired(st, 2) != 0) rc = -1;
+    else if (slot >= 0) {
+        ItemVersion *old = st->heads[slot];
+        v->item = old->item;
+        if (!deleting) v->item.quantity = quantity;
+        v->epoch = currentEpoch(si);
+        v->deleted = deleting;
+        v->prev = old;
+        st->heads[slot] = v;
+        retire(st, old, v->epoch, -1); // Scans from before this write still read 'old'
+        if (deleting) {
+            hashIndexRemove(&st->index, id);
+            retire(st, v, v->epoch, slot); // The slot stays taken while older scans may need what was in it
+            setLive(st, st->live - 1);
+        }
+        if (st->retiredCount >= st->reclaimAt) reclaim(si, st);
+        v = NULL;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&st->lock);
+    free(v);
+    return rc;
+}
+
+int stripedSetQuantity(StripedInventory *si, int id, int quantity) {
+    return replace(si, id, quantity, 0);
+}
+
+int stripedDelete(StripedInventory *si, int id) {
+    return replace(si, id, 0, 1);
+}
+
+static int claimScan(StripedInventory *si) { // Announces a scan in a free place, waiting for one if needed
+    for (;;) {
+        uint64_t e = currentEpoch(si);
+        for (int i = 0; i < STRIPED_MAX_SCANS; ++i) {
+            uint64_t expected = 0;
+            if (__atomic_compare_exchange_n(&si->scans[i], &expected, e, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return i;
+        }
+        sched_yield();
+    }
+}
+
+int stripedScan(StripedInventory *si, StripedScanFn fn, void *ctx) {
+    int place = claimScan(si);
+    uint64_t at = __atomic_fetch_add(&si->epoch, 1, __ATOMIC_SEQ_CST); // Writes from here on carry a later epoch
+    ItemVersion **copy = NULL;
+    int copyCap = 0, rc = 0;
+    for (int s = 0; s < si->stripeCount && rc == 0; ++s) {
+        Stripe *st = &si->stripes[s];
+        pthread_mutex_lock(&st->lock); // Held only to copy the pointers
+        int n = st->count;
+        if (n > copyCap) {
+            ItemVersion **tmp = realloc(copy, (size_t)n * sizeof *tmp);
+            if (!tmp) { pthread_mutex_unlock(&st->lock); rc = -1; break; }
+            copy = tmp;
+            copyCap = n;
+        }
+        if (n > 0) memcpy(copy, st->heads, (size_t)n * sizeof *copy);
+        pthread_mutex_unlock(&st->lock);
+        for (int i = 0; i < n && rc == 0; ++i) {
+            const ItemVersion *v = copy[i];
+            while (v && v->epoch > at) v = v->prev; // Written since the scan started: the value before
+            if (v && !v->deleted) rc = fn(&v->item, ctx);
+        }
+    }
+    __atomic_store_n(&si->scans[place], 0, __ATOMIC_SEQ_CST); // Versions it pinned can go
+    free(copy);
+    return rc;
+}
+
+long stripedLive(const StripedInventory *si) {
+    long live = 0;
+    for (int s = 0; s < si->stripeCount; ++s) live += __atomic_load_n(&si->stripes[s].live, __ATOMIC_RELAXED);
+    return live;
+}
+
+int stripedLoad(StripedInventory *si, const char *filename) {
+    Item *items;
+    int count;
+    int rc = loadItems(filename, &items, &count);
+    if (rc != 0) return rc;
+    for (int i = 0; i < count && rc == 0; ++i) {
+        if (stripedAdd(si, &items[i]) < 0) rc = -1; // Repeated ids: the first stays, as everywhere else
+    }
+    free(items);
+    return rc;
+}
+
+typedef struct { // stripedSave's copy of a scan
+    Item *items;
+    int count, capacity;
+} ItemList;
+
+static int collectItem(const Item *item, void *ctx) {
+    ItemList *list = ctx;
+    if (list->count == list->capacity) {
+        int cap = list->capacity ? list->capacity * 2 : 1024;
+        Item *tmp = realloc(list->items, (size_t)cap * sizeof *tmp);
+        if (!tmp) return -1;
+        list->items = tmp;
+        list->capacity = cap;
+    }
+    list->items[list->count++] = *item;
+    return 0;
+}
+
+int stripedSave(StripedInventory *si, const char *filename) {
+    ItemList list = { NULL, 0, 0 };
+    int rc = stripedScan(si, collectItem, &list);
+    if (rc == 0) rc = saveItems(filename, list.items, list.count);
+    free(list.items);
+    return rc;
+}
@@ -0,0 +1,108 @@
+#ifndef STRIPED_H
+#define STRIPED_H
+#include <stdint.h>
+#include <pthread.h>
+#include "item.h"
+#include "hashindex.h"
+
+/*
+Thread-safe inventory for programs that embed it and call it from many
+threads. Items are spread over stripes by a hash of their id; each stripe
+has its own lock, id index and slots, so calls on items in different
+stripes never wait for each other.
+
+Writes never change an item in place: they link a new version in front of
+the old one, tagged with the global epoch. A scan moves the epoch on and
+then sees, for every item, the newest version from before that moment, so
+it lists one consistent state of the whole inventory while writers carry
+on. It only holds a stripe's lock for as long as it takes to copy that
+stripe's version pointers. Versions that were replaced are freed once no
+open scan can still reach them (epoch-based reclamation, see striped.c).
+
+Held in memory only: stripedLoad and stripedSave read and write an items
+file, but changes are not logged.
+*/
+#define STRIPED_DEFAULT_STRIPES 256 // A few times the threads expected, so two threads rarely want the same lock
+#define STRIPED_MAX_SCANS 64 // Scans open at once (more wait for one to finish)
+#define STRIPED_RETIRE_BATCH 64 // Replaced versions a stripe collects before it tries to free them
+
+typedef struct ItemVersion { // One value of an item, never changed once linked in
+    Item item;
+    uint64_t epoch; // Global epoch when it was written
+    int deleted; // 1 for the version a delete leaves behind
+    struct ItemVersion *prev; // The value before it, NULL for an add (may be freed once no scan needs it)
+} ItemVersion;
+
+typedef struct { // A version waiting for the scans that can still reach it
+    ItemVersion *v;
+    uint64_t until; // Freed once every open scan started at this epoch or later
+    int slot; // For a delete's version: the slot to empty first, -1 otherwise
+} RetiredVersion;
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock; // Guards everything below; each stripe on its own cache lines
+    HashIndex index; // id -> slot, live items only
+    ItemVersion **heads; // Newest version per slot, NULL for an empty slot
+    int count, capacity; // Slots in use / allocated
+    int *freeSlots; // Slots emptied by reclamation, used again before new ones (room for every slot)
+    int freeCount;
+    RetiredVersion *retired;
+    int retiredCount, retiredCap;
+    int reclaimAt; // Retired versions that trigger the next attempt to free them
+    int live; // Items not deleted
+} Stripe;
+
+typedef struct {
+    Stripe *stripes;
+    int stripeCount; // A power of two
+    int stripeBits;
+    uint64_t epoch; // Moved on by every scan
+    uint64_t scans[STRIPED_MAX_SCANS]; // Epoch each open scan announced, 0 for a free place
+} StripedInventory;
+
+/*
+Prepares an empty inventory with 'stripes' stripes (rounded up to a power
+of two; <= 0 for STRIPED_DEFAULT_STRIPES). Returns 0 on success, -1 if out
+of memory
+*/
+int stripedInit(StripedInventory *si, int stripes);
+
+/* Frees everything. No other thread may be using it */
+void stripedFree(StripedInventory *si);
+
+/*
+Adds every item of the items file 'filename' (ids already present are
+skipped). Returns loadItems' code: 0 on success, 1 if there is no such file, negative on failure
+*/
+int stripedLoad(StripedInventory *si, const char *filename);
+
+/* Writes a consistent snapshot (see stripedScan) to 'filename'. Returns saveItems' code, -1 if out of memory */
+int stripedSave(StripedInventory *si, const char *filename);
+
+/* Copies the item with 'id' into 'out'. Returns 0 if found, 1 if not */
+int stripedGet(StripedInventory *si, int id, Item *out);
+
+/* Adds a copy of 'item'. Returns 0 on success, 1 if the id is invalid or taken, -1 if out of memory */
+int stripedAdd(StripedInventory *si, const Item *item);
+
+/* Returns 0 on success, 1 if there is no such item, -1 if out of memory */
+int stripedSetQuantity(StripedInventory *si, int id, int quantity);
+
+/* Returns 0 on success, 1 if there is no such item, -1 if out of memory */
+int stripedDelete(StripedInventory *si, int id);
+
+/* Called by stripedScan for every item; non-zero stops the scan */
+typedef int (*StripedScanFn)(const Item *item, void *ctx);
+
+/*
+Calls 'fn' for every item as of one moment during the call, in no
+particular order, while other threads keep changing the inventory. 'fn'
+runs without any lock held. Returns 0, fn's value if it stopped the scan,
+-1 if out of memory
+*/
+int stripedScan(StripedInventory *si, StripedScanFn fn, void *ctx);
+
+/* Live items, summed over the stripes without locking (only exact while nothing is changing) */
+long stripedLive(const StripedInventory *si);
+
+#endif // STRIPED_H
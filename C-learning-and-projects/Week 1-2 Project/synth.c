@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <string.h>
+#include "synth.h"
+
+static const char *const BRANDS[] = {"Acme", "Nova", "Zenith", "Orion", "Peak", "Summit", "Vertex", "Kiwi"};
+static const char *const COLOURS[] = {"Red", "Blue", "Black", "White", "Green", "Grey", "Navy", "Beige"};
+static const char *const SIZES[] = {"XS", "S", "M", "L", "XL", "XXL"};
+static const char *const ELECTRONICS_KINDS[] = {"USB-C Cable", "Wireless Mouse", "Keyboard", "HDMI Adapter", "Power Bank",
+                                                "Bluetooth Speaker", "Webcam", "Noise Cancelling Headphones", "Phone Charger"};
+static const char *const CLOTHING_KINDS[] = {"T-Shirt", "Hoodie", "Jeans", "Socks", "Cap", "Rain Jacket", "Wool Scarf", "Polo Shirt"};
+static const char *const FOOD_KINDS[] = {"Apples", "Rice", "Pasta", "Olive Oil", "Green Tea", "Dark Chocolate", "Oat Milk",
+                                         "Coffee Beans", "Peanut Butter", "Honey"};
+static const char *const FOOD_PACKS[] = {"250g", "500g", "1kg", "2kg", "6 pack", "12 pack"};
+static const char *const OTHER_KINDS[] = {"Notebook", "Desk Lamp", "Water Bottle", "Umbrella", "Backpack", "Plant Pot", "Candle"};
+
+#define PICK(list, r) list[(r) % (sizeof list / sizeof list[0])]
+
+void synthItems(Item *items, int n, int firstId, uint64_t seed) {
+    for (int i = 0; i < n; ++i) {
+        Item *it = &items[i];
+        int id = firstId + i;
+        uint64_t state = seed ^ ((uint64_t)(uint32_t)id * 0xD1B54A32D192ED03ull); // Independent of the other items
+        uint64_t r1 = synthNext(&state), r2 = synthNext(&state), r3 = synthNext(&state);
+        memset(it, 0, sizeof *it);
+        it->id = id;
+        unsigned mix = (unsigned)(r1 % 100);
+        it->category = mix < 20 ? ELECTRONICS : mix < 55 ? CLOTHING : mix < 85 ? FOOD : OTHER;
+        unsigned a = (unsigned)(r1 >> 8), b = (unsigned)(r1 >> 24), c = (unsigned)(r1 >> 40);
+        switch (it->category) { // Name shapes that repeat across variants
+            case ELECTRONICS:
+                snprintf(it->name, sizeof it->name, "%s %s", PICK(BRANDS, a), PICK(ELECTRONICS_KINDS, b));
+                if (c % 3 == 0) snprintf(it->name + strlen(it->name), sizeof it->name - strlen(it->name), " %s", PICK(COLOURS, c >> 2));
+                break;
+            case CLOTHING:
+                snprintf(it->name, sizeof it->name, "%s %s %s", PICK(CLOTHING_KINDS, a), PICK(COLOURS, b), PICK(SIZES, c));
+                break;
+            case FOOD:
+                snprintf(it->name, sizeof it->name, "%s %s", PICK(FOOD_KINDS, a), PICK(FOOD_PACKS, b));
+                break;
+            default:
+                snprintf(it->name, sizeof it->name, "%s", PICK(OTHER_KINDS, a));
+                if (c % 2 == 0) snprintf(it->name + strlen(it->name), sizeof it->name - strlen(it->name), " %s", PICK(COLOURS, b));
+                break;
+        }
+        if (r3 % 20 == 0) { // A few long descriptive names, cut at the field size
+            snprintf(it->name + strlen(it->name), sizeof it->name - strlen(it->name), " - limited edition model %u", (unsigned)(r3 >> 40) % 10000);
+        }
+        double u = (double)(r2 >> 11) / 9007199254740992.0; // Uniform [0, 1)
+        double base = it->category == ELECTRONICS ? 15.0 : it->category == CLOTHING ? 12.0 : it->category == FOOD ? 2.0 : 5.0;
+        it->price = (float)((int)(base * (1.0 + 30.0 * u * u * u) * 100.0) / 100.0); // Most items cheap, a long tail of expensive ones
+        unsigned q = (unsigned)(r3 >> 8) % 1000;
+        it->quantity = (int)(q * q / 1000); // Skewed towards low stock
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+#include <stdint.h>
+#include "item.h"
+
+/*
+Reproducible synthetic items for benchmarks. Item i depends only on 'seed'
+and its id, so any range can be generated on its own (in chunks, in
+parallel) and always comes out the same. Categories follow a fixed mix
+(Electronics 20%, Clothing 35%, Food 30%, Other 15%), names are built from
+per-category word lists (mostly 10-30 characters, repeating across
+colours and sizes, as real catalogues do), prices are skewed towards cheap
+items and quantities towards small stock levels
+*/
+#define SYNTH_DEFAULT_SEED 20250601u
+
+/* Fills items[0..n) with ids firstId, firstId + 1, ... */
+void synthItems(Item *items, int n, int firstId, uint64_t seed);
+
+/* Small, fast random generator for benchmark workloads (splitmix64) */
+static inline uint64_t synthNext(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+#endif // SYNTH_H
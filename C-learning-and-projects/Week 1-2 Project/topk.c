@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "topk.h"
+
+typedef struct { // Bounded heap of the best entries so far, the worst of them at the root
+    TopKEntry *e;
+    int n, k;
+    int largest; // Larger keys are better
+} Heap;
+
+static inline int better(const Heap *h, TopKEntry a, TopKEntry b) { // Strict order: key, then lower slot
+    if (a.key != b.key) return h->largest ? a.key > b.key : a.key < b.key;
+    return a.slot < b.slot;
+}
+
+static void siftDown(Heap *h, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, w = i;
+        if (l < h->n && better(h, h->e[w], h->e[l])) w = l; // The child is worse
+        if (r < h->n && better(h, h->e[w], h->e[r])) w = r;
+        if (w == i) return;
+        TopKEntry tmp = h->e[i]; h->e[i] = h->e[w]; h->e[w] = tmp;
+        i = w;
+    }
+}
+
+static void siftUp(Heap *h, int i) {
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (!better(h, h->e[p], h->e[i])) return;
+        TopKEntry tmp = h->e[i]; h->e[i] = h->e[p]; h->e[p] = tmp;
+        i = p;
+    }
+}
+
+static inline void offer(Heap *h, double key, int slot) { // Keeps the entry if it beats the current worst
+    TopKEntry e = { key, slot };
+    if (h->n < h->k) { h->e[h->n] = e; siftUp(h, h->n++); return; }
+    if (!better(h, e, h->e[0])) return; // The common case once the heap is warm
+    h->e[0] = e;
+    siftDown(h, 0);
+}
+
+typedef struct { // Work for one scan thread
+    const Item *items;
+    const ItemColumns *cols;
+    TopKField field;
+    int category;
+    int from, to; // Slot range [from, to)
+    Heap heap;
+} ScanTask;
+
+#define SCAN(LIVE, KEY) \
+    for (int i = t->from; i < t->to; ++i) { \
+        if (!(LIVE)) continue; \
+        double key = (KEY); \
+        if (key != key) continue; /* NaN has no place in the order */ \
+        offer(&t->heap, key, i); \
+    }
+
+static void *scanRange(void *arg) { // Fills the task's heap from its slots
+    ScanTask *t = arg;
+    const ItemColumns *c = t->cols;
+    const Item *it = t->items;
+    int cat = t->category;
+    if (c) { // Only the columns the field needs are read
+        switch (t->field) {
+            case TOPK_QUANTITY: SCAN(c->category[i] != COL_DEAD && (cat < 0 || c->category[i] == cat), c->quantity[i]) break;
+            case TOPK_PRICE: SCAN(c->category[i] != COL_DEAD && (cat < 0 || c->category[i] == cat), c->price[i]) break;
+            case TOPK_VALUE: SCAN(c->category[i] != COL_DEAD && (cat < 0 || c->category[i] == cat), (double)c->quantity[i] * c->price[i]) break;
+        }
+    } else {
+        switch (t->field) {
+            case TOPK_QUANTITY: SCAN(it[i].id != 0 && (cat < 0 || (int)it[i].category == cat), it[i].quantity) break;
+            case TOPK_PRICE: SCAN(it[i].id != 0 && (cat < 0 || (int)it[i].category == cat), it[i].price) break;
+            case TOPK_VALUE: SCAN(it[i].id != 0 && (cat < 0 || (int)it[i].category == cat), (double)it[i].quantity * it[i].price) break;
+        }
+    }
+    return NULL;
+}
+
+int topK(const Item *items, int count, const ItemColumns *cols, TopKField field, int category, int largest, int k, int threads, TopKEntry *out) {
+    if (k <= 0 || count <= 0) return 0;
+    if (k > count) k = count; // The heaps never need more room
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > TOPK_MAX_THREADS) threads = TOPK_MAX_THREADS;
+    if (threads > count / TOPK_MIN_PER_THREAD) threads = count / TOPK_MIN_PER_THREAD; // Small inventories scan on one thread
+    if (threads < 1) threads = 1;
+    TopKEntry *pool = malloc((size_t)threads * (size_t)k * sizeof *pool); // One heap per thread
+    if (!pool) return -1;
+    ScanTask tasks[TOPK_MAX_THREADS];
+    pthread_t tids[TOPK_MAX_THREADS];
+    int started[TOPK_MAX_THREADS] = {0};
+    for (int t = 0; t < threads; ++t) { // Equal slot ranges; this thread takes the first one
+        int from = (int)((long long)count * t / threads), to = (int)((long long)count * (t + 1) / threads);
+        tasks[t] = (ScanTask){ items, cols, field, category, from, to, { pool + (size_t)t * k, 0, k, largest } };
+        if (t > 0) started[t] = pthread_create(&tids[t], NULL, scanRange, &tasks[t]) == 0;
+    }
+    scanRange(&tasks[0]);
+    for (int t = 1; t < threads; ++t) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else scanRange(&tasks[t]); // No thread available, do it here
+    }
+
+    Heap *best = &tasks[0].heap; // Merge: the other heaps' entries compete for the first one
+    for (int t = 1; t < threads; ++t) {
+        for (int i = 0; i < tasks[t].heap.n; ++i) offer(best, tasks[t].heap.e[i].key, tasks[t].heap.e[i].slot);
+    }
+    int n = best->n;
+    for (int j = n - 1; j >= 0; --j) { // Pop the worst into the back: out ends up best first
+        out[j] = best->e[0];
+        best->e[0] = best->e[--best->n];
+        siftDown(best, 0);
+    }
+    free(pool);
+    return n;
+}
+
+const char *topKFieldName(TopKField field) {
+    switch (field) {
+        case TOPK_QUANTITY: return "quantity";
+        case TOPK_PRICE: return "price";
+        default: return "value";
+    }
+}
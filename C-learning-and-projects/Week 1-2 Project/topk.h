@@ -0,0 +1,36 @@
+#ifndef TOPK_H
+#define TOPK_H
+#include "item.h"
+#include "columns.h"
+
+/*
+Top-K / bottom-K selection without sorting everything: each scan keeps a
+bounded heap of the K best entries seen so far, whose root is the worst of
+them, so most slots cost one comparison against the root and the whole
+pass is O(n log K). With several threads every thread scans its own range
+of slots into its own heap and the heaps are merged at the end
+*/
+#define TOPK_MAX_THREADS 64
+#define TOPK_MIN_PER_THREAD 65536 // Slots a thread must have to be worth starting
+
+typedef enum { TOPK_QUANTITY, TOPK_PRICE, TOPK_VALUE } TopKField; // value = quantity * price
+
+typedef struct { // One selected item
+    double key; // Its quantity, price or value
+    int slot; // Slot in the items array
+} TopKEntry;
+
+/*
+Finds the 'k' live items of 'category' (-1 for any) with the largest
+('largest' set) or smallest 'field' among 'count' slots of 'items' (id 0
+marks a deleted slot), reading the columns instead where 'cols' is not
+NULL. Ties go to the lower slot; NaN prices are skipped. Uses up to
+'threads' threads (<= 0: one per CPU). Writes the entries best first to
+'out' (room for k) and returns how many there are, or -1 if out of memory
+*/
+int topK(const Item *items, int count, const ItemColumns *cols, TopKField field, int category, int largest, int k, int threads, TopKEntry *out);
+
+/* Name of a field, for reports */
+const char *topKFieldName(TopKField field);
+
+#endif // TOPK_H
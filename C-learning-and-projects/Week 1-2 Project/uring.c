@@ -0,0 +1,219 @@
+#include <string.h>
+#include "uring.h"
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+static int uringSetup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+static int opsSupported(int fd) { // READ and WRITE came in 5.6, two releases after io_uring itself
+#ifdef IO_URING_OP_SUPPORTED
+    enum { PROBE_OPS = 64 };
+    union { struct io_uring_probe probe; unsigned char bytes[sizeof(struct io_uring_probe) + PROBE_OPS * sizeof(struct io_uring_probe_op)]; } u;
+    memset(&u, 0, sizeof u);
+    if (uringRegister(fd, IORING_REGISTER_PROBE, &u.probe, PROBE_OPS) < 0) return 0; // Before 5.6 there is no probe either
+    static const unsigned char needed[] = {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC};
+    for (size_t i = 0; i < sizeof needed; ++i) {
+        unsigned op = needed[i];
+        if (op > u.probe.last_op || op >= u.probe.ops_len || !(u.probe.ops[op].flags & IO_URING_OP_SUPPORTED)) return 0;
+    }
+    return 1;
+#else
+    (void)fd;
+    return 0; // Headers older than the probe: cannot tell, stay on stdio
+#endif
+}
+
+int ioRingAvailable(void) {
+    static int state = 0; // 0 not probed, 1 available, -1 not (racing threads may both probe, they agree)
+    int s = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+    if (s == 0) {
+        IoRing r;
+        s = ioRingInit(&r, 2) == 0 && opsSupported(r.fd) ? 1 : -1;
+        if (r.fd >= 0) ioRingFree(&r);
+        __atomic_store_n(&state, s, __ATOMIC_RELEASE);
+    }
+    return s == 1;
+}
+
+int ioRingInit(IoRing *r, unsigned entries) {
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    int fd = uringSetup(entries, &p);
+    if (fd < 0) return -1;
+    r->fd = fd;
+    r->entries = p.sq_entries;
+    r->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) { // One mapping holds both rings
+        if (r->cqRingSize > r->sqRingSize) r->sqRingSize = r->cqRingSize;
+        r->cqRingSize = r->sqRingSize;
+    }
+    r->sqRing = mmap(NULL, r->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (r->sqRing == MAP_FAILED) { r->sqRing = NULL; ioRingFree(r); return -1; }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cqRing = r->sqRing;
+    } else {
+        r->cqRing = mmap(NULL, r->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (r->cqRing == MAP_FAILED) { r->cqRing = NULL; ioRingFree(r); return -1; }
+    }
+    r->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) { r->sqes = NULL; ioRingFree(r); return -1; }
+    unsigned char *sq = r->sqRing, *cq = r->cqRing;
+    r->sqHead = (unsigned *)(sq + p.sq_off.head);
+    r->sqTail = (unsigned *)(sq + p.sq_off.tail);
+    r->sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sqArray = (unsigned *)(sq + p.sq_off.array);
+    r->cqHead = (unsigned *)(cq + p.cq_off.head);
+    r->cqTail = (unsigned *)(cq + p.cq_off.tail);
+    r->cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = cq + p.cq_off.cqes;
+    return 0;
+}
+
+void ioRingFree(IoRing *r) {
+    if (r->fd >= 0) {
+        while (r->inFlight > 0 && ioRingSubmit(r, 1) >= 0) {} // The kernel may still write into the callers' buffers
+        if (r->sqes) munmap(r->sqes, r->sqesSize);
+        if (r->cqRing && r->cqRing != r->sqRing) munmap(r->cqRing, r->cqRingSize);
+        if (r->sqRing) munmap(r->sqRing, r->sqRingSize);
+        close(r->fd);
+    }
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+}
+
+static struct io_uring_sqe *nextSqe(IoRing *r, IoRequest *req, int flags) { // Claims the next free entry, NULL if full
+    unsigned head = __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE); // The kernel consumes entries
+    unsigned tail = *r->sqTail + r->queued;
+    if (tail - head >= r->entries) return NULL;
+    unsigned index = tail & *r->sqMask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)r->sqes + index;
+    memset(sqe, 0, sizeof *sqe);
+    sqe->flags = (flags & IO_LINK ? IOSQE_IO_LINK : 0) | (flags & IO_DRAIN ? IOSQE_IO_DRAIN : 0);
+    sqe->user_data = (uint64_t)(uintptr_t)req;
+    r->sqArray[index] = index;
+    r->queued++;
+    r->inFlight++;
+    return sqe;
+}
+
+int ioRingRead(IoRing *r, IoRequest *req, int fd, void *buf, uint32_t len, uint64_t offset, int flags) {
+    struct io_uring_sqe *sqe = nextSqe(r, req, flags);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+    return 0;
+}
+
+int ioRingWrite(IoRing *r, IoRequest *req, int fd, const void *buf, uint32_t len, uint64_t offset, int flags) {
+    struct io_uring_sqe *sqe = nextSqe(r, req, flags);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+    return 0;
+}
+
+int ioRingFsync(IoRing *r, IoRequest *req, int fd, int flags) {
+    struct io_uring_sqe *sqe = nextSqe(r, req, flags);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC; // Data and the size, like syncFileData
+    return 0;
+}
+
+static int reap(IoRing *r) { // Runs the callbacks of the completions already posted
+    int ran = 0;
+    unsigned head = *r->cqHead;
+    for (;;) {
+        unsigned tail = __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail) break;
+        struct io_uring_cqe *cqe = (struct io_uring_cqe *)r->cqes + (head & *r->cqMask);
+        IoRequest *req = (IoRequest *)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+        __atomic_store_n(r->cqHead, ++head, __ATOMIC_RELEASE); // Free the slot before the callback queues more
+        r->inFlight--;
+        if (req && req->done) req->done(req, res);
+        ran++;
+    }
+    return ran;
+}
+
+int ioRingSubmit(IoRing *r, unsigned waitFor) {
+    if (r->fd < 0) return -1;
+    unsigned toSubmit = r->queued;
+    if (toSubmit) __atomic_store_n(r->sqTail, *r->sqTail + toSubmit, __ATOMIC_RELEASE); // Publish the new entries
+    r->queued = 0;
+    if (waitFor > r->inFlight) waitFor = r->inFlight;
+    int ran = reap(r); // Completions already there need no system call
+    if (toSubmit > 0 || (unsigned)ran < waitFor) {
+        unsigned need = (unsigned)ran < waitFor ? waitFor - (unsigned)ran : 0;
+        int rc;
+        do rc = uringEnter(r->fd, toSubmit, need, need ? IORING_ENTER_GETEVENTS : 0);
+        while (rc < 0 && errno == EINTR);
+        if (rc < 0) return -1;
+        ran += reap(r);
+    }
+    return ran;
+}
+#else
+int ioRingAvailable(void) { return 0; }
+
+int ioRingInit(IoRing *r, unsigned entries) {
+    (void)entries;
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+    return -1; // No io_uring on this platform
+}
+
+void ioRingFree(IoRing *r) { (void)r; }
+
+int ioRingRead(IoRing *r, IoRequest *req, int fd, void *buf, uint32_t len, uint64_t offset, int flags) {
+    (void)r; (void)req; (void)fd; (void)buf; (void)len; (void)offset; (void)flags;
+    return -1;
+}
+
+int ioRingWrite(IoRing *r, IoRequest *req, int fd, const void *buf, uint32_t len, uint64_t offset, int flags) {
+    (void)r; (void)req; (void)fd; (void)buf; (void)len; (void)offset; (void)flags;
+    return -1;
+}
+
+int ioRingFsync(IoRing *r, IoRequest *req, int fd, int flags) {
+    (void)r; (void)req; (void)fd; (void)flags;
+    return -1;
+}
+
+int ioRingSubmit(IoRing *r, unsigned waitFor) {
+    (void)r; (void)waitFor;
+    return -1;
+}
+#endif
@@ -0,0 +1,66 @@
+#ifndef URING_H
+#define URING_H
+#include <stdint.h>
+
+/*
+Minimal io_uring driver on the raw system calls (no liburing): one
+submission and one completion ring per IoRing, used by one thread at a
+time. Requests are queued with ioRingRead/Write/Fsync and go to the kernel
+together on the next ioRingSubmit, which also runs the callback of every
+completed request. Linking a request (IO_LINK) makes the next one start
+only after it succeeded, e.g. a write followed by its fdatasync; IO_DRAIN
+holds a request until everything queued before it has completed.
+On kernels without io_uring (or where it is blocked, e.g. by seccomp) and
+on other platforms ioRingInit fails and callers fall back to stdio.
+Kernels 5.1 to 5.5 have io_uring but not its READ and WRITE requests:
+ioRingAvailable reports those as unavailable too.
+*/
+#define IO_RING_DEPTH 16 // Default submission queue entries
+#define IO_LINK 1 // The next request waits for this one (and is cancelled if it fails)
+#define IO_DRAIN 2 // This request waits for every earlier one
+
+typedef struct IoRequest IoRequest;
+typedef void (*IoDoneFn)(IoRequest *req, int res); // 'res': bytes transferred, 0 for fsync, or -errno
+
+struct IoRequest { // Embedded by the caller (usually first) in whatever it tracks per request
+    IoDoneFn done;
+};
+
+typedef struct {
+    int fd; // The ring itself, -1 when not set up
+    unsigned entries;
+    unsigned inFlight; // Submitted or queued, not yet completed
+    void *sqRing, *cqRing, *sqes; // The three mappings (sqRing == cqRing with a single mmap)
+    size_t sqRingSize, cqRingSize, sqesSize;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    void *cqes;
+    unsigned queued; // Entries added since the last submit
+} IoRing;
+
+/* Returns 1 if io_uring, with every request type used here, can be used in this process (probed once, thread-safe) */
+int ioRingAvailable(void);
+
+/* Sets up a ring with at least 'entries' submission entries. Returns 0, -1 if io_uring is unavailable */
+int ioRingInit(IoRing *r, unsigned entries);
+
+/* Tears the ring down; requests still in flight are waited for first */
+void ioRingFree(IoRing *r);
+
+/*
+Queue one request (nothing is sent until ioRingSubmit). 'flags' is a mix of
+IO_LINK and IO_DRAIN; 'buf' must stay valid until the callback ran.
+Return 0, -1 if the submission queue is full (submit first)
+*/
+int ioRingRead(IoRing *r, IoRequest *req, int fd, void *buf, uint32_t len, uint64_t offset, int flags);
+int ioRingWrite(IoRing *r, IoRequest *req, int fd, const void *buf, uint32_t len, uint64_t offset, int flags);
+int ioRingFsync(IoRing *r, IoRequest *req, int fd, int flags); // fdatasync
+
+/*
+Sends the queued requests and waits until at least 'waitFor' have
+completed (0: do not block), then runs the callbacks of everything that
+has completed. Returns the number of callbacks run, -1 on a ring error
+*/
+int ioRingSubmit(IoRing *r, unsigned waitFor);
+
+#endif // URING_H
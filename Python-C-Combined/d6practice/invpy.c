@@ -0,0 +1,364 @@
+// Zero-copy Python view of an inventory items file (the C project in C-learning-and-projects/Week 1-2 Project)
+// The file is loaded with loadItemsMapped, so the Item array points straight into the page cache, and handed to
+// Python through the buffer protocol with a structured format string: numpy.asarray(inv) is a record array over
+// the same memory, no struct.unpack per record. Lookups by id and query filters run in C without the GIL.
+#define PY_SSIZE_T_CLEAN // Sizes passed as Py_ssize_t ("y#" below)
+#include <Python.h>
+#include "structmember.h" // T_OBJECT, READONLY
+#include <string.h>
+#include <limits.h>
+#include "item.h"
+#include "fileio.h"
+#include "hashindex.h"
+#include "query.h"
+
+// One record as PEP 3118 sees it: 68 bytes, '=' native byte order with no implicit alignment, so the pad byte
+// after the name is spelled out (x) and NumPy gets exactly the C layout: id, name, quantity, price, category
+#define INVPY_ITEM_FORMAT "T{=i:id:51s:name:xi:quantity:f:price:I:category:}"
+
+static PyObject *arrayType; // array.array, used for the slot lists the functions return
+
+typedef struct {
+    PyObject_HEAD
+    Item *items; // The array from loadItemsMapped (NULL for an empty file)
+    int count; // Slots in the array (id 0 marks a deleted slot)
+    ItemMapping map; // Where the array lives (mapping or heap), for releaseItems
+    HashIndex index; // id -> slot
+    PyObject *path; // File it was loaded from
+    Py_ssize_t exports; // Buffers handed out and not released yet
+    int busy; // Calls running without the GIL
+    int open; // Loaded and not closed yet
+    Py_ssize_t shape[1], strides[1]; // Per object, the views point at them
+} InventoryObject;
+
+static PyObject *raiseItemsError(int rc, const char *filename) { // loadItems code -> Python exception
+    PyObject *type = rc == 1 ? PyExc_FileNotFoundError : rc == -1 || rc == -3 ? PyExc_MemoryError : rc == -2 ? PyExc_OSError : PyExc_ValueError;
+    PyErr_Format(type, "%s: %s", filename, itemsErrorString(rc)); // Same wording as the C menu
+    return NULL;
+}
+
+static int checkOpen(InventoryObject *self) {
+    if (self->open) return 0;
+    PyErr_SetString(PyExc_ValueError, "inventory is closed");
+    return -1;
+}
+
+static int Inventory_init(PyObject *self_, PyObject *args, PyObject *kwds) {
+    InventoryObject *self = (InventoryObject *)self_;
+    static char *kwlist[] = {"path", "verify", NULL};
+    PyObject *path; // str or os.PathLike
+    int verify = 1; // Check every block checksum of a mapped file (a heap load always does)
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|p", kwlist, PyUnicode_FSConverter, &path, &verify)) return -1;
+    if (self->open || self->path) {
+        Py_DECREF(path);
+        PyErr_SetString(PyExc_RuntimeError, "inventory is already open"); // __init__ called twice would leak the array
+        return -1;
+    }
+    const char *filename = PyBytes_AS_STRING(path);
+    Item *items = NULL;
+    int count = 0, rc;
+    ItemMapping map;
+    HashIndex index = {0};
+    Py_BEGIN_ALLOW_THREADS // Reading, checksumming and indexing a large file needs no Python objects
+    rc = loadItemsMapped(filename, &items, &count, &map);
+    if (rc == 0 && verify && verifyMappedItems(&map) != 0) { releaseItems(items, &map); rc = -7; }
+    if (rc == 0 && hashIndexBuild(&index, items, count, NULL) != 0) { releaseItems(items, &map); rc = -1; }
+    Py_END_ALLOW_THREADS
+    if (rc != 0) {
+        raiseItemsError(rc, filename);
+        Py_DECREF(path);
+        return -1;
+    }
+    self->items = items;
+    self->count = count;
+    self->map = map;
+    self->index = index;
+    self->open = 1;
+    self->path = PyUnicode_DecodeFSDefault(filename); // Shown back as str
+    Py_DECREF(path);
+    return self->path ? 0 : -1;
+}
+
+static void release(InventoryObject *self) { // Frees the array and the index; the object stays usable as "closed"
+    if (self->items) releaseItems(self->items, &self->map);
+    hashIndexFree(&self->index);
+    self->items = NULL;
+    self->count = 0;
+    self->open = 0;
+}
+
+static void Inventory_dealloc(PyObject *self_) {
+    InventoryObject *self = (InventoryObject *)self_;
+    release(self); // No view can be alive here: every view holds a reference
+    Py_XDECREF(self->path);
+    Py_TYPE(self_)->tp_free(self_);
+}
+
+static PyObject *Inventory_close(PyObject *self_, PyObject *unused) {
+    InventoryObject *self = (InventoryObject *)self_;
+    if (self->exports > 0) { // A memoryview or NumPy array still points into the mapping
+        PyErr_SetString(PyExc_BufferError, "cannot close: views of the items are still alive");
+        return NULL;
+    }
+    if (self->busy > 0) { // Another thread is scanning the array with the GIL released
+        PyErr_SetString(PyExc_RuntimeError, "cannot close: the inventory is in use by another thread");
+        return NULL;
+    }
+    release(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Inventory_enter(PyObject *self, PyObject *unused) {
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject *Inventory_exit(PyObject *self, PyObject *args) {
+    return Inventory_close(self, NULL); // Exceptions inside the with block propagate as usual
+}
+
+// Buffer protocol: one dimension of count records, itemsize 68, read-only. Writes would go around the id index
+// (and a mapped array is a private copy-on-write mapping anyway, so they would never reach the file)
+static int Inventory_getbuffer(PyObject *self_, Py_buffer *view, int flags) {
+    InventoryObject *self = (InventoryObject *)self_;
+    if (checkOpen(self) != 0) { view->obj = NULL; return -1; }
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "inventory items are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    self->shape[0] = self->count; // Records
+    self->strides[0] = sizeof(Item); // One record to the next
+    view->obj = self_; // The view keeps the inventory (and with it the mapping) alive
+    Py_INCREF(self_);
+    view->buf = self->items ? (void *)self->items : (void *)self->shape; // Any valid pointer for an empty array
+    view->len = (Py_ssize_t)self->count * (Py_ssize_t)sizeof(Item);
+    view->readonly = 1;
+    view->itemsize = sizeof(Item);
+    view->format = (flags & PyBUF_FORMAT) ? INVPY_ITEM_FORMAT : NULL; // Without a format consumers see unsigned bytes
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    self->exports++;
+    return 0;
+}
+
+static void Inventory_releasebuffer(PyObject *self_, Py_buffer *view) {
+    ((InventoryObject *)self_)->exports--; // PyBuffer_Release drops the reference itself
+}
+
+static PyBufferProcs Inventory_as_buffer = {
+    .bf_getbuffer = Inventory_getbuffer,
+    .bf_releasebuffer = Inventory_releasebuffer,
+};
+
+static Py_ssize_t Inventory_len(PyObject *self) { return ((InventoryObject *)self)->count; } // Slots, deleted ones included
+
+static PySequenceMethods Inventory_as_sequence = {
+    .sq_length = Inventory_len,
+};
+
+static int asId(PyObject *obj, int *out) { // Python int -> C int, OverflowError outside its range
+    long v = PyLong_AsLong(obj);
+    if (v == -1 && PyErr_Occurred()) return -1;
+    if (v < INT_MIN || v > INT_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "id does not fit in a C int");
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+static PyObject *itemTuple(const Item *it) { // (id, name, quantity, price, category)
+    return Py_BuildValue("(isids)", it->id, it->name, it->quantity, (double)it->price, categorytostring(it->category));
+}
+
+static PyObject *slotArray(const int *slots, Py_ssize_t n) { // array('i') copied from 'slots'
+    return PyObject_CallFunction(arrayType, "sy#", "i", (const char *)slots, n * (Py_ssize_t)sizeof(int));
+}
+
+static PyObject *Inventory_get(PyObject *self_, PyObject *arg) {
+    InventoryObject *self = (InventoryObject *)self_;
+    int id;
+    if (asId(arg, &id) != 0) return NULL;
+    if (checkOpen(self) != 0) return NULL;
+    int slot = hashIndexFind(&self->index, id); // A single probe: cheaper than giving up the GIL
+    if (slot < 0) Py_RETURN_NONE;
+    return itemTuple(&self->items[slot]);
+}
+
+static int readIds(PyObject *ids, Py_buffer *view, int **idsPtr, Py_ssize_t *nPtr) { // int32 buffer as is, or any iterable of ints
+    *idsPtr = NULL;
+    if (PyObject_CheckBuffer(ids) && PyObject_GetBuffer(ids, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == 0) {
+        const char *f = view->format ? view->format : "B";
+        if (f[0] == '@' || f[0] == '=' || f[0] == '<') ++f; // Native little-endian either way on the hosts the file format maps on
+        if (view->itemsize == sizeof(int) && (strcmp(f, "i") == 0 || (sizeof(long) == sizeof(int) && strcmp(f, "l") == 0))) {
+            *idsPtr = view->buf; // Zero-copy: array('i') or a NumPy int32 array
+            *nPtr = view->len / (Py_ssize_t)sizeof(int);
+            return 1;
+        }
+        PyBuffer_Release(view); // Another element type: convert through Python ints below
+    }
+    PyErr_Clear();
+    PyObject *seq = PySequence_Fast(ids, "ids must be an iterable of ints");
+    if (!seq) return -1;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    int *out = PyMem_Malloc(n ? (size_t)n * sizeof *out : 1);
+    if (!out) { Py_DECREF(seq); PyErr_NoMemory(); return -1; }
+    for (Py_ssize_t i = 0; i < n; ++i) {
+        if (asId(PySequence_Fast_GET_ITEM(seq, i), &out[i]) != 0) { PyMem_Free(out); Py_DECREF(seq); return -1; }
+    }
+    Py_DECREF(seq);
+    *idsPtr = out;
+    *nPtr = n;
+    return 0;
+}
+
+static PyObject *Inventory_lookup(PyObject *self_, PyObject *ids) {
+    InventoryObject *self = (InventoryObject *)self_;
+    if (checkOpen(self) != 0) return NULL;
+    Py_buffer view;
+    int *keys;
+    Py_ssize_t n;
+    int borrowed = readIds(ids, &view, &keys, &n); // 1: keys point into 'view'
+    if (borrowed < 0) return NULL;
+    int *slots = PyMem_RawMalloc(n ? (size_t)n * sizeof *slots : 1); // Raw: filled without the GIL
+    if (!slots) {
+        if (borrowed) PyBuffer_Release(&view); else PyMem_Free(keys);
+        return PyErr_NoMemory();
+    }
+    self->busy++; // close() waits for us
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < n; ++i) slots[i] = hashIndexFind(&self->index, keys[i]);
+    Py_END_ALLOW_THREADS
+    self->busy--;
+    if (borrowed) PyBuffer_Release(&view); else PyMem_Free(keys);
+    PyObject *result = slotArray(slots, n);
+    PyMem_RawFree(slots);
+    return result;
+}
+
+typedef struct { // Inventory_filter: matching slots collected by the query's row callback
+    const Item *base;
+    int *slots;
+    Py_ssize_t n;
+} FilterRows;
+
+static void collectRow(const Item *item, void *ctx) {
+    FilterRows *rows = ctx;
+    rows->slots[rows->n++] = (int)(item - rows->base); // At most one per slot, so 'slots' never overflows
+}
+
+static PyObject *Inventory_filter(PyObject *self_, PyObject *args) {
+    InventoryObject *self = (InventoryObject *)self_;
+    const char *text;
+    if (!PyArg_ParseTuple(args, "s", &text)) return NULL;
+    if (checkOpen(self) != 0) return NULL;
+    Query q;
+    char err[QUERY_ERROR_MAX];
+    if (queryParse(text, &q, err) != 0) {
+        PyErr_SetString(PyExc_ValueError, err);
+        return NULL;
+    }
+    if (q.aggregate) { // Aggregates are one NumPy call away on the view
+        PyErr_SetString(PyExc_ValueError, "filter returns rows: use conditions (and a limit), not aggregates");
+        return NULL;
+    }
+    FilterRows rows = { self->items, PyMem_RawMalloc(self->count ? (size_t)self->count * sizeof(int) : 1), 0 };
+    if (!rows.slots) return PyErr_NoMemory();
+    QueryResult res;
+    int rc;
+    self->busy++;
+    Py_BEGIN_ALLOW_THREADS // The block kernels scan the mapped array; no Python object is touched
+    rc = queryRun(&q, self->items, self->count, NULL, collectRow, &rows, &res);
+    Py_END_ALLOW_THREADS
+    self->busy--;
+    PyObject *result = rc == 0 ? slotArray(rows.slots, rows.n) : PyErr_NoMemory();
+    PyMem_RawFree(rows.slots);
+    return result;
+}
+
+static PyObject *Inventory_getmapped(PyObject *self, void *closure) {
+    return PyBool_FromLong(((InventoryObject *)self)->map.base != NULL); // False: loaded onto the heap (log replayed, or no mmap)
+}
+
+static PyObject *Inventory_getclosed(PyObject *self_, void *closure) {
+    InventoryObject *self = (InventoryObject *)self_; // Never opened counts as closed too
+    return PyBool_FromLong(!self->open);
+}
+
+static PyObject *Inventory_repr(PyObject *self_) {
+    InventoryObject *self = (InventoryObject *)self_;
+    return PyUnicode_FromFormat("<invpy.Inventory %R, %d slots>", self->path ? self->path : Py_None, self->count);
+}
+
+static PyMethodDef Inventory_methods[] = {
+    {"get", Inventory_get, METH_O, "get(id) -> (id, name, quantity, price, category) or None"},
+    {"lookup", Inventory_lookup, METH_O, "lookup(ids) -> array('i') of slots, -1 where an id is missing; the GIL is released"},
+    {"filter", Inventory_filter, METH_VARARGS, "filter(conditions) -> array('i') of matching slots, e.g. \"category=food and quantity<10\"; the GIL is released"},
+    {"close", Inventory_close, METH_NOARGS, "Unmaps the items; fails while views are alive"},
+    {"__enter__", Inventory_enter, METH_NOARGS, NULL},
+    {"__exit__", Inventory_exit, METH_VARARGS, NULL},
+    {NULL}
+};
+
+static PyGetSetDef Inventory_getset[] = {
+    {"mapped", Inventory_getmapped, NULL, "True if the items point into the file mapping", NULL},
+    {"closed", Inventory_getclosed, NULL, "True after close()", NULL},
+    {NULL}
+};
+
+static PyMemberDef Inventory_members[] = {
+    {"path", T_OBJECT, offsetof(InventoryObject, path), READONLY, "File the items were loaded from"},
+    {NULL}
+};
+
+static PyTypeObject InventoryType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "invpy.Inventory",
+    .tp_doc = PyDoc_STR("Inventory(path, verify=True): items file (or shard manifest) loaded through the mmap path.\n"
+                        "Supports the buffer protocol: numpy.asarray(inv) is a zero-copy record array with fields\n"
+                        "id, name, quantity, price and category; slots with id 0 are deleted."),
+    .tp_basicsize = sizeof(InventoryObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = Inventory_init,
+    .tp_dealloc = Inventory_dealloc,
+    .tp_repr = Inventory_repr,
+    .tp_methods = Inventory_methods,
+    .tp_getset = Inventory_getset,
+    .tp_members = Inventory_members,
+    .tp_as_buffer = &Inventory_as_buffer,
+    .tp_as_sequence = &Inventory_as_sequence,
+};
+
+static struct PyModuleDef invpymodule = {
+    PyModuleDef_HEAD_INIT,
+    "invpy",
+    "Zero-copy access to inventory items files",
+    -1,
+    NULL
+};
+
+PyMODINIT_FUNC PyInit_invpy(void) {
+    if (PyType_Ready(&InventoryType) < 0) return NULL;
+    PyObject *array = PyImport_ImportModule("array");
+    if (!array) return NULL;
+    arrayType = PyObject_GetAttrString(array, "array");
+    Py_DECREF(array);
+    if (!arrayType) return NULL;
+    queryUseKernels(COL_KERNEL_AVX2); // Pick the kernels now: queryRun would do it lazily, racing between threads
+    PyObject *m = PyModule_Create(&invpymodule);
+    if (!m) return NULL;
+    PyModule_AddStringConstant(m, "ITEM_FORMAT", INVPY_ITEM_FORMAT);
+    PyModule_AddIntConstant(m, "ITEM_SIZE", sizeof(Item));
+    Py_INCREF(&InventoryType);
+    if (PyModule_AddObject(m, "Inventory", (PyObject *)&InventoryType) < 0) {
+        Py_DECREF(&InventoryType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
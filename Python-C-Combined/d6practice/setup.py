@@ -0,0 +1,35 @@
+# Build the inventory extension with setuptools
+# invpy.c is the binding; the loader, index and query engine are compiled straight from the C project
+import os
+from setuptools import setup, Extension
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+INVENTORY = os.path.normpath(os.path.join(HERE, "..", "..", "C-learning-and-projects", "Week 1-2 Project")) # The C inventory
+SOURCES = ["item.c", "fileio.c", "uring.c", "hashindex.c", "crc32c.c", "shardio.c", "metrics.c", "histogram.c", "columns.c", "query.c"] # What loadItemsMapped, hashIndexFind and queryRun pull in
+
+os.chdir(HERE) # invpy.c and build/ next to this file wherever setup.py is run from
+setup(
+    name="invpy",
+    version="1.0",
+    ext_modules=[Extension(
+        "invpy",
+        sources=["invpy.c"] + [os.path.join(INVENTORY, s) for s in SOURCES],
+        include_dirs=[INVENTORY],
+        extra_compile_args=["-O2", "-pthread"], # shardio.c loads shards on threads
+        extra_link_args=["-pthread"],
+    )]
+)
+# Build and try it in a terminal:
+# python setup.py build_ext --inplace     # builds invpy.*.so next to invpy.c
+# python - <<'PY'
+# import numpy as np, invpy
+# with invpy.Inventory("../../C-learning-and-projects/Week 1-2 Project/items.dat") as inv:
+#     items = np.asarray(inv)                        # Record array over the mapped file, nothing copied
+#     live = items[items["id"] != 0]                 # Deleted slots have id 0
+#     print(live["price"].mean(), inv.get(42))
+#     low = items[inv.filter("category=food and quantity<10")] # Slots from the C query engine, GIL released
+#     slots = inv.lookup(np.array([1, 2, 3], dtype=np.int32))  # -1 where an id is missing
+#     del items, live, low                           # close() refuses while views are alive
+# PY
+
+# Why: the analysts' scripts get the Item array as the C code has it (PEP 3118 format T{...}), instead of re-parsing items.dat with struct.unpack